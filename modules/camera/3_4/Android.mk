@@ -47,13 +47,18 @@ v4l2_src_files := \
   arc/frame_buffer.cpp \
   arc/image_processor.cpp \
   arc/jpeg_compressor.cpp \
+  arc/thread_pool.cpp \
   camera.cpp \
+  capability_cache.cpp \
+  capture_pipeline.cpp \
   capture_request.cpp \
   format_metadata_factory.cpp \
+  latency_histogram.cpp \
   metadata/boottime_state_delegate.cpp \
   metadata/enum_converter.cpp \
   metadata/metadata.cpp \
   metadata/metadata_reader.cpp \
+  request_queue.cpp \
   request_tracker.cpp \
   static_properties.cpp \
   stream_format.cpp \
@@ -63,6 +68,11 @@ v4l2_src_files := \
   v4l2_wrapper.cpp \
 
 v4l2_test_files := \
+  arc/cached_frame_test.cpp \
+  arc/image_processor_test.cpp \
+  arc/jpeg_compressor_test.cpp \
+  capability_cache_test.cpp \
+  capture_pipeline_test.cpp \
   format_metadata_factory_test.cpp \
   metadata/control_test.cpp \
   metadata/default_option_delegate_test.cpp \
@@ -81,6 +91,7 @@ v4l2_test_files := \
   metadata/tagged_control_delegate_test.cpp \
   metadata/tagged_control_options_test.cpp \
   metadata/v4l2_control_delegate_test.cpp \
+  request_queue_test.cpp \
   request_tracker_test.cpp \
   static_properties_test.cpp \
 
@@ -121,4 +132,105 @@ LOCAL_SRC_FILES := \
 
 include $(BUILD_NATIVE_TEST)
 
+# Dequeue CPU-usage benchmark (run against vivid or a real V4L2 device).
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera.v4l2_dequeue_benchmark
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0 SPDX-license-identifier-BSD
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/../../../NOTICE
+LOCAL_CFLAGS += $(v4l2_cflags)
+LOCAL_SRC_FILES := v4l2_dequeue_benchmark.cpp
+include $(BUILD_EXECUTABLE)
+
+# Image conversion benchmark (format x resolution x thread count).
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera.v4l2_image_processor_benchmark
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0 SPDX-license-identifier-BSD
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/../../../NOTICE
+LOCAL_CFLAGS += $(v4l2_cflags)
+LOCAL_SHARED_LIBRARIES := $(v4l2_shared_libs)
+LOCAL_STATIC_LIBRARIES := $(v4l2_static_libs)
+LOCAL_C_INCLUDES += $(v4l2_c_includes)
+LOCAL_SRC_FILES := \
+  image_processor_benchmark.cpp \
+  $(filter arc/%,$(v4l2_src_files)) \
+
+include $(BUILD_EXECUTABLE)
+
+# JPEG encoding throughput benchmark (8/12/20 MP x thread count).
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera.v4l2_jpeg_compressor_benchmark
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0 SPDX-license-identifier-BSD
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/../../../NOTICE
+LOCAL_CFLAGS += $(v4l2_cflags)
+LOCAL_SHARED_LIBRARIES := $(v4l2_shared_libs)
+LOCAL_STATIC_LIBRARIES := $(v4l2_static_libs)
+LOCAL_C_INCLUDES += $(v4l2_c_includes)
+LOCAL_SRC_FILES := \
+  jpeg_compressor_benchmark.cpp \
+  arc/jpeg_compressor.cpp \
+  arc/thread_pool.cpp \
+
+include $(BUILD_EXECUTABLE)
+
+# Per-frame request/result metadata cost (run against vivid or a real device).
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera.v4l2_metadata_benchmark
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0 SPDX-license-identifier-BSD
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/../../../NOTICE
+LOCAL_CFLAGS += $(v4l2_cflags)
+LOCAL_SHARED_LIBRARIES := $(v4l2_shared_libs)
+LOCAL_HEADER_LIBRARIES := libgtest_prod_headers
+LOCAL_STATIC_LIBRARIES := $(v4l2_static_libs)
+LOCAL_C_INCLUDES += $(v4l2_c_includes)
+LOCAL_SRC_FILES := \
+  metadata_benchmark.cpp \
+  $(v4l2_src_files) \
+
+include $(BUILD_EXECUTABLE)
+
+# Still capture JPEG latency, with the EXIF thumbnail made serially or
+# concurrently.
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera.v4l2_still_capture_benchmark
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0 SPDX-license-identifier-BSD
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/../../../NOTICE
+LOCAL_CFLAGS += $(v4l2_cflags)
+LOCAL_SHARED_LIBRARIES := $(v4l2_shared_libs)
+LOCAL_STATIC_LIBRARIES := $(v4l2_static_libs)
+LOCAL_C_INCLUDES += $(v4l2_c_includes)
+LOCAL_SRC_FILES := \
+  still_capture_benchmark.cpp \
+  $(filter arc/%,$(v4l2_src_files)) \
+
+include $(BUILD_EXECUTABLE)
+
+# Static metadata construction time with a cold and a warm capability cache
+# (run against a real V4L2 device).
+# ==============================================================================
+include $(CLEAR_VARS)
+LOCAL_MODULE := camera.v4l2_camera_open_benchmark
+LOCAL_LICENSE_KINDS := SPDX-license-identifier-Apache-2.0 SPDX-license-identifier-BSD
+LOCAL_LICENSE_CONDITIONS := notice
+LOCAL_NOTICE_FILE := $(LOCAL_PATH)/../../../NOTICE
+LOCAL_CFLAGS += $(v4l2_cflags)
+LOCAL_SHARED_LIBRARIES := $(v4l2_shared_libs)
+LOCAL_HEADER_LIBRARIES := libgtest_prod_headers
+LOCAL_STATIC_LIBRARIES := $(v4l2_static_libs)
+LOCAL_C_INCLUDES += $(v4l2_c_includes)
+LOCAL_SRC_FILES := \
+  camera_open_benchmark.cpp \
+  $(v4l2_src_files) \
+
+include $(BUILD_EXECUTABLE)
+
 endif # USE_CAMERA_V4L2_HAL
@@ -14,16 +14,22 @@ namespace arc {
 
 using android::CameraMetadata;
 
+// Upper bound on distinct output sizes kept scaled at once. A stream
+// configuration has only a handful of streams.
+static const size_t kMaxScaledFrames = 8;
+
 CachedFrame::CachedFrame()
     : source_frame_(nullptr),
       cropped_buffer_capacity_(0),
-      yu12_frame_(new AllocatedFrameBuffer(0)),
-      scaled_frame_(new AllocatedFrameBuffer(0)) {}
+      yu12_frame_(new AllocatedFrameBuffer(0)) {}
 
 CachedFrame::~CachedFrame() { UnsetSource(); }
 
 int CachedFrame::SetSource(const FrameBuffer* frame, int rotate_degree) {
   source_frame_ = frame;
+  for (auto& scaled_frame : scaled_frames_) {
+    scaled_frame.valid = false;
+  }
   int res = ConvertToYU12();
   if (res != 0) {
     return res;
@@ -73,19 +79,41 @@ int CachedFrame::Convert(const CameraMetadata& metadata, FrameBuffer* out_frame,
   FrameBuffer* source_frame = yu12_frame_.get();
   if (GetWidth() != out_frame->GetWidth() ||
       GetHeight() != out_frame->GetHeight()) {
-    size_t cache_size = ImageProcessor::GetConvertedSize(
-        yu12_frame_->GetFourcc(), out_frame->GetWidth(),
-        out_frame->GetHeight());
-    if (cache_size == 0) {
-      return -EINVAL;
-    } else if (cache_size > scaled_frame_->GetBufferSize()) {
-      scaled_frame_.reset(new AllocatedFrameBuffer(cache_size));
+    ScaledFrame* scaled = nullptr;
+    for (auto& candidate : scaled_frames_) {
+      if (candidate.frame->GetWidth() == out_frame->GetWidth() &&
+          candidate.frame->GetHeight() == out_frame->GetHeight()) {
+        scaled = &candidate;
+        break;
+      }
+    }
+    if (!scaled) {
+      size_t cache_size = ImageProcessor::GetConvertedSize(
+          yu12_frame_->GetFourcc(), out_frame->GetWidth(),
+          out_frame->GetHeight());
+      if (cache_size == 0) {
+        return -EINVAL;
+      }
+      if (scaled_frames_.size() >= kMaxScaledFrames) {
+        scaled_frames_.erase(scaled_frames_.begin());
+      }
+      scaled_frames_.push_back(
+          {std::unique_ptr<AllocatedFrameBuffer>(
+               new AllocatedFrameBuffer(cache_size)),
+           false});
+      scaled = &scaled_frames_.back();
+      scaled->frame->SetWidth(out_frame->GetWidth());
+      scaled->frame->SetHeight(out_frame->GetHeight());
+    }
+    if (!scaled->valid) {
+      int res = ImageProcessor::Scale(*yu12_frame_.get(), scaled->frame.get());
+      if (res) {
+        return res;
+      }
+      scaled->valid = true;
     }
-    scaled_frame_->SetWidth(out_frame->GetWidth());
-    scaled_frame_->SetHeight(out_frame->GetHeight());
-    ImageProcessor::Scale(*yu12_frame_.get(), scaled_frame_.get());
 
-    source_frame = scaled_frame_.get();
+    source_frame = scaled->frame.get();
   }
   return ImageProcessor::ConvertFormat(metadata, *source_frame, out_frame);
 }
@@ -7,6 +7,7 @@
 #define HAL_USB_CACHED_FRAME_H_
 
 #include <memory>
+#include <vector>
 
 #include <camera/CameraMetadata.h>
 #include "arc/image_processor.h"
@@ -16,6 +17,8 @@ namespace arc {
 // CachedFrame contains a source FrameBuffer and a cached, converted
 // FrameBuffer. The incoming frames would be converted to YU12, the default
 // format of libyuv, to allow convenient processing.
+// A CachedFrame is meant to be kept across frames: its buffers grow to fit
+// and are then reused, so steady-state conversion doesn't allocate.
 class CachedFrame {
  public:
   CachedFrame();
@@ -48,7 +51,8 @@ class CachedFrame {
 
   // Caller should fill everything except |data_size| and |fd| of |out_frame|.
   // The function will do format conversion and scale to fit |out_frame|
-  // requirement.
+  // requirement. Outputs of the same size share one scaled copy of the
+  // current source.
   // If |video_hack| is true, it outputs YU12 when |hal_pixel_format| is YV12
   // (swapping U/V planes). Caller should fill |fourcc|, |data|, and
   // Return non-zero error code on failure; return 0 on success.
@@ -76,8 +80,13 @@ class CachedFrame {
   // Cache YU12 decoded results.
   std::unique_ptr<AllocatedFrameBuffer> yu12_frame_;
 
-  // Temporary buffer for scaled results.
-  std::unique_ptr<AllocatedFrameBuffer> scaled_frame_;
+  // Scaled results, one per output size seen. Invalidated by SetSource().
+  struct ScaledFrame {
+    std::unique_ptr<AllocatedFrameBuffer> frame;
+    // Whether |frame| holds the current source.
+    bool valid;
+  };
+  std::vector<ScaledFrame> scaled_frames_;
 };
 
 }  // namespace arc
@@ -0,0 +1,185 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "arc/cached_frame.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <linux/videodev2.h>
+#include "arc/common.h"
+#include "arc/jpeg_compressor.h"
+
+using testing::Test;
+
+// Count heap allocations made while |g_count_allocations| is set.
+static std::atomic<bool> g_count_allocations(false);
+static std::atomic<size_t> g_allocations(0);
+
+void* operator new(size_t size) {
+  if (g_count_allocations) {
+    ++g_allocations;
+  }
+  void* p = malloc(size ? size : 1);
+  if (!p) {
+    abort();
+  }
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+namespace arc {
+
+class CachedFrameTest : public Test {
+ protected:
+  void SetUp() {
+    // A YUYV capture, which always needs decoding to YU12 first.
+    source_.reset(new AllocatedFrameBuffer(kWidth * kHeight * 2));
+    source_->SetDataSize(kWidth * kHeight * 2);
+    source_->SetFourcc(V4L2_PIX_FMT_YUYV);
+    source_->SetWidth(kWidth);
+    source_->SetHeight(kHeight);
+    FillSource(0);
+
+    // Outputs as a preview/video/still configuration would have them.
+    AddOutput(V4L2_PIX_FMT_YUV420, kWidth, kHeight);
+    AddOutput(V4L2_PIX_FMT_YUV420, kWidth / 2, kHeight / 2);
+    AddOutput(V4L2_PIX_FMT_NV21, kWidth / 2, kHeight / 2);
+    AddOutput(V4L2_PIX_FMT_BGR32, kWidth / 4, kHeight / 4);
+  }
+
+  void FillSource(uint8_t seed) {
+    uint8_t* data = source_->GetData();
+    for (size_t i = 0; i < source_->GetDataSize(); ++i) {
+      data[i] = static_cast<uint8_t>(seed + i * 7);
+    }
+  }
+
+  void AddOutput(uint32_t fourcc, uint32_t width, uint32_t height) {
+    std::unique_ptr<AllocatedFrameBuffer> output(new AllocatedFrameBuffer(0));
+    output->SetFourcc(fourcc);
+    output->SetWidth(width);
+    output->SetHeight(height);
+    outputs_.push_back(std::move(output));
+  }
+
+  // Convert one captured frame to every output.
+  void ConvertFrame() {
+    ASSERT_EQ(dut_.SetSource(source_.get(), 0), 0);
+    for (auto& output : outputs_) {
+      ASSERT_EQ(dut_.Convert(metadata_, output.get()), 0);
+    }
+  }
+
+  static const uint32_t kWidth = 64;
+  static const uint32_t kHeight = 48;
+
+  CachedFrame dut_;
+  android::CameraMetadata metadata_;
+  std::unique_ptr<AllocatedFrameBuffer> source_;
+  std::vector<std::unique_ptr<AllocatedFrameBuffer>> outputs_;
+};
+
+TEST_F(CachedFrameTest, SteadyStateDoesNotAllocate) {
+  // The first frame sizes the YU12, scaled and output buffers.
+  ConvertFrame();
+
+  g_allocations = 0;
+  g_count_allocations = true;
+  for (int i = 0; i < 10; ++i) {
+    ConvertFrame();
+  }
+  g_count_allocations = false;
+  EXPECT_EQ(g_allocations, 0u);
+}
+
+// A request's only output is converted straight from the camera format,
+// bypassing the CachedFrame; semi-planar outputs need chroma scratch space.
+TEST_F(CachedFrameTest, DirectSemiPlanarConversionDoesNotAllocate) {
+  // An MJPEG capture of the YUYV one.
+  AllocatedFrameBuffer yu12(0);
+  yu12.SetFourcc(V4L2_PIX_FMT_YUV420);
+  yu12.SetWidth(kWidth);
+  yu12.SetHeight(kHeight);
+  ASSERT_EQ(ImageProcessor::ConvertFormat(metadata_, *source_, &yu12), 0);
+  JpegCompressor compressor;
+  ASSERT_TRUE(compressor.CompressImage(yu12.GetData(), kWidth, kHeight, 90,
+                                       nullptr, 0));
+  AllocatedFrameBuffer mjpeg(compressor.GetCompressedImageSize());
+  mjpeg.SetDataSize(compressor.GetCompressedImageSize());
+  mjpeg.SetFourcc(V4L2_PIX_FMT_MJPEG);
+  mjpeg.SetWidth(kWidth);
+  mjpeg.SetHeight(kHeight);
+  memcpy(mjpeg.GetData(), compressor.GetCompressedImagePtr(),
+         compressor.GetCompressedImageSize());
+
+  outputs_.clear();
+  AddOutput(V4L2_PIX_FMT_NV12, kWidth, kHeight);
+  AddOutput(V4L2_PIX_FMT_NV21, kWidth, kHeight);
+  auto convert_frame = [&] {
+    for (const FrameBuffer* source : {source_.get(), &mjpeg}) {
+      for (auto& output : outputs_) {
+        ASSERT_EQ(ImageProcessor::ConvertFormat(metadata_, *source,
+                                                output.get()),
+                  0)
+            << FormatToString(source->GetFourcc()) << " to "
+            << FormatToString(output->GetFourcc());
+      }
+    }
+  };
+  // The first frame sizes the outputs and the scratch space.
+  convert_frame();
+
+  g_allocations = 0;
+  g_count_allocations = true;
+  for (int i = 0; i < 10; ++i) {
+    convert_frame();
+  }
+  g_count_allocations = false;
+  EXPECT_EQ(g_allocations, 0u);
+}
+
+TEST_F(CachedFrameTest, SameSizeOutputsShareScaling) {
+  ConvertFrame();
+  // The YU12 and NV21 outputs at half size have identical Y planes.
+  const size_t y_size = (kWidth / 2) * (kHeight / 2);
+  EXPECT_EQ(memcmp(outputs_[1]->GetData(), outputs_[2]->GetData(), y_size),
+            0);
+}
+
+TEST_F(CachedFrameTest, NewSourceInvalidatesScaledFrames) {
+  ConvertFrame();
+  std::vector<uint8_t> first(outputs_[1]->GetData(),
+                             outputs_[1]->GetData() +
+                                 outputs_[1]->GetDataSize());
+
+  FillSource(100);
+  ConvertFrame();
+  std::vector<uint8_t> second(outputs_[1]->GetData(),
+                              outputs_[1]->GetData() +
+                                  outputs_[1]->GetDataSize());
+  EXPECT_NE(first, second);
+}
+
+}  // namespace arc
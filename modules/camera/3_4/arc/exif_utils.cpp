@@ -46,6 +46,8 @@ ExifUtils::ExifUtils()
       yu12_height_(0),
       thumbnail_width_(0),
       thumbnail_height_(0),
+      thumbnail_filtered_(false),
+      thumbnail_generated_(false),
       exif_data_(nullptr),
       app1_buffer_(nullptr),
       app1_length_(0) {}
@@ -288,9 +290,15 @@ bool ExifUtils::SetThumbnailSize(uint16_t width, uint16_t height) {
   }
   thumbnail_width_ = width;
   thumbnail_height_ = height;
+  thumbnail_generated_ = false;
   return true;
 }
 
+void ExifUtils::SetThumbnailFiltering(bool enabled) {
+  thumbnail_filtered_ = enabled;
+  thumbnail_generated_ = false;
+}
+
 bool ExifUtils::SetOrientation(uint16_t orientation) {
   std::unique_ptr<ExifEntry> entry = AddEntry(EXIF_IFD_0, EXIF_TAG_ORIENTATION);
   if (!entry) {
@@ -328,7 +336,7 @@ bool ExifUtils::SetOrientation(uint16_t orientation) {
 bool ExifUtils::GenerateApp1() {
   DestroyApp1();
   if (thumbnail_width_ > 0 && thumbnail_height_ > 0) {
-    if (!GenerateThumbnail()) {
+    if (!thumbnail_generated_ && !GenerateThumbnail()) {
       LOGF(ERROR) << "Generate thumbnail image failed";
       return false;
     }
@@ -364,6 +372,8 @@ void ExifUtils::Reset() {
   yu12_height_ = 0;
   thumbnail_width_ = 0;
   thumbnail_height_ = 0;
+  thumbnail_filtered_ = false;
+  thumbnail_generated_ = false;
   DestroyApp1();
   if (exif_data_) {
     /*
@@ -456,6 +466,10 @@ bool ExifUtils::SetImageLength(uint16_t length) {
 }
 
 bool ExifUtils::GenerateThumbnail() {
+  thumbnail_generated_ = false;
+  if (thumbnail_width_ == 0 || thumbnail_height_ == 0) {
+    return true;
+  }
   // Resize yuv image to |thumbnail_width_| x |thumbnail_height_|.
   std::vector<uint8_t> scaled_buffer;
   if (!GenerateYuvThumbnail(&scaled_buffer)) {
@@ -470,6 +484,7 @@ bool ExifUtils::GenerateThumbnail() {
     LOGF(ERROR) << "Compress thumbnail failed";
     return false;
   }
+  thumbnail_generated_ = true;
   return true;
 }
 
@@ -490,7 +505,7 @@ bool ExifUtils::GenerateYuvThumbnail(std::vector<uint8_t>* scaled_buffer) {
       yu12_width_, yu12_height_, scaled_y_plane, thumbnail_width_,
       scaled_u_plane, thumbnail_width_ / 2, scaled_v_plane,
       thumbnail_width_ / 2, thumbnail_width_, thumbnail_height_,
-      libyuv::kFilterNone);
+      thumbnail_filtered_ ? libyuv::kFilterBox : libyuv::kFilterNone);
   if (result != 0) {
     LOGF(ERROR) << "Scale I420 image failed";
     return false;
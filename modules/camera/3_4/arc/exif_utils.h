@@ -91,10 +91,21 @@ class ExifUtils {
   // Returns false if |width| or |height| is not even.
   bool SetThumbnailSize(uint16_t width, uint16_t height);
 
+  // Scales the thumbnail down with a box filter instead of point sampling.
+  // It looks better at the cost of reading the whole input image.
+  void SetThumbnailFiltering(bool enabled);
+
   // Sets image orientation.
   // Returns false if memory allocation fails.
   bool SetOrientation(uint16_t orientation);
 
+  // Generates a thumbnail if a thumbnail size is set. It only reads the input
+  // image, so it can run on another thread while the main image is compressed
+  // (without the APP1 segment); generateApp1() then uses the result instead of
+  // generating the thumbnail itself.
+  // Returns false if failed.
+  bool GenerateThumbnail();
+
   // Generates APP1 segment.
   // Returns false if generating APP1 segment fails.
   bool GenerateApp1();
@@ -134,11 +145,6 @@ class ExifUtils {
   // Returns false if memory allocation fails.
   bool SetImageLength(uint16_t length);
 
-  // Generates a thumbnail. Calls compressor_.getCompressedImagePtr() to get the
-  // result image.
-  // Returns false if failed.
-  bool GenerateThumbnail();
-
   // Resizes the thumbnail yuv image to |thumbnail_width_| x |thumbnail_height_|
   // and stores in |scaled_buffer|.
   // Returns false if scale image failed.
@@ -156,6 +162,10 @@ class ExifUtils {
   // The size of thumbnail.
   uint16_t thumbnail_width_;
   uint16_t thumbnail_height_;
+  // Whether to box filter the thumbnail.
+  bool thumbnail_filtered_;
+  // Whether |compressor_| holds the thumbnail of the current image.
+  bool thumbnail_generated_;
 
   // The Exif data (APP1). Owned by this class.
   ExifData* exif_data_;
@@ -19,7 +19,8 @@ FrameBuffer::FrameBuffer()
       buffer_size_(0),
       width_(0),
       height_(0),
-      fourcc_(0) {}
+      fourcc_(0),
+      has_ycbcr_layout_(false) {}
 
 FrameBuffer::~FrameBuffer() {}
 
@@ -33,6 +34,46 @@ int FrameBuffer::SetDataSize(size_t data_size) {
   return 0;
 }
 
+bool FrameBuffer::GetYCbCrLayout(YCbCrLayout* layout) const {
+  if (has_ycbcr_layout_) {
+    *layout = ycbcr_layout_;
+    return true;
+  }
+
+  uint32_t y_size = width_ * height_;
+  layout->y = data_;
+  layout->y_stride = width_;
+  switch (fourcc_) {
+    case V4L2_PIX_FMT_YUV420:  // YU12
+      layout->cb = data_ + y_size;
+      layout->cr = data_ + y_size * 5 / 4;
+      layout->c_stride = width_ / 2;
+      layout->chroma_step = 1;
+      return true;
+    case V4L2_PIX_FMT_YVU420:  // YV12, with strides aligned to 16 bytes.
+      layout->y_stride = (width_ + 15) & ~15;
+      layout->c_stride = (width_ / 2 + 15) & ~15;
+      layout->cr = data_ + layout->y_stride * height_;
+      layout->cb = layout->cr + layout->c_stride * height_ / 2;
+      layout->chroma_step = 1;
+      return true;
+    case V4L2_PIX_FMT_NV12:
+      layout->cb = data_ + y_size;
+      layout->cr = layout->cb + 1;
+      layout->c_stride = width_;
+      layout->chroma_step = 2;
+      return true;
+    case V4L2_PIX_FMT_NV21:
+      layout->cr = data_ + y_size;
+      layout->cb = layout->cr + 1;
+      layout->c_stride = width_;
+      layout->chroma_step = 2;
+      return true;
+    default:
+      return false;
+  }
+}
+
 AllocatedFrameBuffer::AllocatedFrameBuffer(int buffer_size) {
   buffer_.reset(new uint8_t[buffer_size]);
   buffer_size_ = buffer_size;
@@ -139,11 +180,22 @@ int GrallocFrameBuffer::Map() {
   switch (fourcc_) {
     case V4L2_PIX_FMT_YUV420:
     case V4L2_PIX_FMT_YVU420:
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV21:
     case V4L2_PIX_FMT_YUYV:
       android_ycbcr yuv_data;
       ret = gralloc_module_->lock_ycbcr(gralloc_module_, buffer_, stream_usage_,
                                         0, 0, width_, height_, &yuv_data);
       addr = yuv_data.y;
+      // Write 4:2:0 frames the way gralloc laid them out, which for flexible
+      // YUV may well be semi-planar.
+      has_ycbcr_layout_ = !ret && fourcc_ != V4L2_PIX_FMT_YUYV;
+      ycbcr_layout_.y = static_cast<uint8_t*>(yuv_data.y);
+      ycbcr_layout_.cb = static_cast<uint8_t*>(yuv_data.cb);
+      ycbcr_layout_.cr = static_cast<uint8_t*>(yuv_data.cr);
+      ycbcr_layout_.y_stride = yuv_data.ystride;
+      ycbcr_layout_.c_stride = yuv_data.cstride;
+      ycbcr_layout_.chroma_step = yuv_data.chroma_step;
       break;
     case V4L2_PIX_FMT_JPEG:
       ret = gralloc_module_->lock(gralloc_module_, buffer_, stream_usage_, 0, 0,
@@ -165,9 +217,13 @@ int GrallocFrameBuffer::Map() {
 
   data_ = static_cast<uint8_t*>(addr);
   if (fourcc_ == V4L2_PIX_FMT_YVU420 || fourcc_ == V4L2_PIX_FMT_YUV420 ||
-      fourcc_ == V4L2_PIX_FMT_NV21 || fourcc_ == V4L2_PIX_FMT_RGB32 ||
-      fourcc_ == V4L2_PIX_FMT_BGR32) {
+      fourcc_ == V4L2_PIX_FMT_NV12 || fourcc_ == V4L2_PIX_FMT_NV21 ||
+      fourcc_ == V4L2_PIX_FMT_RGB32 || fourcc_ == V4L2_PIX_FMT_BGR32) {
     buffer_size_ = ImageProcessor::GetConvertedSize(fourcc_, width_, height_);
+  } else if (fourcc_ == V4L2_PIX_FMT_JPEG) {
+    // The compressed size isn't known up front; the whole locked range can
+    // be written.
+    buffer_size_ = device_buffer_length_;
   }
 
   is_mapped_ = true;
@@ -181,6 +237,7 @@ int GrallocFrameBuffer::Unmap() {
     return -EINVAL;
   }
   is_mapped_ = false;
+  has_ycbcr_layout_ = false;
   return 0;
 }
 
@@ -17,6 +17,18 @@ namespace arc {
 
 class FrameBuffer {
  public:
+  // Where the planes of a YUV 4:2:0 frame are, as android_ycbcr reports them.
+  struct YCbCrLayout {
+    uint8_t* y;
+    uint8_t* cb;
+    uint8_t* cr;
+    uint32_t y_stride;
+    uint32_t c_stride;
+    // Bytes from one chroma sample to the next: 1 for planar layouts, 2 for
+    // semi-planar ones (NV12, NV21).
+    uint32_t chroma_step;
+  };
+
   FrameBuffer();
   virtual ~FrameBuffer();
 
@@ -37,6 +49,12 @@ class FrameBuffer {
   void SetFourcc(uint32_t fourcc) { fourcc_ = fourcc; }
   virtual int SetDataSize(size_t data_size);
 
+  // Get the plane layout of a YUV 4:2:0 frame: the one reported when the
+  // buffer was mapped, or else the tightly packed planes of |fourcc_|
+  // (V4L2_PIX_FMT_YUV420, YVU420, NV12 or NV21) starting at |data_|. Return
+  // false for other formats.
+  bool GetYCbCrLayout(YCbCrLayout* layout) const;
+
  protected:
   uint8_t* data_;
 
@@ -52,6 +70,10 @@ class FrameBuffer {
 
   // This is V4L2_PIX_FMT_* in linux/videodev2.h.
   uint32_t fourcc_;
+
+  // Set by Map() if the buffer has its own plane layout.
+  bool has_ycbcr_layout_;
+  YCbCrLayout ycbcr_layout_;
 };
 
 // AllocatedFrameBuffer is used for the buffer from hal malloc-ed. User should
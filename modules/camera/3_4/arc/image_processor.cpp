@@ -5,14 +5,20 @@
 
 #include "arc/image_processor.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <ctime>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include <libyuv.h>
 #include "arc/common.h"
 #include "arc/exif_utils.h"
 #include "arc/jpeg_compressor.h"
+#include "arc/thread_pool.h"
 
 namespace arc {
 
@@ -26,6 +32,8 @@ using android::CameraMetadata;
  * -----------------------------------------------------------------------------
  * HAL_PIXEL_FORMAT_YV12         = V4L2_PIX_FMT_YVU420 = FOURCC_YV12
  * HAL_PIXEL_FORMAT_YCrCb_420_SP = V4L2_PIX_FMT_NV21   = FOURCC_NV21
+ * HAL_PIXEL_FORMAT_YCbCr_420_888 = V4L2_PIX_FMT_YUV420, laid out by gralloc
+ *                                 (e.g. as V4L2_PIX_FMT_NV12 = FOURCC_NV12)
  * HAL_PIXEL_FORMAT_RGBA_8888    = V4L2_PIX_FMT_RGB32  = FOURCC_BGR4
  * HAL_PIXEL_FORMAT_YCbCr_422_I  = V4L2_PIX_FMT_YUYV   = FOURCC_YUYV
  *                                                     = FOURCC_YUY2
@@ -42,22 +50,70 @@ using android::CameraMetadata;
  * YV12 horizontal stride should be a multiple of 16 pixels. See
  * android.graphics.ImageFormat.YV12.
  * The stride of ARGB, YU12, and NV21 are always equal to the width.
+ * Gralloc buffers are written with the plane layout gralloc reports instead.
  *
  * Conversion Path:
  * MJPG/YUYV (from camera) -> YU12 -> ARGB (preview)
- *                                 -> NV21 (apps)
+ *                                 -> NV12/NV21 (apps)
  *                                 -> YV12 (apps)
  *                                 -> YU12 (video encoder)
+ *                                 -> JPEG (still capture)
+ * MJPG/YUYV (from camera) -> YU12/YV12/NV12/NV21 directly, when the frame
+ *                            isn't needed in other formats or sizes.
  */
 
-// YV12 horizontal stride should be a multiple of 16 pixels for each plane.
-// |dst_stride_uv| is the pixel stride of u or v plane.
-static int YU12ToYV12(const void* yv12, void* yu12, int width, int height,
-                      int dst_stride_y, int dst_stride_uv);
-static int YU12ToNV21(const void* yv12, void* nv21, int width, int height);
+// Converts rows [|first_row|, |last_row|) of |in_frame| to |out_frame|.
+typedef int (*ConvertRowsFunction)(const FrameBuffer& in_frame,
+                                   uint32_t first_row, uint32_t last_row,
+                                   FrameBuffer* out_frame);
+static int ConvertInBands(ConvertRowsFunction convert,
+                          const FrameBuffer& in_frame, FrameBuffer* out_frame);
+// The YCbCr functions write any 4:2:0 layout |out_frame| reports (YU12,
+// YV12, NV12, NV21 or the layout of a gralloc buffer).
+static int YUYVToYCbCrRows(const FrameBuffer& in_frame, uint32_t first_row,
+                           uint32_t last_row, FrameBuffer* out_frame);
+static int YU12ToYCbCrRows(const FrameBuffer& in_frame, uint32_t first_row,
+                           uint32_t last_row, FrameBuffer* out_frame);
+static int MJPEGToYCbCr(const FrameBuffer& in_frame, FrameBuffer* out_frame);
+static int YU12ToABGRRows(const FrameBuffer& in_frame, uint32_t first_row,
+                          uint32_t last_row, FrameBuffer* out_frame);
+static int YU12ToARGBRows(const FrameBuffer& in_frame, uint32_t first_row,
+                          uint32_t last_row, FrameBuffer* out_frame);
+
+// One band of one plane for Scale().
+struct ScaleBand {
+  const uint8_t* src;
+  int src_stride;
+  int src_width;
+  int src_height;
+  uint8_t* dst;
+  int dst_stride;
+  int dst_width;
+  int dst_height;
+};
+// Split scaling a plane into at most |max_bands| bands with the same result.
+// Return the number of bands written to |bands|.
+static size_t SplitScalePlane(const uint8_t* src, int src_stride,
+                              int src_width, int src_height, uint8_t* dst,
+                              int dst_stride, int dst_width, int dst_height,
+                              size_t max_bands, ScaleBand* bands);
 static bool ConvertToJpeg(const CameraMetadata& metadata,
                           const FrameBuffer& in_frame, FrameBuffer* out_frame);
 static bool SetExifTags(const CameraMetadata& metadata, ExifUtils* utils);
+// Fill |utils| with the EXIF data for |metadata|, with |yu12_data| as the
+// source of the thumbnail, if any. Set |jpeg_quality| to the requested
+// quality of the main image.
+static bool InitializeExif(const CameraMetadata& metadata,
+                           const uint8_t* yu12_data, uint32_t width,
+                           uint32_t height, ExifUtils* utils,
+                           int* jpeg_quality);
+// InitializeExif() and generate the APP1 segment.
+static bool GenerateApp1(const CameraMetadata& metadata,
+                         const uint8_t* yu12_data, uint32_t width,
+                         uint32_t height, ExifUtils* utils, int* jpeg_quality);
+// Write the APP1 segment generated by |utils|, marker included, to |dst|.
+// Return the end of it.
+static uint8_t* WriteApp1(ExifUtils* utils, uint8_t* dst);
 
 // How precise the float-to-rational conversion for EXIF tags would be.
 static const int kRationalPrecision = 10000;
@@ -67,6 +123,108 @@ static const int DEFAULT_JPEG_QUALITY = 80;
 
 inline static size_t Align16(size_t value) { return (value + 15) & ~15; }
 
+inline static bool IsYCbCr420(uint32_t fourcc) {
+  return fourcc == V4L2_PIX_FMT_YUV420 || fourcc == V4L2_PIX_FMT_YVU420 ||
+         fourcc == V4L2_PIX_FMT_NV12 || fourcc == V4L2_PIX_FMT_NV21;
+}
+
+// Frames are split into bands of at least this many rows, so that small
+// frames aren't worth waking other threads for.
+static const uint32_t kMinBandRows = 64;
+// Rows converted at a time for semi-planar output, whose chroma goes through
+// scratch planes that should stay in cache.
+static const uint32_t kChromaChunkRows = 16;
+// Default limit on the threads a conversion runs on.
+static const size_t kDefaultMaxThreads = 4;
+// Upper bound for SetMaxThreads().
+static const size_t kMaxThreads = 8;
+
+// JPEG markers, each following a 0xFF byte.
+static const uint8_t kJpegMarkerPrefix = 0xFF;
+static const uint8_t kJpegSOI = 0xD8;
+static const uint8_t kJpegEOI = 0xD9;
+static const uint8_t kJpegSOS = 0xDA;
+static const uint8_t kJpegDHT = 0xC4;
+static const uint8_t kJpegAPP0 = 0xE0;
+static const uint8_t kJpegAPP1 = 0xE1;
+
+// DHT segment with the standard Huffman tables of JPEG Annex K.3, which
+// Motion JPEG streams (e.g. from UVC cameras) use without including them.
+static const uint8_t kStandardDHT[] = {
+    0xFF, 0xC4, 0x01, 0xA2,
+    // Luminance DC.
+    0x00, 0x00, 0x01, 0x05, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07, 0x08, 0x09, 0x0A, 0x0B,
+    // Luminance AC.
+    0x10, 0x00, 0x02, 0x01, 0x03, 0x03, 0x02, 0x04, 0x03, 0x05, 0x05, 0x04,
+    0x04, 0x00, 0x00, 0x01, 0x7D, 0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05,
+    0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14,
+    0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1,
+    0xF0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19,
+    0x1A, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38,
+    0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54,
+    0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84,
+    0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97,
+    0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA,
+    0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4,
+    0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7,
+    0xD8, 0xD9, 0xDA, 0xE1, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9,
+    0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA,
+    // Chrominance DC.
+    0x01, 0x00, 0x03, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+    0x07, 0x08, 0x09, 0x0A, 0x0B,
+    // Chrominance AC.
+    0x11, 0x00, 0x02, 0x01, 0x02, 0x04, 0x04, 0x03, 0x04, 0x07, 0x05, 0x04,
+    0x04, 0x00, 0x01, 0x02, 0x77, 0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05,
+    0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32,
+    0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52,
+    0xF0, 0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1,
+    0x17, 0x18, 0x19, 0x1A, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37,
+    0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53,
+    0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67,
+    0x68, 0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82,
+    0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95,
+    0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8,
+    0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2,
+    0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5,
+    0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8,
+    0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA,
+};
+
+static std::mutex g_thread_pool_lock;
+static ThreadPool* g_thread_pool = nullptr;
+static std::atomic<bool> g_thumbnail_filtering(false);
+
+static ThreadPool* GetThreadPool() {
+  std::lock_guard<std::mutex> lock(g_thread_pool_lock);
+  if (!g_thread_pool) {
+    size_t num_cpus = std::thread::hardware_concurrency();
+    g_thread_pool = new ThreadPool(
+        std::max<size_t>(1, std::min(num_cpus, kDefaultMaxThreads)));
+  }
+  return g_thread_pool;
+}
+
+// Number of bands to split |rows| rows into.
+static size_t NumBands(uint32_t rows) {
+  return std::max<size_t>(
+      1, std::min<size_t>(GetThreadPool()->num_threads(), rows / kMinBandRows));
+}
+
+void ImageProcessor::SetMaxThreads(size_t num_threads) {
+  std::lock_guard<std::mutex> lock(g_thread_pool_lock);
+  delete g_thread_pool;
+  g_thread_pool =
+      new ThreadPool(std::max<size_t>(1, std::min(num_threads, kMaxThreads)));
+}
+
+void ImageProcessor::SetThumbnailFiltering(bool enabled) {
+  g_thumbnail_filtering = enabled;
+}
+
 size_t ImageProcessor::GetConvertedSize(int fourcc, uint32_t width,
                                         uint32_t height) {
   if ((width % 2) || (height % 2)) {
@@ -80,6 +238,8 @@ size_t ImageProcessor::GetConvertedSize(int fourcc, uint32_t width,
       return Align16(width) * height + Align16(width / 2) * height;
     case V4L2_PIX_FMT_YUV420:  // YU12
     // Fall-through.
+    case V4L2_PIX_FMT_NV12:  // NV12
+    // Fall-through.
     case V4L2_PIX_FMT_NV21:  // NV21
       return width * height * 3 / 2;
     case V4L2_PIX_FMT_BGR32:
@@ -98,15 +258,13 @@ bool ImageProcessor::SupportsConversion(uint32_t from_fourcc,
                                         uint32_t to_fourcc) {
   switch (from_fourcc) {
     case V4L2_PIX_FMT_YUYV:
-      return (to_fourcc == V4L2_PIX_FMT_YUV420);
+      return IsYCbCr420(to_fourcc);
     case V4L2_PIX_FMT_YUV420:
-      return (
-          to_fourcc == V4L2_PIX_FMT_YUV420 ||
-          to_fourcc == V4L2_PIX_FMT_YVU420 || to_fourcc == V4L2_PIX_FMT_NV21 ||
-          to_fourcc == V4L2_PIX_FMT_RGB32 || to_fourcc == V4L2_PIX_FMT_BGR32 ||
-          to_fourcc == V4L2_PIX_FMT_JPEG);
+      return (IsYCbCr420(to_fourcc) || to_fourcc == V4L2_PIX_FMT_RGB32 ||
+              to_fourcc == V4L2_PIX_FMT_BGR32 ||
+              to_fourcc == V4L2_PIX_FMT_JPEG);
     case V4L2_PIX_FMT_MJPEG:
-      return (to_fourcc == V4L2_PIX_FMT_YUV420);
+      return IsYCbCr420(to_fourcc);
     default:
       return false;
   }
@@ -132,21 +290,14 @@ int ImageProcessor::ConvertFormat(const CameraMetadata& metadata,
   if (in_frame.GetFourcc() == V4L2_PIX_FMT_YUYV) {
     switch (out_frame->GetFourcc()) {
       case V4L2_PIX_FMT_YUV420:  // YU12
+      case V4L2_PIX_FMT_YVU420:  // YV12
+      case V4L2_PIX_FMT_NV12:    // NV12
+      case V4L2_PIX_FMT_NV21:    // NV21
       {
-        int res = libyuv::YUY2ToI420(
-            in_frame.GetData(),      /* src_yuy2 */
-            in_frame.GetWidth() * 2, /* src_stride_yuy2 */
-            out_frame->GetData(),    /* dst_y */
-            out_frame->GetWidth(),   /* dst_stride_y */
-            out_frame->GetData() +
-                out_frame->GetWidth() * out_frame->GetHeight(), /* dst_u */
-            out_frame->GetWidth() / 2, /* dst_stride_u */
-            out_frame->GetData() + out_frame->GetWidth() *
-                                       out_frame->GetHeight() * 5 /
-                                       4, /* dst_v */
-            out_frame->GetWidth() / 2,    /* dst_stride_v */
-            in_frame.GetWidth(), in_frame.GetHeight());
-        LOGF_IF(ERROR, res) << "YUY2ToI420() for YU12 returns " << res;
+        int res = ConvertInBands(YUYVToYCbCrRows, in_frame, out_frame);
+        LOGF_IF(ERROR, res) << "YUY2ToI420() for "
+                            << FormatToString(out_frame->GetFourcc())
+                            << " returns " << res;
         return res ? -EINVAL : 0;
       }
       default:
@@ -160,66 +311,31 @@ int ImageProcessor::ConvertFormat(const CameraMetadata& metadata,
     // (V4L2_PIX_FMT_YUV420), and YV12 is similar to YU12 except that U/V
     // planes are swapped.
     switch (out_frame->GetFourcc()) {
-      case V4L2_PIX_FMT_YVU420:  // YV12
-      {
-        int ystride = Align16(in_frame.GetWidth());
-        int uvstride = Align16(in_frame.GetWidth() / 2);
-        int res = YU12ToYV12(in_frame.GetData(), out_frame->GetData(),
-                             in_frame.GetWidth(), in_frame.GetHeight(), ystride,
-                             uvstride);
-        LOGF_IF(ERROR, res) << "YU12ToYV12() returns " << res;
-        return res ? -EINVAL : 0;
-      }
       case V4L2_PIX_FMT_YUV420:  // YU12
+      case V4L2_PIX_FMT_YVU420:  // YV12
+      case V4L2_PIX_FMT_NV12:    // NV12
+      case V4L2_PIX_FMT_NV21:    // NV21
       {
-        memcpy(out_frame->GetData(), in_frame.GetData(),
-               in_frame.GetDataSize());
-        return 0;
-      }
-      case V4L2_PIX_FMT_NV21:  // NV21
-      {
-        // TODO(henryhsu): Use libyuv::I420ToNV21.
-        int res = YU12ToNV21(in_frame.GetData(), out_frame->GetData(),
-                             in_frame.GetWidth(), in_frame.GetHeight());
-        LOGF_IF(ERROR, res) << "YU12ToNV21() returns " << res;
+        int res = ConvertInBands(YU12ToYCbCrRows, in_frame, out_frame);
+        LOGF_IF(ERROR, res) << "YU12 to "
+                            << FormatToString(out_frame->GetFourcc())
+                            << " returns " << res;
         return res ? -EINVAL : 0;
       }
       case V4L2_PIX_FMT_BGR32: {
-        int res = libyuv::I420ToABGR(
-            in_frame.GetData(),  /* src_y */
-            in_frame.GetWidth(), /* src_stride_y */
-            in_frame.GetData() +
-                in_frame.GetWidth() * in_frame.GetHeight(), /* src_u */
-            in_frame.GetWidth() / 2,                        /* src_stride_u */
-            in_frame.GetData() +
-                in_frame.GetWidth() * in_frame.GetHeight() * 5 / 4, /* src_v */
-            in_frame.GetWidth() / 2,   /* src_stride_v */
-            out_frame->GetData(),      /* dst_abgr */
-            out_frame->GetWidth() * 4, /* dst_stride_abgr */
-            in_frame.GetWidth(), in_frame.GetHeight());
+        int res = ConvertInBands(YU12ToABGRRows, in_frame, out_frame);
         LOGF_IF(ERROR, res) << "I420ToABGR() returns " << res;
         return res ? -EINVAL : 0;
       }
       case V4L2_PIX_FMT_RGB32: {
-        int res = libyuv::I420ToARGB(
-            in_frame.GetData(),  /* src_y */
-            in_frame.GetWidth(), /* src_stride_y */
-            in_frame.GetData() +
-                in_frame.GetWidth() * in_frame.GetHeight(), /* src_u */
-            in_frame.GetWidth() / 2,                        /* src_stride_u */
-            in_frame.GetData() +
-                in_frame.GetWidth() * in_frame.GetHeight() * 5 / 4, /* src_v */
-            in_frame.GetWidth() / 2,   /* src_stride_v */
-            out_frame->GetData(),      /* dst_argb */
-            out_frame->GetWidth() * 4, /* dst_stride_argb */
-            in_frame.GetWidth(), in_frame.GetHeight());
+        int res = ConvertInBands(YU12ToARGBRows, in_frame, out_frame);
         LOGF_IF(ERROR, res) << "I420ToARGB() returns " << res;
         return res ? -EINVAL : 0;
       }
       case V4L2_PIX_FMT_JPEG: {
         bool res = ConvertToJpeg(metadata, in_frame, out_frame);
         LOGF_IF(ERROR, !res) << "ConvertToJpeg() returns " << res;
-        return res ? -EINVAL : 0;
+        return res ? 0 : -EINVAL;
       }
       default:
         LOGF(ERROR) << "Destination pixel format "
@@ -230,22 +346,14 @@ int ImageProcessor::ConvertFormat(const CameraMetadata& metadata,
   } else if (in_frame.GetFourcc() == V4L2_PIX_FMT_MJPEG) {
     switch (out_frame->GetFourcc()) {
       case V4L2_PIX_FMT_YUV420:  // YU12
+      case V4L2_PIX_FMT_YVU420:  // YV12
+      case V4L2_PIX_FMT_NV12:    // NV12
+      case V4L2_PIX_FMT_NV21:    // NV21
       {
-        int res = libyuv::MJPGToI420(
-            in_frame.GetData(),     /* sample */
-            in_frame.GetDataSize(), /* sample_size */
-            out_frame->GetData(),   /* dst_y */
-            out_frame->GetWidth(),  /* dst_stride_y */
-            out_frame->GetData() +
-                out_frame->GetWidth() * out_frame->GetHeight(), /* dst_u */
-            out_frame->GetWidth() / 2, /* dst_stride_u */
-            out_frame->GetData() + out_frame->GetWidth() *
-                                       out_frame->GetHeight() * 5 /
-                                       4, /* dst_v */
-            out_frame->GetWidth() / 2,    /* dst_stride_v */
-            in_frame.GetWidth(), in_frame.GetHeight(), out_frame->GetWidth(),
-            out_frame->GetHeight());
-        LOGF_IF(ERROR, res) << "MJPEGToI420() returns " << res;
+        int res = MJPEGToYCbCr(in_frame, out_frame);
+        LOGF_IF(ERROR, res) << "MJPEGToI420() for "
+                            << FormatToString(out_frame->GetFourcc())
+                            << " returns " << res;
         return res ? -EINVAL : 0;
       }
       default:
@@ -277,124 +385,559 @@ int ImageProcessor::Scale(const FrameBuffer& in_frame, FrameBuffer* out_frame) {
   }
   out_frame->SetFourcc(in_frame.GetFourcc());
 
+  if (in_frame.GetWidth() == 0 || in_frame.GetHeight() == 0 ||
+      out_frame->GetWidth() == 0 || out_frame->GetHeight() == 0) {
+    LOGF(ERROR) << "Invalid size " << in_frame.GetWidth() << "x"
+                << in_frame.GetHeight() << " -> " << out_frame->GetWidth()
+                << "x" << out_frame->GetHeight();
+    return -EINVAL;
+  }
+
   VLOGF(1) << "Scale image from " << in_frame.GetWidth() << "x"
            << in_frame.GetHeight() << " to " << out_frame->GetWidth() << "x"
            << out_frame->GetHeight();
 
-  int ret = libyuv::I420Scale(
-      in_frame.GetData(), in_frame.GetWidth(),
-      in_frame.GetData() + in_frame.GetWidth() * in_frame.GetHeight(),
-      in_frame.GetWidth() / 2,
-      in_frame.GetData() + in_frame.GetWidth() * in_frame.GetHeight() * 5 / 4,
-      in_frame.GetWidth() / 2, in_frame.GetWidth(), in_frame.GetHeight(),
-      out_frame->GetData(), out_frame->GetWidth(),
-      out_frame->GetData() + out_frame->GetWidth() * out_frame->GetHeight(),
-      out_frame->GetWidth() / 2,
-      out_frame->GetData() +
-          out_frame->GetWidth() * out_frame->GetHeight() * 5 / 4,
-      out_frame->GetWidth() / 2, out_frame->GetWidth(), out_frame->GetHeight(),
-      libyuv::FilterMode::kFilterNone);
-  LOGF_IF(ERROR, ret) << "I420Scale failed: " << ret;
-  return ret;
+  // Same as libyuv::I420Scale(), which scales the three planes one after
+  // the other, except that the planes (and bands of them) run in parallel.
+  // The largest centered region of the input with the aspect ratio of the
+  // output is scaled, as the framework expects of streams smaller than the
+  // capture. It's kept at even coordinates so the chroma planes line up.
+  int in_width = in_frame.GetWidth();
+  int in_height = in_frame.GetHeight();
+  int dst_width = out_frame->GetWidth();
+  int dst_height = out_frame->GetHeight();
+  int src_width = in_width;
+  int src_height = in_height;
+  if (static_cast<int64_t>(in_width) * dst_height >
+      static_cast<int64_t>(dst_width) * in_height) {
+    src_width = std::max<int64_t>(
+        static_cast<int64_t>(in_height) * dst_width / dst_height & ~1, 2);
+  } else {
+    src_height = std::max<int64_t>(
+        static_cast<int64_t>(in_width) * dst_height / dst_width & ~1, 2);
+  }
+  int crop_x = (in_width - src_width) / 2 & ~1;
+  int crop_y = (in_height - src_height) / 2 & ~1;
+  const uint8_t* in_y = in_frame.GetData();
+  const uint8_t* src_y = in_y + crop_y * in_width + crop_x;
+  const uint8_t* src_u = in_y + in_width * in_height +
+                         crop_y / 2 * (in_width / 2) + crop_x / 2;
+  const uint8_t* src_v = in_y + in_width * in_height * 5 / 4 +
+                         crop_y / 2 * (in_width / 2) + crop_x / 2;
+  uint8_t* dst_y = out_frame->GetData();
+  uint8_t* dst_u = dst_y + dst_width * dst_height;
+  uint8_t* dst_v = dst_y + dst_width * dst_height * 5 / 4;
+
+  struct ScaleJob {
+    ScaleBand bands[3 * kMaxThreads];
+    size_t num_bands;
+  } job;
+  size_t max_bands = NumBands(dst_height);
+  job.num_bands = 0;
+  job.num_bands += SplitScalePlane(src_y, in_width, src_width, src_height,
+                                   dst_y, dst_width, dst_width, dst_height,
+                                   max_bands, &job.bands[job.num_bands]);
+  job.num_bands += SplitScalePlane(
+      src_u, in_width / 2, src_width / 2, src_height / 2, dst_u, dst_width / 2,
+      dst_width / 2, dst_height / 2, max_bands, &job.bands[job.num_bands]);
+  job.num_bands += SplitScalePlane(
+      src_v, in_width / 2, src_width / 2, src_height / 2, dst_v, dst_width / 2,
+      dst_width / 2, dst_height / 2, max_bands, &job.bands[job.num_bands]);
+
+  GetThreadPool()->ParallelFor(job.num_bands, [&job](size_t i) {
+    const ScaleBand& band = job.bands[i];
+    libyuv::ScalePlane(band.src, band.src_stride, band.src_width,
+                       band.src_height, band.dst, band.dst_stride,
+                       band.dst_width, band.dst_height,
+                       libyuv::FilterMode::kFilterNone);
+  });
+  return 0;
 }
 
-static int YU12ToYV12(const void* yu12, void* yv12, int width, int height,
-                      int dst_stride_y, int dst_stride_uv) {
-  if ((width % 2) || (height % 2)) {
-    LOGF(ERROR) << "Width or height is not even (" << width << " x " << height
-                << ")";
+bool ImageProcessor::NeedsThumbnail(const CameraMetadata& metadata) {
+  if (!metadata.exists(ANDROID_JPEG_THUMBNAIL_SIZE)) {
+    return false;
+  }
+  camera_metadata_ro_entry entry = metadata.find(ANDROID_JPEG_THUMBNAIL_SIZE);
+  return entry.count >= 2 && entry.data.i32[0] > 0 && entry.data.i32[1] > 0;
+}
+
+int ImageProcessor::MJPEGToJPEG(const CameraMetadata& metadata,
+                                const FrameBuffer& in_frame,
+                                const uint8_t* yu12_data,
+                                FrameBuffer* out_frame) {
+  const uint8_t* src = in_frame.GetData();
+  size_t size = in_frame.GetDataSize();
+  if (size < 4 || src[0] != kJpegMarkerPrefix || src[1] != kJpegSOI) {
+    LOGF(ERROR) << "MJPEG frame doesn't start with SOI";
     return -EINVAL;
   }
-  if (dst_stride_y < width || dst_stride_uv < width / 2) {
-    LOGF(ERROR) << "Y plane stride (" << dst_stride_y
-                << ") or U/V plane stride (" << dst_stride_uv
-                << ") is invalid for width " << width;
+
+  // Walk the segments in front of the scan, which are copied over except for
+  // APP0 (JFIF) and APP1 (EXIF) that get replaced.
+  size_t sos = 0;
+  size_t header_size = 0;
+  bool has_dht = false;
+  for (size_t pos = 2; pos + 4 <= size;) {
+    if (src[pos] != kJpegMarkerPrefix) {
+      LOGF(ERROR) << "Corrupt MJPEG header at offset " << pos;
+      return -EINVAL;
+    }
+    uint8_t marker = src[pos + 1];
+    if (marker == kJpegMarkerPrefix) {
+      // Fill byte.
+      ++pos;
+      continue;
+    }
+    if (marker == kJpegSOS) {
+      sos = pos;
+      break;
+    }
+    size_t length = (src[pos + 2] << 8) | src[pos + 3];
+    if (length < 2 || pos + 2 + length > size) {
+      LOGF(ERROR) << "Corrupt MJPEG segment at offset " << pos;
+      return -EINVAL;
+    }
+    if (marker == kJpegDHT) {
+      has_dht = true;
+    }
+    if (marker != kJpegAPP0 && marker != kJpegAPP1) {
+      header_size += 2 + length;
+    }
+    pos += 2 + length;
+  }
+  if (!sos) {
+    LOGF(ERROR) << "MJPEG frame has no start of scan";
+    return -EINVAL;
+  }
+  // The scan runs up to EOI; drivers may report padding after it.
+  size_t end = size;
+  while (end >= sos + 4 &&
+         !(src[end - 2] == kJpegMarkerPrefix && src[end - 1] == kJpegEOI)) {
+    --end;
+  }
+  if (end < sos + 4) {
+    LOGF(ERROR) << "MJPEG frame has no EOI";
     return -EINVAL;
   }
 
-  const uint8_t* src = reinterpret_cast<const uint8_t*>(yu12);
-  uint8_t* dst = reinterpret_cast<uint8_t*>(yv12);
-  const uint8_t* u_src = src + width * height;
-  uint8_t* u_dst = dst + dst_stride_y * height + dst_stride_uv * height / 2;
-  const uint8_t* v_src = src + width * height * 5 / 4;
-  uint8_t* v_dst = dst + dst_stride_y * height;
+  if (NeedsThumbnail(metadata) && !yu12_data) {
+    LOGF(ERROR) << "A thumbnail needs the decoded frame";
+    return -EINVAL;
+  }
+  ExifUtils utils;
+  int jpeg_quality;
+  if (!GenerateApp1(metadata, yu12_data, in_frame.GetWidth(),
+                    in_frame.GetHeight(), &utils, &jpeg_quality)) {
+    return -EINVAL;
+  }
+  size_t data_size = 2 + 4 + utils.GetApp1Length() + header_size +
+                     (has_dht ? 0 : sizeof(kStandardDHT)) + (end - sos);
+  if (out_frame->SetDataSize(data_size)) {
+    LOGF(ERROR) << "JPEG of " << data_size << " bytes doesn't fit";
+    return -EINVAL;
+  }
 
-  return libyuv::I420Copy(src, width, u_src, width / 2, v_src, width / 2, dst,
-                          dst_stride_y, u_dst, dst_stride_uv, v_dst,
-                          dst_stride_uv, width, height);
+  uint8_t* dst = out_frame->GetData();
+  *dst++ = kJpegMarkerPrefix;
+  *dst++ = kJpegSOI;
+  dst = WriteApp1(&utils, dst);
+  for (size_t pos = 2; pos < sos;) {
+    if (src[pos + 1] == kJpegMarkerPrefix) {
+      ++pos;
+      continue;
+    }
+    size_t segment_size = 2 + ((src[pos + 2] << 8) | src[pos + 3]);
+    if (src[pos + 1] != kJpegAPP0 && src[pos + 1] != kJpegAPP1) {
+      memcpy(dst, src + pos, segment_size);
+      dst += segment_size;
+    }
+    pos += segment_size;
+  }
+  if (!has_dht) {
+    memcpy(dst, kStandardDHT, sizeof(kStandardDHT));
+    dst += sizeof(kStandardDHT);
+  }
+  memcpy(dst, src + sos, end - sos);
+  return 0;
 }
 
-static int YU12ToNV21(const void* yu12, void* nv21, int width, int height) {
-  if ((width % 2) || (height % 2)) {
-    LOGF(ERROR) << "Width or height is not even (" << width << " x " << height
-                << ")";
-    return -EINVAL;
+static int ConvertInBands(ConvertRowsFunction convert,
+                          const FrameBuffer& in_frame, FrameBuffer* out_frame) {
+  struct ConvertJob {
+    ConvertRowsFunction convert;
+    const FrameBuffer* in_frame;
+    FrameBuffer* out_frame;
+    size_t num_bands;
+    std::atomic<int> result;
+  } job;
+  job.convert = convert;
+  job.in_frame = &in_frame;
+  job.out_frame = out_frame;
+  job.num_bands = NumBands(in_frame.GetHeight());
+  job.result = 0;
+
+  // Bands start on even rows, so each covers whole rows of the 4:2:0 chroma
+  // planes and gives the same result as converting the frame in one go.
+  GetThreadPool()->ParallelFor(job.num_bands, [&job](size_t band) {
+    uint32_t row_pairs = job.in_frame->GetHeight() / 2;
+    uint32_t first_row = row_pairs * band / job.num_bands * 2;
+    uint32_t last_row = row_pairs * (band + 1) / job.num_bands * 2;
+    int res = job.convert(*job.in_frame, first_row, last_row, job.out_frame);
+    if (res) {
+      job.result = res;
+    }
+  });
+  return job.result;
+}
+
+static size_t SplitScalePlane(const uint8_t* src, int src_stride,
+                              int src_width, int src_height, uint8_t* dst,
+                              int dst_stride, int dst_width, int dst_height,
+                              size_t max_bands, ScaleBand* bands) {
+  // Point sampling steps through the source rows in 16.16 fixed point. A band
+  // gives the same rows as the whole plane only if it starts where that step
+  // lands exactly on a source row, i.e. after a whole number of
+  // |src_rows|:|dst_rows| cycles, and the step itself is exact.
+  int cycles = src_height;
+  for (int b = dst_height; b;) {
+    int r = cycles % b;
+    cycles = b;
+    b = r;
+  }
+  int src_rows = src_height / cycles;
+  int dst_rows = dst_height / cycles;
+  size_t num_bands = std::min<size_t>(max_bands, cycles);
+  if ((static_cast<int64_t>(src_height) << 16) % dst_height) {
+    num_bands = 1;
+  }
+
+  for (size_t i = 0; i < num_bands; ++i) {
+    int first_cycle = cycles * i / num_bands;
+    int last_cycle = cycles * (i + 1) / num_bands;
+    bands[i].src = src + first_cycle * src_rows * src_stride;
+    bands[i].src_stride = src_stride;
+    bands[i].src_width = src_width;
+    bands[i].src_height = (last_cycle - first_cycle) * src_rows;
+    bands[i].dst = dst + first_cycle * dst_rows * dst_stride;
+    bands[i].dst_stride = dst_stride;
+    bands[i].dst_width = dst_width;
+    bands[i].dst_height = (last_cycle - first_cycle) * dst_rows;
   }
+  return num_bands;
+}
 
-  const uint8_t* src = reinterpret_cast<const uint8_t*>(yu12);
-  uint8_t* dst = reinterpret_cast<uint8_t*>(nv21);
-  const uint8_t* u_src = src + width * height;
-  const uint8_t* v_src = src + width * height * 5 / 4;
-  uint8_t* vu_dst = dst + width * height;
+// Rows of an I420 image for a conversion to write.
+struct I420Rows {
+  uint8_t* y;
+  int y_stride;
+  uint8_t* u;
+  int u_stride;
+  uint8_t* v;
+  int v_stride;
+};
 
-  memcpy(dst, src, width * height);
+// Scratch space of at least |size| bytes for the calling thread. Each
+// thread's grows to the largest size it has needed and is then reused, so
+// converting frames of a running capture doesn't allocate.
+static uint8_t* GetScratch(size_t size) {
+  thread_local std::unique_ptr<uint8_t[]> scratch;
+  thread_local size_t capacity = 0;
+  if (size > capacity) {
+    scratch.reset(new uint8_t[size]);
+    capacity = size;
+  }
+  return scratch.get();
+}
 
-  for (int i = 0; i < height / 2; i++) {
-    for (int j = 0; j < width / 2; j++) {
-      *vu_dst++ = *v_src++;
-      *vu_dst++ = *u_src++;
+// Write rows [|first_row|, |last_row|) of the 4:2:0 frame |layout| with
+// |convert|(first, last, rows), which converts rows [first, last) to I420.
+// Planar layouts are written in place. Semi-planar ones get their luma in
+// place and their chroma through scratch planes, |chunk_rows| rows at a time
+// (or all at once if 0), interleaved into place with libyuv::MergeUVPlane.
+// Row numbers must be even.
+template <typename Convert>
+static int WriteI420Rows(const FrameBuffer::YCbCrLayout& layout,
+                         uint32_t width, uint32_t first_row, uint32_t last_row,
+                         uint32_t chunk_rows, Convert convert) {
+  if (layout.chroma_step == 1) {
+    I420Rows rows = {layout.y + first_row * layout.y_stride,
+                     static_cast<int>(layout.y_stride),
+                     layout.cb + first_row / 2 * layout.c_stride,
+                     static_cast<int>(layout.c_stride),
+                     layout.cr + first_row / 2 * layout.c_stride,
+                     static_cast<int>(layout.c_stride)};
+    return convert(first_row, last_row, rows);
+  }
+  if (layout.chroma_step != 2) {
+    LOGF(ERROR) << "Chroma step " << layout.chroma_step << " is unsupported.";
+    return -EINVAL;
+  }
+
+  if (!chunk_rows || chunk_rows > last_row - first_row) {
+    chunk_rows = last_row - first_row;
+  }
+  int half_width = width / 2;
+  uint8_t* u = GetScratch(half_width * chunk_rows);
+  uint8_t* v = u + half_width * chunk_rows / 2;
+  // NV12 has U first, NV21 V first.
+  bool vu = layout.cr < layout.cb;
+  uint8_t* uv = vu ? layout.cr : layout.cb;
+  for (uint32_t row = first_row; row < last_row; row += chunk_rows) {
+    uint32_t end = std::min(row + chunk_rows, last_row);
+    I420Rows rows = {layout.y + row * layout.y_stride,
+                     static_cast<int>(layout.y_stride), u, half_width, v,
+                     half_width};
+    int res = convert(row, end, rows);
+    if (res) {
+      return res;
     }
+    libyuv::MergeUVPlane(vu ? v : u, half_width, vu ? u : v, half_width,
+                         uv + row / 2 * layout.c_stride, layout.c_stride,
+                         half_width, (end - row) / 2);
   }
   return 0;
 }
 
-static bool ConvertToJpeg(const CameraMetadata& metadata,
-                          const FrameBuffer& in_frame, FrameBuffer* out_frame) {
-  ExifUtils utils;
-  int jpeg_quality, thumbnail_jpeg_quality;
+static int YUYVToYCbCrRows(const FrameBuffer& in_frame, uint32_t first_row,
+                           uint32_t last_row, FrameBuffer* out_frame) {
+  FrameBuffer::YCbCrLayout layout;
+  if (!out_frame->GetYCbCrLayout(&layout)) {
+    return -EINVAL;
+  }
+  const uint8_t* src = in_frame.GetData();
+  int src_stride = in_frame.GetWidth() * 2;
+  int width = in_frame.GetWidth();
+  return WriteI420Rows(
+      layout, width, first_row, last_row, kChromaChunkRows,
+      [src, src_stride, width](uint32_t first, uint32_t last,
+                               const I420Rows& dst) {
+        return libyuv::YUY2ToI420(src + first * src_stride, src_stride,
+                                  dst.y, dst.y_stride, dst.u, dst.u_stride,
+                                  dst.v, dst.v_stride, width, last - first);
+      });
+}
+
+static int YU12ToYCbCrRows(const FrameBuffer& in_frame, uint32_t first_row,
+                           uint32_t last_row, FrameBuffer* out_frame) {
+  FrameBuffer::YCbCrLayout layout;
+  if (!out_frame->GetYCbCrLayout(&layout)) {
+    return -EINVAL;
+  }
+  int width = in_frame.GetWidth();
+  int height = in_frame.GetHeight();
+  int first_uv_row = first_row / 2;
+  const uint8_t* src_y = in_frame.GetData() + first_row * width;
+  const uint8_t* src_u =
+      in_frame.GetData() + width * height + first_uv_row * (width / 2);
+  const uint8_t* src_v =
+      in_frame.GetData() + width * height * 5 / 4 + first_uv_row * (width / 2);
+  uint8_t* dst_y = layout.y + first_row * layout.y_stride;
+  uint8_t* dst_cb = layout.cb + first_uv_row * layout.c_stride;
+  uint8_t* dst_cr = layout.cr + first_uv_row * layout.c_stride;
+  int rows = last_row - first_row;
+
+  if (layout.chroma_step == 1) {
+    return libyuv::I420Copy(src_y, width, src_u, width / 2, src_v, width / 2,
+                            dst_y, layout.y_stride, dst_cb, layout.c_stride,
+                            dst_cr, layout.c_stride, width, rows);
+  } else if (layout.chroma_step == 2 && layout.cr == layout.cb + 1) {
+    return libyuv::I420ToNV12(src_y, width, src_u, width / 2, src_v,
+                              width / 2, dst_y, layout.y_stride, dst_cb,
+                              layout.c_stride, width, rows);
+  } else if (layout.chroma_step == 2 && layout.cb == layout.cr + 1) {
+    return libyuv::I420ToNV21(src_y, width, src_u, width / 2, src_v,
+                              width / 2, dst_y, layout.y_stride, dst_cr,
+                              layout.c_stride, width, rows);
+  }
+  LOGF(ERROR) << "Chroma step " << layout.chroma_step << " is unsupported.";
+  return -EINVAL;
+}
+
+static int MJPEGToYCbCr(const FrameBuffer& in_frame, FrameBuffer* out_frame) {
+  FrameBuffer::YCbCrLayout layout;
+  if (!out_frame->GetYCbCrLayout(&layout)) {
+    return -EINVAL;
+  }
+  // The decoder produces I420 for the whole frame in one go, so semi-planar
+  // output needs scratch chroma planes for all of it (but no luma copy).
+  return WriteI420Rows(
+      layout, out_frame->GetWidth(), 0, out_frame->GetHeight(), 0,
+      [&in_frame, out_frame](uint32_t first, uint32_t last,
+                             const I420Rows& dst) {
+        return libyuv::MJPGToI420(
+            in_frame.GetData(), in_frame.GetDataSize(), dst.y, dst.y_stride,
+            dst.u, dst.u_stride, dst.v, dst.v_stride, in_frame.GetWidth(),
+            in_frame.GetHeight(), out_frame->GetWidth(),
+            out_frame->GetHeight());
+      });
+}
+
+typedef int (*I420ToRGBFunction)(const uint8_t* src_y, int src_stride_y,
+                                 const uint8_t* src_u, int src_stride_u,
+                                 const uint8_t* src_v, int src_stride_v,
+                                 uint8_t* dst, int dst_stride, int width,
+                                 int height);
+
+static int YU12ToRGBRows(I420ToRGBFunction convert, const FrameBuffer& in_frame,
+                         uint32_t first_row, uint32_t last_row,
+                         FrameBuffer* out_frame) {
+  uint32_t width = in_frame.GetWidth();
+  uint32_t height = in_frame.GetHeight();
+  const uint8_t* src_y = in_frame.GetData();
+  const uint8_t* src_u = src_y + width * height;
+  const uint8_t* src_v = src_y + width * height * 5 / 4;
+  return convert(src_y + first_row * width,            /* src_y */
+                 width,                                /* src_stride_y */
+                 src_u + first_row / 2 * (width / 2),  /* src_u */
+                 width / 2,                            /* src_stride_u */
+                 src_v + first_row / 2 * (width / 2),  /* src_v */
+                 width / 2,                            /* src_stride_v */
+                 out_frame->GetData() +
+                     first_row * out_frame->GetWidth() * 4, /* dst */
+                 out_frame->GetWidth() * 4,                 /* dst_stride */
+                 width, last_row - first_row);
+}
+
+static int YU12ToABGRRows(const FrameBuffer& in_frame, uint32_t first_row,
+                          uint32_t last_row, FrameBuffer* out_frame) {
+  return YU12ToRGBRows(libyuv::I420ToABGR, in_frame, first_row, last_row,
+                       out_frame);
+}
+
+static int YU12ToARGBRows(const FrameBuffer& in_frame, uint32_t first_row,
+                          uint32_t last_row, FrameBuffer* out_frame) {
+  return YU12ToRGBRows(libyuv::I420ToARGB, in_frame, first_row, last_row,
+                       out_frame);
+}
+
+static bool InitializeExif(const CameraMetadata& metadata,
+                           const uint8_t* yu12_data, uint32_t width,
+                           uint32_t height, ExifUtils* utils,
+                           int* jpeg_quality) {
+  int thumbnail_jpeg_quality;
   camera_metadata_ro_entry entry;
 
   if (metadata.exists(ANDROID_JPEG_QUALITY)) {
     entry = metadata.find(ANDROID_JPEG_QUALITY);
-    jpeg_quality = entry.data.u8[0];
+    *jpeg_quality = entry.data.u8[0];
   } else {
     LOGF(ERROR) << "Could not find jpeg quality in metadata, defaulting to "
                 << DEFAULT_JPEG_QUALITY;
-    jpeg_quality = DEFAULT_JPEG_QUALITY;
+    *jpeg_quality = DEFAULT_JPEG_QUALITY;
   }
   if (metadata.exists(ANDROID_JPEG_THUMBNAIL_QUALITY)) {
     entry = metadata.find(ANDROID_JPEG_THUMBNAIL_QUALITY);
     thumbnail_jpeg_quality = entry.data.u8[0];
   } else {
-    thumbnail_jpeg_quality = jpeg_quality;
+    thumbnail_jpeg_quality = *jpeg_quality;
   }
 
-  if (!utils.Initialize(in_frame.GetData(), in_frame.GetWidth(),
-                        in_frame.GetHeight(), thumbnail_jpeg_quality)) {
+  if (!utils->Initialize(yu12_data, width, height, thumbnail_jpeg_quality)) {
     LOGF(ERROR) << "ExifUtils initialization failed.";
     return false;
   }
-  if (!SetExifTags(metadata, &utils)) {
+  if (!SetExifTags(metadata, utils)) {
     LOGF(ERROR) << "Setting Exif tags failed.";
     return false;
   }
-  if (!utils.GenerateApp1()) {
+  utils->SetThumbnailFiltering(g_thumbnail_filtering);
+  return true;
+}
+
+static bool GenerateApp1(const CameraMetadata& metadata,
+                         const uint8_t* yu12_data, uint32_t width,
+                         uint32_t height, ExifUtils* utils, int* jpeg_quality) {
+  if (!InitializeExif(metadata, yu12_data, width, height, utils,
+                      jpeg_quality)) {
+    return false;
+  }
+  if (!utils->GenerateApp1()) {
     LOGF(ERROR) << "Generating APP1 segment failed.";
     return false;
   }
-  JpegCompressor compressor;
-  if (!compressor.CompressImage(in_frame.GetData(), in_frame.GetWidth(),
-                                in_frame.GetHeight(), jpeg_quality,
-                                utils.GetApp1Buffer(), utils.GetApp1Length())) {
+  return true;
+}
+
+static uint8_t* WriteApp1(ExifUtils* utils, uint8_t* dst) {
+  size_t app1_length = utils->GetApp1Length();
+  *dst++ = kJpegMarkerPrefix;
+  *dst++ = kJpegAPP1;
+  *dst++ = static_cast<uint8_t>((app1_length + 2) >> 8);
+  *dst++ = static_cast<uint8_t>((app1_length + 2) & 0xFF);
+  memcpy(dst, utils->GetApp1Buffer(), app1_length);
+  return dst + app1_length;
+}
+
+static bool ConvertToJpeg(const CameraMetadata& metadata,
+                          const FrameBuffer& in_frame, FrameBuffer* out_frame) {
+  ExifUtils utils;
+  int jpeg_quality;
+  if (!InitializeExif(metadata, in_frame.GetData(), in_frame.GetWidth(),
+                      in_frame.GetHeight(), &utils, &jpeg_quality)) {
+    return false;
+  }
+
+  // The thumbnail is made while the main image is compressed without APP1,
+  // and the APP1 segment holding it is spliced in once both are done.
+  JpegCompressor compressor(GetThreadPool());
+  struct JpegJob {
+    const FrameBuffer* in_frame;
+    int quality;
+    JpegCompressor* compressor;
+    ExifUtils* utils;
+    bool compressed;
+    bool thumbnail_generated;
+  } job;
+  job.in_frame = &in_frame;
+  job.quality = jpeg_quality;
+  job.compressor = &compressor;
+  job.utils = &utils;
+  job.compressed = false;
+  job.thumbnail_generated = false;
+  GetThreadPool()->ParallelFor(2, [&job](size_t task) {
+    if (task == 0) {
+      job.compressed = job.compressor->CompressImage(
+          job.in_frame->GetData(), job.in_frame->GetWidth(),
+          job.in_frame->GetHeight(), job.quality, nullptr, 0);
+    } else {
+      job.thumbnail_generated = job.utils->GenerateThumbnail();
+    }
+  });
+  if (!job.compressed) {
     LOGF(ERROR) << "JPEG image compression failed";
     return false;
   }
-  size_t buffer_length = compressor.GetCompressedImageSize();
-  if (out_frame->SetDataSize(buffer_length)) {
+  if (!job.thumbnail_generated) {
+    LOGF(ERROR) << "Generating thumbnail failed.";
+    return false;
+  }
+  if (!utils.GenerateApp1()) {
+    LOGF(ERROR) << "Generating APP1 segment failed.";
+    return false;
+  }
+
+  // APP1 goes where the compressor would have written it: after SOI and the
+  // JFIF APP0 segment.
+  const uint8_t* jpeg =
+      static_cast<const uint8_t*>(compressor.GetCompressedImagePtr());
+  size_t jpeg_size = compressor.GetCompressedImageSize();
+  size_t app1_offset = 2;
+  if (jpeg_size >= app1_offset + 4 && jpeg[app1_offset] == kJpegMarkerPrefix &&
+      jpeg[app1_offset + 1] == kJpegAPP0) {
+    app1_offset += 2 + ((jpeg[app1_offset + 2] << 8) | jpeg[app1_offset + 3]);
+  }
+  if (jpeg_size < app1_offset) {
+    LOGF(ERROR) << "Compressed JPEG is truncated";
+    return false;
+  }
+  if (out_frame->SetDataSize(jpeg_size + 4 + utils.GetApp1Length())) {
     return false;
   }
-  memcpy(out_frame->GetData(), compressor.GetCompressedImagePtr(),
-         buffer_length);
+  uint8_t* dst = out_frame->GetData();
+  memcpy(dst, jpeg, app1_offset);
+  dst = WriteApp1(&utils, dst + app1_offset);
+  memcpy(dst, jpeg + app1_offset, jpeg_size - app1_offset);
   return true;
 }
 
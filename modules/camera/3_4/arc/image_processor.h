@@ -34,11 +34,42 @@ struct ImageProcessor {
   static int ConvertFormat(const android::CameraMetadata& metadata,
                            const FrameBuffer& in_frame, FrameBuffer* out_frame);
 
-  // Scale image size according to |in_frame| and |out_frame|. Only support
-  // V4L2_PIX_FMT_YUV420 format. Caller should fill |data|, |width|, |height|,
-  // and |buffer_size| of |out_frame|. The function will fill |data_size| and
-  // |fourcc| of |out_frame|.
+  // Scale image size according to |in_frame| and |out_frame|. If their aspect
+  // ratios differ, |in_frame| is center-cropped to that of |out_frame| first
+  // rather than stretched. Only support V4L2_PIX_FMT_YUV420 format. Caller
+  // should fill |data|, |width|, |height|, and |buffer_size| of |out_frame|.
+  // The function will fill |data_size| and |fourcc| of |out_frame|.
   static int Scale(const FrameBuffer& in_frame, FrameBuffer* out_frame);
+
+  // Make a JPEG of the MJPEG frame |in_frame| without re-encoding it. The EXIF
+  // APP1 segment built from |metadata| replaces the APP0/APP1 segments of the
+  // frame, and the standard Huffman tables are added if the frame leaves them
+  // out (as UVC cameras do). |yu12_data| is |in_frame| decoded to YU12, only
+  // needed if NeedsThumbnail(|metadata|); it may be null otherwise. Caller
+  // should fill |data| and |buffer_size| of |out_frame|. The function will
+  // fill |data_size|. Return non-zero error code on failure; return 0 on
+  // success.
+  static int MJPEGToJPEG(const android::CameraMetadata& metadata,
+                         const FrameBuffer& in_frame, const uint8_t* yu12_data,
+                         FrameBuffer* out_frame);
+
+  // Return whether a JPEG for |metadata| carries an EXIF thumbnail, which has
+  // to be made from a decoded frame.
+  static bool NeedsThumbnail(const android::CameraMetadata& metadata);
+
+  // ConvertFormat() and Scale() split large frames into horizontal bands and
+  // process them on up to |num_threads| threads, including the caller. The
+  // output is the same for any thread count, except that JPEG output is
+  // encoded in strips separated by restart markers. Defaults to the number
+  // of CPUs, up to 4. Must not be called while a conversion is running.
+  static void SetMaxThreads(size_t num_threads);
+
+  // Box filter the EXIF thumbnail instead of point sampling it. JPEG output
+  // from ConvertFormat() makes the thumbnail while it encodes the main image,
+  // so this adds no latency when there is more than one thread. Off by
+  // default; the V4L2 HAL turns it on unless the
+  // camera.v4l2.thumbnail_filtering property is false.
+  static void SetThumbnailFiltering(bool enabled);
 };
 
 }  // namespace arc
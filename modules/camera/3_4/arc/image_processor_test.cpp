@@ -0,0 +1,566 @@
+/* Copyright 2026 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "arc/image_processor.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include <jpeglib.h>
+#include <libyuv.h>
+#include "arc/common.h"
+#include "arc/jpeg_compressor.h"
+
+using testing::TestWithParam;
+using testing::Values;
+
+namespace arc {
+
+struct Conversion {
+  uint32_t in_fourcc;
+  uint32_t in_width;
+  uint32_t in_height;
+  // Scale to this size if it differs from the input.
+  uint32_t out_fourcc;
+  uint32_t out_width;
+  uint32_t out_height;
+};
+
+// Converting in bands must give the same output as converting whole frames.
+class ImageProcessorBandTest : public TestWithParam<Conversion> {
+ protected:
+  void TearDown() { ImageProcessor::SetMaxThreads(4); }
+
+  std::unique_ptr<AllocatedFrameBuffer> MakeSource() {
+    const Conversion& c = GetParam();
+    size_t size = c.in_fourcc == V4L2_PIX_FMT_YUYV
+                      ? c.in_width * c.in_height * 2
+                      : c.in_width * c.in_height * 3 / 2;
+    std::unique_ptr<AllocatedFrameBuffer> frame(new AllocatedFrameBuffer(size));
+    frame->SetDataSize(size);
+    frame->SetFourcc(c.in_fourcc);
+    frame->SetWidth(c.in_width);
+    frame->SetHeight(c.in_height);
+    uint8_t* data = frame->GetData();
+    for (size_t i = 0; i < size; ++i) {
+      data[i] = static_cast<uint8_t>(i * 31 + i / c.in_width * 7);
+    }
+    return frame;
+  }
+
+  std::vector<uint8_t> Run(size_t num_threads) {
+    const Conversion& c = GetParam();
+    ImageProcessor::SetMaxThreads(num_threads);
+    std::unique_ptr<AllocatedFrameBuffer> in = MakeSource();
+    AllocatedFrameBuffer out(0);
+    out.SetFourcc(c.out_fourcc);
+    out.SetWidth(c.out_width);
+    out.SetHeight(c.out_height);
+    if (c.out_width != c.in_width || c.out_height != c.in_height) {
+      EXPECT_EQ(ImageProcessor::Scale(*in, &out), 0);
+    } else {
+      android::CameraMetadata metadata;
+      EXPECT_EQ(ImageProcessor::ConvertFormat(metadata, *in, &out), 0);
+    }
+    return std::vector<uint8_t>(out.GetData(),
+                                out.GetData() + out.GetDataSize());
+  }
+};
+
+TEST_P(ImageProcessorBandTest, SameOutputForAnyThreadCount) {
+  std::vector<uint8_t> expected = Run(1);
+  ASSERT_FALSE(expected.empty());
+  for (size_t threads : {2, 3, 4, 8}) {
+    EXPECT_EQ(Run(threads), expected) << threads << " threads";
+  }
+}
+
+TEST_P(ImageProcessorBandTest, ScaleMatchesWholeFrameScale) {
+  const Conversion& c = GetParam();
+  if (c.out_width == c.in_width && c.out_height == c.in_height) {
+    return;
+  }
+  std::unique_ptr<AllocatedFrameBuffer> in = MakeSource();
+  std::vector<uint8_t> expected(c.out_width * c.out_height * 3 / 2);
+  // The input is center-cropped to the output's aspect ratio.
+  uint32_t crop_width = c.in_width;
+  uint32_t crop_height = c.in_height;
+  if (c.in_width * c.out_height > c.out_width * c.in_height) {
+    crop_width = c.in_height * c.out_width / c.out_height & ~1;
+  } else {
+    crop_height = c.in_width * c.out_height / c.out_width & ~1;
+  }
+  uint32_t crop_x = (c.in_width - crop_width) / 2 & ~1;
+  uint32_t crop_y = (c.in_height - crop_height) / 2 & ~1;
+  const uint8_t* src = in->GetData();
+  uint8_t* dst = expected.data();
+  int src_y_size = c.in_width * c.in_height;
+  int src_c_offset = crop_y / 2 * (c.in_width / 2) + crop_x / 2;
+  int dst_y_size = c.out_width * c.out_height;
+  ASSERT_EQ(libyuv::I420Scale(
+                src + crop_y * c.in_width + crop_x, c.in_width,
+                src + src_y_size + src_c_offset, c.in_width / 2,
+                src + src_y_size * 5 / 4 + src_c_offset, c.in_width / 2,
+                crop_width, crop_height, dst, c.out_width, dst + dst_y_size,
+                c.out_width / 2, dst + dst_y_size * 5 / 4, c.out_width / 2,
+                c.out_width, c.out_height, libyuv::FilterMode::kFilterNone),
+            0);
+  EXPECT_EQ(Run(4), expected);
+}
+
+INSTANTIATE_TEST_CASE_P(
+    Conversions, ImageProcessorBandTest,
+    Values(Conversion{V4L2_PIX_FMT_YUYV, 640, 480, V4L2_PIX_FMT_YUV420, 640,
+                      480},
+           Conversion{V4L2_PIX_FMT_YUYV, 642, 482, V4L2_PIX_FMT_YUV420, 642,
+                      482},
+           Conversion{V4L2_PIX_FMT_YUYV, 640, 480, V4L2_PIX_FMT_YVU420, 640,
+                      480},
+           Conversion{V4L2_PIX_FMT_YUYV, 640, 480, V4L2_PIX_FMT_NV12, 640,
+                      480},
+           Conversion{V4L2_PIX_FMT_YUYV, 642, 482, V4L2_PIX_FMT_NV21, 642,
+                      482},
+           Conversion{V4L2_PIX_FMT_YUV420, 640, 480, V4L2_PIX_FMT_YUV420, 640,
+                      480},
+           Conversion{V4L2_PIX_FMT_YUV420, 640, 480, V4L2_PIX_FMT_YVU420, 640,
+                      480},
+           Conversion{V4L2_PIX_FMT_YUV420, 640, 480, V4L2_PIX_FMT_NV21, 640,
+                      480},
+           Conversion{V4L2_PIX_FMT_YUV420, 640, 480, V4L2_PIX_FMT_NV12, 640,
+                      480},
+           Conversion{V4L2_PIX_FMT_YUV420, 640, 480, V4L2_PIX_FMT_BGR32, 640,
+                      480},
+           Conversion{V4L2_PIX_FMT_YUV420, 640, 480, V4L2_PIX_FMT_RGB32, 640,
+                      480},
+           // Exact 16.16 steps, split into bands.
+           Conversion{V4L2_PIX_FMT_YUV420, 1280, 720, V4L2_PIX_FMT_YUV420, 640,
+                      360},
+           Conversion{V4L2_PIX_FMT_YUV420, 1920, 1080, V4L2_PIX_FMT_YUV420,
+                      1280, 720},
+           Conversion{V4L2_PIX_FMT_YUV420, 640, 480, V4L2_PIX_FMT_YUV420, 1280,
+                      960},
+           // Inexact steps, one band per plane.
+           Conversion{V4L2_PIX_FMT_YUV420, 2592, 1944, V4L2_PIX_FMT_YUV420,
+                      1280, 720},
+           Conversion{V4L2_PIX_FMT_YUV420, 640, 480, V4L2_PIX_FMT_YUV420, 352,
+                      288}));
+
+// Scaling to another aspect ratio keeps the center of the frame instead of
+// stretching all of it.
+TEST(ImageProcessorTest, ScaleCropsToOutputAspectRatio) {
+  // 16x8 YU12 whose pixels hold their column.
+  const uint32_t width = 16, height = 8;
+  AllocatedFrameBuffer in(width * height * 3 / 2);
+  in.SetDataSize(width * height * 3 / 2);
+  in.SetFourcc(V4L2_PIX_FMT_YUV420);
+  in.SetWidth(width);
+  in.SetHeight(height);
+  uint8_t* data = in.GetData();
+  for (uint32_t i = 0; i < width * height; ++i) {
+    data[i] = i % width;
+  }
+  // Both chroma planes, one after the other.
+  uint8_t* chroma = data + width * height;
+  for (uint32_t i = 0; i < width * height / 2; ++i) {
+    chroma[i] = i % (width / 2);
+  }
+
+  AllocatedFrameBuffer out(0);
+  out.SetWidth(8);
+  out.SetHeight(8);
+  ASSERT_EQ(ImageProcessor::Scale(in, &out), 0);
+
+  const uint8_t* y = out.GetData();
+  const uint8_t* u = y + 8 * 8;
+  const uint8_t* v = u + 4 * 4;
+  for (uint32_t row = 0; row < 8; ++row) {
+    for (uint32_t col = 0; col < 8; ++col) {
+      EXPECT_EQ(y[row * 8 + col], col + 4) << row << "," << col;
+    }
+  }
+  for (uint32_t i = 0; i < 4 * 4; ++i) {
+    EXPECT_EQ(u[i], i % 4 + 2) << i;
+    EXPECT_EQ(v[i], i % 4 + 2) << i;
+  }
+}
+
+// A frame buffer with the plane layout of a gralloc buffer: padded rows and
+// either planar or semi-planar chroma.
+class LayoutFrameBuffer : public AllocatedFrameBuffer {
+ public:
+  LayoutFrameBuffer(uint32_t fourcc, uint32_t width, uint32_t height,
+                    uint32_t stride)
+      : AllocatedFrameBuffer(stride * height * 2) {
+    SetFourcc(fourcc);
+    SetWidth(width);
+    SetHeight(height);
+    memset(GetData(), kPadding, stride * height * 2);
+    has_ycbcr_layout_ = true;
+    ycbcr_layout_.y = GetData();
+    ycbcr_layout_.y_stride = stride;
+    ycbcr_layout_.c_stride = stride;
+    uint8_t* chroma = GetData() + stride * height;
+    if (fourcc == V4L2_PIX_FMT_NV12 || fourcc == V4L2_PIX_FMT_NV21) {
+      bool nv21 = fourcc == V4L2_PIX_FMT_NV21;
+      ycbcr_layout_.cb = chroma + nv21;
+      ycbcr_layout_.cr = chroma + !nv21;
+      ycbcr_layout_.chroma_step = 2;
+    } else {
+      ycbcr_layout_.cb = chroma;
+      ycbcr_layout_.cr = chroma + stride * height / 2;
+      ycbcr_layout_.chroma_step = 1;
+    }
+  }
+
+  // The frame without row padding, the way AllocatedFrameBuffer holds it.
+  std::vector<uint8_t> Packed() const {
+    const YCbCrLayout& l = ycbcr_layout_;
+    uint32_t width = GetWidth();
+    uint32_t height = GetHeight();
+    std::vector<uint8_t> packed;
+    for (uint32_t row = 0; row < height; ++row) {
+      packed.insert(packed.end(), l.y + row * l.y_stride,
+                    l.y + row * l.y_stride + width);
+    }
+    if (l.chroma_step == 2) {
+      const uint8_t* uv = std::min(l.cb, l.cr);
+      for (uint32_t row = 0; row < height / 2; ++row) {
+        packed.insert(packed.end(), uv + row * l.c_stride,
+                      uv + row * l.c_stride + width);
+      }
+      return packed;
+    }
+    // YV12 packs V first, with its own stride.
+    bool yv12 = GetFourcc() == V4L2_PIX_FMT_YVU420;
+    for (const uint8_t* plane : {yv12 ? l.cr : l.cb, yv12 ? l.cb : l.cr}) {
+      for (uint32_t row = 0; row < height / 2; ++row) {
+        packed.insert(packed.end(), plane + row * l.c_stride,
+                      plane + row * l.c_stride + width / 2);
+      }
+    }
+    return packed;
+  }
+
+  // Whether all bytes past the end of each row are untouched.
+  bool PaddingIntact() const {
+    const YCbCrLayout& l = ycbcr_layout_;
+    uint32_t height = GetHeight();
+    uint32_t y_width = GetWidth();
+    uint32_t c_width = l.chroma_step == 2 ? y_width : y_width / 2;
+    for (uint32_t row = 0; row < height; ++row) {
+      for (uint32_t col = y_width; col < l.y_stride; ++col) {
+        if (l.y[row * l.y_stride + col] != kPadding) {
+          return false;
+        }
+      }
+    }
+    const uint8_t* planes[] = {std::min(l.cb, l.cr), std::max(l.cb, l.cr)};
+    for (size_t i = 0; i < (l.chroma_step == 2 ? 1 : 2); ++i) {
+      for (uint32_t row = 0; row < height / 2; ++row) {
+        for (uint32_t col = c_width; col < l.c_stride; ++col) {
+          if (planes[i][row * l.c_stride + col] != kPadding) {
+            return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+ private:
+  static const uint8_t kPadding = 0xA5;
+};
+
+// Converting into a buffer's own plane layout must give the same pixels as
+// converting into a packed frame, without writing the padding.
+class ImageProcessorLayoutTest
+    : public TestWithParam<std::pair<uint32_t, uint32_t>> {
+ protected:
+  std::unique_ptr<AllocatedFrameBuffer> MakeSource(uint32_t fourcc) {
+    size_t size = fourcc == V4L2_PIX_FMT_YUYV ? kWidth * kHeight * 2
+                                              : kWidth * kHeight * 3 / 2;
+    std::unique_ptr<AllocatedFrameBuffer> frame(new AllocatedFrameBuffer(size));
+    frame->SetDataSize(size);
+    frame->SetFourcc(fourcc);
+    frame->SetWidth(kWidth);
+    frame->SetHeight(kHeight);
+    for (size_t i = 0; i < size; ++i) {
+      frame->GetData()[i] = static_cast<uint8_t>(i * 13 + i / kWidth * 5);
+    }
+    return frame;
+  }
+
+  static const uint32_t kWidth = 320;
+  static const uint32_t kHeight = 240;
+  static const uint32_t kStride = 384;
+};
+
+TEST_P(ImageProcessorLayoutTest, WritesPlaneLayout) {
+  uint32_t in_fourcc = GetParam().first;
+  uint32_t out_fourcc = GetParam().second;
+  std::unique_ptr<AllocatedFrameBuffer> in = MakeSource(in_fourcc);
+  android::CameraMetadata metadata;
+
+  AllocatedFrameBuffer packed(0);
+  packed.SetFourcc(out_fourcc);
+  packed.SetWidth(kWidth);
+  packed.SetHeight(kHeight);
+  ASSERT_EQ(ImageProcessor::ConvertFormat(metadata, *in, &packed), 0);
+
+  LayoutFrameBuffer strided(out_fourcc, kWidth, kHeight, kStride);
+  ASSERT_EQ(ImageProcessor::ConvertFormat(metadata, *in, &strided), 0);
+  EXPECT_EQ(strided.Packed(),
+            std::vector<uint8_t>(packed.GetData(),
+                                 packed.GetData() + packed.GetDataSize()));
+  EXPECT_TRUE(strided.PaddingIntact());
+}
+
+INSTANTIATE_TEST_CASE_P(
+    Layouts, ImageProcessorLayoutTest,
+    Values(std::make_pair(V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_YUV420),
+           std::make_pair(V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_YVU420),
+           std::make_pair(V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_NV12),
+           std::make_pair(V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_NV21),
+           std::make_pair(V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_YUV420),
+           std::make_pair(V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_NV12),
+           std::make_pair(V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_NV21)));
+
+// Going straight from the camera format to NV12 or NV21 must give the same
+// frame as going through YU12.
+TEST(ImageProcessorTest, YUYVToSemiPlanarMatchesYU12Path) {
+  const uint32_t width = 640;
+  const uint32_t height = 480;
+  AllocatedFrameBuffer yuyv(width * height * 2);
+  yuyv.SetDataSize(width * height * 2);
+  yuyv.SetFourcc(V4L2_PIX_FMT_YUYV);
+  yuyv.SetWidth(width);
+  yuyv.SetHeight(height);
+  for (size_t i = 0; i < yuyv.GetDataSize(); ++i) {
+    yuyv.GetData()[i] = static_cast<uint8_t>(i * 7 + i / width);
+  }
+  android::CameraMetadata metadata;
+
+  AllocatedFrameBuffer yu12(0);
+  yu12.SetFourcc(V4L2_PIX_FMT_YUV420);
+  yu12.SetWidth(width);
+  yu12.SetHeight(height);
+  ASSERT_EQ(ImageProcessor::ConvertFormat(metadata, yuyv, &yu12), 0);
+
+  for (uint32_t fourcc : {V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV21}) {
+    AllocatedFrameBuffer via_yu12(0);
+    via_yu12.SetFourcc(fourcc);
+    via_yu12.SetWidth(width);
+    via_yu12.SetHeight(height);
+    ASSERT_EQ(ImageProcessor::ConvertFormat(metadata, yu12, &via_yu12), 0);
+
+    AllocatedFrameBuffer direct(0);
+    direct.SetFourcc(fourcc);
+    direct.SetWidth(width);
+    direct.SetHeight(height);
+    ASSERT_EQ(ImageProcessor::ConvertFormat(metadata, yuyv, &direct), 0);
+    ASSERT_EQ(direct.GetDataSize(), via_yu12.GetDataSize());
+    EXPECT_EQ(memcmp(direct.GetData(), via_yu12.GetData(),
+                     direct.GetDataSize()),
+              0)
+        << FormatToString(fourcc);
+  }
+}
+
+// Decode |jpeg| to interleaved YCbCr with libjpeg. Returns an empty vector
+// if it isn't a valid JPEG.
+static std::vector<uint8_t> DecodeJpeg(const std::vector<uint8_t>& jpeg) {
+  struct ErrorManager {
+    jpeg_error_mgr mgr;
+    jmp_buf setjmp_buffer;
+  };
+  jpeg_decompress_struct cinfo;
+  ErrorManager error;
+  cinfo.err = jpeg_std_error(&error.mgr);
+  error.mgr.error_exit = [](j_common_ptr cinfo) {
+    longjmp(reinterpret_cast<ErrorManager*>(cinfo->err)->setjmp_buffer, 1);
+  };
+  std::vector<uint8_t> pixels;
+  if (setjmp(error.setjmp_buffer)) {
+    jpeg_destroy_decompress(&cinfo);
+    return std::vector<uint8_t>();
+  }
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, const_cast<uint8_t*>(jpeg.data()), jpeg.size());
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_YCbCr;
+  jpeg_start_decompress(&cinfo);
+  size_t row_size = cinfo.output_width * cinfo.output_components;
+  pixels.resize(row_size * cinfo.output_height);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = &pixels[cinfo.output_scanline * row_size];
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return pixels;
+}
+
+class ImageProcessorMJPEGTest : public testing::Test {
+ protected:
+  static const uint32_t kWidth = 160;
+  static const uint32_t kHeight = 120;
+
+  void SetUp() {
+    std::vector<uint8_t> yu12(kWidth * kHeight * 3 / 2);
+    for (size_t i = 0; i < yu12.size(); ++i) {
+      yu12[i] = static_cast<uint8_t>(i * 13 + i / kWidth * 5);
+    }
+    JpegCompressor compressor;
+    ASSERT_TRUE(
+        compressor.CompressImage(yu12.data(), kWidth, kHeight, 90, NULL, 0));
+    const uint8_t* data =
+        static_cast<const uint8_t*>(compressor.GetCompressedImagePtr());
+    jpeg_.assign(data, data + compressor.GetCompressedImageSize());
+  }
+
+  // |jpeg_| the way a UVC camera sends it: without JFIF and Huffman tables,
+  // and padded after EOI.
+  std::vector<uint8_t> MakeMJPEG() {
+    std::vector<uint8_t> mjpeg(jpeg_.begin(), jpeg_.begin() + 2);
+    size_t pos = 2;
+    while (jpeg_[pos + 1] != 0xDA) {
+      size_t segment_size = 2 + (jpeg_[pos + 2] << 8 | jpeg_[pos + 3]);
+      if (jpeg_[pos + 1] != 0xC4 && jpeg_[pos + 1] != 0xE0) {
+        mjpeg.insert(mjpeg.end(), jpeg_.begin() + pos,
+                     jpeg_.begin() + pos + segment_size);
+      }
+      pos += segment_size;
+    }
+    scan_.assign(jpeg_.begin() + pos, jpeg_.end());
+    mjpeg.insert(mjpeg.end(), scan_.begin(), scan_.end());
+    mjpeg.resize(mjpeg.size() + 100, 0);
+    return mjpeg;
+  }
+
+  std::vector<uint8_t> Run(const std::vector<uint8_t>& mjpeg) {
+    AllocatedFrameBuffer in(mjpeg.size());
+    memcpy(in.GetData(), mjpeg.data(), mjpeg.size());
+    in.SetDataSize(mjpeg.size());
+    in.SetFourcc(V4L2_PIX_FMT_MJPEG);
+    in.SetWidth(kWidth);
+    in.SetHeight(kHeight);
+    AllocatedFrameBuffer out(mjpeg.size() + 64 * 1024);
+    android::CameraMetadata metadata;
+    const float focal_length = 3.04f;
+    metadata.update(ANDROID_LENS_FOCAL_LENGTH, &focal_length, 1);
+    EXPECT_EQ(ImageProcessor::MJPEGToJPEG(metadata, in, nullptr, &out), 0);
+    return std::vector<uint8_t>(out.GetData(),
+                                out.GetData() + out.GetDataSize());
+  }
+
+  std::vector<uint8_t> jpeg_;
+  // SOS through EOI of |jpeg_|.
+  std::vector<uint8_t> scan_;
+};
+
+TEST_F(ImageProcessorMJPEGTest, KeepsScanAndAddsExif) {
+  std::vector<uint8_t> out = Run(MakeMJPEG());
+  ASSERT_GT(out.size(), scan_.size() + 6);
+  EXPECT_EQ(out[0], 0xFF);
+  EXPECT_EQ(out[1], 0xD8);
+  EXPECT_EQ(out[2], 0xFF);
+  EXPECT_EQ(out[3], 0xE1);
+  EXPECT_EQ(memcmp(&out[6], "Exif\0\0", 6), 0);
+  EXPECT_TRUE(std::equal(scan_.begin(), scan_.end(),
+                         out.end() - scan_.size()));
+}
+
+TEST_F(ImageProcessorMJPEGTest, DecodesLikeTheSource) {
+  std::vector<uint8_t> expected = DecodeJpeg(jpeg_);
+  ASSERT_FALSE(expected.empty());
+  EXPECT_EQ(DecodeJpeg(Run(MakeMJPEG())), expected);
+  // Frames that carry their own tables keep them.
+  EXPECT_EQ(DecodeJpeg(Run(jpeg_)), expected);
+}
+
+TEST_F(ImageProcessorMJPEGTest, RejectsTruncatedFrames) {
+  std::vector<uint8_t> mjpeg = MakeMJPEG();
+  mjpeg.resize(mjpeg.size() - scan_.size() - 100);
+  AllocatedFrameBuffer in(mjpeg.size());
+  memcpy(in.GetData(), mjpeg.data(), mjpeg.size());
+  in.SetDataSize(mjpeg.size());
+  in.SetWidth(kWidth);
+  in.SetHeight(kHeight);
+  AllocatedFrameBuffer out(64 * 1024);
+  android::CameraMetadata metadata;
+  EXPECT_EQ(ImageProcessor::MJPEGToJPEG(metadata, in, nullptr, &out), -EINVAL);
+}
+
+// JPEG output is compressed without APP1, which is spliced in afterwards; it
+// has to end up where the compressor would have put it.
+class ImageProcessorJpegTest : public TestWithParam<size_t> {
+ protected:
+  static const uint32_t kWidth = 640;
+  static const uint32_t kHeight = 480;
+
+  void TearDown() {
+    ImageProcessor::SetMaxThreads(4);
+    ImageProcessor::SetThumbnailFiltering(false);
+  }
+};
+
+TEST_P(ImageProcessorJpegTest, SplicesExifAfterJfif) {
+  ImageProcessor::SetMaxThreads(GetParam());
+  AllocatedFrameBuffer in(kWidth * kHeight * 3 / 2);
+  in.SetDataSize(kWidth * kHeight * 3 / 2);
+  in.SetFourcc(V4L2_PIX_FMT_YUV420);
+  in.SetWidth(kWidth);
+  in.SetHeight(kHeight);
+  for (size_t i = 0; i < in.GetDataSize(); ++i) {
+    in.GetData()[i] = static_cast<uint8_t>(i * 11 + i / kWidth * 7);
+  }
+  JpegCompressor compressor;
+  ASSERT_TRUE(compressor.CompressImage(in.GetData(), kWidth, kHeight, 90,
+                                       NULL, 0));
+  const uint8_t* data =
+      static_cast<const uint8_t*>(compressor.GetCompressedImagePtr());
+  std::vector<uint8_t> expected(data,
+                                data + compressor.GetCompressedImageSize());
+  ASSERT_EQ(expected[3], 0xE0);
+  size_t jfif_end = 4 + (expected[4] << 8 | expected[5]);
+
+  android::CameraMetadata metadata;
+  const float focal_length = 3.04f;
+  metadata.update(ANDROID_LENS_FOCAL_LENGTH, &focal_length, 1);
+  const uint8_t quality = 90;
+  metadata.update(ANDROID_JPEG_QUALITY, &quality, 1);
+  const int32_t thumbnail_size[] = {160, 120};
+  metadata.update(ANDROID_JPEG_THUMBNAIL_SIZE, thumbnail_size, 2);
+  for (bool filtering : {false, true}) {
+    ImageProcessor::SetThumbnailFiltering(filtering);
+    AllocatedFrameBuffer out(expected.size() + 64 * 1024);
+    out.SetFourcc(V4L2_PIX_FMT_JPEG);
+    ASSERT_EQ(ImageProcessor::ConvertFormat(metadata, in, &out), 0);
+    std::vector<uint8_t> jpeg(out.GetData(),
+                              out.GetData() + out.GetDataSize());
+    ASSERT_GT(jpeg.size(), expected.size() + 10);
+    EXPECT_TRUE(std::equal(expected.begin(), expected.begin() + jfif_end,
+                           jpeg.begin()));
+    EXPECT_EQ(jpeg[jfif_end], 0xFF);
+    EXPECT_EQ(jpeg[jfif_end + 1], 0xE1);
+    size_t app1_end = jfif_end + 2 + (jpeg[jfif_end + 2] << 8 |
+                                      jpeg[jfif_end + 3]);
+    EXPECT_EQ(memcmp(&jpeg[jfif_end + 4], "Exif\0\0", 6), 0);
+    EXPECT_EQ(jpeg.size() - app1_end, expected.size() - jfif_end);
+    EXPECT_TRUE(std::equal(expected.begin() + jfif_end, expected.end(),
+                           jpeg.begin() + app1_end));
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Threads, ImageProcessorJpegTest, Values(1, 2, 4));
+
+}  // namespace arc
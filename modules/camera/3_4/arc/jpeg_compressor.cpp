@@ -6,20 +6,62 @@
 
 #include "arc/jpeg_compressor.h"
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 
 #include "arc/common.h"
+#include "arc/thread_pool.h"
 
 namespace arc {
 
-// The destination manager that can access |result_buffer_| in JpegCompressor.
+// The destination manager that writes to a buffer of JpegCompressor.
 struct destination_mgr {
  public:
   struct jpeg_destination_mgr mgr;
-  JpegCompressor* compressor;
+  std::vector<JOCTET>* buffer;
+  size_t initial_size;
 };
 
-JpegCompressor::JpegCompressor() {}
+// JPEG markers, each following a 0xFF byte.
+static const JOCTET kMarkerPrefix = 0xFF;
+static const JOCTET kMarkerSOF0 = 0xC0;
+static const JOCTET kMarkerRST0 = 0xD0;
+static const JOCTET kMarkerEOI = 0xD9;
+static const JOCTET kMarkerSOS = 0xDA;
+
+// The largest restart interval a DRI segment can hold, in MCUs.
+static const unsigned int kMaxRestartInterval = 0xFFFF;
+
+// Rough upper estimate of the compressed size of |num_pixels| pixels of YU12,
+// so that the output buffer rarely has to grow. Camera frames are noisier
+// than typical photos, which take about 2 bits per pixel at quality 90.
+static size_t EstimateCompressedSize(size_t num_pixels, int quality) {
+  const size_t kHeaderSize = 1024;
+  size_t bits_per_pixel = quality >= 95 ? 6 : quality >= 85 ? 4 : 3;
+  return kHeaderSize + num_pixels * bits_per_pixel / 8;
+}
+
+// Returns the offset of the segment with |marker| in the header of |jpeg|,
+// or 0 if there is none before the scan.
+static size_t FindSegment(const std::vector<JOCTET>& jpeg, JOCTET marker) {
+  size_t pos = 2;
+  while (pos + 4 <= jpeg.size() && jpeg[pos] == kMarkerPrefix) {
+    if (jpeg[pos + 1] == marker) {
+      return pos;
+    }
+    if (jpeg[pos + 1] == kMarkerSOS) {
+      break;
+    }
+    pos += 2 + ((jpeg[pos + 2] << 8) | jpeg[pos + 3]);
+  }
+  return 0;
+}
+
+JpegCompressor::JpegCompressor() : thread_pool_(nullptr) {}
+
+JpegCompressor::JpegCompressor(ThreadPool* thread_pool)
+    : thread_pool_(thread_pool) {}
 
 JpegCompressor::~JpegCompressor() {}
 
@@ -50,25 +92,27 @@ size_t JpegCompressor::GetCompressedImageSize() {
 
 void JpegCompressor::InitDestination(j_compress_ptr cinfo) {
   destination_mgr* dest = reinterpret_cast<destination_mgr*>(cinfo->dest);
-  std::vector<JOCTET>& buffer = dest->compressor->result_buffer_;
-  buffer.resize(kBlockSize);
+  std::vector<JOCTET>& buffer = *dest->buffer;
+  buffer.resize(
+      std::max(dest->initial_size, static_cast<size_t>(kBlockSize)));
   dest->mgr.next_output_byte = &buffer[0];
   dest->mgr.free_in_buffer = buffer.size();
 }
 
 boolean JpegCompressor::EmptyOutputBuffer(j_compress_ptr cinfo) {
   destination_mgr* dest = reinterpret_cast<destination_mgr*>(cinfo->dest);
-  std::vector<JOCTET>& buffer = dest->compressor->result_buffer_;
+  std::vector<JOCTET>& buffer = *dest->buffer;
+  // The estimate was too low; grow geometrically.
   size_t oldsize = buffer.size();
-  buffer.resize(oldsize + kBlockSize);
+  buffer.resize(oldsize * 2);
   dest->mgr.next_output_byte = &buffer[oldsize];
-  dest->mgr.free_in_buffer = kBlockSize;
+  dest->mgr.free_in_buffer = buffer.size() - oldsize;
   return true;
 }
 
 void JpegCompressor::TerminateDestination(j_compress_ptr cinfo) {
   destination_mgr* dest = reinterpret_cast<destination_mgr*>(cinfo->dest);
-  std::vector<JOCTET>& buffer = dest->compressor->result_buffer_;
+  std::vector<JOCTET>& buffer = *dest->buffer;
   buffer.resize(buffer.size() - dest->mgr.free_in_buffer);
 }
 
@@ -83,6 +127,72 @@ void JpegCompressor::OutputErrorMessage(j_common_ptr cinfo) {
 bool JpegCompressor::Encode(const void* inYuv, int width, int height,
                             int jpegQuality, const void* app1Buffer,
                             unsigned int app1Size) {
+  const uint8_t* yuv = static_cast<const uint8_t*>(inYuv);
+  // With 4:2:0 subsampling an MCU covers 16x16 pixels.
+  int mcus_per_row = (width + 15) / 16;
+  int mcu_rows = (height + 15) / 16;
+  size_t num_strips = 1;
+  if (thread_pool_) {
+    num_strips = std::min<size_t>(thread_pool_->num_threads(),
+                                  mcu_rows / kMinStripMcuRows);
+  }
+  if (num_strips <= 1) {
+    return EncodeStrip(yuv, width, height, 0, height, jpegQuality, 0,
+                       app1Buffer, app1Size, &result_buffer_);
+  }
+
+  // Every strip but the last one is exactly one restart interval, so the
+  // strips can be encoded independently and then joined with RST markers.
+  int strip_mcu_rows = (mcu_rows + num_strips - 1) / num_strips;
+  strip_mcu_rows = std::min<int>(strip_mcu_rows,
+                                 kMaxRestartInterval / mcus_per_row);
+  num_strips = (mcu_rows + strip_mcu_rows - 1) / strip_mcu_rows;
+  int strip_rows = strip_mcu_rows * 16;
+  unsigned int restart_interval = strip_mcu_rows * mcus_per_row;
+
+  strip_buffers_.resize(num_strips);
+  struct StripJob {
+    JpegCompressor* compressor;
+    const uint8_t* yuv;
+    int width;
+    int height;
+    int strip_rows;
+    int quality;
+    unsigned int restart_interval;
+    const void* app1_buffer;
+    unsigned int app1_size;
+    std::atomic<bool> succeeded;
+  } job;
+  job.compressor = this;
+  job.yuv = yuv;
+  job.width = width;
+  job.height = height;
+  job.strip_rows = strip_rows;
+  job.quality = jpegQuality;
+  job.restart_interval = restart_interval;
+  job.app1_buffer = app1Buffer;
+  job.app1_size = app1Size;
+  job.succeeded = true;
+  thread_pool_->ParallelFor(num_strips, [&job](size_t strip) {
+    int first_row = strip * job.strip_rows;
+    if (!EncodeStrip(job.yuv, job.width, job.height, first_row,
+                     std::min(job.strip_rows, job.height - first_row),
+                     job.quality, job.restart_interval,
+                     strip == 0 ? job.app1_buffer : nullptr,
+                     strip == 0 ? job.app1_size : 0,
+                     &job.compressor->strip_buffers_[strip])) {
+      job.succeeded = false;
+    }
+  });
+  return job.succeeded && JoinStrips(num_strips, height);
+}
+
+bool JpegCompressor::EncodeStrip(const uint8_t* yuv, int width, int height,
+                                 int first_row, int num_rows, int quality,
+                                 unsigned int restart_interval,
+                                 const void* app1Buffer,
+                                 unsigned int app1Size,
+                                 std::vector<JOCTET>* buffer) {
   jpeg_compress_struct cinfo;
   jpeg_error_mgr jerr;
 
@@ -90,9 +200,12 @@ bool JpegCompressor::Encode(const void* inYuv, int width, int height,
   // Override output_message() to print error log with ALOGE().
   cinfo.err->output_message = &OutputErrorMessage;
   jpeg_create_compress(&cinfo);
-  SetJpegDestination(&cinfo);
+  SetJpegDestination(&cinfo, buffer,
+                     EstimateCompressedSize(width * num_rows, quality) +
+                         app1Size);
 
-  SetJpegCompressStruct(width, height, jpegQuality, &cinfo);
+  SetJpegCompressStruct(width, num_rows, quality, &cinfo);
+  cinfo.restart_interval = restart_interval;
   jpeg_start_compress(&cinfo, TRUE);
 
   if (app1Buffer != nullptr && app1Size > 0) {
@@ -100,18 +213,71 @@ bool JpegCompressor::Encode(const void* inYuv, int width, int height,
                       static_cast<const JOCTET*>(app1Buffer), app1Size);
   }
 
-  if (!Compress(&cinfo, static_cast<const uint8_t*>(inYuv))) {
+  size_t y_plane_size = width * height;
+  const uint8_t* u_plane = yuv + y_plane_size;
+  const uint8_t* v_plane = u_plane + y_plane_size / 4;
+  size_t uv_offset = first_row / 2 * (width / 2);
+  bool result = Compress(&cinfo, yuv + first_row * width, u_plane + uv_offset,
+                         v_plane + uv_offset);
+  if (result) {
+    jpeg_finish_compress(&cinfo);
+  }
+  jpeg_destroy_compress(&cinfo);
+  return result;
+}
+
+bool JpegCompressor::JoinStrips(size_t num_strips, int height) {
+  // The first strip provides the headers, with the image height fixed up.
+  std::vector<JOCTET>& first = strip_buffers_[0];
+  size_t sof = FindSegment(first, kMarkerSOF0);
+  if (!sof || first.size() < sof + 9) {
+    LOGF(ERROR) << "Encoded strip has no SOF0 segment";
     return false;
   }
-  jpeg_finish_compress(&cinfo);
+  first[sof + 5] = static_cast<JOCTET>(height >> 8);
+  first[sof + 6] = static_cast<JOCTET>(height & 0xFF);
+
+  // Each strip ends with EOI; the others start their entropy-coded data
+  // right after their SOS segment.
+  std::vector<size_t> scan_begin(num_strips);
+  size_t size = first.size();
+  for (size_t strip = 1; strip < num_strips; ++strip) {
+    const std::vector<JOCTET>& jpeg = strip_buffers_[strip];
+    size_t sos = FindSegment(jpeg, kMarkerSOS);
+    if (!sos) {
+      LOGF(ERROR) << "Encoded strip " << strip << " has no SOS segment";
+      return false;
+    }
+    scan_begin[strip] = sos + 2 + ((jpeg[sos + 2] << 8) | jpeg[sos + 3]);
+    // The RST marker takes the place of the previous strip's EOI.
+    size += jpeg.size() - 2 - scan_begin[strip] + 2;
+  }
+
+  result_buffer_.resize(size);
+  JOCTET* dst = result_buffer_.data();
+  memcpy(dst, first.data(), first.size() - 2);
+  dst += first.size() - 2;
+  for (size_t strip = 1; strip < num_strips; ++strip) {
+    const std::vector<JOCTET>& jpeg = strip_buffers_[strip];
+    *dst++ = kMarkerPrefix;
+    *dst++ = kMarkerRST0 + (strip - 1) % 8;
+    memcpy(dst, jpeg.data() + scan_begin[strip],
+           jpeg.size() - 2 - scan_begin[strip]);
+    dst += jpeg.size() - 2 - scan_begin[strip];
+  }
+  *dst++ = kMarkerPrefix;
+  *dst++ = kMarkerEOI;
   return true;
 }
 
-void JpegCompressor::SetJpegDestination(jpeg_compress_struct* cinfo) {
+void JpegCompressor::SetJpegDestination(jpeg_compress_struct* cinfo,
+                                        std::vector<JOCTET>* buffer,
+                                        size_t initial_size) {
   destination_mgr* dest =
       static_cast<struct destination_mgr*>((*cinfo->mem->alloc_small)(
           (j_common_ptr)cinfo, JPOOL_PERMANENT, sizeof(destination_mgr)));
-  dest->compressor = this;
+  dest->buffer = buffer;
+  dest->initial_size = initial_size;
   dest->mgr.init_destination = &InitDestination;
   dest->mgr.empty_output_buffer = &EmptyOutputBuffer;
   dest->mgr.term_destination = &TerminateDestination;
@@ -141,17 +307,14 @@ void JpegCompressor::SetJpegCompressStruct(int width, int height, int quality,
   cinfo->comp_info[2].v_samp_factor = 1;
 }
 
-bool JpegCompressor::Compress(jpeg_compress_struct* cinfo, const uint8_t* yuv) {
+bool JpegCompressor::Compress(jpeg_compress_struct* cinfo,
+                              const uint8_t* y_plane, const uint8_t* u_plane,
+                              const uint8_t* v_plane) {
   JSAMPROW y[kCompressBatchSize];
   JSAMPROW cb[kCompressBatchSize / 2];
   JSAMPROW cr[kCompressBatchSize / 2];
   JSAMPARRAY planes[3]{y, cb, cr};
 
-  size_t y_plane_size = cinfo->image_width * cinfo->image_height;
-  size_t uv_plane_size = y_plane_size / 4;
-  uint8_t* y_plane = const_cast<uint8_t*>(yuv);
-  uint8_t* u_plane = const_cast<uint8_t*>(yuv + y_plane_size);
-  uint8_t* v_plane = const_cast<uint8_t*>(yuv + y_plane_size + uv_plane_size);
   std::unique_ptr<uint8_t[]> empty(new uint8_t[cinfo->image_width]);
   memset(empty.get(), 0, cinfo->image_width);
 
@@ -159,7 +322,7 @@ bool JpegCompressor::Compress(jpeg_compress_struct* cinfo, const uint8_t* yuv) {
     for (int i = 0; i < kCompressBatchSize; ++i) {
       size_t scanline = cinfo->next_scanline + i;
       if (scanline < cinfo->image_height) {
-        y[i] = y_plane + scanline * cinfo->image_width;
+        y[i] = const_cast<uint8_t*>(y_plane) + scanline * cinfo->image_width;
       } else {
         y[i] = empty.get();
       }
@@ -169,8 +332,8 @@ bool JpegCompressor::Compress(jpeg_compress_struct* cinfo, const uint8_t* yuv) {
       size_t scanline = cinfo->next_scanline / 2 + i;
       if (scanline < cinfo->image_height / 2) {
         int offset = scanline * (cinfo->image_width / 2);
-        cb[i] = u_plane + offset;
-        cr[i] = v_plane + offset;
+        cb[i] = const_cast<uint8_t*>(u_plane) + offset;
+        cr[i] = const_cast<uint8_t*>(v_plane) + offset;
       } else {
         cb[i] = cr[i] = empty.get();
       }
@@ -18,11 +18,16 @@ extern "C" {
 
 namespace arc {
 
+class ThreadPool;
+
 // Encapsulates a converter from YU12 to JPEG format. This class is not
 // thread-safe.
 class JpegCompressor {
  public:
   JpegCompressor();
+  // Large images are split into strips encoded concurrently on |thread_pool|
+  // and joined with restart markers. |thread_pool| must outlive this object.
+  explicit JpegCompressor(ThreadPool* thread_pool);
   ~JpegCompressor();
 
   // Compresses YU12 image to JPEG format. After calling this method, call
@@ -52,20 +57,39 @@ class JpegCompressor {
   // Returns false if errors occur.
   bool Encode(const void* inYuv, int width, int height, int jpegQuality,
               const void* app1Buffer, unsigned int app1Size);
-  void SetJpegDestination(jpeg_compress_struct* cinfo);
-  void SetJpegCompressStruct(int width, int height, int quality,
-                             jpeg_compress_struct* cinfo);
+  // Encodes rows [|first_row|, |first_row| + |num_rows|) of the |width| x
+  // |height| YU12 image |yuv| as a JPEG of its own into |buffer|, with
+  // |restart_interval| in the DRI segment. Returns false if errors occur.
+  static bool EncodeStrip(const uint8_t* yuv, int width, int height,
+                          int first_row, int num_rows, int quality,
+                          unsigned int restart_interval,
+                          const void* app1Buffer, unsigned int app1Size,
+                          std::vector<JOCTET>* buffer);
+  // Joins the JPEGs of |num_strips| strips from EncodeStrip() into one
+  // |height| rows high in |result_buffer_|. Returns false if errors occur.
+  bool JoinStrips(size_t num_strips, int height);
+  static void SetJpegDestination(jpeg_compress_struct* cinfo,
+                                 std::vector<JOCTET>* buffer,
+                                 size_t initial_size);
+  static void SetJpegCompressStruct(int width, int height, int quality,
+                                    jpeg_compress_struct* cinfo);
   // Returns false if errors occur.
-  bool Compress(jpeg_compress_struct* cinfo, const uint8_t* yuv);
+  static bool Compress(jpeg_compress_struct* cinfo, const uint8_t* y_plane,
+                       const uint8_t* u_plane, const uint8_t* v_plane);
 
-  // The block size for encoded jpeg image buffer.
+  // The minimum size for encoded jpeg image buffer.
   static const int kBlockSize = 16384;
   // Process 16 lines of Y and 16 lines of U/V each time.
   // We must pass at least 16 scanlines according to libjpeg documentation.
   static const int kCompressBatchSize = 16;
+  // Don't split an image into strips of fewer MCU rows (16 lines each).
+  static const int kMinStripMcuRows = 16;
 
+  ThreadPool* thread_pool_;
   // The buffer that holds the compressed result.
   std::vector<JOCTET> result_buffer_;
+  // The compressed strips, kept to avoid reallocating them for each image.
+  std::vector<std::vector<JOCTET>> strip_buffers_;
 };
 
 }  // namespace arc
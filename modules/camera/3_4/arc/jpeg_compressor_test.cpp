@@ -0,0 +1,103 @@
+/* Copyright 2026 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "arc/jpeg_compressor.h"
+
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "arc/thread_pool.h"
+
+using testing::TestWithParam;
+using testing::Values;
+
+namespace arc {
+
+struct ImageSize {
+  int width;
+  int height;
+};
+
+// Encoding in strips must decode to the same image as encoding in one go.
+class JpegCompressorStripTest : public TestWithParam<ImageSize> {
+ protected:
+  void SetUp() {
+    const ImageSize& size = GetParam();
+    yu12_.resize(size.width * size.height * 3 / 2);
+    for (size_t i = 0; i < yu12_.size(); ++i) {
+      yu12_[i] = static_cast<uint8_t>(i * 7 + i / size.width * 3);
+    }
+  }
+
+  std::vector<uint8_t> Compress(JpegCompressor* compressor) {
+    const ImageSize& size = GetParam();
+    const uint8_t app1[] = {'E', 'x', 'i', 'f', 0, 0};
+    EXPECT_TRUE(compressor->CompressImage(yu12_.data(), size.width,
+                                          size.height, 90, app1,
+                                          sizeof(app1)));
+    const uint8_t* data =
+        static_cast<const uint8_t*>(compressor->GetCompressedImagePtr());
+    return std::vector<uint8_t>(data,
+                                data + compressor->GetCompressedImageSize());
+  }
+
+  // Decodes |jpeg| to interleaved YCbCr and counts its restart markers.
+  std::vector<uint8_t> Decode(const std::vector<uint8_t>& jpeg,
+                              unsigned int* restart_interval) {
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, const_cast<uint8_t*>(jpeg.data()), jpeg.size());
+    EXPECT_EQ(jpeg_read_header(&cinfo, TRUE), JPEG_HEADER_OK);
+    cinfo.out_color_space = JCS_YCbCr;
+    jpeg_start_decompress(&cinfo);
+    EXPECT_EQ(cinfo.output_width, static_cast<JDIMENSION>(GetParam().width));
+    EXPECT_EQ(cinfo.output_height, static_cast<JDIMENSION>(GetParam().height));
+    *restart_interval = cinfo.restart_interval;
+    size_t row_size = cinfo.output_width * cinfo.output_components;
+    std::vector<uint8_t> pixels(row_size * cinfo.output_height);
+    while (cinfo.output_scanline < cinfo.output_height) {
+      JSAMPROW row = &pixels[cinfo.output_scanline * row_size];
+      jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+    // Corrupt data is only a warning to libjpeg.
+    EXPECT_EQ(jerr.num_warnings, 0);
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    return pixels;
+  }
+
+  std::vector<uint8_t> yu12_;
+};
+
+TEST_P(JpegCompressorStripTest, DecodesLikeOneStrip) {
+  JpegCompressor serial;
+  unsigned int restart_interval;
+  std::vector<uint8_t> expected = Decode(Compress(&serial), &restart_interval);
+  EXPECT_EQ(restart_interval, 0u);
+
+  for (size_t threads : {2, 3, 4}) {
+    ThreadPool pool(threads);
+    JpegCompressor compressor(&pool);
+    // Compress twice to reuse the strip buffers.
+    Compress(&compressor);
+    std::vector<uint8_t> jpeg = Compress(&compressor);
+    EXPECT_EQ(Decode(jpeg, &restart_interval), expected) << threads
+                                                         << " threads";
+    EXPECT_GT(restart_interval, 0u) << threads << " threads";
+    EXPECT_EQ(jpeg[0], 0xFF);
+    EXPECT_EQ(jpeg[1], 0xD8);
+    EXPECT_EQ(jpeg[jpeg.size() - 2], 0xFF);
+    EXPECT_EQ(jpeg[jpeg.size() - 1], 0xD9);
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(Sizes, JpegCompressorStripTest,
+                        Values(ImageSize{1280, 720},
+                               // Partial MCU row at the end.
+                               ImageSize{1920, 1080}));
+
+}  // namespace arc
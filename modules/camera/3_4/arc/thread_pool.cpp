@@ -0,0 +1,114 @@
+/* Copyright 2026 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include "arc/thread_pool.h"
+
+namespace arc {
+
+ThreadPool::ThreadPool(size_t num_threads)
+    : pending_head_(nullptr), pending_tail_(nullptr), stopping_(false) {
+  for (size_t i = 1; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    stopping_ = true;
+    work_available_.notify_all();
+  }
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::ParallelFor(size_t num_tasks,
+                             const std::function<void(size_t)>& task) {
+  if (num_tasks == 0) {
+    return;
+  }
+  if (num_tasks == 1 || workers_.empty()) {
+    for (size_t i = 0; i < num_tasks; ++i) {
+      task(i);
+    }
+    return;
+  }
+
+  Batch batch;
+  batch.task = &task;
+  batch.num_tasks = num_tasks;
+  batch.next_task = 0;
+  batch.finished_tasks = 0;
+  batch.next = nullptr;
+
+  std::unique_lock<std::mutex> lock(lock_);
+  if (pending_tail_) {
+    pending_tail_->next = &batch;
+  } else {
+    pending_head_ = &batch;
+  }
+  pending_tail_ = &batch;
+  work_available_.notify_all();
+
+  // Work on our own batch rather than wait for the workers to get to it.
+  size_t index;
+  while (TakeTask(&batch, &index)) {
+    lock.unlock();
+    RunTask(&batch, index);
+    lock.lock();
+  }
+  batch.all_finished.wait(
+      lock, [&batch] { return batch.finished_tasks == batch.num_tasks; });
+}
+
+bool ThreadPool::TakeTask(Batch* batch, size_t* index) {
+  if (batch->next_task == batch->num_tasks) {
+    return false;
+  }
+  *index = batch->next_task++;
+  if (batch->next_task == batch->num_tasks) {
+    // Nothing left to hand out; unlink it. The list is as short as the
+    // number of threads running batches.
+    Batch** link = &pending_head_;
+    Batch* previous = nullptr;
+    while (*link != batch) {
+      previous = *link;
+      link = &(*link)->next;
+    }
+    *link = batch->next;
+    if (pending_tail_ == batch) {
+      pending_tail_ = previous;
+    }
+  }
+  return true;
+}
+
+void ThreadPool::RunTask(Batch* batch, size_t index) {
+  (*batch->task)(index);
+  std::lock_guard<std::mutex> lock(lock_);
+  if (++batch->finished_tasks == batch->num_tasks) {
+    batch->all_finished.notify_one();
+  }
+}
+
+void ThreadPool::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(lock_);
+  while (true) {
+    work_available_.wait(lock,
+                         [this] { return stopping_ || pending_head_; });
+    if (stopping_) {
+      return;
+    }
+    Batch* batch = pending_head_;
+    size_t index = 0;
+    TakeTask(batch, &index);
+    lock.unlock();
+    RunTask(batch, index);
+    lock.lock();
+  }
+}
+
+}  // namespace arc
@@ -0,0 +1,64 @@
+/* Copyright 2026 The Chromium OS Authors. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef HAL_USB_THREAD_POOL_H_
+#define HAL_USB_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace arc {
+
+// ThreadPool runs batches of independent tasks, e.g. the bands of an image,
+// on a fixed set of worker threads. The calling thread works on its own batch
+// too, so a pool of N threads has N - 1 workers.
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t num_threads);
+  ~ThreadPool();
+
+  // Number of threads a batch can run on, including the caller.
+  size_t num_threads() const { return workers_.size() + 1; }
+
+  // Run |task(0)| ... |task(num_tasks - 1)| and return once all have finished.
+  // Tasks may run in any order and concurrently. Several threads may run
+  // batches at once. Doesn't allocate, so |task| should be small enough for
+  // std::function to hold inline (e.g. a lambda capturing one reference).
+  void ParallelFor(size_t num_tasks, const std::function<void(size_t)>& task);
+
+ private:
+  struct Batch {
+    const std::function<void(size_t)>* task;
+    size_t num_tasks;
+    // Index of the next task to hand out.
+    size_t next_task;
+    size_t finished_tasks;
+    std::condition_variable all_finished;
+    // Next batch with tasks left to hand out.
+    Batch* next;
+  };
+
+  void WorkerLoop();
+  // Hand out the next task of |batch|, removing it from the pending list when
+  // its last task goes. Returns false if it had none left. Requires |lock_|.
+  bool TakeTask(Batch* batch, size_t* index);
+  // Run task |index| of |batch| without |lock_| held.
+  void RunTask(Batch* batch, size_t index);
+
+  std::mutex lock_;
+  std::condition_variable work_available_;
+  // Batches with tasks left to hand out, oldest first.
+  Batch* pending_head_;
+  Batch* pending_tail_;
+  bool stopping_;
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace arc
+
+#endif  // HAL_USB_THREAD_POOL_H_
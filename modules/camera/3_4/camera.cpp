@@ -38,6 +38,9 @@
 
 namespace default_camera_hal {
 
+// Requests kept for reuse; more than any pipeline keeps in flight.
+static const size_t kRequestPoolSize = 32;
+
 extern "C" {
 // Shim passed to the framework to close an opened device.
 static int close_device(hw_device_t* dev)
@@ -53,7 +56,8 @@ Camera::Camera(int id)
     mSettingsSet(false),
     mBusy(false),
     mCallbackOps(NULL),
-    mInFlightTracker(new RequestTracker)
+    mInFlightTracker(new RequestTracker),
+    mRequestPool(kRequestPoolSize)
 {
     memset(&mTemplates, 0, sizeof(mTemplates));
     memset(&mDevice, 0, sizeof(mDevice));
@@ -310,7 +314,7 @@ int Camera::processCaptureRequest(camera3_capture_request_t *temp_request)
 
     // Make a persistent copy of request, since otherwise it won't live
     // past the end of this method.
-    std::shared_ptr<CaptureRequest> request = std::make_shared<CaptureRequest>(temp_request);
+    std::shared_ptr<CaptureRequest> request = mRequestPool.Acquire(temp_request);
 
     ALOGV("%s:%d: frame: %d", __func__, mId, request->frame_number);
 
@@ -364,7 +368,13 @@ int Camera::processCaptureRequest(camera3_capture_request_t *temp_request)
     mSettingsSet = true;
 
     // Send the request off to the device for completion.
-    enqueueRequest(request);
+    res = enqueueRequest(request);
+    if (res) {
+        ALOGE("%s:%d: Failed to enqueue request for frame %d.",
+              __func__, mId, request->frame_number);
+        mInFlightTracker->Remove(request);
+        return res;
+    }
 
     // Request is now in flight. The device will call completeRequest
     // asynchronously when it is done filling buffers and metadata.
@@ -423,8 +433,14 @@ int Camera::flush()
     // is called concurrently with this (in either order).
     // Since the callback to completeRequest also may happen on a separate
     // thread, this function should behave nicely concurrently with that too.
-    android::Mutex::Autolock tl(mInFlightTrackerLock);
 
+    // Call down into the device flushing first: buffers may still be being
+    // written until it returns, so they can't go back to the framework yet.
+    // Requests it finishes meanwhile are completed as usual, which takes
+    // the tracker lock, so it mustn't be held here.
+    int res = flushBuffers();
+
+    android::Mutex::Autolock tl(mInFlightTrackerLock);
     std::set<std::shared_ptr<CaptureRequest>> requests;
     mInFlightTracker->Clear(&requests);
     for (auto& request : requests) {
@@ -434,9 +450,7 @@ int Camera::flush()
     }
 
     ALOGV("%s:%d: Flushed %zu requests.", __func__, mId, requests.size());
-
-    // Call down into the device flushing.
-    return flushBuffers();
+    return res;
 }
 
 int Camera::preprocessCaptureBuffer(camera3_stream_buffer_t *buffer)
@@ -519,6 +533,7 @@ void Camera::dump(int fd)
     android::Mutex::Autolock dl(mDeviceLock);
 
     dprintf(fd, "Camera ID: %d (Busy: %d)\n", mId, mBusy);
+    dumpDevice(fd);
 
     // TODO: dump all settings
 }
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures how long building a camera's static metadata takes, the way
+// V4L2Camera::NewV4L2Camera does, against a real capture device:
+//   cold: no capability cache, so every format, frame size and frame
+//         interval is enumerated with ioctls.
+//   warm: the cache written by the previous open is used.
+//
+// Usage: camera_open_benchmark [device] [iterations] [cache dir]
+//   e.g. camera_open_benchmark /dev/video0 20 /data/local/tmp
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <linux/videodev2.h>
+#include "capability_cache.h"
+#include "metadata/metadata.h"
+#include "v4l2_metadata_factory.h"
+#include "v4l2_wrapper.h"
+
+using v4l2_camera_hal::CapabilityCache;
+using v4l2_camera_hal::Metadata;
+using v4l2_camera_hal::V4L2Wrapper;
+
+namespace {
+
+double MonotonicMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Open |path| |iterations| times, removing |cache_path| first if |cold|,
+// and print the time per open.
+bool Measure(const char* name, const char* path, const std::string& cache_path,
+             bool cold, int iterations) {
+  std::vector<double> times;
+  for (int i = 0; i < iterations; ++i) {
+    if (cold) {
+      unlink(cache_path.c_str());
+    }
+    double start = MonotonicMs();
+    std::shared_ptr<V4L2Wrapper> device(V4L2Wrapper::NewV4L2Wrapper(path));
+    std::unique_ptr<Metadata> metadata;
+    int res = v4l2_camera_hal::GetV4L2Metadata(device, &metadata);
+    times.push_back(MonotonicMs() - start);
+    if (res) {
+      fprintf(stderr, "%s: open %d failed: %d\n", name, i, res);
+      return false;
+    }
+  }
+  std::sort(times.begin(), times.end());
+  printf("%-6s %10.2f %10.2f %10.2f\n", name, times[times.size() / 2],
+         times.front(), times.back());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* path = argc > 1 ? argv[1] : "/dev/video0";
+  int iterations = argc > 2 ? atoi(argv[2]) : 20;
+  std::string dir = argc > 3 ? argv[3] : "/data/local/tmp";
+  if (iterations <= 0) {
+    fprintf(stderr, "Usage: %s [device] [iterations] [cache dir]\n", argv[0]);
+    return 1;
+  }
+
+  // The cache file is named after the device, so find out which it is.
+  v4l2_capability cap;
+  {
+    int fd = open(path, O_RDWR);
+    if (fd < 0 || ioctl(fd, VIDIOC_QUERYCAP, &cap)) {
+      fprintf(stderr, "Failed to query %s\n", path);
+      return 1;
+    }
+    close(fd);
+  }
+  std::string cache_path = dir + "/" + CapabilityCache::FileName(cap);
+  V4L2Wrapper::SetCapabilityCacheDir(dir);
+
+  printf("%-6s %10s %10s %10s\n", "cache", "median ms", "min ms", "max ms");
+  bool ok = Measure("cold", path, cache_path, true, iterations) &&
+            Measure("warm", path, cache_path, false, iterations);
+  unlink(cache_path.c_str());
+  return ok ? 0 : 1;
+}
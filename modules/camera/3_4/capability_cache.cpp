@@ -0,0 +1,237 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "CapabilityCache"
+
+#include "capability_cache.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+
+namespace v4l2_camera_hal {
+
+// First line of the file. Bump the version when the format changes.
+static const char kHeader[] = "v4l2-capabilities 1";
+
+// A NUL-terminated string field of v4l2_capability, with anything that
+// would break the line-based file replaced.
+template <size_t N>
+static std::string CapString(const __u8 (&field)[N], bool file_name) {
+  std::string result(reinterpret_cast<const char*>(field),
+                     strnlen(reinterpret_cast<const char*>(field), N));
+  for (char& c : result) {
+    if (file_name ? !isalnum(c) && c != '.' && c != '-' : !isprint(c)) {
+      c = '_';
+    }
+  }
+  return result;
+}
+
+CapabilityCache::CapabilityCache() : has_formats_(false), dirty_(false) {}
+
+std::string CapabilityCache::DeviceKey(const v4l2_capability& cap) {
+  char version[16];
+  snprintf(version, sizeof(version), "%u.%u.%u", (cap.version >> 16) & 0xFF,
+           (cap.version >> 8) & 0xFF, cap.version & 0xFF);
+  return CapString(cap.bus_info, false) + "|" + CapString(cap.driver, false) +
+         "|" + CapString(cap.card, false) + "|" + version;
+}
+
+std::string CapabilityCache::FileName(const v4l2_capability& cap) {
+  std::string bus = CapString(cap.bus_info, true);
+  return "v4l2_" + (bus.empty() ? CapString(cap.card, true) : bus) + ".caps";
+}
+
+bool CapabilityCache::Load(const std::string& path, const std::string& key) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (path == path_ && key == key_) {
+    return has_formats_;
+  }
+  path_ = path;
+  key_ = key;
+  ClearLocked();
+  if (path_.empty()) {
+    return false;
+  }
+  if (!ReadLocked()) {
+    ClearLocked();
+    return false;
+  }
+  HAL_LOGV("Loaded capabilities of %s from %s.", key_.c_str(), path_.c_str());
+  return true;
+}
+
+bool CapabilityCache::ReadLocked() {
+  FILE* file = fopen(path_.c_str(), "re");
+  if (!file) {
+    if (errno != ENOENT) {
+      HAL_LOGW("Failed to open %s: %s", path_.c_str(), strerror(errno));
+    }
+    return false;
+  }
+
+  char line[512];
+  bool valid = fgets(line, sizeof(line), file) &&
+               strcmp(line, std::string(kHeader).append("\n").c_str()) == 0 &&
+               fgets(line, sizeof(line), file) &&
+               ("key " + key_ + "\n") == line;
+  while (valid && fgets(line, sizeof(line), file)) {
+    uint32_t format;
+    std::array<int32_t, 2> size;
+    std::array<int64_t, 2> range;
+    if (strcmp(line, "formats\n") == 0) {
+      has_formats_ = true;
+    } else if (sscanf(line, "format %" SCNx32, &format) == 1) {
+      formats_.insert(format);
+    } else if (sscanf(line, "sizes %" SCNx32, &format) == 1) {
+      frame_sizes_[format];
+    } else if (sscanf(line, "size %" SCNx32 " %" SCNd32 " %" SCNd32, &format,
+                      &size[0], &size[1]) == 3) {
+      frame_sizes_[format].insert(size);
+    } else if (sscanf(line,
+                      "duration %" SCNx32 " %" SCNd32 " %" SCNd32 " %" SCNd64
+                      " %" SCNd64,
+                      &format, &size[0], &size[1], &range[0],
+                      &range[1]) == 5) {
+      duration_ranges_[FormatSize(format, size)] = range;
+    } else {
+      HAL_LOGW("Ignoring corrupt capability cache %s.", path_.c_str());
+      valid = false;
+    }
+  }
+  fclose(file);
+  return valid && has_formats_;
+}
+
+int CapabilityCache::Save() {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (path_.empty() || !dirty_) {
+    return 0;
+  }
+
+  // Write a new file and rename it over the old one, so a reader never sees
+  // half of it.
+  std::string temp_path = path_ + ".tmp";
+  FILE* file = fopen(temp_path.c_str(), "we");
+  if (!file) {
+    int res = -errno;
+    HAL_LOGW("Failed to create %s: %s", temp_path.c_str(), strerror(errno));
+    return res;
+  }
+  fprintf(file, "%s\nkey %s\n", kHeader, key_.c_str());
+  if (has_formats_) {
+    fprintf(file, "formats\n");
+    for (uint32_t format : formats_) {
+      fprintf(file, "format %" PRIx32 "\n", format);
+    }
+  }
+  for (const auto& entry : frame_sizes_) {
+    fprintf(file, "sizes %" PRIx32 "\n", entry.first);
+    for (const auto& size : entry.second) {
+      fprintf(file, "size %" PRIx32 " %" PRId32 " %" PRId32 "\n", entry.first,
+              size[0], size[1]);
+    }
+  }
+  for (const auto& entry : duration_ranges_) {
+    fprintf(file,
+            "duration %" PRIx32 " %" PRId32 " %" PRId32 " %" PRId64 " %" PRId64
+            "\n",
+            entry.first.first, entry.first.second[0], entry.first.second[1],
+            entry.second[0], entry.second[1]);
+  }
+  errno = 0;
+  bool written = !ferror(file);
+  if (fclose(file) || !written || rename(temp_path.c_str(), path_.c_str())) {
+    int res = errno ? -errno : -EIO;
+    HAL_LOGW("Failed to write %s: %s", path_.c_str(), strerror(-res));
+    unlink(temp_path.c_str());
+    return res;
+  }
+  dirty_ = false;
+  HAL_LOGV("Saved capabilities of %s to %s.", key_.c_str(), path_.c_str());
+  return 0;
+}
+
+void CapabilityCache::ClearLocked() {
+  has_formats_ = false;
+  formats_.clear();
+  frame_sizes_.clear();
+  duration_ranges_.clear();
+  dirty_ = false;
+}
+
+bool CapabilityCache::GetFormats(std::set<uint32_t>* formats) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!has_formats_) {
+    return false;
+  }
+  formats->insert(formats_.begin(), formats_.end());
+  return true;
+}
+
+void CapabilityCache::SetFormats(const std::set<uint32_t>& formats) {
+  std::lock_guard<std::mutex> lock(lock_);
+  has_formats_ = true;
+  formats_ = formats;
+  dirty_ = true;
+}
+
+bool CapabilityCache::GetFrameSizes(
+    uint32_t v4l2_format, std::set<std::array<int32_t, 2>>* sizes) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto entry = frame_sizes_.find(v4l2_format);
+  if (entry == frame_sizes_.end()) {
+    return false;
+  }
+  sizes->insert(entry->second.begin(), entry->second.end());
+  return true;
+}
+
+void CapabilityCache::SetFrameSizes(
+    uint32_t v4l2_format, const std::set<std::array<int32_t, 2>>& sizes) {
+  std::lock_guard<std::mutex> lock(lock_);
+  frame_sizes_[v4l2_format] = sizes;
+  dirty_ = true;
+}
+
+bool CapabilityCache::GetFrameDurationRange(
+    uint32_t v4l2_format, const std::array<int32_t, 2>& size,
+    std::array<int64_t, 2>* duration_range) const {
+  std::lock_guard<std::mutex> lock(lock_);
+  auto entry = duration_ranges_.find(FormatSize(v4l2_format, size));
+  if (entry == duration_ranges_.end()) {
+    return false;
+  }
+  *duration_range = entry->second;
+  return true;
+}
+
+void CapabilityCache::SetFrameDurationRange(
+    uint32_t v4l2_format, const std::array<int32_t, 2>& size,
+    const std::array<int64_t, 2>& duration_range) {
+  std::lock_guard<std::mutex> lock(lock_);
+  duration_ranges_[FormatSize(v4l2_format, size)] = duration_range;
+  dirty_ = true;
+}
+
+}  // namespace v4l2_camera_hal
@@ -0,0 +1,94 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V4L2_CAMERA_HAL_CAPABILITY_CACHE_H_
+#define V4L2_CAMERA_HAL_CAPABILITY_CACHE_H_
+
+#include <array>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+
+#include <android-base/macros.h>
+#include <linux/videodev2.h>
+
+namespace v4l2_camera_hal {
+
+// On-disk copy of what a device reported through VIDIOC_ENUM_FMT,
+// VIDIOC_ENUM_FRAMESIZES and VIDIOC_ENUM_FRAMEINTERVALS, which can take
+// hundreds of slow ioctls on UVC cameras. The file is tied to the device's
+// bus, driver, card name and driver version, so it is dropped when any of
+// them changes. Entries are only added, by whoever enumerated them.
+// Thread-safe.
+class CapabilityCache {
+ public:
+  CapabilityCache();
+
+  // Key and file name identifying the device that reported |cap|.
+  static std::string DeviceKey(const v4l2_capability& cap);
+  static std::string FileName(const v4l2_capability& cap);
+
+  // Back the cache by the file at |path|, keeping its entries if it was
+  // written for |key|. An empty |path| keeps the cache in memory only.
+  // Does nothing if already loaded from |path| for |key|. Returns whether
+  // the file had entries for |key|.
+  bool Load(const std::string& path, const std::string& key);
+  // Write the entries to the file if any were added since Load.
+  // Returns 0 on success, or -errno.
+  int Save();
+
+  // Each getter returns false if the entry isn't cached.
+  bool GetFormats(std::set<uint32_t>* formats) const;
+  void SetFormats(const std::set<uint32_t>& formats);
+  bool GetFrameSizes(uint32_t v4l2_format,
+                     std::set<std::array<int32_t, 2>>* sizes) const;
+  void SetFrameSizes(uint32_t v4l2_format,
+                     const std::set<std::array<int32_t, 2>>& sizes);
+  bool GetFrameDurationRange(uint32_t v4l2_format,
+                             const std::array<int32_t, 2>& size,
+                             std::array<int64_t, 2>* duration_range) const;
+  void SetFrameDurationRange(uint32_t v4l2_format,
+                             const std::array<int32_t, 2>& size,
+                             const std::array<int64_t, 2>& duration_range);
+
+ private:
+  typedef std::pair<uint32_t, std::array<int32_t, 2>> FormatSize;
+
+  // Drop all entries. Requires |lock_|.
+  void ClearLocked();
+  // Read the entries of |path_| if it was written for |key_|. Requires
+  // |lock_|.
+  bool ReadLocked();
+
+  mutable std::mutex lock_;
+  std::string path_;
+  std::string key_;
+  // Whether |formats_| holds the ENUM_FMT result.
+  bool has_formats_;
+  std::set<uint32_t> formats_;
+  std::map<uint32_t, std::set<std::array<int32_t, 2>>> frame_sizes_;
+  std::map<FormatSize, std::array<int64_t, 2>> duration_ranges_;
+  // Whether there are entries the file doesn't have.
+  bool dirty_;
+
+  DISALLOW_COPY_AND_ASSIGN(CapabilityCache);
+};
+
+}  // namespace v4l2_camera_hal
+
+#endif  // V4L2_CAMERA_HAL_CAPABILITY_CACHE_H_
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "capability_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+namespace v4l2_camera_hal {
+
+class CapabilityCacheTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    memset(&cap_, 0, sizeof(cap_));
+    strcpy(reinterpret_cast<char*>(cap_.driver), "uvcvideo");
+    strcpy(reinterpret_cast<char*>(cap_.card), "Integrated Camera: Cam");
+    strcpy(reinterpret_cast<char*>(cap_.bus_info), "usb-0000:00:14.0-8");
+    cap_.version = 0x040e00;
+    path_ = testing::TempDir() + "/" + CapabilityCache::FileName(cap_);
+    unlink(path_.c_str());
+  }
+
+  virtual void TearDown() { unlink(path_.c_str()); }
+
+  // Fill |cache| the way V4L2Wrapper does after enumerating.
+  void Fill(CapabilityCache* cache) {
+    cache->SetFormats({V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_MJPEG});
+    cache->SetFrameSizes(V4L2_PIX_FMT_YUYV, {{{640, 480}}, {{1280, 720}}});
+    // Formats may have no sizes.
+    cache->SetFrameSizes(V4L2_PIX_FMT_MJPEG, {});
+    cache->SetFrameDurationRange(V4L2_PIX_FMT_YUYV, {{640, 480}},
+                                 {{33333333, 200000000}});
+  }
+
+  v4l2_capability cap_;
+  std::string path_;
+};
+
+TEST_F(CapabilityCacheTest, FileNameFromBus) {
+  EXPECT_EQ(CapabilityCache::FileName(cap_), "v4l2_usb-0000_00_14.0-8.caps");
+}
+
+TEST_F(CapabilityCacheTest, EmptyUntilSet) {
+  CapabilityCache cache;
+  EXPECT_FALSE(cache.Load(path_, CapabilityCache::DeviceKey(cap_)));
+  std::set<uint32_t> formats;
+  EXPECT_FALSE(cache.GetFormats(&formats));
+  std::set<std::array<int32_t, 2>> sizes;
+  EXPECT_FALSE(cache.GetFrameSizes(V4L2_PIX_FMT_YUYV, &sizes));
+  std::array<int64_t, 2> range;
+  EXPECT_FALSE(
+      cache.GetFrameDurationRange(V4L2_PIX_FMT_YUYV, {{640, 480}}, &range));
+}
+
+TEST_F(CapabilityCacheTest, SaveAndLoad) {
+  {
+    CapabilityCache cache;
+    cache.Load(path_, CapabilityCache::DeviceKey(cap_));
+    Fill(&cache);
+    ASSERT_EQ(cache.Save(), 0);
+  }
+
+  CapabilityCache cache;
+  ASSERT_TRUE(cache.Load(path_, CapabilityCache::DeviceKey(cap_)));
+  std::set<uint32_t> formats;
+  ASSERT_TRUE(cache.GetFormats(&formats));
+  EXPECT_EQ(formats,
+            std::set<uint32_t>({V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_MJPEG}));
+  std::set<std::array<int32_t, 2>> sizes;
+  ASSERT_TRUE(cache.GetFrameSizes(V4L2_PIX_FMT_YUYV, &sizes));
+  std::set<std::array<int32_t, 2>> expected_sizes = {{{640, 480}},
+                                                     {{1280, 720}}};
+  EXPECT_EQ(sizes, expected_sizes);
+  sizes.clear();
+  EXPECT_TRUE(cache.GetFrameSizes(V4L2_PIX_FMT_MJPEG, &sizes));
+  EXPECT_TRUE(sizes.empty());
+  std::array<int64_t, 2> range;
+  ASSERT_TRUE(
+      cache.GetFrameDurationRange(V4L2_PIX_FMT_YUYV, {{640, 480}}, &range));
+  EXPECT_EQ(range[0], 33333333);
+  EXPECT_EQ(range[1], 200000000);
+  EXPECT_FALSE(
+      cache.GetFrameDurationRange(V4L2_PIX_FMT_YUYV, {{1280, 720}}, &range));
+}
+
+TEST_F(CapabilityCacheTest, DriverUpdateDropsEntries) {
+  {
+    CapabilityCache cache;
+    cache.Load(path_, CapabilityCache::DeviceKey(cap_));
+    Fill(&cache);
+    ASSERT_EQ(cache.Save(), 0);
+  }
+
+  cap_.version = 0x040f00;
+  CapabilityCache cache;
+  EXPECT_FALSE(cache.Load(path_, CapabilityCache::DeviceKey(cap_)));
+  std::set<uint32_t> formats;
+  EXPECT_FALSE(cache.GetFormats(&formats));
+}
+
+TEST_F(CapabilityCacheTest, CorruptFileIgnored) {
+  {
+    CapabilityCache cache;
+    cache.Load(path_, CapabilityCache::DeviceKey(cap_));
+    Fill(&cache);
+    ASSERT_EQ(cache.Save(), 0);
+  }
+  FILE* file = fopen(path_.c_str(), "a");
+  ASSERT_NE(file, nullptr);
+  fputs("size 56595559 640\n", file);
+  fclose(file);
+
+  CapabilityCache cache;
+  EXPECT_FALSE(cache.Load(path_, CapabilityCache::DeviceKey(cap_)));
+  std::set<std::array<int32_t, 2>> sizes;
+  EXPECT_FALSE(cache.GetFrameSizes(V4L2_PIX_FMT_YUYV, &sizes));
+}
+
+TEST_F(CapabilityCacheTest, NoFileWithoutPath) {
+  CapabilityCache cache;
+  EXPECT_FALSE(cache.Load("", CapabilityCache::DeviceKey(cap_)));
+  Fill(&cache);
+  EXPECT_EQ(cache.Save(), 0);
+  std::set<uint32_t> formats;
+  EXPECT_TRUE(cache.GetFormats(&formats));
+  EXPECT_NE(access(path_.c_str(), F_OK), 0);
+}
+
+}  // namespace v4l2_camera_hal
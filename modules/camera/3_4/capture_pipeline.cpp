@@ -0,0 +1,225 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "capture_pipeline.h"
+
+#include <errno.h>
+#include <stdio.h>
+
+#include <limits>
+
+#include "common.h"
+#include "function_thread.h"
+
+namespace v4l2_camera_hal {
+
+typedef std::chrono::steady_clock Clock;
+
+CapturePipeline::CapturePipeline(StageFunction convert,
+                                 StageFunction encode,
+                                 StageFunction release,
+                                 StageFunction complete,
+                                 size_t num_convert_workers,
+                                 size_t queue_depth)
+    : convert_(std::move(convert)),
+      encode_(std::move(encode)),
+      release_(std::move(release)),
+      complete_(std::move(complete)),
+      convert_queue_(queue_depth),
+      encode_queue_(queue_depth),
+      complete_queue_(std::numeric_limits<size_t>::max()),
+      encoder_(new FunctionThread(
+          std::bind(&CapturePipeline::encodeFrames, this))),
+      completer_(new FunctionThread(
+          std::bind(&CapturePipeline::completeFrames, this))),
+      running_(false),
+      stopped_(false),
+      next_encode_sequence_(0),
+      next_sequence_(0),
+      pending_(0) {
+  for (size_t i = 0; i < num_convert_workers; ++i) {
+    converters_.push_back(new FunctionThread(
+        std::bind(&CapturePipeline::convertFrames, this)));
+  }
+}
+
+CapturePipeline::~CapturePipeline() { Stop(); }
+
+int CapturePipeline::Start() {
+  std::lock_guard<std::mutex> guard(pending_lock_);
+  if (stopped_) {
+    HAL_LOGE("Pipeline has been stopped.");
+    return -ENODEV;
+  }
+  if (running_) {
+    return 0;
+  }
+
+  for (auto& converter : converters_) {
+    android::status_t res = converter->run("Convert frames");
+    if (res != android::OK) {
+      HAL_LOGE("Failed to start frame conversion thread: %d", res);
+      return -ENODEV;
+    }
+  }
+  android::status_t res = encoder_->run("Encode frames");
+  if (res != android::OK) {
+    HAL_LOGE("Failed to start frame encoding thread: %d", res);
+    return -ENODEV;
+  }
+  res = completer_->run("Complete results");
+  if (res != android::OK) {
+    HAL_LOGE("Failed to start result completion thread: %d", res);
+    return -ENODEV;
+  }
+  running_ = true;
+  return 0;
+}
+
+void CapturePipeline::Stop() {
+  {
+    std::lock_guard<std::mutex> guard(pending_lock_);
+    if (stopped_) {
+      return;
+    }
+    stopped_ = true;
+    pending_released_.notify_all();
+  }
+
+  // Stop the stages front to back, so none loses the frames handed to it by
+  // the one before.
+  convert_queue_.Close();
+  for (auto& converter : converters_) {
+    converter->requestExitAndWait();
+  }
+  encode_queue_.Close();
+  encoder_->requestExitAndWait();
+  complete_queue_.Close();
+  completer_->requestExitAndWait();
+}
+
+int CapturePipeline::Submit(
+    std::shared_ptr<default_camera_hal::CaptureRequest> request,
+    uint32_t index) {
+  Frame frame;
+  frame.request = std::move(request);
+  frame.index = index;
+  frame.submitted = Clock::now();
+  {
+    std::lock_guard<std::mutex> guard(pending_lock_);
+    if (stopped_) {
+      return -ENODEV;
+    }
+    frame.sequence = next_sequence_++;
+    ++pending_;
+  }
+
+  if (!convert_queue_.Push(std::move(frame))) {
+    // Only happens when stopping, after which nothing is delivered anyway.
+    std::lock_guard<std::mutex> guard(pending_lock_);
+    --pending_;
+    pending_released_.notify_all();
+    return -ENODEV;
+  }
+  return 0;
+}
+
+void CapturePipeline::Drain() {
+  std::unique_lock<std::mutex> lock(pending_lock_);
+  while (pending_ > 0 && !stopped_) {
+    pending_released_.wait(lock);
+  }
+}
+
+bool CapturePipeline::convertFrames() {
+  Frame frame;
+  if (!convert_queue_.Pop(&frame)) {
+    return false;
+  }
+
+  Clock::time_point start = Clock::now();
+  convert_(frame);
+  convert_latency_.Record(Clock::now() - start);
+
+  // Pass frames on in submission order. Pushing under the lock keeps
+  // other workers from overtaking; the encode thread never takes it.
+  std::lock_guard<std::mutex> guard(reorder_lock_);
+  uint64_t sequence = frame.sequence;
+  reorder_.emplace(sequence, std::move(frame));
+  while (!reorder_.empty() &&
+         reorder_.begin()->first == next_encode_sequence_) {
+    if (!encode_queue_.Push(std::move(reorder_.begin()->second))) {
+      return false;
+    }
+    reorder_.erase(reorder_.begin());
+    ++next_encode_sequence_;
+  }
+  return true;
+}
+
+bool CapturePipeline::encodeFrames() {
+  Frame frame;
+  if (!encode_queue_.Pop(&frame)) {
+    return false;
+  }
+
+  Clock::time_point start = Clock::now();
+  encode_(frame);
+  frame.encoded = Clock::now();
+  encode_latency_.Record(frame.encoded - start);
+
+  // Give the device buffer back before the framework sees the result, so a
+  // following flush or reconfiguration finds nothing in flight.
+  release_(frame);
+  {
+    std::lock_guard<std::mutex> guard(pending_lock_);
+    --pending_;
+    pending_released_.notify_all();
+  }
+  return complete_queue_.Push(std::move(frame));
+}
+
+bool CapturePipeline::completeFrames() {
+  // Keep going until the queue is closed and empty rather than returning
+  // per frame, so stopping still delivers every result already released.
+  Frame frame;
+  while (complete_queue_.Pop(&frame)) {
+    complete_(frame);
+    Clock::time_point completed = Clock::now();
+    result_latency_.Record(completed - frame.encoded);
+    total_latency_.Record(completed - frame.submitted);
+  }
+  return false;
+}
+
+void CapturePipeline::Dump(int fd) {
+  size_t pending;
+  {
+    std::lock_guard<std::mutex> guard(pending_lock_);
+    pending = pending_;
+  }
+  dprintf(fd,
+          "Capture pipeline: %zu converters, %zu frames pending "
+          "(%zu to convert, %zu to encode, %zu to complete)\n",
+          converters_.size(), pending, convert_queue_.size(),
+          encode_queue_.size(), complete_queue_.size());
+  convert_latency_.Dump(fd, "convert");
+  encode_latency_.Dump(fd, "encode");
+  result_latency_.Dump(fd, "result");
+  total_latency_.Dump(fd, "total");
+}
+
+}  // namespace v4l2_camera_hal
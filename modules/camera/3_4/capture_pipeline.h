@@ -0,0 +1,193 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V4L2_CAMERA_HAL_CAPTURE_PIPELINE_H_
+#define V4L2_CAMERA_HAL_CAPTURE_PIPELINE_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <android-base/macros.h>
+#include <utils/StrongPointer.h>
+#include <utils/Thread.h>
+#include "capture_request.h"
+#include "latency_histogram.h"
+
+namespace v4l2_camera_hal {
+
+// Fixed-capacity FIFO shared between pipeline threads.
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity)
+      : capacity_(capacity), closed_(false) {}
+
+  // Blocks while the queue is full. Returns false if the queue is closed.
+  bool Push(T item) {
+    std::unique_lock<std::mutex> lock(lock_);
+    not_full_.wait(lock,
+                   [this] { return closed_ || items_.size() < capacity_; });
+    if (closed_) {
+      return false;
+    }
+    items_.push_back(std::move(item));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  // Blocks while the queue is empty. Returns false once the queue is closed
+  // and drained.
+  bool Pop(T* item) {
+    std::unique_lock<std::mutex> lock(lock_);
+    not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) {
+      return false;
+    }
+    *item = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  // Wake up and fail every blocked and future Push, and every Pop once empty.
+  void Close() {
+    std::lock_guard<std::mutex> lock(lock_);
+    closed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return items_.size();
+  }
+
+ private:
+  const size_t capacity_;
+  bool closed_;
+  std::deque<T> items_;
+  std::mutex lock_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+
+  DISALLOW_COPY_AND_ASSIGN(BoundedQueue);
+};
+
+// Processes dequeued frames in stages, so a slow frame (e.g. a JPEG) doesn't
+// hold up the frames behind it:
+//
+//   Submit -> convert (worker pool) -> reorder -> encode -> release -> complete
+//
+// Frames are converted concurrently and may finish out of order; they are
+// put back in submission order before the single encode thread, which also
+// releases them. A single completion thread then delivers the results, so
+// they leave in frame_number order, and a completion blocked on a caller's
+// lock never keeps later buffers from being released.
+class CapturePipeline {
+ public:
+  struct Frame {
+    std::shared_ptr<default_camera_hal::CaptureRequest> request;
+    // Device buffer holding the captured image.
+    uint32_t index;
+    // Submission order; results are delivered in this order.
+    uint64_t sequence;
+    std::chrono::steady_clock::time_point submitted;
+    std::chrono::steady_clock::time_point encoded;
+  };
+  typedef std::function<void(const Frame&)> StageFunction;
+
+  // |convert| is called from |num_convert_workers| threads concurrently, the
+  // other stages from one thread. At most |queue_depth| frames wait in front
+  // of each stage.
+  CapturePipeline(StageFunction convert,
+                  StageFunction encode,
+                  StageFunction release,
+                  StageFunction complete,
+                  size_t num_convert_workers,
+                  size_t queue_depth);
+  ~CapturePipeline();
+
+  // Start the stage threads if they're not already running.
+  int Start();
+  // Stop the stage threads. Frames not yet released are dropped; results of
+  // released ones are still delivered. A stopped pipeline can't be
+  // restarted.
+  void Stop();
+
+  // Hand a frame to the pipeline. Blocks while the pipeline is full.
+  // Returns -ENODEV if the pipeline is stopped; the frame is then still the
+  // caller's to release and complete.
+  int Submit(std::shared_ptr<default_camera_hal::CaptureRequest> request,
+             uint32_t index);
+  // Block until every submitted frame has been released (its result may
+  // still be on its way to the framework). Doesn't wait for |complete|, so
+  // it may be called with a lock that |complete| takes held.
+  void Drain();
+
+  // Print per-stage latencies.
+  void Dump(int fd);
+
+ private:
+  // Thread functions. Return true to loop, false to exit.
+  bool convertFrames();
+  bool encodeFrames();
+  bool completeFrames();
+
+  const StageFunction convert_;
+  const StageFunction encode_;
+  const StageFunction release_;
+  const StageFunction complete_;
+
+  BoundedQueue<Frame> convert_queue_;
+  BoundedQueue<Frame> encode_queue_;
+  // Effectively unbounded, so the encode thread never waits for results to
+  // be delivered. The frames in it hold no device buffers.
+  BoundedQueue<Frame> complete_queue_;
+  // Threads require holding an Android strong pointer.
+  std::vector<android::sp<android::Thread>> converters_;
+  android::sp<android::Thread> encoder_;
+  android::sp<android::Thread> completer_;
+  bool running_;
+  bool stopped_;
+
+  // Converted frames waiting for the ones submitted before them.
+  std::mutex reorder_lock_;
+  std::map<uint64_t, Frame> reorder_;
+  uint64_t next_encode_sequence_;
+
+  // Frames submitted but not yet released.
+  std::mutex pending_lock_;
+  std::condition_variable pending_released_;
+  uint64_t next_sequence_;
+  size_t pending_;
+
+  LatencyHistogram convert_latency_;
+  LatencyHistogram encode_latency_;
+  LatencyHistogram result_latency_;
+  LatencyHistogram total_latency_;
+
+  DISALLOW_COPY_AND_ASSIGN(CapturePipeline);
+};
+
+}  // namespace v4l2_camera_hal
+
+#endif  // V4L2_CAMERA_HAL_CAPTURE_PIPELINE_H_
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "capture_pipeline.h"
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using testing::Test;
+
+namespace v4l2_camera_hal {
+
+class CapturePipelineTest : public Test {
+ protected:
+  void SetUp() {
+    dut_.reset(new CapturePipeline(
+        [this](const CapturePipeline::Frame& frame) { Convert(frame); },
+        [](const CapturePipeline::Frame& frame) {},
+        [this](const CapturePipeline::Frame& frame) {
+          std::lock_guard<std::mutex> guard(lock_);
+          released_.push_back(frame.index);
+        },
+        [this](const CapturePipeline::Frame& frame) {
+          std::lock_guard<std::mutex> tracker(tracker_lock_);
+          std::lock_guard<std::mutex> guard(lock_);
+          completed_.push_back(frame.request->frame_number);
+        },
+        3,
+        2));
+    ASSERT_EQ(dut_->Start(), 0);
+  }
+
+  void TearDown() { dut_->Stop(); }
+
+  // Even frames take longer to convert than the odd frames behind them.
+  void Convert(const CapturePipeline::Frame& frame) {
+    if (frame.request->frame_number % 2 == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  }
+
+  void Submit(uint32_t frame_number) {
+    std::shared_ptr<default_camera_hal::CaptureRequest> request =
+        std::make_shared<default_camera_hal::CaptureRequest>();
+    request->frame_number = frame_number;
+    ASSERT_EQ(dut_->Submit(request, frame_number % 4), 0);
+  }
+
+  std::unique_ptr<CapturePipeline> dut_;
+  // Taken to complete a result, like the camera's in-flight tracker lock.
+  std::mutex tracker_lock_;
+  std::mutex lock_;
+  std::vector<uint32_t> released_;
+  std::vector<uint32_t> completed_;
+};
+
+TEST_F(CapturePipelineTest, CompletesInSubmissionOrder) {
+  const uint32_t kFrames = 20;
+  for (uint32_t i = 0; i < kFrames; ++i) {
+    Submit(i);
+  }
+  dut_->Drain();
+  dut_->Stop();
+
+  ASSERT_EQ(completed_.size(), kFrames);
+  for (uint32_t i = 0; i < kFrames; ++i) {
+    EXPECT_EQ(completed_[i], i);
+    EXPECT_EQ(released_[i], i % 4);
+  }
+}
+
+TEST_F(CapturePipelineTest, DrainWaitsForRelease) {
+  Submit(0);
+  Submit(1);
+  dut_->Drain();
+  std::lock_guard<std::mutex> guard(lock_);
+  EXPECT_EQ(released_.size(), 2u);
+}
+
+// Camera::flush drains with the lock held that completing a result takes.
+TEST_F(CapturePipelineTest, DrainWhileCompletionBlocked) {
+  const uint32_t kFrames = 8;
+  std::unique_lock<std::mutex> flushing(tracker_lock_);
+  std::future<void> drained = std::async(std::launch::async, [this] {
+    for (uint32_t i = 0; i < kFrames; ++i) {
+      Submit(i);
+    }
+    dut_->Drain();
+  });
+  bool drained_in_time = drained.wait_for(std::chrono::seconds(5)) ==
+                         std::future_status::ready;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    EXPECT_TRUE(completed_.empty());
+  }
+  flushing.unlock();
+  ASSERT_TRUE(drained_in_time);
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    EXPECT_EQ(released_.size(), kFrames);
+  }
+
+  // The results are still delivered once the lock is dropped.
+  dut_->Stop();
+  EXPECT_EQ(completed_.size(), kFrames);
+}
+
+TEST_F(CapturePipelineTest, SubmitFailsWhenStopped) {
+  dut_->Stop();
+  std::shared_ptr<default_camera_hal::CaptureRequest> request =
+      std::make_shared<default_camera_hal::CaptureRequest>();
+  EXPECT_EQ(dut_->Submit(request, 0), -ENODEV);
+  EXPECT_TRUE(completed_.empty());
+}
+
+}  // namespace v4l2_camera_hal
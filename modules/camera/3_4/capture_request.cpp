@@ -16,6 +16,8 @@
 
 #include "capture_request.h"
 
+#include <atomic>
+
 namespace default_camera_hal {
 
 CaptureRequest::CaptureRequest() : CaptureRequest(nullptr) {}
@@ -24,7 +26,10 @@ CaptureRequest::CaptureRequest(const camera3_capture_request_t* request) {
   if (!request) {
     return;
   }
+  Assign(request);
+}
 
+void CaptureRequest::Assign(const camera3_capture_request_t* request) {
   frame_number = request->frame_number;
 
   // CameraMetadata makes copies of camera_metadata_t through the
@@ -36,7 +41,11 @@ CaptureRequest::CaptureRequest(const camera3_capture_request_t* request) {
   // as its pointer values are handles, not ownerships.
 
   // Copy the input buffer.
-  if (request->input_buffer) {
+  if (!request->input_buffer) {
+    input_buffer.reset();
+  } else if (input_buffer) {
+    *input_buffer = *request->input_buffer;
+  } else {
     input_buffer =
         std::make_unique<camera3_stream_buffer_t>(*request->input_buffer);
   }
@@ -46,9 +55,34 @@ CaptureRequest::CaptureRequest(const camera3_capture_request_t* request) {
   if (num_output_buffers < 0 || !request->output_buffers) {
     num_output_buffers = 0;
   }
-  output_buffers.insert(output_buffers.end(),
-                        request->output_buffers,
+  output_buffers.assign(request->output_buffers,
                         request->output_buffers + num_output_buffers);
 }
 
+CaptureRequestPool::CaptureRequestPool(size_t max_size)
+    : max_size_(max_size), next_(0) {}
+
+std::shared_ptr<CaptureRequest> CaptureRequestPool::Acquire(
+    const camera3_capture_request_t* request) {
+  // Requests usually complete in order, so the oldest one is likely free.
+  for (size_t i = 0; i < requests_.size(); ++i) {
+    std::shared_ptr<CaptureRequest>& pooled =
+        requests_[(next_ + i) % requests_.size()];
+    // Only the pool holds it, so nobody else can take a new reference.
+    if (pooled.use_count() == 1) {
+      // Order the last user's accesses before ours.
+      std::atomic_thread_fence(std::memory_order_acquire);
+      next_ = (next_ + i + 1) % requests_.size();
+      pooled->Assign(request);
+      return pooled;
+    }
+  }
+  std::shared_ptr<CaptureRequest> result =
+      std::make_shared<CaptureRequest>(request);
+  if (requests_.size() < max_size_) {
+    requests_.push_back(result);
+  }
+  return result;
+}
+
 }  // namespace default_camera_hal
@@ -36,6 +36,29 @@ struct CaptureRequest {
   CaptureRequest();
   // Create a deep copy of |request|.
   CaptureRequest(const camera3_capture_request_t* request);
+
+  // Make this a deep copy of |request|, reusing the buffers it already has.
+  void Assign(const camera3_capture_request_t* request);
+};
+
+// Recycles CaptureRequests, so that steady-state capture doesn't allocate
+// one (and its buffer vector) per frame. A request is reused once every
+// reference handed out for it is gone. Not thread-safe.
+class CaptureRequestPool {
+ public:
+  // Keep at most |max_size| requests; beyond that, requests are allocated
+  // as needed.
+  explicit CaptureRequestPool(size_t max_size);
+
+  // Return a deep copy of |request|.
+  std::shared_ptr<CaptureRequest> Acquire(
+      const camera3_capture_request_t* request);
+
+ private:
+  const size_t max_size_;
+  std::vector<std::shared_ptr<CaptureRequest>> requests_;
+  // Where to start looking for a free request.
+  size_t next_;
 };
 
 }  // namespace default_camera_hal
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures arc::ImageProcessor conversion and scaling time for every
+// format x resolution x thread count, and checks that the multi-threaded
+// output is bit-exact with the single-threaded one.
+//
+// Usage: image_processor_benchmark [iterations] [max threads]
+//   e.g. image_processor_benchmark 50 4
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <camera/CameraMetadata.h>
+#include "arc/image_processor.h"
+
+namespace {
+
+struct Operation {
+  const char* name;
+  uint32_t in_fourcc;
+  uint32_t out_fourcc;
+  // Output size relative to the input (Scale only).
+  int scale_divisor;
+};
+
+const Operation kOperations[] = {
+    {"YUYV->YU12", V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_YUV420, 1},
+    {"YU12->NV21", V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_NV21, 1},
+    {"YU12->YV12", V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_YVU420, 1},
+    {"YU12->ABGR", V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_BGR32, 1},
+    {"YU12->ARGB", V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_RGB32, 1},
+    {"scale 1/2", V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_YUV420, 2},
+};
+
+const struct {
+  uint32_t width;
+  uint32_t height;
+} kResolutions[] = {{640, 480}, {1280, 720}, {1920, 1080}, {3840, 2160}};
+
+double MonotonicMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Run |op| |iterations| times. Returns the median time in ms and leaves the
+// output in |output|.
+double Measure(const Operation& op, const arc::FrameBuffer& in,
+               int iterations, std::vector<uint8_t>* output) {
+  android::CameraMetadata metadata;
+  arc::AllocatedFrameBuffer out(0);
+  out.SetFourcc(op.out_fourcc);
+  out.SetWidth(in.GetWidth() / op.scale_divisor);
+  out.SetHeight(in.GetHeight() / op.scale_divisor);
+
+  std::vector<double> times;
+  for (int i = 0; i < iterations; ++i) {
+    double start = MonotonicMs();
+    int res = op.scale_divisor > 1
+                  ? arc::ImageProcessor::Scale(in, &out)
+                  : arc::ImageProcessor::ConvertFormat(metadata, in, &out);
+    times.push_back(MonotonicMs() - start);
+    if (res) {
+      fprintf(stderr, "%s failed: %d\n", op.name, res);
+      exit(1);
+    }
+  }
+  output->assign(out.GetData(), out.GetData() + out.GetDataSize());
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 30;
+  size_t max_threads = argc > 2 ? atoi(argv[2]) : 4;
+  if (iterations <= 0 || max_threads == 0) {
+    fprintf(stderr, "Usage: %s [iterations] [max threads]\n", argv[0]);
+    return 1;
+  }
+
+  printf("%-12s %-10s %8s %10s %8s %s\n", "operation", "resolution",
+         "threads", "median ms", "speedup", "bit-exact");
+  for (const auto& op : kOperations) {
+    for (const auto& resolution : kResolutions) {
+      size_t size = op.in_fourcc == V4L2_PIX_FMT_YUYV
+                        ? resolution.width * resolution.height * 2
+                        : resolution.width * resolution.height * 3 / 2;
+      arc::AllocatedFrameBuffer in(size);
+      in.SetDataSize(size);
+      in.SetFourcc(op.in_fourcc);
+      in.SetWidth(resolution.width);
+      in.SetHeight(resolution.height);
+      for (size_t i = 0; i < size; ++i) {
+        in.GetData()[i] = static_cast<uint8_t>(rand());
+      }
+
+      std::vector<uint8_t> reference;
+      double reference_ms = 0;
+      for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        arc::ImageProcessor::SetMaxThreads(threads);
+        std::vector<uint8_t> output;
+        double ms = Measure(op, in, iterations, &output);
+        if (threads == 1) {
+          reference.swap(output);
+          reference_ms = ms;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "%ux%u", resolution.width,
+                 resolution.height);
+        printf("%-12s %-10s %8zu %10.2f %7.2fx %s\n", op.name, name, threads,
+               ms, reference_ms / ms,
+               threads == 1 ? "-" : (output == reference ? "yes" : "NO"));
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures arc::JpegCompressor throughput at 8, 12 and 20 megapixels for
+// every thread count, and checks that the strip-encoded JPEG decodes to the
+// same image as the one encoded on a single thread.
+//
+// Usage: jpeg_compressor_benchmark [iterations] [max threads] [quality]
+//   e.g. jpeg_compressor_benchmark 10 4 90
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "arc/jpeg_compressor.h"
+#include "arc/thread_pool.h"
+
+namespace {
+
+const struct {
+  const char* name;
+  int width;
+  int height;
+} kResolutions[] = {
+    {"8MP", 3264, 2448}, {"12MP", 4032, 3024}, {"20MP", 5472, 3648},
+};
+
+double MonotonicMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Decodes |jpeg| to interleaved YCbCr.
+std::vector<uint8_t> Decode(const void* jpeg, size_t size) {
+  jpeg_decompress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo,
+               static_cast<unsigned char*>(const_cast<void*>(jpeg)), size);
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_YCbCr;
+  jpeg_start_decompress(&cinfo);
+  size_t row_size = cinfo.output_width * cinfo.output_components;
+  std::vector<uint8_t> pixels(row_size * cinfo.output_height);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW row = &pixels[cinfo.output_scanline * row_size];
+    jpeg_read_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  return pixels;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 10;
+  size_t max_threads = argc > 2 ? atoi(argv[2]) : 4;
+  int quality = argc > 3 ? atoi(argv[3]) : 90;
+  if (iterations <= 0 || max_threads == 0 || quality < 1 || quality > 100) {
+    fprintf(stderr, "Usage: %s [iterations] [max threads] [quality]\n",
+            argv[0]);
+    return 1;
+  }
+
+  printf("%-10s %8s %10s %8s %8s %10s %s\n", "resolution", "threads",
+         "median ms", "MP/s", "speedup", "bytes", "same image");
+  for (const auto& resolution : kResolutions) {
+    // Smooth gradients with some noise, roughly like a camera frame.
+    size_t pixels = resolution.width * resolution.height;
+    std::vector<uint8_t> yu12(pixels * 3 / 2);
+    for (size_t i = 0; i < yu12.size(); ++i) {
+      yu12[i] = static_cast<uint8_t>(i % resolution.width / 16 +
+                                     i / resolution.width / 16 + rand() % 16);
+    }
+
+    std::vector<uint8_t> reference;
+    double reference_ms = 0;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+      std::unique_ptr<arc::ThreadPool> pool;
+      std::unique_ptr<arc::JpegCompressor> compressor;
+      if (threads == 1) {
+        compressor.reset(new arc::JpegCompressor());
+      } else {
+        pool.reset(new arc::ThreadPool(threads));
+        compressor.reset(new arc::JpegCompressor(pool.get()));
+      }
+
+      std::vector<double> times;
+      for (int i = 0; i < iterations; ++i) {
+        double start = MonotonicMs();
+        bool ok = compressor->CompressImage(yu12.data(), resolution.width,
+                                            resolution.height, quality,
+                                            nullptr, 0);
+        times.push_back(MonotonicMs() - start);
+        if (!ok) {
+          fprintf(stderr, "%s: compression failed\n", resolution.name);
+          return 1;
+        }
+      }
+      std::sort(times.begin(), times.end());
+      double ms = times[times.size() / 2];
+
+      std::vector<uint8_t> image =
+          Decode(compressor->GetCompressedImagePtr(),
+                 compressor->GetCompressedImageSize());
+      if (threads == 1) {
+        reference.swap(image);
+        reference_ms = ms;
+      }
+      printf("%-10s %8zu %10.2f %8.1f %7.2fx %10zu %s\n", resolution.name,
+             threads, ms, pixels / ms / 1e3, reference_ms / ms,
+             compressor->GetCompressedImageSize(),
+             threads == 1 ? "-" : (image == reference ? "yes" : "NO"));
+    }
+  }
+  return 0;
+}
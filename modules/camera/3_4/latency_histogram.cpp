@@ -0,0 +1,90 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "latency_histogram.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+
+namespace v4l2_camera_hal {
+
+LatencyHistogram::LatencyHistogram() { Reset(); }
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency) {
+  int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(latency)
+                   .count();
+  uint64_t value = us > 0 ? us : 0;
+
+  size_t bucket = 0;
+  for (uint64_t v = value; v && bucket < kNumBuckets - 1; v >>= 1) {
+    ++bucket;
+  }
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  total_us_.fetch_add(value, std::memory_order_relaxed);
+
+  uint64_t max = max_us_.load(std::memory_order_relaxed);
+  while (value > max && !max_us_.compare_exchange_weak(
+                              max, value, std::memory_order_relaxed)) {
+  }
+}
+
+void LatencyHistogram::Reset() {
+  for (auto& bucket : buckets_) {
+    bucket = 0;
+  }
+  count_ = 0;
+  total_us_ = 0;
+  max_us_ = 0;
+}
+
+uint64_t LatencyHistogram::PercentileUs(double percentile) const {
+  uint64_t count = count_;
+  if (count == 0) {
+    return 0;
+  }
+  uint64_t target = static_cast<uint64_t>(count * percentile / 100.0);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    seen += buckets_[i];
+    if (seen > target) {
+      return uint64_t{1} << i;
+    }
+  }
+  return max_us_;
+}
+
+void LatencyHistogram::Dump(int fd, const char* name) const {
+  uint64_t count = count_;
+  dprintf(fd,
+          "  %-10s n=%" PRIu64 " mean=%" PRIu64 "us p50<%" PRIu64
+          "us p90<%" PRIu64 "us p99<%" PRIu64 "us max=%" PRIu64 "us\n",
+          name, count, count ? total_us_ / count : 0, PercentileUs(50),
+          PercentileUs(90), PercentileUs(99), static_cast<uint64_t>(max_us_));
+  if (count == 0) {
+    return;
+  }
+  dprintf(fd, "             ");
+  for (size_t i = 0; i < kNumBuckets; ++i) {
+    uint64_t n = buckets_[i];
+    if (n) {
+      dprintf(fd, " <%" PRIu64 "us:%" PRIu64, uint64_t{1} << i, n);
+    }
+  }
+  dprintf(fd, "\n");
+}
+
+}  // namespace v4l2_camera_hal
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V4L2_CAMERA_HAL_LATENCY_HISTOGRAM_H_
+#define V4L2_CAMERA_HAL_LATENCY_HISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include <android-base/macros.h>
+
+namespace v4l2_camera_hal {
+
+// Lock-free log2 histogram of latencies, for dumpsys.
+// Bucket 0 counts samples under 1us, bucket i counts [2^(i-1), 2^i) us.
+class LatencyHistogram {
+ public:
+  LatencyHistogram();
+
+  // Safe to call from any thread.
+  void Record(std::chrono::nanoseconds latency);
+  void Reset();
+
+  uint64_t count() const { return count_; }
+  // Upper bound (in us) of the bucket holding the |percentile|th sample.
+  uint64_t PercentileUs(double percentile) const;
+
+  // Print a one-line summary plus the non-empty buckets.
+  void Dump(int fd, const char* name) const;
+
+ private:
+  static const size_t kNumBuckets = 24;  // Last bucket is >= ~4s.
+
+  std::array<std::atomic<uint64_t>, kNumBuckets> buckets_;
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> total_us_;
+  std::atomic<uint64_t> max_us_;
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyHistogram);
+};
+
+}  // namespace v4l2_camera_hal
+
+#endif  // V4L2_CAMERA_HAL_LATENCY_HISTOGRAM_H_
@@ -25,9 +25,27 @@
 
 namespace v4l2_camera_hal {
 
+// Size of the data section of |metadata|, in bytes.
+static size_t DataCount(const android::CameraMetadata& metadata) {
+  const camera_metadata_t* buffer = metadata.getAndLock();
+  size_t count = buffer ? get_camera_metadata_data_count(buffer) : 0;
+  metadata.unlock(buffer);
+  return count;
+}
+
 Metadata::Metadata(PartialMetadataSet components)
-    : components_(std::move(components)) {
+    : components_(std::move(components)),
+      result_snapshot_valid_(false),
+      result_entry_capacity_(0),
+      result_data_capacity_(0) {
   HAL_LOG_ENTER();
+  for (auto& component : components_) {
+    if (component->DynamicFieldsCacheable()) {
+      cacheable_components_.push_back(component.get());
+    } else {
+      live_components_.push_back(component.get());
+    }
+  }
 }
 
 Metadata::~Metadata() {
@@ -169,6 +187,7 @@ int Metadata::SetRequestSettings(const android::CameraMetadata& metadata) {
   if (metadata.isEmpty())
     return 0;
 
+  InvalidateResultCache();
   for (auto& component : components_) {
     int res = component->SetRequestValues(metadata);
     if (res) {
@@ -187,7 +206,76 @@ int Metadata::FillResultMetadata(android::CameraMetadata* metadata) {
     return -EINVAL;
   }
 
-  for (auto& component : components_) {
+  std::lock_guard<std::mutex> guard(result_cache_lock_);
+  if (!result_snapshot_valid_) {
+    int res = UpdateResultSnapshot();
+    if (res) {
+      return res;
+    }
+  }
+
+  // Assemble the result in a buffer that fits it, instead of growing
+  // |metadata| once per component.
+  size_t request_entries = metadata->entryCount();
+  size_t request_data = DataCount(*metadata);
+  android::CameraMetadata result(request_entries + result_entry_capacity_,
+                                 request_data + result_data_capacity_);
+  int res = result.append(*metadata);
+  if (res == android::OK && !result_snapshot_.isEmpty()) {
+    res = result.append(result_snapshot_);
+  }
+  if (res != android::OK) {
+    HAL_LOGE("Failed to append all dynamic result fields.");
+    return res;
+  }
+  for (auto component : live_components_) {
+    res = component->PopulateDynamicFields(&result);
+    if (res) {
+      HAL_LOGE("Failed to get all dynamic result fields.");
+      return res;
+    }
+  }
+
+  if (!result_entry_capacity_) {
+    result_entry_capacity_ = result.entryCount() - request_entries;
+    result_data_capacity_ = DataCount(result) - request_data;
+  }
+  metadata->acquire(result);
+  return 0;
+}
+
+int Metadata::UpdateLiveResultMetadata(android::CameraMetadata* metadata) {
+  HAL_LOG_ENTER();
+  if (!metadata) {
+    HAL_LOGE("Can't update null metadata.");
+    return -EINVAL;
+  }
+
+  for (auto component : live_components_) {
+    int res = component->PopulateDynamicFields(metadata);
+    if (res) {
+      HAL_LOGE("Failed to get all dynamic result fields.");
+      return res;
+    }
+  }
+  return 0;
+}
+
+void Metadata::InvalidateResultCache() {
+  std::lock_guard<std::mutex> guard(result_cache_lock_);
+  result_snapshot_valid_ = false;
+}
+
+void Metadata::ResetResultCache() {
+  std::lock_guard<std::mutex> guard(result_cache_lock_);
+  result_snapshot_valid_ = false;
+  result_entry_capacity_ = 0;
+  result_data_capacity_ = 0;
+}
+
+int Metadata::UpdateResultSnapshot() {
+  result_snapshot_.clear();
+  for (auto component : cacheable_components_) {
     // Prevent components from potentially overriding others.
     android::CameraMetadata additional_metadata;
     int res = component->PopulateDynamicFields(&additional_metadata);
@@ -197,14 +285,14 @@ int Metadata::FillResultMetadata(android::CameraMetadata* metadata) {
     }
     // Add it to the overall result.
     if (!additional_metadata.isEmpty()) {
-      res = metadata->append(additional_metadata);
+      res = result_snapshot_.append(additional_metadata);
       if (res != android::OK) {
         HAL_LOGE("Failed to append all dynamic result fields.");
         return res;
       }
     }
   }
-
+  result_snapshot_valid_ = true;
   return 0;
 }
 
@@ -17,6 +17,9 @@
 #ifndef V4L2_CAMERA_HAL_METADATA_H_
 #define V4L2_CAMERA_HAL_METADATA_H_
 
+#include <mutex>
+#include <vector>
+
 #include <android-base/macros.h>
 #include <camera/CameraMetadata.h>
 
@@ -34,11 +37,40 @@ class Metadata {
                          android::CameraMetadata* template_metadata);
   int SetRequestSettings(const android::CameraMetadata& metadata);
   int FillResultMetadata(android::CameraMetadata* metadata);
+  // Refresh the fields of |metadata|, a result of FillResultMetadata, that
+  // may change every frame even when the cached ones can't (e.g. to reuse
+  // the result of a request with the same settings).
+  int UpdateLiveResultMetadata(android::CameraMetadata* metadata);
+
+  // FillResultMetadata reads the cacheable dynamic fields only when they may
+  // have changed: after non-empty settings are set, or after this is called
+  // (e.g. when the device changed controls on its own).
+  void InvalidateResultCache();
+  // Also size the result buffer afresh on the next FillResultMetadata, e.g.
+  // for a new stream configuration.
+  void ResetResultCache();
 
  private:
+  // Read the dynamic fields of |cacheable_components_| into
+  // |result_snapshot_|. Requires |result_cache_lock_|.
+  int UpdateResultSnapshot();
+
   // The overall metadata is broken down into several distinct pieces.
   // Note: it is undefined behavior if multiple components share tags.
   PartialMetadataSet components_;
+  // |components_| split by PartialMetadataInterface::DynamicFieldsCacheable.
+  std::vector<PartialMetadataInterface*> cacheable_components_;
+  std::vector<PartialMetadataInterface*> live_components_;
+
+  // Lock protecting the result cache below.
+  std::mutex result_cache_lock_;
+  // Dynamic fields of |cacheable_components_|, if |result_snapshot_valid_|.
+  android::CameraMetadata result_snapshot_;
+  bool result_snapshot_valid_;
+  // Entries and data bytes FillResultMetadata adds to a request, measured
+  // on the first result after ResetResultCache (0 until then).
+  size_t result_entry_capacity_;
+  size_t result_data_capacity_;
 
   DISALLOW_COPY_AND_ASSIGN(Metadata);
 };
@@ -313,6 +313,109 @@ TEST_F(MetadataTest, FillResultFail) {
   EXPECT_EQ(dut_->FillResultMetadata(metadata_.get()), err);
 }
 
+TEST_F(MetadataTest, FillResultCached) {
+  // Dynamic fields are read once until settings change.
+  EXPECT_CALL(*component1_, PopulateDynamicFields(_))
+      .Times(2)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*component2_, PopulateDynamicFields(_))
+      .Times(2)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*component1_, SetRequestValues(_)).WillOnce(Return(0));
+  EXPECT_CALL(*component2_, SetRequestValues(_)).WillOnce(Return(0));
+
+  AddComponents();
+  EXPECT_EQ(dut_->FillResultMetadata(metadata_.get()), 0);
+  EXPECT_EQ(dut_->FillResultMetadata(metadata_.get()), 0);
+  // Empty settings change nothing.
+  EXPECT_EQ(dut_->SetRequestSettings(android::CameraMetadata()), 0);
+  EXPECT_EQ(dut_->FillResultMetadata(metadata_.get()), 0);
+  EXPECT_EQ(dut_->SetRequestSettings(*non_empty_metadata_), 0);
+  EXPECT_EQ(dut_->FillResultMetadata(metadata_.get()), 0);
+  EXPECT_EQ(dut_->FillResultMetadata(metadata_.get()), 0);
+}
+
+TEST_F(MetadataTest, FillResultInvalidated) {
+  EXPECT_CALL(*component1_, PopulateDynamicFields(_))
+      .Times(3)
+      .WillRepeatedly(Return(0));
+  EXPECT_CALL(*component2_, PopulateDynamicFields(_))
+      .Times(3)
+      .WillRepeatedly(Return(0));
+
+  AddComponents();
+  EXPECT_EQ(dut_->FillResultMetadata(metadata_.get()), 0);
+  dut_->InvalidateResultCache();
+  EXPECT_EQ(dut_->FillResultMetadata(metadata_.get()), 0);
+  dut_->ResetResultCache();
+  EXPECT_EQ(dut_->FillResultMetadata(metadata_.get()), 0);
+}
+
+// A component whose dynamic fields change every frame.
+class LivePartialMetadataMock : public PartialMetadataInterfaceMock {
+ public:
+  bool DynamicFieldsCacheable() const override { return false; }
+};
+
+TEST_F(MetadataTest, FillResultLiveAndCached) {
+  std::unique_ptr<LivePartialMetadataMock> live(new LivePartialMetadataMock());
+  int64_t timestamp = 0;
+  EXPECT_CALL(*live, PopulateDynamicFields(_))
+      .Times(3)
+      .WillRepeatedly(testing::Invoke([&timestamp](
+          android::CameraMetadata* metadata) {
+        ++timestamp;
+        return metadata->update(ANDROID_SENSOR_TIMESTAMP, &timestamp, 1);
+      }));
+  EXPECT_CALL(*component1_, PopulateDynamicFields(_))
+      .WillOnce(testing::Invoke([](android::CameraMetadata* metadata) {
+        uint8_t mode = ANDROID_CONTROL_AE_MODE_ON;
+        return metadata->update(ANDROID_CONTROL_AE_MODE, &mode, 1);
+      }));
+  component2_.reset(live.release());
+
+  AddComponents();
+  for (int64_t frame = 1; frame <= 3; ++frame) {
+    android::CameraMetadata result(*non_empty_metadata_);
+    EXPECT_EQ(dut_->FillResultMetadata(&result), 0);
+    // The request settings, the cached and the live fields.
+    EXPECT_EQ(result.entryCount(), 3u);
+    EXPECT_EQ(result.find(ANDROID_CONTROL_AE_MODE).data.u8[0],
+              ANDROID_CONTROL_AE_MODE_ON);
+    EXPECT_EQ(result.find(ANDROID_SENSOR_TIMESTAMP).data.i64[0], frame);
+  }
+}
+
+TEST_F(MetadataTest, UpdateLiveResult) {
+  std::unique_ptr<LivePartialMetadataMock> live(new LivePartialMetadataMock());
+  int64_t timestamp = 0;
+  EXPECT_CALL(*live, PopulateDynamicFields(_))
+      .Times(2)
+      .WillRepeatedly(testing::Invoke([&timestamp](
+          android::CameraMetadata* metadata) {
+        ++timestamp;
+        return metadata->update(ANDROID_SENSOR_TIMESTAMP, &timestamp, 1);
+      }));
+  // Cached fields aren't read again.
+  EXPECT_CALL(*component1_, PopulateDynamicFields(_))
+      .WillOnce(testing::Invoke([](android::CameraMetadata* metadata) {
+        uint8_t mode = ANDROID_CONTROL_AE_MODE_ON;
+        return metadata->update(ANDROID_CONTROL_AE_MODE, &mode, 1);
+      }));
+  component2_.reset(live.release());
+
+  AddComponents();
+  android::CameraMetadata result(*non_empty_metadata_);
+  EXPECT_EQ(dut_->FillResultMetadata(&result), 0);
+  android::CameraMetadata reused(result);
+  EXPECT_EQ(dut_->UpdateLiveResultMetadata(&reused), 0);
+  EXPECT_EQ(reused.entryCount(), 3u);
+  EXPECT_EQ(reused.find(ANDROID_CONTROL_AE_MODE).data.u8[0],
+            ANDROID_CONTROL_AE_MODE_ON);
+  EXPECT_EQ(reused.find(ANDROID_SENSOR_TIMESTAMP).data.i64[0], 2);
+  EXPECT_EQ(result.find(ANDROID_SENSOR_TIMESTAMP).data.i64[0], 1);
+}
+
 TEST_F(MetadataTest, FillResultNull) {
   AddComponents();
   EXPECT_EQ(dut_->FillResultMetadata(nullptr), -EINVAL);
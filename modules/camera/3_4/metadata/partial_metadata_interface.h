@@ -41,6 +41,10 @@ class PartialMetadataInterface {
   // is responsible for to |metadata|.
   virtual int PopulateDynamicFields(
       android::CameraMetadata* metadata) const = 0;
+  // Whether the dynamic states only change when controls are set (by the HAL
+  // or the device), so they can be cached between frames. Must be false for
+  // states that change every frame, like the sensor timestamp.
+  virtual bool DynamicFieldsCacheable() const { return true; }
   // Add default request values for a given template type for all the controls
   // this partial metadata owns.
   virtual int PopulateTemplateRequest(
@@ -39,6 +39,8 @@ class State : public PartialMetadataInterface {
       android::CameraMetadata* metadata) const override;
   virtual int PopulateDynamicFields(
       android::CameraMetadata* metadata) const override;
+  // States are read from their delegate every frame.
+  virtual bool DynamicFieldsCacheable() const override { return false; };
   virtual int PopulateTemplateRequest(
       int template_type, android::CameraMetadata* metadata) const override;
   virtual bool SupportsRequestValues(
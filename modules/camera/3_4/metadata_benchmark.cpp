@@ -0,0 +1,128 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the per-frame cost of setting request metadata and filling result
+// metadata the way V4L2Camera::enqueueRequestBuffers does, against a real
+// capture device (e.g. the vivid virtual driver):
+//   settings:  every request carries the full preview template, so controls
+//              are set and the result snapshot is read from the device again.
+//   repeating: requests carry no settings (a repeating request), so the
+//              cached result snapshot is reused.
+//
+// Usage: metadata_benchmark [device] [frames]
+//   e.g. modprobe vivid && metadata_benchmark /dev/video0 1000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <hardware/camera3.h>
+#include "metadata/metadata.h"
+#include "v4l2_metadata_factory.h"
+#include "v4l2_wrapper.h"
+
+using v4l2_camera_hal::Metadata;
+using v4l2_camera_hal::V4L2Wrapper;
+
+namespace {
+
+double MonotonicUs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Run |frames| requests with |settings| and print the time per frame.
+bool Measure(const char* name, V4L2Wrapper* device, Metadata* metadata,
+             const android::CameraMetadata& settings, int frames) {
+  std::vector<double> times;
+  for (int i = 0; i < frames; ++i) {
+    android::CameraMetadata request(settings);
+    double start = MonotonicUs();
+    device->BeginControlBatch();
+    int res = metadata->SetRequestSettings(request);
+    int commit_res = device->CommitControlBatch();
+    if (device->ControlsChanged()) {
+      metadata->InvalidateResultCache();
+    }
+    if (!res) {
+      res = commit_res;
+    }
+    if (!res) {
+      res = metadata->FillResultMetadata(&request);
+    }
+    times.push_back(MonotonicUs() - start);
+    if (res) {
+      fprintf(stderr, "%s: frame %d failed: %d\n", name, i, res);
+      return false;
+    }
+  }
+  std::sort(times.begin(), times.end());
+  double total = 0;
+  for (double time : times) {
+    total += time;
+  }
+  printf("%-10s %10.1f %10.1f %10.1f\n", name, times[times.size() / 2],
+         times[times.size() * 99 / 100], total / times.size());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const char* path = argc > 1 ? argv[1] : "/dev/video0";
+  int frames = argc > 2 ? atoi(argv[2]) : 1000;
+  if (frames <= 0) {
+    fprintf(stderr, "Usage: %s [device] [frames]\n", argv[0]);
+    return 1;
+  }
+
+  std::shared_ptr<V4L2Wrapper> device(V4L2Wrapper::NewV4L2Wrapper(path));
+  if (!device) {
+    fprintf(stderr, "Failed to create wrapper for %s\n", path);
+    return 1;
+  }
+  V4L2Wrapper::Connection connection(device);
+  if (connection.status()) {
+    fprintf(stderr, "Failed to connect to %s\n", path);
+    return 1;
+  }
+  std::unique_ptr<Metadata> metadata;
+  if (v4l2_camera_hal::GetV4L2Metadata(device, &metadata)) {
+    fprintf(stderr, "Failed to build metadata for %s\n", path);
+    return 1;
+  }
+  android::CameraMetadata preview;
+  if (metadata->GetRequestTemplate(CAMERA3_TEMPLATE_PREVIEW, &preview)) {
+    fprintf(stderr, "Failed to get the preview template\n");
+    return 1;
+  }
+
+  printf("%-10s %10s %10s %10s\n", "requests", "median us", "p99 us",
+         "mean us");
+  if (!Measure("settings", device.get(), metadata.get(), preview, frames) ||
+      !Measure("repeating", device.get(), metadata.get(),
+               android::CameraMetadata(), frames)) {
+    return 1;
+  }
+  device->DumpControlStats(STDOUT_FILENO);
+  return 0;
+}
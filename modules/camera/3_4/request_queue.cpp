@@ -0,0 +1,162 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "RequestQueue"
+
+#include "request_queue.h"
+
+#include <errno.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "common.h"
+
+namespace v4l2_camera_hal {
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "The futex word must be a plain 32-bit integer");
+
+static size_t RoundUpToPowerOfTwo(size_t value) {
+  size_t result = 1;
+  while (result < value) {
+    result *= 2;
+  }
+  return result;
+}
+
+RequestQueue::RequestQueue(size_t capacity)
+    : mask_(RoundUpToPowerOfTwo(capacity) - 1),
+      slots_(new Slot[mask_ + 1]),
+      tail_(0),
+      head_(0),
+      wakeups_(0),
+      waiting_(false),
+      closed_(false) {
+  for (size_t i = 0; i <= mask_; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+RequestQueue::~RequestQueue() {}
+
+bool RequestQueue::Push(
+    std::shared_ptr<default_camera_hal::CaptureRequest> request) {
+  if (closed_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+
+  // Claim the slot at the tail, unless the consumer hasn't emptied it yet.
+  size_t position = tail_.load(std::memory_order_relaxed);
+  Slot* slot;
+  while (true) {
+    slot = &slots_[position & mask_];
+    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    ptrdiff_t lag = static_cast<ptrdiff_t>(sequence - position);
+    if (lag == 0) {
+      if (tail_.compare_exchange_weak(
+              position, position + 1, std::memory_order_relaxed)) {
+        break;
+      }
+    } else if (lag < 0) {
+      return false;
+    } else {
+      // Another producer took it.
+      position = tail_.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->request = std::move(request);
+  slot->sequence.store(position + 1, std::memory_order_release);
+  Wake();
+  return true;
+}
+
+bool RequestQueue::TryPop(
+    std::shared_ptr<default_camera_hal::CaptureRequest>* request) {
+  Slot& slot = slots_[head_ & mask_];
+  if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+    return false;
+  }
+  *request = std::move(slot.request);
+  slot.request.reset();
+  // Hand the slot back to the producers, one lap ahead.
+  slot.sequence.store(head_ + mask_ + 1, std::memory_order_release);
+  ++head_;
+  return true;
+}
+
+bool RequestQueue::PopAll(
+    std::vector<std::shared_ptr<default_camera_hal::CaptureRequest>>*
+        requests) {
+  size_t popped = 0;
+  while (true) {
+    std::shared_ptr<default_camera_hal::CaptureRequest> request;
+    while (TryPop(&request)) {
+      requests->push_back(std::move(request));
+      ++popped;
+    }
+    if (popped) {
+      return true;
+    }
+    if (closed_.load()) {
+      // Close may have raced with a last push.
+      if (TryPop(&request)) {
+        requests->push_back(std::move(request));
+        return true;
+      }
+      return false;
+    }
+
+    // Announce the wait before sampling the futex word, and Wake bumps the
+    // word before checking for a waiter, so either a push after the sample
+    // changes the word (and the wait returns at once), or it sees
+    // |waiting_| and wakes us.
+    waiting_.store(true);
+    uint32_t wakeups = wakeups_.load();
+    if (TryPop(&request)) {
+      waiting_.store(false, std::memory_order_relaxed);
+      requests->push_back(std::move(request));
+      ++popped;
+      continue;
+    }
+    if (!closed_.load()) {
+      int res = syscall(SYS_futex, reinterpret_cast<uint32_t*>(&wakeups_),
+                        FUTEX_WAIT_PRIVATE, wakeups, nullptr, nullptr, 0);
+      if (res && errno != EAGAIN && errno != EINTR) {
+        HAL_LOGE("Failed to wait for requests: %s", strerror(errno));
+      }
+    }
+    waiting_.store(false, std::memory_order_relaxed);
+  }
+}
+
+void RequestQueue::Close() {
+  closed_.store(true);
+  Wake();
+}
+
+void RequestQueue::Wake() {
+  wakeups_.fetch_add(1);
+  if (waiting_.load()) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&wakeups_),
+            FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+  }
+}
+
+}  // namespace v4l2_camera_hal
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef V4L2_CAMERA_HAL_REQUEST_QUEUE_H_
+#define V4L2_CAMERA_HAL_REQUEST_QUEUE_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <android-base/macros.h>
+#include "capture_request.h"
+
+namespace v4l2_camera_hal {
+
+// Fixed-capacity FIFO of capture requests from any number of submitting
+// threads to one consumer. Push never blocks or takes a lock; the consumer
+// sleeps on a futex while the queue is empty, and the futex is only woken
+// when it actually sleeps.
+class RequestQueue {
+ public:
+  // |capacity| is rounded up to a power of two.
+  explicit RequestQueue(size_t capacity);
+  ~RequestQueue();
+
+  // Returns false if the queue is full or closed.
+  bool Push(std::shared_ptr<default_camera_hal::CaptureRequest> request);
+
+  // Move every queued request to the end of |requests|, blocking while the
+  // queue is empty. Returns false once the queue is closed and drained.
+  // Only one thread may pop.
+  bool PopAll(
+      std::vector<std::shared_ptr<default_camera_hal::CaptureRequest>>*
+          requests);
+
+  // Wake up the consumer and fail every future Push, and every PopAll once
+  // empty.
+  void Close();
+
+ private:
+  struct Slot {
+    // Position this slot can next be pushed at, or that position + 1 once
+    // it holds a request.
+    std::atomic<size_t> sequence;
+    std::shared_ptr<default_camera_hal::CaptureRequest> request;
+  };
+
+  // Take the request at the head, if any. Consumer only.
+  bool TryPop(std::shared_ptr<default_camera_hal::CaptureRequest>* request);
+  // Let the consumer know something changed.
+  void Wake();
+
+  const size_t mask_;
+  std::unique_ptr<Slot[]> slots_;
+  // Next position to push at, shared by the producers.
+  std::atomic<size_t> tail_;
+  // Next position to pop from, owned by the consumer.
+  size_t head_;
+  // Futex word, bumped after every push and on close.
+  std::atomic<uint32_t> wakeups_;
+  // Whether the consumer is (about to be) asleep on |wakeups_|.
+  std::atomic<bool> waiting_;
+  std::atomic<bool> closed_;
+
+  DISALLOW_COPY_AND_ASSIGN(RequestQueue);
+};
+
+}  // namespace v4l2_camera_hal
+
+#endif  // V4L2_CAMERA_HAL_REQUEST_QUEUE_H_
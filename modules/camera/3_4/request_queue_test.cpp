@@ -0,0 +1,146 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "request_queue.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using default_camera_hal::CaptureRequest;
+using testing::Test;
+
+namespace v4l2_camera_hal {
+
+class RequestQueueTest : public Test {
+ protected:
+  std::shared_ptr<CaptureRequest> Request(uint32_t frame_number) {
+    std::shared_ptr<CaptureRequest> request =
+        std::make_shared<CaptureRequest>();
+    request->frame_number = frame_number;
+    return request;
+  }
+
+  std::vector<uint32_t> FrameNumbers() {
+    std::vector<uint32_t> result;
+    for (const auto& request : popped_) {
+      result.push_back(request->frame_number);
+    }
+    return result;
+  }
+
+  std::vector<std::shared_ptr<CaptureRequest>> popped_;
+};
+
+TEST_F(RequestQueueTest, PopAllInOrder) {
+  RequestQueue dut(4);
+  EXPECT_TRUE(dut.Push(Request(1)));
+  EXPECT_TRUE(dut.Push(Request(2)));
+  EXPECT_TRUE(dut.Push(Request(3)));
+  EXPECT_TRUE(dut.PopAll(&popped_));
+  EXPECT_EQ(FrameNumbers(), std::vector<uint32_t>({1, 2, 3}));
+}
+
+TEST_F(RequestQueueTest, FullPushFails) {
+  // Rounded up to 4.
+  RequestQueue dut(3);
+  for (uint32_t i = 0; i < 4; ++i) {
+    EXPECT_TRUE(dut.Push(Request(i)));
+  }
+  EXPECT_FALSE(dut.Push(Request(4)));
+
+  // Popping makes room again, and the slots are reused in order.
+  EXPECT_TRUE(dut.PopAll(&popped_));
+  for (uint32_t i = 4; i < 8; ++i) {
+    EXPECT_TRUE(dut.Push(Request(i)));
+  }
+  EXPECT_TRUE(dut.PopAll(&popped_));
+  EXPECT_EQ(FrameNumbers(),
+            std::vector<uint32_t>({0, 1, 2, 3, 4, 5, 6, 7}));
+}
+
+TEST_F(RequestQueueTest, PopAllWaitsForPush) {
+  RequestQueue dut(4);
+  std::thread producer([&dut, this] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    dut.Push(Request(7));
+  });
+  EXPECT_TRUE(dut.PopAll(&popped_));
+  EXPECT_EQ(FrameNumbers(), std::vector<uint32_t>({7}));
+  producer.join();
+}
+
+TEST_F(RequestQueueTest, CloseWakesConsumer) {
+  RequestQueue dut(4);
+  std::thread closer([&dut] {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    dut.Close();
+  });
+  EXPECT_FALSE(dut.PopAll(&popped_));
+  closer.join();
+  EXPECT_FALSE(dut.Push(Request(1)));
+}
+
+TEST_F(RequestQueueTest, CloseKeepsQueuedRequests) {
+  RequestQueue dut(4);
+  EXPECT_TRUE(dut.Push(Request(1)));
+  dut.Close();
+  EXPECT_TRUE(dut.PopAll(&popped_));
+  EXPECT_EQ(FrameNumbers(), std::vector<uint32_t>({1}));
+  EXPECT_FALSE(dut.PopAll(&popped_));
+}
+
+TEST_F(RequestQueueTest, ConcurrentProducers) {
+  const uint32_t kProducers = 4;
+  const uint32_t kRequestsEach = 10000;
+  RequestQueue dut(8);
+  std::vector<std::thread> producers;
+  for (uint32_t p = 0; p < kProducers; ++p) {
+    producers.emplace_back([&dut, p, this] {
+      for (uint32_t i = 0; i < kRequestsEach; ++i) {
+        std::shared_ptr<CaptureRequest> request =
+            Request(p * kRequestsEach + i);
+        // Only full queues fail; wait for the consumer.
+        while (!dut.Push(request)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  while (popped_.size() < kProducers * kRequestsEach) {
+    ASSERT_TRUE(dut.PopAll(&popped_));
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+
+  // Each producer's requests come out in the order it pushed them.
+  std::vector<uint32_t> next(kProducers);
+  for (uint32_t frame_number : FrameNumbers()) {
+    uint32_t p = frame_number / kRequestsEach;
+    ASSERT_LT(p, kProducers);
+    EXPECT_EQ(frame_number % kRequestsEach, next[p]);
+    next[p] = frame_number % kRequestsEach + 1;
+  }
+  for (uint32_t p = 0; p < kProducers; ++p) {
+    EXPECT_EQ(next[p], kRequestsEach);
+  }
+}
+
+}  // namespace v4l2_camera_hal
@@ -23,7 +23,34 @@
 
 namespace default_camera_hal {
 
-RequestTracker::RequestTracker() {}
+// Frame slots to start with, before any stream is configured.
+static const size_t kMinFrameSlots = 8;
+
+// Call |visit| once for each stream used by |request|, until it returns
+// false. Returns whether it got through all of them.
+template <typename Visitor>
+static bool ForEachStream(const CaptureRequest& request, Visitor visit) {
+  const camera3_stream_t* input_stream =
+      request.input_buffer ? request.input_buffer->stream : nullptr;
+  if (input_stream && !visit(input_stream)) {
+    return false;
+  }
+  const auto& outputs = request.output_buffers;
+  for (size_t i = 0; i < outputs.size(); ++i) {
+    const camera3_stream_t* stream = outputs[i].stream;
+    bool seen = stream == input_stream;
+    for (size_t j = 0; j < i && !seen; ++j) {
+      seen = outputs[j].stream == stream;
+    }
+    if (!seen && !visit(stream)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+RequestTracker::RequestTracker()
+    : frames_in_flight_(kMinFrameSlots), num_frames_in_flight_(0) {}
 
 RequestTracker::~RequestTracker() {}
 
@@ -31,57 +58,98 @@ void RequestTracker::SetStreamConfiguration(
     const camera3_stream_configuration_t& config) {
   // Clear the old configuration.
   ClearStreamConfiguration();
-  // Add an entry to the buffer tracking map for each configured stream.
+  // Add an entry to the buffer tracking array for each configured stream.
+  // Every request takes a buffer of some stream, so the streams bound the
+  // number of frames in flight.
+  size_t max_frames = 0;
   for (size_t i = 0; i < config.num_streams; ++i) {
-    buffers_in_flight_.emplace(config.streams[i], 0);
+    buffers_in_flight_.push_back({config.streams[i], 0});
+    max_frames += config.streams[i]->max_buffers;
+  }
+  size_t slots = kMinFrameSlots;
+  while (slots < max_frames) {
+    slots *= 2;
+  }
+  if (slots != frames_in_flight_.size()) {
+    Resize(slots);
   }
 }
 
 void RequestTracker::ClearStreamConfiguration() {
-  // The keys of the in flight buffer map are the configured streams.
+  // The entries of the in flight buffer array are the configured streams.
   buffers_in_flight_.clear();
 }
 
-// Helper: get the streams used by a request.
-std::set<camera3_stream_t*> RequestStreams(const CaptureRequest& request) {
-  std::set<camera3_stream_t*> result;
-  if (request.input_buffer) {
-    result.insert(request.input_buffer->stream);
+RequestTracker::StreamCount* RequestTracker::FindStream(
+    const camera3_stream_t* stream) {
+  for (auto& stream_count : buffers_in_flight_) {
+    if (stream_count.stream == stream) {
+      return &stream_count;
+    }
   }
-  for (const auto& output_buffer : request.output_buffers) {
-    result.insert(output_buffer.stream);
+  return nullptr;
+}
+
+const RequestTracker::StreamCount* RequestTracker::FindStream(
+    const camera3_stream_t* stream) const {
+  return const_cast<RequestTracker*>(this)->FindStream(stream);
+}
+
+void RequestTracker::Resize(size_t min_slots) {
+  std::vector<std::shared_ptr<CaptureRequest>> old_frames;
+  old_frames.swap(frames_in_flight_);
+  size_t slots = min_slots;
+  bool placed = false;
+  while (!placed) {
+    frames_in_flight_.assign(slots, nullptr);
+    placed = true;
+    for (const auto& request : old_frames) {
+      if (!request) {
+        continue;
+      }
+      auto& slot = frames_in_flight_[Slot(request->frame_number)];
+      if (slot) {
+        placed = false;
+        break;
+      }
+      slot = request;
+    }
+    slots *= 2;
   }
-  return result;
 }
 
-bool RequestTracker::Add(std::shared_ptr<CaptureRequest> request) {
+bool RequestTracker::Add(const std::shared_ptr<CaptureRequest>& request) {
   if (!CanAddRequest(*request)) {
     return false;
   }
 
   // Add to the count for each stream used.
-  for (const auto stream : RequestStreams(*request)) {
-    ++buffers_in_flight_[stream];
-  }
+  ForEachStream(*request, [this](const camera3_stream_t* stream) {
+    ++FindStream(stream)->buffers_in_flight;
+    return true;
+  });
 
-  // Store the request.
-  frames_in_flight_[request->frame_number] = request;
+  // Store the request, making room if another frame is in its slot.
+  while (frames_in_flight_[Slot(request->frame_number)]) {
+    Resize(frames_in_flight_.size() * 2);
+  }
+  frames_in_flight_[Slot(request->frame_number)] = request;
+  ++num_frames_in_flight_;
 
   return true;
 }
 
-bool RequestTracker::Remove(std::shared_ptr<CaptureRequest> request) {
+bool RequestTracker::Remove(const std::shared_ptr<CaptureRequest>& request) {
   if (!request) {
     return false;
   }
 
   // Get the request.
-  const auto frame_number_request =
-      frames_in_flight_.find(request->frame_number);
-  if (frame_number_request == frames_in_flight_.end()) {
+  auto& slot = frames_in_flight_[Slot(request->frame_number)];
+  if (!slot || slot->frame_number != request->frame_number) {
     ALOGE("%s: Frame %u is not in flight.", __func__, request->frame_number);
     return false;
-  } else if (request != frame_number_request->second) {
+  } else if (request != slot) {
     ALOGE(
         "%s: Request for frame %u cannot be removed: "
         "does not matched the stored request.",
@@ -90,36 +158,40 @@ bool RequestTracker::Remove(std::shared_ptr<CaptureRequest> request) {
     return false;
   }
 
-  frames_in_flight_.erase(frame_number_request);
+  slot.reset();
+  --num_frames_in_flight_;
 
   // Decrement the counts of used streams.
-  for (const auto stream : RequestStreams(*request)) {
-    --buffers_in_flight_[stream];
-  }
+  ForEachStream(*request, [this](const camera3_stream_t* stream) {
+    StreamCount* stream_count = FindStream(stream);
+    if (stream_count) {
+      --stream_count->buffers_in_flight;
+    }
+    return true;
+  });
 
   return true;
 }
 
 void RequestTracker::Clear(
     std::set<std::shared_ptr<CaptureRequest>>* requests) {
-  // If desired, extract all the currently in-flight requests.
-  if (requests) {
-    for (auto& frame_number_request : frames_in_flight_) {
-      requests->insert(frame_number_request.second);
+  // Clear out all tracking, extracting the in-flight requests if desired.
+  for (auto& slot : frames_in_flight_) {
+    if (slot && requests) {
+      requests->insert(slot);
     }
+    slot.reset();
   }
-
-  // Clear out all tracking.
-  frames_in_flight_.clear();
+  num_frames_in_flight_ = 0;
   // Maintain the configuration, but reset counts.
   for (auto& stream_count : buffers_in_flight_) {
-    stream_count.second = 0;
+    stream_count.buffers_in_flight = 0;
   }
 }
 
 bool RequestTracker::CanAddRequest(const CaptureRequest& request) const {
   // Check that it's not a duplicate.
-  if (frames_in_flight_.count(request.frame_number) > 0) {
+  if (InFlight(request.frame_number)) {
     ALOGE("%s: Already tracking a request with frame number %d.",
           __func__,
           request.frame_number);
@@ -128,32 +200,33 @@ bool RequestTracker::CanAddRequest(const CaptureRequest& request) const {
 
   // Check that each stream has space
   // (which implicitly checks if it is configured).
-  for (const auto stream : RequestStreams(request)) {
+  return ForEachStream(request, [this](const camera3_stream_t* stream) {
     if (StreamFull(stream)) {
-      ALOGE("%s: Stream %p is full.", __func__, stream);
+      ALOGE("CanAddRequest: Stream %p is full.", stream);
       return false;
     }
-  }
-  return true;
+    return true;
+  });
 }
 
 bool RequestTracker::StreamFull(const camera3_stream_t* handle) const {
-  const auto it = buffers_in_flight_.find(handle);
-  if (it == buffers_in_flight_.end()) {
+  const StreamCount* stream_count = FindStream(handle);
+  if (!stream_count) {
     // Unconfigured streams are implicitly full.
     ALOGV("%s: Stream %p is not a configured stream.", __func__, handle);
     return true;
   } else {
-    return it->second >= it->first->max_buffers;
+    return stream_count->buffers_in_flight >= handle->max_buffers;
   }
 }
 
 bool RequestTracker::InFlight(uint32_t frame_number) const {
-  return frames_in_flight_.count(frame_number) > 0;
+  const auto& slot = frames_in_flight_[Slot(frame_number)];
+  return slot && slot->frame_number == frame_number;
 }
 
 bool RequestTracker::Empty() const {
-  return frames_in_flight_.empty();
+  return num_frames_in_flight_ == 0;
 }
 
 }  // namespace default_camera_hal
@@ -17,9 +17,9 @@
 #ifndef DEFAULT_CAMERA_HAL_REQUEST_TRACKER_H_
 #define DEFAULT_CAMERA_HAL_REQUEST_TRACKER_H_
 
-#include <map>
 #include <memory>
 #include <set>
+#include <vector>
 
 #include <android-base/macros.h>
 #include <hardware/camera3.h>
@@ -28,6 +28,9 @@
 namespace default_camera_hal {
 
 // Keep track of what requests and streams are in flight.
+// Requests live in a ring indexed by frame number, sized for the configured
+// streams, and stream counts in a flat array; tracking a request doesn't
+// allocate unless frame numbers in flight are far apart.
 class RequestTracker {
  public:
   RequestTracker();
@@ -44,10 +47,10 @@ class RequestTracker {
   // Tracking methods.
   // Track a request.
   // False if a request of the same frame number is already being tracked
-  virtual bool Add(std::shared_ptr<CaptureRequest> request);
+  virtual bool Add(const std::shared_ptr<CaptureRequest>& request);
   // Stop tracking a request.
   // False if the given request is not being tracked.
-  virtual bool Remove(std::shared_ptr<CaptureRequest> request = nullptr);
+  virtual bool Remove(const std::shared_ptr<CaptureRequest>& request = nullptr);
   // Empty out all requests being tracked.
   virtual void Clear(
       std::set<std::shared_ptr<CaptureRequest>>* requests = nullptr);
@@ -64,10 +67,28 @@ class RequestTracker {
   virtual bool Empty() const;
 
  private:
-  // Track for each stream, how many buffers are in flight.
-  std::map<const camera3_stream_t*, size_t> buffers_in_flight_;
-  // Track the frames in flight.
-  std::map<uint32_t, std::shared_ptr<CaptureRequest>> frames_in_flight_;
+  struct StreamCount {
+    const camera3_stream_t* stream;
+    size_t buffers_in_flight;
+  };
+
+  // The count of |stream|, or null if it isn't configured.
+  StreamCount* FindStream(const camera3_stream_t* stream);
+  const StreamCount* FindStream(const camera3_stream_t* stream) const;
+  // The slot of |frame_number| in |frames_in_flight_|.
+  size_t Slot(uint32_t frame_number) const {
+    return frame_number & (frames_in_flight_.size() - 1);
+  }
+  // Resize |frames_in_flight_| to at least |min_slots| slots, and further
+  // until each frame in flight gets a slot of its own.
+  void Resize(size_t min_slots);
+
+  // Track for each configured stream, how many buffers are in flight.
+  std::vector<StreamCount> buffers_in_flight_;
+  // Track the frames in flight. A power of two in size; empty slots hold
+  // null.
+  std::vector<std::shared_ptr<CaptureRequest>> frames_in_flight_;
+  size_t num_frames_in_flight_;
 
   DISALLOW_COPY_AND_ASSIGN(RequestTracker);
 };
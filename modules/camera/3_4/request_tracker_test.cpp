@@ -16,6 +16,8 @@
 
 #include "request_tracker.h"
 
+#include <chrono>
+
 #include <gtest/gtest.h>
 
 using testing::Test;
@@ -256,4 +258,70 @@ TEST_F(RequestTrackerTest, ClearConfiguration) {
   EXPECT_TRUE(dut_->StreamFull(&stream2_));
 }
 
+TEST_F(RequestTrackerTest, AddCollidingFrames) {
+  // Frames are kept in a ring indexed by frame number, with at least as many
+  // slots as buffers can be in flight. Frames that far apart land in the
+  // same slot, which should still work.
+  uint32_t frame = 1;
+  uint32_t far_frame = frame + 1024;
+  AddRequest(frame, {&stream1_});
+  AddRequest(far_frame, {&stream2_});
+  EXPECT_TRUE(dut_->InFlight(frame));
+  EXPECT_FALSE(dut_->InFlight(frame + 512));
+
+  std::shared_ptr<CaptureRequest> request =
+      GenerateCaptureRequest(frame, {&stream1_});
+  EXPECT_FALSE(dut_->Remove(request));
+  std::set<std::shared_ptr<CaptureRequest>> requests;
+  dut_->Clear(&requests);
+  EXPECT_EQ(requests.size(), 2u);
+  EXPECT_TRUE(dut_->Empty());
+}
+
+TEST_F(RequestTrackerTest, SubmitCompleteThroughput) {
+  // Steady state for a pipeline of depth 3 sending to both streams, the
+  // way Camera::processCaptureRequest() and completeRequest() drive it.
+  const uint32_t kFrames = 200000;
+  const uint32_t kDepth = 3;
+  CaptureRequestPool pool(kDepth + 1);
+  std::vector<camera3_stream_buffer_t> buffers = {
+      {&stream1_, nullptr, 0, -1, -1}, {&stream2_, nullptr, 0, -1, -1}};
+  camera3_capture_request_t submitted{
+      0, nullptr, nullptr, static_cast<uint32_t>(buffers.size()),
+      buffers.data()};
+  std::vector<std::shared_ptr<CaptureRequest>> pipeline(kDepth);
+
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t frame = 0; frame < kFrames; ++frame) {
+    std::shared_ptr<CaptureRequest>& slot = pipeline[frame % kDepth];
+    if (slot) {
+      ASSERT_TRUE(dut_->Remove(slot));
+      slot.reset();
+    }
+    submitted.frame_number = frame;
+    slot = pool.Acquire(&submitted);
+    ASSERT_TRUE(dut_->CanAddRequest(*slot));
+    ASSERT_TRUE(dut_->Add(slot));
+  }
+  for (auto& request : pipeline) {
+    ASSERT_TRUE(dut_->Remove(request));
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  EXPECT_TRUE(dut_->Empty());
+  printf("%.0f submit/complete cycles per second\n", kFrames / elapsed.count());
+
+  // Completed requests are handed out again.
+  pipeline.clear();
+  std::vector<std::shared_ptr<CaptureRequest>> held;
+  for (uint32_t i = 0; i <= kDepth; ++i) {
+    held.push_back(pool.Acquire(&submitted));
+  }
+  CaptureRequest* completed = held[1].get();
+  held[1].reset();
+  std::shared_ptr<CaptureRequest> reused = pool.Acquire(&submitted);
+  EXPECT_EQ(reused.get(), completed);
+  EXPECT_EQ(reused->output_buffers.size(), buffers.size());
+}
+
 }  // namespace default_camera_hal
@@ -0,0 +1,162 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the latency of turning a YU12 still capture into a JPEG with an
+// EXIF thumbnail:
+//   serial:     the thumbnail is scaled and compressed into APP1 first, and
+//               the main image is compressed after that.
+//   concurrent: ImageProcessor::ConvertFormat(), which makes the thumbnail
+//               while the main image is compressed.
+// for every resolution, thread count and thumbnail filter.
+//
+// Usage: still_capture_benchmark [iterations] [max threads]
+//   e.g. still_capture_benchmark 10 4
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <camera/CameraMetadata.h>
+#include "arc/exif_utils.h"
+#include "arc/image_processor.h"
+#include "arc/jpeg_compressor.h"
+#include "arc/thread_pool.h"
+
+namespace {
+
+const struct {
+  const char* name;
+  uint32_t width;
+  uint32_t height;
+} kResolutions[] = {
+    {"2MP", 1920, 1080}, {"8MP", 3264, 2448}, {"12MP", 4032, 3024},
+};
+
+const uint16_t kThumbnailWidth = 320;
+const uint16_t kThumbnailHeight = 240;
+const uint8_t kQuality = 90;
+const float kFocalLength = 3.04f;
+
+double MonotonicMs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// Returns the median time of |iterations| runs of |capture| in ms.
+double Measure(int iterations, const std::function<bool()>& capture) {
+  std::vector<double> times;
+  for (int i = 0; i < iterations; ++i) {
+    double start = MonotonicMs();
+    bool ok = capture();
+    times.push_back(MonotonicMs() - start);
+    if (!ok) {
+      fprintf(stderr, "Capture failed\n");
+      exit(1);
+    }
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+// The way ConvertFormat() encoded JPEGs before making the thumbnail
+// concurrently.
+bool SerialCapture(const arc::FrameBuffer& in, bool thumbnail,
+                   bool filtering, arc::JpegCompressor* compressor) {
+  arc::ExifUtils utils;
+  if (!utils.Initialize(in.GetData(), in.GetWidth(), in.GetHeight(),
+                        kQuality) ||
+      !utils.SetFocalLength(kFocalLength * 10000, 10000) ||
+      (thumbnail &&
+       !utils.SetThumbnailSize(kThumbnailWidth, kThumbnailHeight))) {
+    return false;
+  }
+  utils.SetThumbnailFiltering(filtering);
+  return utils.GenerateApp1() &&
+         compressor->CompressImage(in.GetData(), in.GetWidth(),
+                                   in.GetHeight(), kQuality,
+                                   utils.GetApp1Buffer(),
+                                   utils.GetApp1Length());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int iterations = argc > 1 ? atoi(argv[1]) : 10;
+  size_t max_threads = argc > 2 ? atoi(argv[2]) : 4;
+  if (iterations <= 0 || max_threads == 0) {
+    fprintf(stderr, "Usage: %s [iterations] [max threads]\n", argv[0]);
+    return 1;
+  }
+
+  const struct {
+    const char* name;
+    bool thumbnail;
+    bool filtering;
+  } kThumbnails[] = {{"none", false, false},
+                     {"point", true, false},
+                     {"box", true, true}};
+
+  printf("%-10s %8s %-9s %10s %14s %8s\n", "resolution", "threads",
+         "thumbnail", "serial ms", "concurrent ms", "saved");
+  for (const auto& resolution : kResolutions) {
+    size_t size = resolution.width * resolution.height * 3 / 2;
+    arc::AllocatedFrameBuffer in(size);
+    in.SetDataSize(size);
+    in.SetFourcc(V4L2_PIX_FMT_YUV420);
+    in.SetWidth(resolution.width);
+    in.SetHeight(resolution.height);
+    // Smooth gradients with some noise, roughly like a camera frame.
+    for (size_t i = 0; i < size; ++i) {
+      in.GetData()[i] = static_cast<uint8_t>(
+          i % resolution.width / 16 + i / resolution.width / 16 + rand() % 16);
+    }
+    arc::AllocatedFrameBuffer out(size);
+    out.SetFourcc(V4L2_PIX_FMT_JPEG);
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+      arc::ThreadPool pool(threads);
+      arc::JpegCompressor compressor(&pool);
+      arc::ImageProcessor::SetMaxThreads(threads);
+      for (const auto& thumbnail : kThumbnails) {
+        android::CameraMetadata metadata;
+        metadata.update(ANDROID_JPEG_QUALITY, &kQuality, 1);
+        metadata.update(ANDROID_LENS_FOCAL_LENGTH, &kFocalLength, 1);
+        if (thumbnail.thumbnail) {
+          const int32_t thumbnail_size[] = {kThumbnailWidth, kThumbnailHeight};
+          metadata.update(ANDROID_JPEG_THUMBNAIL_SIZE, thumbnail_size, 2);
+        }
+        arc::ImageProcessor::SetThumbnailFiltering(thumbnail.filtering);
+
+        double serial_ms = Measure(iterations, [&] {
+          return SerialCapture(in, thumbnail.thumbnail, thumbnail.filtering,
+                               &compressor);
+        });
+        double concurrent_ms = Measure(iterations, [&] {
+          return arc::ImageProcessor::ConvertFormat(metadata, in, &out) == 0;
+        });
+        printf("%-10s %8zu %-9s %10.2f %14.2f %7.1f%%\n", resolution.name,
+               threads, thumbnail.name, serial_ms, concurrent_ms,
+               100 * (serial_ms - concurrent_ms) / serial_ms);
+      }
+    }
+  }
+  return 0;
+}
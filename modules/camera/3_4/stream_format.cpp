@@ -125,9 +125,9 @@ uint32_t StreamFormat::HalToV4L2PixelFormat(int hal_pixel_format) {
       return V4L2_PIX_FMT_BGR32;
     case HAL_PIXEL_FORMAT_YCbCr_420_888:
       // This is a flexible YUV format that depends on platform. Different
-      // platform may have different format. It can be YVU420 or NV12. Now we
-      // return YVU420 first.
-      // TODO(): call drm_drv.get_fourcc() to get correct format.
+      // platform may have different format. It can be YVU420 or NV12. The
+      // frame is written in whatever plane layout gralloc's lock_ycbcr
+      // reports, so YUV420 only stands for "some 4:2:0 layout" here.
       return V4L2_PIX_FMT_YUV420;
     case HAL_PIXEL_FORMAT_YCbCr_422_I:
       return V4L2_PIX_FMT_YUYV;
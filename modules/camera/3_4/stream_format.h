@@ -24,6 +24,10 @@
 
 namespace v4l2_camera_hal {
 
+// Size of BLOB (JPEG) stream buffers, advertised as ANDROID_JPEG_MAX_SIZE.
+// Generously allow up to 6MB (the largest size on the RPi Camera is about 5MB).
+const size_t kV4L2MaxJpegSize = 6000000;
+
 enum FormatCategory {
   kFormatCategoryRaw,
   kFormatCategoryStalling,
@@ -19,14 +19,19 @@
 
 #include "v4l2_camera.h"
 
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
 #include <fcntl.h>
 
 #include <camera/CameraMetadata.h>
+#include <cutils/properties.h>
 #include <hardware/camera3.h>
 #include <linux/videodev2.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <system/camera_metadata.h>
+#include "arc/image_processor.h"
 #include "common.h"
 #include "function_thread.h"
 #include "metadata/metadata_common.h"
@@ -37,6 +42,52 @@
 
 namespace v4l2_camera_hal {
 
+// Upper bound on a single wait for the device to fill a buffer. The wait
+// normally ends much earlier, when a frame is ready or on flush/shutdown.
+const int kDequeueWaitTimeoutMs = 1000;
+// Back off after a device error instead of retrying DQBUF immediately.
+const std::chrono::milliseconds kDequeueErrorBackoff(10);
+// Frames are converted on this many threads at once.
+const size_t kConvertWorkers = 2;
+// Set to false to point sample EXIF thumbnails instead of box filtering them.
+const char kThumbnailFilteringProperty[] = "camera.v4l2.thumbnail_filtering";
+// Frames waiting in front of each pipeline stage before dequeue blocks.
+const size_t kPipelineQueueDepth = 4;
+// Requests waiting to be enqueued. More than the request tracker lets be in
+// flight, which is bounded by the device's buffers per stream.
+const size_t kRequestQueueCapacity = 64;
+
+// Whether |a| and |b| hold the same entries, in the same order. Repeated
+// settings are copies of one buffer, so reordered entries needn't match.
+static bool SameSettings(const android::CameraMetadata& a,
+                         const android::CameraMetadata& b) {
+  if (a.entryCount() != b.entryCount()) {
+    return false;
+  }
+  if (a.isEmpty()) {
+    return true;
+  }
+
+  const camera_metadata_t* a_buffer = a.getAndLock();
+  const camera_metadata_t* b_buffer = b.getAndLock();
+  size_t count = get_camera_metadata_entry_count(a_buffer);
+  bool same = true;
+  for (size_t i = 0; same && i < count; ++i) {
+    camera_metadata_ro_entry_t a_entry;
+    camera_metadata_ro_entry_t b_entry;
+    same = !get_camera_metadata_ro_entry(a_buffer, i, &a_entry) &&
+           !get_camera_metadata_ro_entry(b_buffer, i, &b_entry) &&
+           a_entry.tag == b_entry.tag && a_entry.type == b_entry.type &&
+           a_entry.count == b_entry.count &&
+           !memcmp(a_entry.data.u8,
+                   b_entry.data.u8,
+                   a_entry.count * camera_metadata_type_size[a_entry.type]);
+  }
+  a.unlock(a_buffer);
+  b.unlock(b_buffer);
+  return same;
+}
+
 V4L2Camera* V4L2Camera::NewV4L2Camera(int id, const std::string path) {
   HAL_LOG_ENTER();
 
@@ -53,6 +104,11 @@ V4L2Camera* V4L2Camera::NewV4L2Camera(int id, const std::string path) {
     return nullptr;
   }
 
+  // Filtered thumbnails are made while the main image is encoded, so they
+  // only cost CPU time, not latency.
+  arc::ImageProcessor::SetThumbnailFiltering(
+      property_get_bool(kThumbnailFilteringProperty, true));
+
   return new V4L2Camera(id, std::move(v4l2_wrapper), std::move(metadata));
 }
 
@@ -62,10 +118,21 @@ V4L2Camera::V4L2Camera(int id,
     : default_camera_hal::Camera(id),
       device_(std::move(v4l2_wrapper)),
       metadata_(std::move(metadata)),
+      request_queue_(kRequestQueueCapacity),
+      last_settings_valid_(false),
+      last_settings_stale_(false),
       buffer_enqueuer_(new FunctionThread(
           std::bind(&V4L2Camera::enqueueRequestBuffers, this))),
       buffer_dequeuer_(new FunctionThread(
           std::bind(&V4L2Camera::dequeueRequestBuffers, this))),
+      pipeline_(new CapturePipeline(
+          std::bind(&V4L2Camera::convertFrame, this, std::placeholders::_1),
+          std::bind(&V4L2Camera::encodeFrame, this, std::placeholders::_1),
+          std::bind(&V4L2Camera::releaseFrame, this, std::placeholders::_1),
+          std::bind(&V4L2Camera::completeFrame, this, std::placeholders::_1),
+          kConvertWorkers,
+          kPipelineQueueDepth)),
+      shutting_down_(false),
       max_input_streams_(0),
       max_output_streams_({{0, 0, 0}}) {
   HAL_LOG_ENTER();
@@ -73,6 +140,19 @@ V4L2Camera::V4L2Camera(int id,
 
 V4L2Camera::~V4L2Camera() {
   HAL_LOG_ENTER();
+
+  // The threads call back into this object, stop them before it goes away.
+  shutting_down_ = true;
+  request_queue_.Close();
+  {
+    std::lock_guard<std::mutex> guard(in_flight_lock_);
+    buffers_in_flight_.notify_all();
+  }
+  device_->InterruptWait();
+  buffer_enqueuer_->requestExitAndWait();
+  buffer_dequeuer_->requestExitAndWait();
+  // Nothing is submitted anymore.
+  pipeline_->Stop();
 }
 
 int V4L2Camera::connect() {
@@ -88,6 +168,7 @@ int V4L2Camera::connect() {
     HAL_LOGE("Failed to connect to device.");
     return connection_->status();
   }
+  last_settings_stale_ = true;
 
   // TODO(b/29185945): confirm this is a supported device.
   // This is checked by the HAL, but the device at |device_|'s path may
@@ -112,7 +193,26 @@ void V4L2Camera::disconnect() {
 
 int V4L2Camera::flushBuffers() {
   HAL_LOG_ENTER();
-  return device_->StreamOff();
+  int res = device_->StreamOff();
+
+  // Turning the stream off returned every buffer, and Camera::flush errors
+  // out their requests once this returns. Let the dequeue thread go back to
+  // sleep rather than keep waiting on the device for them.
+  {
+    std::lock_guard<std::mutex> guard(in_flight_lock_);
+    in_flight_buffer_count_ = 0;
+  }
+  device_->InterruptWait();
+  // Wait for frames already dequeued to give their buffers back, so none is
+  // returned to the framework while still being written.
+  pipeline_->Drain();
+  last_settings_stale_ = true;
+  return res;
+}
+
+void V4L2Camera::dumpDevice(int fd) {
+  pipeline_->Dump(fd);
+  device_->DumpControlStats(fd);
 }
 
 int V4L2Camera::initStaticInfo(android::CameraMetadata* out) {
@@ -160,6 +260,13 @@ void V4L2Camera::initDeviceInfo(camera_info_t* info) {
 int V4L2Camera::initDevice() {
   HAL_LOG_ENTER();
 
+  // Start the pipeline before anything can be dequeued into it.
+  int pipeline_res = pipeline_->Start();
+  if (pipeline_res) {
+    HAL_LOGE("Failed to start capture pipeline: %d", pipeline_res);
+    return pipeline_res;
+  }
+
   // Start the buffer enqueue/dequeue threads if they're not already running.
   if (!buffer_enqueuer_->isRunning()) {
     android::status_t res = buffer_enqueuer_->run("Enqueue buffers");
@@ -184,69 +291,99 @@ int V4L2Camera::enqueueRequest(
   HAL_LOG_ENTER();
 
   // Assume request validated before calling this function.
-  // (For now, always exactly 1 output buffer, no inputs).
-  {
-    std::lock_guard<std::mutex> guard(request_queue_lock_);
-    request_queue_.push(request);
-    requests_available_.notify_one();
+  // (Any number of output buffers, no inputs).
+  if (!request_queue_.Push(request)) {
+    HAL_LOGE("Failed to queue request for frame %u.", request->frame_number);
+    return -ENOSPC;
   }
 
   return 0;
 }
 
-std::shared_ptr<default_camera_hal::CaptureRequest>
-V4L2Camera::dequeueRequest() {
-  std::unique_lock<std::mutex> lock(request_queue_lock_);
-  while (request_queue_.empty()) {
-    requests_available_.wait(lock);
+bool V4L2Camera::enqueueRequestBuffers() {
+  // Take every request queued since the last pass (blocks this thread until
+  // there is one), so a burst costs one wakeup.
+  if (!request_queue_.PopAll(&pending_requests_)) {
+    return false;
   }
-
-  std::shared_ptr<default_camera_hal::CaptureRequest> request =
-      request_queue_.front();
-  request_queue_.pop();
-  return request;
+  for (auto& request : pending_requests_) {
+    enqueueRequestBuffer(std::move(request));
+  }
+  pending_requests_.clear();
+  return true;
 }
 
-bool V4L2Camera::enqueueRequestBuffers() {
-  // Get a request from the queue (blocks this thread until one is available).
-  std::shared_ptr<default_camera_hal::CaptureRequest> request =
-      dequeueRequest();
-
+void V4L2Camera::enqueueRequestBuffer(
+    std::shared_ptr<default_camera_hal::CaptureRequest> request) {
   // Assume request validated before being added to the queue
-  // (For now, always exactly 1 output buffer, no inputs).
+  // (Any number of output buffers, no inputs).
 
   // Setting and getting settings are best effort here,
   // since there's no way to know through V4L2 exactly what
   // settings are used for a buffer unless we were to enqueue them
   // one at a time, which would be too slow.
 
-  // Set the requested settings
-  int res = metadata_->SetRequestSettings(request->settings);
-  if (res) {
-    HAL_LOGE("Failed to set settings.");
-    completeRequest(request, res);
-    return true;
+  if (last_settings_stale_.exchange(false)) {
+    last_settings_valid_ = false;
+  }
+  // Repeating requests carry the same settings as the one before (or none,
+  // which means the same), and those are already applied.
+  bool same_settings =
+      last_settings_valid_ && SameSettings(request->settings, last_settings_);
+  int res;
+  if (!same_settings) {
+    last_settings_valid_ = false;
+    // Set the requested settings. Changed controls are applied together,
+    // with one ioctl per control class.
+    device_->BeginControlBatch();
+    res = metadata_->SetRequestSettings(request->settings);
+    int commit_res = device_->CommitControlBatch();
+    if (!res) {
+      res = commit_res;
+    }
+    if (res) {
+      HAL_LOGE("Failed to set settings.");
+      completeRequest(request, res);
+      return;
+    }
+    last_settings_ = request->settings;
   }
 
   // Replace the requested settings with a snapshot of
-  // the used settings/state immediately before enqueue.
-  res = metadata_->FillResultMetadata(&request->settings);
+  // the used settings/state immediately before enqueue. Unless the settings
+  // or the device changed controls, the cached snapshot is still current,
+  // and so is the previous result but for its live fields.
+  bool controls_changed = device_->ControlsChanged();
+  if (controls_changed) {
+    metadata_->InvalidateResultCache();
+  }
+  if (same_settings && !controls_changed) {
+    request->settings = last_result_;
+    res = metadata_->UpdateLiveResultMetadata(&request->settings);
+  } else {
+    res = metadata_->FillResultMetadata(&request->settings);
+    if (!res) {
+      last_result_ = request->settings;
+    }
+  }
   if (res) {
     // Note: since request is a shared pointer, this may happen if another
     // thread has already decided to complete the request (e.g. via flushing),
     // since that locks the metadata (in that case, this failing is fine,
     // and completeRequest will simply do nothing).
     HAL_LOGE("Failed to fill result metadata.");
+    last_settings_valid_ = false;
     completeRequest(request, res);
-    return true;
+    return;
   }
+  last_settings_valid_ = true;
 
   // Actually enqueue the buffer for capture.
   res = device_->EnqueueRequest(request);
   if (res) {
     HAL_LOGE("Device failed to enqueue buffer.");
     completeRequest(request, res);
-    return true;
+    return;
   }
 
   // Make sure the stream is on (no effect if already on).
@@ -256,13 +393,12 @@ bool V4L2Camera::enqueueRequestBuffers() {
     // Don't really want to send an error for only the request here,
     // since this is a full device error.
     // TODO: Should trigger full flush.
-    return true;
+    return;
   }
 
   std::unique_lock<std::mutex> lock(in_flight_lock_);
   in_flight_buffer_count_++;
   buffers_in_flight_.notify_one();
-  return true;
 }
 
 bool V4L2Camera::dequeueRequestBuffers() {
@@ -270,29 +406,71 @@ bool V4L2Camera::dequeueRequestBuffers() {
   std::shared_ptr<default_camera_hal::CaptureRequest> request;
   int res;
 
+  uint32_t index;
   {
     std::unique_lock<std::mutex> lock(in_flight_lock_);
-    res = device_->DequeueRequest(&request);
+    res = device_->DequeueFrame(&request, &index);
     if (!res) {
-      if (request) {
-        completeRequest(request, res);
-        in_flight_buffer_count_--;
-      }
-      return true;
+      in_flight_buffer_count_--;
     }
   }
+  if (!res) {
+    // Conversion, encoding and completion happen on the pipeline threads,
+    // so this thread can go straight back to the device.
+    res = pipeline_->Submit(request, index);
+    if (res) {
+      HAL_LOGE("Failed to submit frame to the pipeline: %d", res);
+      device_->ReleaseFrame(index);
+      completeRequest(request, res);
+    }
+    return !shutting_down_;
+  }
 
   if (res == -EAGAIN) {
     // EAGAIN just means nothing to dequeue right now.
-    // Wait until something is available before looping again.
-    std::unique_lock<std::mutex> lock(in_flight_lock_);
-    while (in_flight_buffer_count_ == 0) {
-      buffers_in_flight_.wait(lock);
+    // Wait until a buffer has been handed to the device...
+    {
+      std::unique_lock<std::mutex> lock(in_flight_lock_);
+      while (in_flight_buffer_count_ == 0) {
+        if (shutting_down_) {
+          return false;
+        }
+        buffers_in_flight_.wait(lock);
+      }
+    }
+    // ...and then until the device has filled one, instead of retrying
+    // DQBUF in a loop. Flush and shutdown interrupt this wait.
+    res = device_->WaitForBuffer(kDequeueWaitTimeoutMs);
+    if (res == 0 || res == -EINTR || res == -ETIMEDOUT) {
+      return !shutting_down_;
     }
-  } else {
-    HAL_LOGW("Device failed to dequeue buffer: %d", res);
   }
-  return true;
+
+  HAL_LOGW("Device failed to dequeue buffer: %d", res);
+  std::unique_lock<std::mutex> lock(in_flight_lock_);
+  buffers_in_flight_.wait_for(lock, kDequeueErrorBackoff);
+  return !shutting_down_;
+}
+
+void V4L2Camera::convertFrame(const CapturePipeline::Frame& frame) {
+  device_->ProcessFrame(frame.index, false);
+}
+
+void V4L2Camera::encodeFrame(const CapturePipeline::Frame& frame) {
+  for (const auto& stream_buffer : frame.request->output_buffers) {
+    if (stream_buffer.stream->format == HAL_PIXEL_FORMAT_BLOB) {
+      device_->ProcessFrame(frame.index, true);
+      return;
+    }
+  }
+}
+
+void V4L2Camera::releaseFrame(const CapturePipeline::Frame& frame) {
+  device_->ReleaseFrame(frame.index);
+}
+
+void V4L2Camera::completeFrame(const CapturePipeline::Frame& frame) {
+  completeRequest(frame.request, 0);
 }
 
 bool V4L2Camera::validateDataspacesAndRotations(
@@ -323,37 +501,21 @@ int V4L2Camera::setupStreams(camera3_stream_configuration_t* stream_config) {
   in_flight_buffer_count_ = 0;
 
   // stream_config should have been validated; assume at least 1 stream.
+  // V4L2 only captures one stream at a time, so capture at the largest
+  // configured size and derive every other stream from that frame, cropped
+  // to its aspect ratio (see V4L2Wrapper::ProcessFrame).
   camera3_stream_t* stream = stream_config->streams[0];
+  for (uint32_t i = 1; i < stream_config->num_streams; ++i) {
+    camera3_stream_t* candidate = stream_config->streams[i];
+    if (static_cast<uint64_t>(candidate->width) * candidate->height >
+        static_cast<uint64_t>(stream->width) * stream->height) {
+      stream = candidate;
+    }
+  }
   int format = stream->format;
   uint32_t width = stream->width;
   uint32_t height = stream->height;
 
-  if (stream_config->num_streams > 1) {
-    // TODO(b/29939583):  V4L2 doesn't actually support more than 1
-    // stream at a time. If not all streams are the same format
-    // and size, error. Note that this means the HAL is not spec-compliant.
-    // Technically, this error should be thrown during validation, but
-    // since it isn't a spec-valid error validation isn't set up to check it.
-    for (uint32_t i = 1; i < stream_config->num_streams; ++i) {
-      stream = stream_config->streams[i];
-      if (stream->format != format || stream->width != width ||
-          stream->height != height) {
-        HAL_LOGE(
-            "V4L2 only supports 1 stream configuration at a time "
-            "(stream 0 is format %d, width %u, height %u, "
-            "stream %d is format %d, width %u, height %u).",
-            format,
-            width,
-            height,
-            i,
-            stream->format,
-            stream->width,
-            stream->height);
-        return -EINVAL;
-      }
-    }
-  }
-
   // Ensure the stream is off.
   int res = device_->StreamOff();
   if (res) {
@@ -363,7 +525,8 @@ int V4L2Camera::setupStreams(camera3_stream_configuration_t* stream_config) {
 
   StreamFormat stream_format(format, width, height);
   uint32_t max_buffers = 0;
-  res = device_->SetFormat(stream_format, &max_buffers);
+  res = device_->SetFormat(
+      stream_format, stream_config->num_streams == 1, &max_buffers);
   if (res) {
     HAL_LOGE("Failed to set device to correct format for stream: %d.", res);
     return -ENODEV;
@@ -388,17 +551,20 @@ int V4L2Camera::setupStreams(camera3_stream_configuration_t* stream_config) {
     // Max buffers as reported by the device.
     stream->max_buffers = max_buffers;
 
-    // Usage: currently using sw graphics.
+    // Usage: currently using sw graphics, unless the device captures
+    // straight into the output buffers.
     switch (stream->stream_type) {
       case CAMERA3_STREAM_INPUT:
         stream->usage = GRALLOC_USAGE_SW_READ_OFTEN;
         break;
       case CAMERA3_STREAM_OUTPUT:
-        stream->usage = GRALLOC_USAGE_SW_WRITE_OFTEN;
+        stream->usage =
+            GRALLOC_USAGE_SW_WRITE_OFTEN | device_->GetOutputBufferUsage();
         break;
       case CAMERA3_STREAM_BIDIRECTIONAL:
-        stream->usage =
-            GRALLOC_USAGE_SW_READ_OFTEN | GRALLOC_USAGE_SW_WRITE_OFTEN;
+        stream->usage = GRALLOC_USAGE_SW_READ_OFTEN |
+                        GRALLOC_USAGE_SW_WRITE_OFTEN |
+                        device_->GetOutputBufferUsage();
         break;
       default:
         // nothing to do.
@@ -412,6 +578,10 @@ int V4L2Camera::setupStreams(camera3_stream_configuration_t* stream_config) {
     stream->data_space = HAL_DATASPACE_V0_JFIF;
   }
 
+  // Results are sized afresh for the new configuration.
+  metadata_->ResetResultCache();
+  last_settings_stale_ = true;
+
   return 0;
 }
 
@@ -20,16 +20,19 @@
 #define V4L2_CAMERA_HAL_V4L2_CAMERA_H_
 
 #include <array>
+#include <atomic>
 #include <condition_variable>
-#include <queue>
 #include <string>
+#include <vector>
 
 #include <camera/CameraMetadata.h>
 #include <utils/StrongPointer.h>
 #include <utils/Thread.h>
 #include "camera.h"
+#include "capture_pipeline.h"
 #include "common.h"
 #include "metadata/metadata.h"
+#include "request_queue.h"
 #include "v4l2_wrapper.h"
 
 namespace v4l2_camera_hal {
@@ -77,11 +80,14 @@ class V4L2Camera : public default_camera_hal::Camera {
       std::shared_ptr<default_camera_hal::CaptureRequest> request) override;
   // Flush in flight buffers.
   int flushBuffers() override;
+  // Dump pipeline statistics.
+  void dumpDevice(int fd) override;
 
   // Async request processing helpers.
-  // Dequeue a request from the waiting queue.
-  // Blocks until a request is available.
-  std::shared_ptr<default_camera_hal::CaptureRequest> dequeueRequest();
+  // Apply the settings of |request|, fill in its result metadata and pass
+  // its buffers to the device.
+  void enqueueRequestBuffer(
+      std::shared_ptr<default_camera_hal::CaptureRequest> request);
 
   // Thread functions. Return true to loop, false to exit.
   // Pass buffers for enqueued requests to the device.
@@ -89,20 +95,43 @@ class V4L2Camera : public default_camera_hal::Camera {
   // Retreive buffers from the device.
   bool dequeueRequestBuffers();
 
+  // Pipeline stages for dequeued frames.
+  // Convert the frame for the non-BLOB outputs.
+  void convertFrame(const CapturePipeline::Frame& frame);
+  // Encode the frame for the BLOB outputs, if any.
+  void encodeFrame(const CapturePipeline::Frame& frame);
+  // Return the device buffer.
+  void releaseFrame(const CapturePipeline::Frame& frame);
+  // Send the result to the framework.
+  void completeFrame(const CapturePipeline::Frame& frame);
+
   // V4L2 helper.
   std::shared_ptr<V4L2Wrapper> device_;
   std::unique_ptr<V4L2Wrapper::Connection> connection_;
   std::unique_ptr<Metadata> metadata_;
-  std::mutex request_queue_lock_;
-  std::queue<std::shared_ptr<default_camera_hal::CaptureRequest>>
-      request_queue_;
+  // Requests waiting for the enqueue thread.
+  RequestQueue request_queue_;
+  // Enqueue thread only: the requests taken from |request_queue_| in one
+  // pass, and what the last enqueued request applied and got as a result,
+  // so repeated settings aren't applied and snapshotted again.
+  std::vector<std::shared_ptr<default_camera_hal::CaptureRequest>>
+      pending_requests_;
+  bool last_settings_valid_;
+  android::CameraMetadata last_settings_;
+  android::CameraMetadata last_result_;
+  // Set when the device or metadata state behind |last_result_| may have
+  // changed (configure, flush, reconnect).
+  std::atomic<bool> last_settings_stale_;
   std::mutex in_flight_lock_;
   uint32_t in_flight_buffer_count_;
   // Threads require holding an Android strong pointer.
   android::sp<android::Thread> buffer_enqueuer_;
   android::sp<android::Thread> buffer_dequeuer_;
-  std::condition_variable requests_available_;
+  // Paints and returns dequeued frames off the dequeue thread.
+  std::unique_ptr<CapturePipeline> pipeline_;
   std::condition_variable buffers_in_flight_;
+  // Set on destruction to stop the enqueue/dequeue threads.
+  std::atomic<bool> shutting_down_;
 
   int32_t max_input_streams_;
   std::array<int, 3> max_output_streams_;  // {raw, non-stalling, stalling}.
@@ -0,0 +1,350 @@
+/*
+ * Copyright 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the CPU cost of waiting for V4L2 capture buffers. Streams from a
+// capture device (e.g. the vivid virtual driver) at a fixed frame rate and
+// reports the CPU time burned per second of wall time, either spinning on
+// VIDIOC_DQBUF against a non-blocking fd (the old dequeue loop) or sleeping
+// in poll() until a buffer is ready (what V4L2Wrapper::WaitForBuffer does).
+//
+// Each dequeued frame is handed to an output buffer the way V4L2Wrapper does
+// for the selected memory type, and the per-frame latency (capture timestamp
+// to hand-off) and bytes moved by the CPU are reported:
+//   userptr:  clear the HAL buffer on enqueue, memcpy it out on dequeue.
+//   mmap:     memcpy straight out of the driver's buffer.
+//   zerocopy: no copy, as when the output buffer is imported via DMABUF.
+//
+// Usage: v4l2_dequeue_benchmark [device] [fps] [seconds] [spin|poll|both]
+//                               [userptr|mmap|zerocopy|all]
+//   e.g. modprobe vivid && v4l2_dequeue_benchmark /dev/video0 60 10 poll all
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int kBufferCount = 4;
+
+enum MemoryMode { kUserptr, kMmap, kZeroCopy };
+
+const char* MemoryModeName(MemoryMode mode) {
+  switch (mode) {
+    case kUserptr:
+      return "userptr";
+    case kMmap:
+      return "mmap";
+    default:
+      return "zerocopy";
+  }
+}
+
+struct MappedBuffer {
+  void* address;
+  size_t length;
+  bool owned;  // Allocated here (USERPTR) rather than mmap'ed.
+};
+
+int xioctl(int fd, unsigned long request, void* arg) {
+  return TEMP_FAILURE_RETRY(ioctl(fd, request, arg));
+}
+
+double MonotonicSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double CpuSeconds() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+         usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+bool SetFrameRate(int fd, int fps) {
+  struct v4l2_streamparm parm;
+  memset(&parm, 0, sizeof(parm));
+  parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if (xioctl(fd, VIDIOC_G_PARM, &parm) < 0) {
+    fprintf(stderr, "VIDIOC_G_PARM: %s\n", strerror(errno));
+    return false;
+  }
+  if (!(parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME)) {
+    fprintf(stderr, "Device does not support setting the frame rate\n");
+    return false;
+  }
+  parm.parm.capture.timeperframe.numerator = 1;
+  parm.parm.capture.timeperframe.denominator = fps;
+  if (xioctl(fd, VIDIOC_S_PARM, &parm) < 0) {
+    fprintf(stderr, "VIDIOC_S_PARM: %s\n", strerror(errno));
+    return false;
+  }
+  const v4l2_fract& tpf = parm.parm.capture.timeperframe;
+  if (tpf.numerator == 0 || tpf.denominator / tpf.numerator != (unsigned)fps) {
+    fprintf(stderr, "Driver picked %u/%u s per frame instead of 1/%d\n",
+            tpf.numerator, tpf.denominator, fps);
+  }
+  return true;
+}
+
+uint32_t MemoryType(MemoryMode mode) {
+  return mode == kUserptr ? V4L2_MEMORY_USERPTR : V4L2_MEMORY_MMAP;
+}
+
+bool QueueBuffer(int fd, MemoryMode mode, struct v4l2_buffer* buffer,
+                 const MappedBuffer& mapped) {
+  if (mode == kUserptr) {
+    // V4L2Wrapper used to zero the whole buffer before every QBUF.
+    memset(mapped.address, 0, mapped.length);
+    buffer->m.userptr = reinterpret_cast<unsigned long>(mapped.address);
+    buffer->length = mapped.length;
+  }
+  return xioctl(fd, VIDIOC_QBUF, buffer) == 0;
+}
+
+bool StartStreaming(int fd, MemoryMode mode,
+                    std::vector<MappedBuffer>* buffers) {
+  struct v4l2_format format;
+  memset(&format, 0, sizeof(format));
+  format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if (xioctl(fd, VIDIOC_G_FMT, &format) < 0) {
+    fprintf(stderr, "VIDIOC_G_FMT: %s\n", strerror(errno));
+    return false;
+  }
+
+  struct v4l2_requestbuffers req;
+  memset(&req, 0, sizeof(req));
+  req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  req.memory = MemoryType(mode);
+  req.count = kBufferCount;
+  if (xioctl(fd, VIDIOC_REQBUFS, &req) < 0 || req.count == 0) {
+    fprintf(stderr, "VIDIOC_REQBUFS: %s\n", strerror(errno));
+    return false;
+  }
+
+  for (uint32_t i = 0; i < req.count; ++i) {
+    struct v4l2_buffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory = MemoryType(mode);
+    buffer.index = i;
+    if (xioctl(fd, VIDIOC_QUERYBUF, &buffer) < 0) {
+      fprintf(stderr, "VIDIOC_QUERYBUF: %s\n", strerror(errno));
+      return false;
+    }
+    MappedBuffer mapped;
+    if (mode == kUserptr) {
+      mapped.length = format.fmt.pix.sizeimage;
+      mapped.owned = true;
+      if (posix_memalign(&mapped.address, getpagesize(), mapped.length)) {
+        fprintf(stderr, "posix_memalign failed\n");
+        return false;
+      }
+    } else {
+      mapped.length = buffer.length;
+      mapped.owned = false;
+      mapped.address = mmap(nullptr, buffer.length, PROT_READ, MAP_SHARED, fd,
+                            buffer.m.offset);
+      if (mapped.address == MAP_FAILED) {
+        fprintf(stderr, "mmap: %s\n", strerror(errno));
+        return false;
+      }
+    }
+    buffers->push_back(mapped);
+    if (!QueueBuffer(fd, mode, &buffer, mapped)) {
+      fprintf(stderr, "VIDIOC_QBUF: %s\n", strerror(errno));
+      return false;
+    }
+  }
+
+  int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if (xioctl(fd, VIDIOC_STREAMON, &type) < 0) {
+    fprintf(stderr, "VIDIOC_STREAMON: %s\n", strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+void StopStreaming(int fd, MemoryMode mode,
+                   std::vector<MappedBuffer>* buffers) {
+  int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  xioctl(fd, VIDIOC_STREAMOFF, &type);
+  for (const auto& buffer : *buffers) {
+    if (buffer.owned) {
+      free(buffer.address);
+    } else {
+      munmap(buffer.address, buffer.length);
+    }
+  }
+  buffers->clear();
+
+  struct v4l2_requestbuffers req;
+  memset(&req, 0, sizeof(req));
+  req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  req.memory = MemoryType(mode);
+  req.count = 0;
+  xioctl(fd, VIDIOC_REQBUFS, &req);
+}
+
+// Runs one capture session. Returns false on a setup or streaming error.
+bool Run(const std::string& device, int fps, int seconds, bool use_poll,
+         MemoryMode mode) {
+  int fd = TEMP_FAILURE_RETRY(open(device.c_str(), O_RDWR | O_NONBLOCK));
+  if (fd < 0) {
+    fprintf(stderr, "open %s: %s\n", device.c_str(), strerror(errno));
+    return false;
+  }
+
+  std::vector<MappedBuffer> buffers;
+  if (!SetFrameRate(fd, fps) || !StartStreaming(fd, mode, &buffers)) {
+    StopStreaming(fd, mode, &buffers);
+    close(fd);
+    return false;
+  }
+  // Stands in for the gralloc output buffer.
+  std::vector<uint8_t> output(buffers[0].length);
+
+  bool ok = true;
+  uint64_t frames = 0;
+  uint64_t dqbuf_calls = 0;
+  uint64_t bytes_moved = 0;
+  double latency_sum = 0;
+  double latency_max = 0;
+  double wall_start = MonotonicSeconds();
+  double cpu_start = CpuSeconds();
+  double deadline = wall_start + seconds;
+  while (MonotonicSeconds() < deadline) {
+    if (use_poll) {
+      struct pollfd pfd;
+      memset(&pfd, 0, sizeof(pfd));
+      pfd.fd = fd;
+      pfd.events = POLLIN;
+      int res = TEMP_FAILURE_RETRY(poll(&pfd, 1, 1000));
+      if (res < 0 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+        fprintf(stderr, "poll: %s\n", res < 0 ? strerror(errno) : "error");
+        ok = false;
+        break;
+      }
+      if (res == 0) {
+        continue;
+      }
+    }
+
+    struct v4l2_buffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory = MemoryType(mode);
+    ++dqbuf_calls;
+    if (xioctl(fd, VIDIOC_DQBUF, &buffer) < 0) {
+      if (errno == EAGAIN) {
+        continue;
+      }
+      fprintf(stderr, "VIDIOC_DQBUF: %s\n", strerror(errno));
+      ok = false;
+      break;
+    }
+    ++frames;
+
+    const MappedBuffer& mapped = buffers[buffer.index];
+    if (mode != kZeroCopy) {
+      size_t size = buffer.bytesused ? buffer.bytesused : mapped.length;
+      size = std::min(size, output.size());
+      memcpy(output.data(), mapped.address, size);
+      bytes_moved += size;
+    }
+    // Capture timestamps are CLOCK_MONOTONIC on current drivers.
+    double latency = MonotonicSeconds() - (buffer.timestamp.tv_sec +
+                                           buffer.timestamp.tv_usec / 1e6);
+    latency_sum += latency;
+    latency_max = std::max(latency_max, latency);
+
+    if (!QueueBuffer(fd, mode, &buffer, mapped)) {
+      fprintf(stderr, "VIDIOC_QBUF: %s\n", strerror(errno));
+      ok = false;
+      break;
+    }
+    if (mode == kUserptr) {
+      bytes_moved += mapped.length;
+    }
+  }
+  double wall = MonotonicSeconds() - wall_start;
+  double cpu = CpuSeconds() - cpu_start;
+
+  StopStreaming(fd, mode, &buffers);
+  close(fd);
+
+  printf("%-4s %-8s %3d fps: %6llu frames in %5.2f s (%6.2f fps), "
+         "%10llu DQBUF calls, cpu %6.3f s = %5.1f%% of one core, "
+         "latency avg %6.2f ms max %6.2f ms, cpu traffic %7.1f MB/s\n",
+         use_poll ? "poll" : "spin", MemoryModeName(mode), fps,
+         (unsigned long long)frames, wall, frames / wall,
+         (unsigned long long)dqbuf_calls, cpu, 100.0 * cpu / wall,
+         frames ? 1000.0 * latency_sum / frames : 0.0, 1000.0 * latency_max,
+         bytes_moved / wall / (1 << 20));
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string device = argc > 1 ? argv[1] : "/dev/video0";
+  int fps = argc > 2 ? atoi(argv[2]) : 30;
+  int seconds = argc > 3 ? atoi(argv[3]) : 10;
+  std::string mode = argc > 4 ? argv[4] : "both";
+  std::string memory = argc > 5 ? argv[5] : "userptr";
+  if (fps <= 0 || seconds <= 0 ||
+      (mode != "spin" && mode != "poll" && mode != "both") ||
+      (memory != "userptr" && memory != "mmap" && memory != "zerocopy" &&
+       memory != "all")) {
+    fprintf(stderr,
+            "Usage: %s [device] [fps] [seconds] [spin|poll|both] "
+            "[userptr|mmap|zerocopy|all]\n",
+            argv[0]);
+    return 1;
+  }
+
+  std::vector<MemoryMode> memory_modes;
+  for (MemoryMode m : {kUserptr, kMmap, kZeroCopy}) {
+    if (memory == "all" || memory == MemoryModeName(m)) {
+      memory_modes.push_back(m);
+    }
+  }
+
+  bool ok = true;
+  for (MemoryMode m : memory_modes) {
+    if (mode != "poll") {
+      ok = Run(device, fps, seconds, false, m) && ok;
+    }
+    if (mode != "spin") {
+      ok = Run(device, fps, seconds, true, m) && ok;
+    }
+  }
+  return ok ? 0 : 1;
+}
@@ -37,8 +37,6 @@ const camera_metadata_rational_t kAeCompensationUnit = {1, 1000};
 const int64_t kV4L2ExposureTimeStepNs = 100000;
 // According to spec, each unit of V4L2_CID_ISO_SENSITIVITY is ISO/1000.
 const int32_t kV4L2SensitivityDenominator = 1000;
-// Generously allow up to 6MB (the largest size on the RPi Camera is about 5MB).
-const size_t kV4L2MaxJpegSize = 6000000;
 
 int GetV4L2Metadata(std::shared_ptr<V4L2Wrapper> device,
                     std::unique_ptr<Metadata>* result) {
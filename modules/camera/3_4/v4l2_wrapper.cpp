@@ -21,13 +21,21 @@
 
 #include <algorithm>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits>
+#include <stdio.h>
 
 #include <android-base/unique_fd.h>
+#include <hardware/camera3.h>
+#include <hardware/gralloc.h>
 #include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 #include "arc/cached_frame.h"
+#include "arc/common.h"
 
 namespace v4l2_camera_hal {
 
@@ -50,12 +58,36 @@ const int32_t kStandardSizes[][2] = {
   { 176,  144}  // QCIF
 };
 
+// Gralloc usage of output buffers the device captures into directly.
+static const uint32_t kDirectOutputUsage =
+    GRALLOC_USAGE_SW_WRITE_OFTEN | GRALLOC_USAGE_HW_CAMERA_WRITE;
+
+// Where capability cache files are kept. The HAL needs to be able to
+// write there; if it can't, devices are enumerated on every open.
+static std::mutex g_capability_cache_dir_lock;
+static std::string g_capability_cache_dir = "/data/vendor/camera";
+
 V4L2Wrapper* V4L2Wrapper::NewV4L2Wrapper(const std::string device_path) {
   return new V4L2Wrapper(device_path);
 }
 
+void V4L2Wrapper::SetCapabilityCacheDir(const std::string& dir) {
+  std::lock_guard<std::mutex> lock(g_capability_cache_dir_lock);
+  g_capability_cache_dir = dir;
+}
+
 V4L2Wrapper::V4L2Wrapper(const std::string device_path)
-    : device_path_(std::move(device_path)), connection_count_(0) {}
+    : device_path_(std::move(device_path)),
+      wake_fd_(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)),
+      memory_(V4L2_MEMORY_USERPTR),
+      connection_count_(0),
+      control_batch_open_(false),
+      unwatched_controls_(false),
+      control_stats_() {
+  if (wake_fd_.get() < 0) {
+    HAL_LOGE("Failed to create wake eventfd: %s", strerror(errno));
+  }
+}
 
 V4L2Wrapper::~V4L2Wrapper() {}
 
@@ -83,6 +115,24 @@ int V4L2Wrapper::Connect() {
   query.id = V4L2_CTRL_FLAG_NEXT_CTRL | V4L2_CTRL_FLAG_NEXT_COMPOUND;
   extended_query_supported_ = (IoctlLocked(VIDIOC_QUERY_EXT_CTRL, &query) == 0);
 
+  // Reuse the enumeration results of an earlier open if they were made by
+  // the same device and driver version.
+  v4l2_capability cap;
+  memset(&cap, 0, sizeof(cap));
+  if (IoctlLocked(VIDIOC_QUERYCAP, &cap) == 0) {
+    std::string dir;
+    {
+      std::lock_guard<std::mutex> dir_lock(g_capability_cache_dir_lock);
+      dir = g_capability_cache_dir;
+    }
+    capabilities_.Load(
+        dir.empty() ? dir : dir + "/" + CapabilityCache::FileName(cap),
+        CapabilityCache::DeviceKey(cap));
+  } else {
+    HAL_LOGE("QUERYCAP fails: %s", strerror(errno));
+    capabilities_.Load("", "");
+  }
+
   // TODO(b/29185945): confirm this is a supported device.
   // This is checked by the HAL, but the device at device_path_ may
   // not be the same one that was there when the HAL was loaded.
@@ -114,11 +164,23 @@ void V4L2Wrapper::Disconnect() {
     return;
   }
 
+  // Don't leave a dequeue thread polling a closed fd.
+  InterruptWait();
   device_fd_.reset(-1);  // Includes close().
   format_.reset();
+  capabilities_.Save();
+  {
+    // Controls may be reset by the time the device is opened again.
+    std::lock_guard<std::mutex> control_lock(control_lock_);
+    pending_controls_.clear();
+    applied_controls_.clear();
+    watched_controls_.clear();
+    unwatched_controls_ = false;
+  }
   {
     std::lock_guard<std::mutex> buffer_lock(buffer_queue_lock_);
     buffers_.clear();
+    cached_frames_.clear();
   }
 }
 
@@ -168,8 +230,11 @@ int V4L2Wrapper::StreamOff() {
   }
   std::lock_guard<std::mutex> lock(buffer_queue_lock_);
   for (auto& buffer : buffers_) {
-    buffer.active = false;
-    buffer.request.reset();
+    // Dequeued frames stay with their caller until ReleaseFrame.
+    if (buffer.active) {
+      buffer.active = false;
+      buffer.request.reset();
+    }
   }
   HAL_LOGV("Stream turned off.");
   return 0;
@@ -236,6 +301,14 @@ int V4L2Wrapper::QueryControl(uint32_t control_id,
 }
 
 int V4L2Wrapper::GetControl(uint32_t control_id, int32_t* value) {
+  {
+    // Subscribe before reading, so no change goes unnoticed.
+    std::lock_guard<std::mutex> guard(control_lock_);
+    if (watched_controls_.find(control_id) == watched_controls_.end()) {
+      WatchControl(control_id);
+    }
+  }
+
   // For extended controls (any control class other than "user"),
   // G_EXT_CTRL must be used instead of G_CTRL.
   if (V4L2_CTRL_ID2CLASS(control_id) != V4L2_CTRL_CLASS_USER) {
@@ -262,12 +335,192 @@ int V4L2Wrapper::GetControl(uint32_t control_id, int32_t* value) {
     }
     *value = control.value;
   }
+
+  // The driver may have changed the value on its own (e.g. exposure under
+  // auto exposure), so don't skip setting it back.
+  std::lock_guard<std::mutex> guard(control_lock_);
+  auto applied = applied_controls_.find(control_id);
+  if (applied != applied_controls_.end()) {
+    applied->second = *value;
+  }
   return 0;
 }
 
 int V4L2Wrapper::SetControl(uint32_t control_id,
                             int32_t desired,
                             int32_t* result) {
+  std::lock_guard<std::mutex> guard(control_lock_);
+  auto applied = applied_controls_.find(control_id);
+  if (applied != applied_controls_.end() && applied->second == desired) {
+    pending_controls_.erase(control_id);
+    ++control_stats_.controls_skipped;
+    if (result != nullptr) {
+      *result = desired;
+    }
+    return 0;
+  }
+
+  if (control_batch_open_) {
+    pending_controls_[control_id] = desired;
+    if (result != nullptr) {
+      *result = desired;
+    }
+    return 0;
+  }
+
+  ++control_stats_.ioctls;
+  int res = ApplyControl(control_id, desired, result);
+  if (res) {
+    applied_controls_.erase(control_id);
+    return res;
+  }
+  ++control_stats_.controls_set;
+  applied_controls_[control_id] = desired;
+  return 0;
+}
+
+void V4L2Wrapper::WatchControl(uint32_t control_id) {
+  watched_controls_.insert(control_id);
+
+  // Volatile controls change without sending events.
+  v4l2_query_ext_ctrl query;
+  bool is_volatile = QueryControl(control_id, &query) == 0 &&
+                     (query.flags & V4L2_CTRL_FLAG_VOLATILE);
+  // Without V4L2_EVENT_SUB_FL_ALLOW_FEEDBACK, setting the control through
+  // this fd doesn't send an event; SetRequestSettings covers those changes.
+  v4l2_event_subscription subscription;
+  memset(&subscription, 0, sizeof(subscription));
+  subscription.type = V4L2_EVENT_CTRL;
+  subscription.id = control_id;
+  if (is_volatile || IoctlLocked(VIDIOC_SUBSCRIBE_EVENT, &subscription) < 0) {
+    HAL_LOGV("Control %u changes can't be watched; reading it every frame.",
+             control_id);
+    unwatched_controls_ = true;
+  }
+}
+
+bool V4L2Wrapper::ControlsChanged() {
+  std::lock_guard<std::mutex> guard(control_lock_);
+  if (watched_controls_.empty()) {
+    return false;
+  }
+
+  bool changed = unwatched_controls_;
+  v4l2_event event;
+  // Fails with ENOENT once no events are pending.
+  while (IoctlLocked(VIDIOC_DQEVENT, &event) == 0) {
+    if (event.type == V4L2_EVENT_CTRL) {
+      // Don't skip setting it back to the last value the HAL applied.
+      applied_controls_.erase(event.id);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+void V4L2Wrapper::BeginControlBatch() {
+  std::lock_guard<std::mutex> guard(control_lock_);
+  control_batch_open_ = true;
+}
+
+int V4L2Wrapper::CommitControlBatch() {
+  std::lock_guard<std::mutex> guard(control_lock_);
+  control_batch_open_ = false;
+  uint64_t ioctls_before = control_stats_.ioctls;
+
+  std::vector<v4l2_ext_control> controls;
+  controls.reserve(pending_controls_.size());
+  for (const auto& pending : pending_controls_) {
+    v4l2_ext_control control;
+    memset(&control, 0, sizeof(control));
+    control.id = pending.first;
+    control.value = pending.second;
+    controls.push_back(control);
+  }
+  pending_controls_.clear();
+
+  int res = 0;
+  for (size_t begin = 0; begin < controls.size();) {
+    uint32_t control_class = V4L2_CTRL_ID2CLASS(controls[begin].id);
+    size_t end = begin + 1;
+    while (end < controls.size() &&
+           V4L2_CTRL_ID2CLASS(controls[end].id) == control_class) {
+      ++end;
+    }
+    int class_res =
+        ApplyControlClass(control_class, &controls[begin], end - begin);
+    if (class_res) {
+      res = class_res;
+    }
+    begin = end;
+  }
+
+  uint32_t batch_ioctls = control_stats_.ioctls - ioctls_before;
+  ++control_stats_.batches;
+  control_stats_.batch_ioctls += batch_ioctls;
+  control_stats_.last_batch_ioctls = batch_ioctls;
+  control_stats_.max_batch_ioctls =
+      std::max(control_stats_.max_batch_ioctls, batch_ioctls);
+  return res;
+}
+
+int V4L2Wrapper::ApplyControlClass(uint32_t control_class,
+                                   v4l2_ext_control* controls,
+                                   uint32_t count) {
+  v4l2_ext_controls ext_controls;
+  memset(&ext_controls, 0, sizeof(ext_controls));
+  ext_controls.ctrl_class = control_class;
+  ext_controls.count = count;
+  ext_controls.controls = controls;
+
+  ++control_stats_.ioctls;
+  if (IoctlLocked(VIDIOC_S_EXT_CTRLS, &ext_controls) == 0) {
+    control_stats_.controls_set += count;
+    for (uint32_t i = 0; i < count; ++i) {
+      applied_controls_[controls[i].id] = controls[i].value;
+    }
+    return 0;
+  }
+
+  // Older drivers don't take user class controls through S_EXT_CTRLS, and
+  // a single bad control fails the whole call; retry them one at a time so
+  // the others still get set.
+  HAL_LOGV("S_EXT_CTRLS of %u controls in class 0x%x fails (%s), retrying "
+           "one at a time.",
+           count, control_class, strerror(errno));
+  int res = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    ++control_stats_.ioctls;
+    int control_res = ApplyControl(controls[i].id, controls[i].value, nullptr);
+    if (control_res) {
+      applied_controls_.erase(controls[i].id);
+      res = control_res;
+    } else {
+      ++control_stats_.controls_set;
+      applied_controls_[controls[i].id] = controls[i].value;
+    }
+  }
+  return res;
+}
+
+void V4L2Wrapper::DumpControlStats(int fd) {
+  std::lock_guard<std::mutex> guard(control_lock_);
+  dprintf(fd,
+          "Controls: %" PRIu64 " ioctls, %" PRIu64
+          " request batches (%.2f ioctls per batch, last %u, max %u), %" PRIu64
+          " set, %" PRIu64 " unchanged and skipped\n",
+          control_stats_.ioctls, control_stats_.batches,
+          control_stats_.batches
+              ? static_cast<double>(control_stats_.batch_ioctls) /
+                    control_stats_.batches
+              : 0.0,
+          control_stats_.last_batch_ioctls, control_stats_.max_batch_ioctls,
+          control_stats_.controls_set, control_stats_.controls_skipped);
+}
+
+int V4L2Wrapper::ApplyControl(uint32_t control_id,
+                              int32_t desired,
+                              int32_t* result) {
   int32_t result_value = 0;
 
   // TODO(b/29334616): When async, this may need to check if the stream
@@ -341,13 +594,17 @@ const SupportedFormats V4L2Wrapper::GetSupportedFormats() {
 
 int V4L2Wrapper::GetFormats(std::set<uint32_t>* v4l2_formats) {
   HAL_LOG_ENTER();
+  if (capabilities_.GetFormats(v4l2_formats)) {
+    return 0;
+  }
 
+  std::set<uint32_t> formats;
   v4l2_fmtdesc format_query;
   memset(&format_query, 0, sizeof(format_query));
   // TODO(b/30000211): multiplanar support.
   format_query.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
   while (IoctlLocked(VIDIOC_ENUM_FMT, &format_query) >= 0) {
-    v4l2_formats->insert(format_query.pixelformat);
+    formats.insert(format_query.pixelformat);
     ++format_query.index;
   }
 
@@ -356,6 +613,8 @@ int V4L2Wrapper::GetFormats(std::set<uint32_t>* v4l2_formats) {
         "ENUM_FMT fails at index %d: %s", format_query.index, strerror(errno));
     return -ENODEV;
   }
+  capabilities_.SetFormats(formats);
+  v4l2_formats->insert(formats.begin(), formats.end());
   return 0;
 }
 
@@ -377,6 +636,21 @@ int V4L2Wrapper::GetQualifiedFormats(std::vector<uint32_t>* v4l2_formats) {
 
 int V4L2Wrapper::GetFormatFrameSizes(uint32_t v4l2_format,
                                      std::set<std::array<int32_t, 2>>* sizes) {
+  if (capabilities_.GetFrameSizes(v4l2_format, sizes)) {
+    return 0;
+  }
+  std::set<std::array<int32_t, 2>> found_sizes;
+  int res = EnumerateFrameSizes(v4l2_format, &found_sizes);
+  if (res) {
+    return res;
+  }
+  capabilities_.SetFrameSizes(v4l2_format, found_sizes);
+  sizes->insert(found_sizes.begin(), found_sizes.end());
+  return 0;
+}
+
+int V4L2Wrapper::EnumerateFrameSizes(uint32_t v4l2_format,
+                                     std::set<std::array<int32_t, 2>>* sizes) {
   v4l2_frmsizeenum size_query;
   memset(&size_query, 0, sizeof(size_query));
   size_query.pixel_format = v4l2_format;
@@ -452,6 +726,10 @@ int V4L2Wrapper::GetFormatFrameDurationRange(
     const std::array<int32_t, 2>& size,
     std::array<int64_t, 2>* duration_range) {
   // Potentially called so many times logging entry is a bad idea.
+  if (capabilities_.GetFrameDurationRange(v4l2_format, size,
+                                          duration_range)) {
+    return 0;
+  }
 
   v4l2_frmivalenum duration_query;
   memset(&duration_query, 0, sizeof(duration_query));
@@ -485,14 +763,17 @@ int V4L2Wrapper::GetFormatFrameDurationRange(
   }
   (*duration_range)[0] = min;
   (*duration_range)[1] = max;
+  capabilities_.SetFrameDurationRange(v4l2_format, size, *duration_range);
   return 0;
 }
 
 int V4L2Wrapper::SetFormat(const StreamFormat& desired_format,
+                           bool allow_direct_output,
                            uint32_t* result_max_buffers) {
   HAL_LOG_ENTER();
 
-  if (format_ && desired_format == *format_) {
+  if (format_ && desired_format == *format_ &&
+      (allow_direct_output || memory_ != V4L2_MEMORY_DMABUF)) {
     HAL_LOGV("Already in correct format, skipping format setting.");
     *result_max_buffers = buffers_.size();
     return 0;
@@ -544,9 +825,24 @@ int V4L2Wrapper::SetFormat(const StreamFormat& desired_format,
 
   // Keep track of our new format.
   format_.reset(new StreamFormat(new_format));
+  {
+    std::lock_guard<std::mutex> guard(buffer_queue_lock_);
+    cached_frames_.clear();
+  }
 
-  // Format changed, request new buffers.
-  int res = RequestBuffers(1);
+  // Frames can go straight to the framework when the device produces exactly
+  // what the stream asked for. Compressed frames still need a JPEG blob.
+  bool direct_output =
+      allow_direct_output &&
+      format_->v4l2_pixel_format() == desired_format.v4l2_pixel_format() &&
+      format_->width() == desired_format.width() &&
+      format_->height() == desired_format.height() &&
+      format_->Category() == kFormatCategoryNonStalling;
+
+  // Format changed, request new buffers. Capturing into the output buffers
+  // only works if gralloc lays them out exactly like the device's frames.
+  int res = NegotiateMemory(
+      direct_output && CanImportOutputBuffers(new_format.fmt.pix.sizeimage));
   if (res) {
     HAL_LOGE("Requesting buffers for new format failed.");
     return res;
@@ -555,16 +851,169 @@ int V4L2Wrapper::SetFormat(const StreamFormat& desired_format,
   return 0;
 }
 
+int V4L2Wrapper::NegotiateMemory(bool direct_output) {
+  std::vector<uint32_t> candidates;
+  if (direct_output) {
+    candidates.push_back(V4L2_MEMORY_DMABUF);
+  }
+  candidates.push_back(V4L2_MEMORY_MMAP);
+  candidates.push_back(V4L2_MEMORY_USERPTR);
+
+  for (uint32_t memory : candidates) {
+    memory_ = memory;
+    int res = RequestBuffers(1);
+    if (res == -EINVAL) {
+      // Memory type not supported by the driver, try the next one.
+      continue;
+    } else if (res) {
+      return res;
+    }
+    if (memory_ == V4L2_MEMORY_MMAP && MapBuffers()) {
+      HAL_LOGW("Failed to map MMAP buffers, falling back.");
+      res = RequestBuffers(0);
+      if (res) {
+        HAL_LOGE("Failed to release MMAP buffers: %d", res);
+        return res;
+      }
+      continue;
+    }
+    HAL_LOGV("Using memory type %u with %zu buffers.", memory_,
+             buffers_.size());
+    return 0;
+  }
+  HAL_LOGE("Device supports none of the buffer memory types.");
+  return -ENODEV;
+}
+
+// Whether |fd| is a buffer of at least |length| bytes. dma-bufs report their
+// size through lseek.
+static bool FdHolds(int fd, uint32_t length) {
+  off_t size = lseek(fd, 0, SEEK_END);
+  lseek(fd, 0, SEEK_SET);
+  return size >= 0 && static_cast<uint64_t>(size) >= length;
+}
+
+// Whether the 4:2:0 planes gralloc reports in |layout| are where the device
+// writes them for |v4l2_pixel_format| with |bytes_per_line| and |height|.
+static bool MatchesDeviceLayout(const android_ycbcr& layout,
+                                uint32_t v4l2_pixel_format,
+                                uint32_t bytes_per_line, uint32_t height) {
+  const uint8_t* y = static_cast<const uint8_t*>(layout.y);
+  ptrdiff_t cb = static_cast<const uint8_t*>(layout.cb) - y;
+  ptrdiff_t cr = static_cast<const uint8_t*>(layout.cr) - y;
+  ptrdiff_t y_size = bytes_per_line * height;
+  if (layout.ystride != bytes_per_line) {
+    return false;
+  }
+  switch (v4l2_pixel_format) {
+    case V4L2_PIX_FMT_YUV420:
+      return layout.chroma_step == 1 && layout.cstride == bytes_per_line / 2 &&
+             cb == y_size && cr == y_size + y_size / 4;
+    case V4L2_PIX_FMT_YVU420:
+      return layout.chroma_step == 1 && layout.cstride == bytes_per_line / 2 &&
+             cr == y_size && cb == y_size + y_size / 4;
+    case V4L2_PIX_FMT_NV12:
+      return layout.chroma_step == 2 && layout.cstride == bytes_per_line &&
+             cb == y_size && cr == cb + 1;
+    case V4L2_PIX_FMT_NV21:
+      return layout.chroma_step == 2 && layout.cstride == bytes_per_line &&
+             cr == y_size && cb == cr + 1;
+    default:
+      return false;
+  }
+}
+
+bool V4L2Wrapper::CanImportOutputBuffers(uint32_t size_image) {
+  // There's no output buffer yet, so check one allocated the way the
+  // framework will allocate them.
+  int hal_format =
+      StreamFormat::V4L2ToHalPixelFormat(format_->v4l2_pixel_format());
+  const hw_module_t* module = nullptr;
+  alloc_device_t* alloc_device = nullptr;
+  if (hal_format < 0 || hw_get_module(GRALLOC_HARDWARE_MODULE_ID, &module) ||
+      !module || gralloc_open(module, &alloc_device) || !alloc_device) {
+    HAL_LOGV("Can't allocate a buffer to check the output layout with.");
+    return false;
+  }
+  const gralloc_module_t* gralloc =
+      reinterpret_cast<const gralloc_module_t*>(module);
+
+  uint32_t width = format_->width();
+  uint32_t height = format_->height();
+  uint32_t bytes_per_line = format_->bytes_per_line();
+  buffer_handle_t buffer = nullptr;
+  int stride = 0;
+  if (alloc_device->alloc(alloc_device, width, height, hal_format,
+                          kDirectOutputUsage, &buffer, &stride)) {
+    HAL_LOGV("Failed to allocate a buffer to check the output layout with.");
+    gralloc_close(alloc_device);
+    return false;
+  }
+
+  bool fits = buffer->numFds >= 1 && FdHolds(buffer->data[0], size_image);
+  switch (format_->v4l2_pixel_format()) {
+    case V4L2_PIX_FMT_YUV420:
+    case V4L2_PIX_FMT_YVU420:
+    case V4L2_PIX_FMT_NV12:
+    case V4L2_PIX_FMT_NV21: {
+      android_ycbcr layout;
+      if (fits && !gralloc->lock_ycbcr(gralloc, buffer, kDirectOutputUsage, 0,
+                                       0, width, height, &layout)) {
+        fits = MatchesDeviceLayout(layout, format_->v4l2_pixel_format(),
+                                   bytes_per_line, height);
+        gralloc->unlock(gralloc, buffer);
+      } else {
+        fits = false;
+      }
+      break;
+    }
+    case V4L2_PIX_FMT_YUYV:
+      fits = fits && static_cast<uint32_t>(stride) * 2 == bytes_per_line;
+      break;
+    case V4L2_PIX_FMT_RGB32:
+    case V4L2_PIX_FMT_BGR32:
+      fits = fits && static_cast<uint32_t>(stride) * 4 == bytes_per_line;
+      break;
+    default:
+      fits = false;
+      break;
+  }
+  alloc_device->free(alloc_device, buffer);
+  gralloc_close(alloc_device);
+
+  if (!fits) {
+    HAL_LOGV("Output buffers aren't laid out like %ux%u frames of %s.",
+             width, height,
+             FormatToString(format_->v4l2_pixel_format()).c_str());
+  }
+  return fits;
+}
+
+uint32_t V4L2Wrapper::GetOutputBufferUsage() {
+  return memory_ == V4L2_MEMORY_DMABUF ? kDirectOutputUsage : 0;
+}
+
 int V4L2Wrapper::RequestBuffers(uint32_t num_requested) {
+  {
+    // Drop the previous buffers first; MMAP buffers can't be freed by the
+    // driver while they are still mapped.
+    std::lock_guard<std::mutex> guard(buffer_queue_lock_);
+    buffers_.clear();
+  }
+
   v4l2_requestbuffers req_buffers;
   memset(&req_buffers, 0, sizeof(req_buffers));
   req_buffers.type = format_->type();
-  req_buffers.memory = V4L2_MEMORY_USERPTR;
+  req_buffers.memory = memory_;
   req_buffers.count = num_requested;
 
   int res = IoctlLocked(VIDIOC_REQBUFS, &req_buffers);
   // Calling REQBUFS releases all queued buffers back to the user.
   if (res < 0) {
+    if (errno == EINVAL) {
+      HAL_LOGV("REQBUFS doesn't support memory type %u.", memory_);
+      return -EINVAL;
+    }
     HAL_LOGE("REQBUFS failed: %s", strerror(errno));
     return -ENODEV;
   }
@@ -574,7 +1023,58 @@ int V4L2Wrapper::RequestBuffers(uint32_t num_requested) {
     HAL_LOGE("REQBUFS claims it can't handle any buffers.");
     return -ENODEV;
   }
+  std::lock_guard<std::mutex> guard(buffer_queue_lock_);
   buffers_.resize(req_buffers.count);
+  if (memory_ == V4L2_MEMORY_USERPTR) {
+    for (auto& buffer : buffers_) {
+      buffer.camera_buffer = std::make_shared<AllocatedFrameBuffer>(0);
+    }
+  }
+  return 0;
+}
+
+int V4L2Wrapper::MapBuffers() {
+  std::vector<std::shared_ptr<arc::FrameBuffer>> mapped;
+  size_t num_buffers;
+  {
+    std::lock_guard<std::mutex> guard(buffer_queue_lock_);
+    num_buffers = buffers_.size();
+  }
+
+  for (size_t i = 0; i < num_buffers; ++i) {
+    v4l2_buffer device_buffer;
+    memset(&device_buffer, 0, sizeof(device_buffer));
+    device_buffer.type = format_->type();
+    device_buffer.memory = V4L2_MEMORY_MMAP;
+    device_buffer.index = i;
+    if (IoctlLocked(VIDIOC_QUERYBUF, &device_buffer) < 0) {
+      HAL_LOGE("QUERYBUF fails: %s", strerror(errno));
+      return -ENODEV;
+    }
+
+    v4l2_exportbuffer export_buffer;
+    memset(&export_buffer, 0, sizeof(export_buffer));
+    export_buffer.type = format_->type();
+    export_buffer.index = i;
+    export_buffer.flags = O_RDONLY | O_CLOEXEC;
+    if (IoctlLocked(VIDIOC_EXPBUF, &export_buffer) < 0) {
+      HAL_LOGE("EXPBUF fails: %s", strerror(errno));
+      return -ENODEV;
+    }
+
+    auto buffer = std::make_shared<arc::V4L2FrameBuffer>(
+        base::ScopedFD(export_buffer.fd), device_buffer.length,
+        format_->width(), format_->height(), format_->v4l2_pixel_format());
+    if (buffer->Map()) {
+      return -ENODEV;
+    }
+    mapped.push_back(std::move(buffer));
+  }
+
+  std::lock_guard<std::mutex> guard(buffer_queue_lock_);
+  for (size_t i = 0; i < buffers_.size() && i < mapped.size(); ++i) {
+    buffers_[i].camera_buffer = std::move(mapped[i]);
+  }
   return 0;
 }
 
@@ -592,7 +1092,7 @@ int V4L2Wrapper::EnqueueRequest(
   {
     std::lock_guard<std::mutex> guard(buffer_queue_lock_);
     for (size_t i = 0; i < buffers_.size(); ++i) {
-      if (!buffers_[i].active) {
+      if (!buffers_[i].active && !buffers_[i].processing) {
         index = i;
         break;
       }
@@ -609,6 +1109,7 @@ int V4L2Wrapper::EnqueueRequest(
   v4l2_buffer device_buffer;
   memset(&device_buffer, 0, sizeof(device_buffer));
   device_buffer.type = format_->type();
+  device_buffer.memory = memory_;
   device_buffer.index = index;
 
   // Use QUERYBUF to ensure our buffer/device is in good shape,
@@ -621,21 +1122,39 @@ int V4L2Wrapper::EnqueueRequest(
     return -ENODEV;
   }
 
-  // Setup our request context and fill in the user pointer field.
+  // Setup our request context and tell the device where the frame goes.
+  // MMAP buffers are identified by index alone.
   RequestContext* request_context;
-  void* data;
   {
     std::lock_guard<std::mutex> guard(buffer_queue_lock_);
     request_context = &buffers_[index];
-    request_context->camera_buffer->SetDataSize(device_buffer.length);
-    request_context->camera_buffer->Reset();
-    request_context->camera_buffer->SetFourcc(format_->v4l2_pixel_format());
-    request_context->camera_buffer->SetWidth(format_->width());
-    request_context->camera_buffer->SetHeight(format_->height());
     request_context->request = request;
-    data = request_context->camera_buffer->GetData();
+    if (memory_ == V4L2_MEMORY_USERPTR) {
+      // Offer the device the whole buffer; DequeueFrame trims it to what
+      // the device actually filled in.
+      AllocatedFrameBuffer* camera_buffer = static_cast<AllocatedFrameBuffer*>(
+          request_context->camera_buffer.get());
+      camera_buffer->SetDataSize(device_buffer.length);
+      camera_buffer->SetFourcc(format_->v4l2_pixel_format());
+      camera_buffer->SetWidth(format_->width());
+      camera_buffer->SetHeight(format_->height());
+      device_buffer.m.userptr =
+          reinterpret_cast<unsigned long>(camera_buffer->GetData());
+    }
+  }
+  if (memory_ == V4L2_MEMORY_DMABUF) {
+    // Capture straight into the framework's buffer.
+    buffer_handle_t handle = *request->output_buffers[0].buffer;
+    if (!handle || handle->numFds < 1 ||
+        !FdHolds(handle->data[0], device_buffer.length)) {
+      HAL_LOGE("Output buffer has no dma-buf fd of %u bytes to import.",
+               device_buffer.length);
+      std::lock_guard<std::mutex> guard(buffer_queue_lock_);
+      request_context->request.reset();
+      return -EINVAL;
+    }
+    device_buffer.m.fd = handle->data[0];
   }
-  device_buffer.m.userptr = reinterpret_cast<unsigned long>(data);
 
   // Pass the buffer to the camera.
   if (IoctlLocked(VIDIOC_QBUF, &device_buffer) < 0) {
@@ -650,7 +1169,145 @@ int V4L2Wrapper::EnqueueRequest(
   return 0;
 }
 
-int V4L2Wrapper::DequeueRequest(std::shared_ptr<CaptureRequest>* request) {
+// Appends the camera3_jpeg_blob trailer that tells the framework how much of
+// the BLOB buffer |output_frame| holds JPEG data.
+static int WriteJpegBlobTrailer(arc::FrameBuffer* output_frame) {
+  camera3_jpeg_blob_t blob;
+  blob.jpeg_blob_id = CAMERA3_JPEG_BLOB_ID;
+  blob.jpeg_size = output_frame->GetDataSize();
+  if (output_frame->GetBufferSize() < sizeof(blob) ||
+      blob.jpeg_size > output_frame->GetBufferSize() - sizeof(blob)) {
+    HAL_LOGE("JPEG of %u bytes leaves no room for the blob trailer.",
+             blob.jpeg_size);
+    return -ENOSPC;
+  }
+  memcpy(output_frame->GetData() + output_frame->GetBufferSize() - sizeof(blob),
+         &blob, sizeof(blob));
+  return 0;
+}
+
+// Whether |a| and |b| lay their 4:2:0 planes out alike relative to their
+// data, or neither is a 4:2:0 frame, so that one can be copied over the other
+// as is.
+static bool SamePlaneLayout(const arc::FrameBuffer& a,
+                            const arc::FrameBuffer& b) {
+  arc::FrameBuffer::YCbCrLayout a_layout;
+  arc::FrameBuffer::YCbCrLayout b_layout;
+  bool a_ycbcr = a.GetYCbCrLayout(&a_layout);
+  bool b_ycbcr = b.GetYCbCrLayout(&b_layout);
+  if (!a_ycbcr || !b_ycbcr) {
+    return a_ycbcr == b_ycbcr;
+  }
+  return a_layout.y - a.GetData() == b_layout.y - b.GetData() &&
+         a_layout.cb - a.GetData() == b_layout.cb - b.GetData() &&
+         a_layout.cr - a.GetData() == b_layout.cr - b.GetData() &&
+         a_layout.y_stride == b_layout.y_stride &&
+         a_layout.c_stride == b_layout.c_stride &&
+         a_layout.chroma_step == b_layout.chroma_step;
+}
+
+// Paints one output buffer of a request from the captured frame, converting
+// and scaling as needed. |cached_frame| holds the YU12 decode of
+// |camera_buffer| shared by all outputs; |cached| tracks whether it has been
+// set up yet. |sole_output| is set if this is the request's only output, so
+// nothing else would use the YU12 decode.
+static int FillOutputBuffer(const arc::FrameBuffer& camera_buffer,
+                            uint32_t device_buffer_length,
+                            const android::CameraMetadata& settings,
+                            camera3_stream_buffer_t* stream_buffer,
+                            arc::CachedFrame* cached_frame, bool* cached,
+                            bool sole_output) {
+  uint32_t fourcc =
+      StreamFormat::HalToV4L2PixelFormat(stream_buffer->stream->format);
+  bool same_size = camera_buffer.GetWidth() == stream_buffer->stream->width &&
+                   camera_buffer.GetHeight() == stream_buffer->stream->height;
+
+  // Note that the device buffer length is passed to the output frame. If the
+  // GrallocFrameBuffer does not have support for the transformation to
+  // |fourcc|, it will assume that the amount of data to lock is based on
+  // |device_buffer_length|, otherwise it will use the
+  // ImageProcessor::ConvertedSize. BLOB buffers are always allocated with
+  // the advertised ANDROID_JPEG_MAX_SIZE.
+  arc::GrallocFrameBuffer output_frame(
+      *stream_buffer->buffer, stream_buffer->stream->width,
+      stream_buffer->stream->height, fourcc,
+      fourcc == V4L2_PIX_FMT_JPEG ? kV4L2MaxJpegSize : device_buffer_length,
+      stream_buffer->stream->usage);
+  int res = output_frame.Map();
+  if (res) {
+    HAL_LOGE("Failed to map output frame.");
+    return -EINVAL;
+  }
+
+  if (camera_buffer.GetFourcc() == fourcc && same_size &&
+      !SamePlaneLayout(camera_buffer, output_frame)) {
+    // Same format, but gralloc padded or interleaved the planes differently.
+    res = arc::ImageProcessor::ConvertFormat(settings, camera_buffer,
+                                             &output_frame);
+    if (res) {
+      HAL_LOGE("Failed to copy %ux%u frame into the output plane layout: %d",
+               stream_buffer->stream->width, stream_buffer->stream->height,
+               res);
+    }
+    return res;
+  }
+  if (camera_buffer.GetFourcc() == fourcc && same_size) {
+    // If no format conversion needs to be applied, directly copy the data over.
+    if (fourcc == V4L2_PIX_FMT_JPEG) {
+      res = output_frame.SetDataSize(camera_buffer.GetDataSize());
+      if (res) {
+        HAL_LOGE("Captured JPEG doesn't fit the output buffer.");
+        return res;
+      }
+    }
+    memcpy(output_frame.GetData(), camera_buffer.GetData(),
+           camera_buffer.GetDataSize());
+    return fourcc == V4L2_PIX_FMT_JPEG ? WriteJpegBlobTrailer(&output_frame)
+                                       : 0;
+  }
+
+  // A full size MJPEG capture already is a JPEG; it only needs the EXIF
+  // segment. The frame is still decoded if the EXIF thumbnail needs it.
+  bool passthrough = fourcc == V4L2_PIX_FMT_JPEG &&
+                     camera_buffer.GetFourcc() == V4L2_PIX_FMT_MJPEG &&
+                     same_size;
+  // A lone YUV output is converted straight from the camera format into the
+  // output buffer, in the plane layout gralloc gave it, without the YU12
+  // intermediate.
+  bool direct = sole_output && same_size && !passthrough &&
+                arc::ImageProcessor::SupportsConversion(
+                    camera_buffer.GetFourcc(), fourcc);
+
+  // Perform the format conversion.
+  if (!*cached && !direct &&
+      (!passthrough || arc::ImageProcessor::NeedsThumbnail(settings))) {
+    res = cached_frame->SetSource(&camera_buffer, 0);
+    if (res) {
+      HAL_LOGE("Failed to decode captured frame: %d", res);
+      return res;
+    }
+    *cached = true;
+  }
+  if (passthrough) {
+    res = arc::ImageProcessor::MJPEGToJPEG(
+        settings, camera_buffer,
+        *cached ? cached_frame->GetCachedBuffer() : nullptr, &output_frame);
+  } else if (direct) {
+    res = arc::ImageProcessor::ConvertFormat(settings, camera_buffer,
+                                             &output_frame);
+  } else {
+    res = cached_frame->Convert(settings, &output_frame);
+  }
+  if (res) {
+    HAL_LOGE("Failed to convert frame for %ux%u output: %d",
+             stream_buffer->stream->width, stream_buffer->stream->height, res);
+    return res;
+  }
+  return fourcc == V4L2_PIX_FMT_JPEG ? WriteJpegBlobTrailer(&output_frame) : 0;
+}
+
+int V4L2Wrapper::DequeueFrame(std::shared_ptr<CaptureRequest>* request,
+                              uint32_t* index) {
   if (!format_) {
     HAL_LOGV(
         "Format not set, so stream can't be on, "
@@ -661,7 +1318,7 @@ int V4L2Wrapper::DequeueRequest(std::shared_ptr<CaptureRequest>* request) {
   v4l2_buffer buffer;
   memset(&buffer, 0, sizeof(buffer));
   buffer.type = format_->type();
-  buffer.memory = V4L2_MEMORY_USERPTR;
+  buffer.memory = memory_;
   int res = IoctlLocked(VIDIOC_DQBUF, &buffer);
   if (res) {
     if (errno == EAGAIN) {
@@ -677,56 +1334,138 @@ int V4L2Wrapper::DequeueRequest(std::shared_ptr<CaptureRequest>* request) {
   std::lock_guard<std::mutex> guard(buffer_queue_lock_);
   RequestContext* request_context = &buffers_[buffer.index];
 
-  // Lock the camera stream buffer for painting.
-  const camera3_stream_buffer_t* stream_buffer =
-      &request_context->request->output_buffers[0];
-  uint32_t fourcc =
-      StreamFormat::HalToV4L2PixelFormat(stream_buffer->stream->format);
-
   if (request) {
     *request = request_context->request;
   }
 
-  // Note that the device buffer length is passed to the output frame. If the
-  // GrallocFrameBuffer does not have support for the transformation to
-  // |fourcc|, it will assume that the amount of data to lock is based on
-  // |buffer.length|, otherwise it will use the ImageProcessor::ConvertedSize.
-  arc::GrallocFrameBuffer output_frame(
-      *stream_buffer->buffer, stream_buffer->stream->width,
-      stream_buffer->stream->height, fourcc, buffer.length,
-      stream_buffer->stream->usage);
-  res = output_frame.Map();
-  if (res) {
-    HAL_LOGE("Failed to map output frame.");
-    request_context->request.reset();
-    return -EINVAL;
+  if (request_context->camera_buffer) {
+    // Only copy/convert what the device filled in, so nothing is read from
+    // past the end of this frame (e.g. a stale JPEG EOI).
+    request_context->camera_buffer->SetDataSize(
+        buffer.bytesused ? buffer.bytesused : buffer.length);
   }
-  if (request_context->camera_buffer->GetFourcc() == fourcc &&
-      request_context->camera_buffer->GetWidth() ==
-          stream_buffer->stream->width &&
-      request_context->camera_buffer->GetHeight() ==
-          stream_buffer->stream->height) {
-    // If no format conversion needs to be applied, directly copy the data over.
-    memcpy(output_frame.GetData(), request_context->camera_buffer->GetData(),
-           request_context->camera_buffer->GetDataSize());
-  } else {
-    // Perform the format conversion.
-    arc::CachedFrame cached_frame;
-    cached_frame.SetSource(request_context->camera_buffer.get(), 0);
-    cached_frame.Convert(request_context->request->settings, &output_frame);
+  request_context->device_buffer_length = buffer.length;
+  request_context->cached = false;
+  // The buffer is no longer in flight, but not reusable until released.
+  request_context->active = false;
+  request_context->processing = true;
+  *index = buffer.index;
+  return 0;
+}
+
+int V4L2Wrapper::ProcessFrame(uint32_t index, bool blob_outputs) {
+  RequestContext* request_context;
+  {
+    std::lock_guard<std::mutex> guard(buffer_queue_lock_);
+    if (index >= buffers_.size() || !buffers_[index].processing) {
+      HAL_LOGE("Buffer %u has not been dequeued.", index);
+      return -EINVAL;
+    }
+    request_context = &buffers_[index];
+    if (memory_ == V4L2_MEMORY_DMABUF) {
+      // The device already wrote the frame into the (only) output buffer.
+      return 0;
+    }
+    if (!request_context->cached_frame) {
+      if (cached_frames_.empty()) {
+        request_context->cached_frame.reset(new arc::CachedFrame());
+      } else {
+        request_context->cached_frame = std::move(cached_frames_.back());
+        cached_frames_.pop_back();
+      }
+    }
   }
 
+  // The context belongs to the caller until ReleaseFrame, so paint without
+  // the lock to let other frames be processed meanwhile.
+  // Fan the single capture out to the output buffers of the request. The
+  // YU12 decode is done at most once and shared by all converted outputs.
+  for (auto& stream_buffer : request_context->request->output_buffers) {
+    if ((stream_buffer.stream->format == HAL_PIXEL_FORMAT_BLOB) !=
+        blob_outputs) {
+      continue;
+    }
+    if (FillOutputBuffer(*request_context->camera_buffer,
+                         request_context->device_buffer_length,
+                         request_context->request->settings, &stream_buffer,
+                         request_context->cached_frame.get(),
+                         &request_context->cached,
+                         request_context->request->output_buffers.size() ==
+                             1)) {
+      stream_buffer.status = CAMERA3_BUFFER_STATUS_ERROR;
+    }
+  }
+  return 0;
+}
+
+void V4L2Wrapper::ReleaseFrame(uint32_t index) {
+  std::lock_guard<std::mutex> guard(buffer_queue_lock_);
+  if (index >= buffers_.size() || !buffers_[index].processing) {
+    HAL_LOGE("Buffer %u has not been dequeued.", index);
+    return;
+  }
+  RequestContext* request_context = &buffers_[index];
+  if (request_context->cached_frame) {
+    cached_frames_.push_back(std::move(request_context->cached_frame));
+  }
   request_context->request.reset();
-  // Mark the buffer as not in flight.
-  request_context->active = false;
+  request_context->processing = false;
+}
+
+int V4L2Wrapper::WaitForBuffer(int timeout_ms) {
+  int device_fd;
+  {
+    // Only hold the lock to read the fd; other ioctls (QBUF) must be able to
+    // proceed while this thread sleeps.
+    std::lock_guard<std::mutex> lock(device_lock_);
+    if (!connected()) {
+      return -ENODEV;
+    }
+    device_fd = device_fd_.get();
+  }
+
+  struct pollfd fds[2];
+  memset(fds, 0, sizeof(fds));
+  fds[0].fd = device_fd;
+  fds[0].events = POLLIN;
+  fds[1].fd = wake_fd_.get();
+  fds[1].events = POLLIN;
+  int res = TEMP_FAILURE_RETRY(poll(fds, wake_fd_.get() >= 0 ? 2 : 1,
+                                    timeout_ms));
+  if (res < 0) {
+    HAL_LOGE("poll fails: %s", strerror(errno));
+    return -errno;
+  }
+  if (res == 0) {
+    return -ETIMEDOUT;
+  }
+
+  if (fds[1].revents & POLLIN) {
+    uint64_t count;
+    TEMP_FAILURE_RETRY(read(wake_fd_.get(), &count, sizeof(count)));
+    return -EINTR;
+  }
+  if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+    return -EIO;
+  }
   return 0;
 }
 
+void V4L2Wrapper::InterruptWait() {
+  if (wake_fd_.get() < 0) {
+    return;
+  }
+  uint64_t one = 1;
+  if (TEMP_FAILURE_RETRY(write(wake_fd_.get(), &one, sizeof(one))) < 0) {
+    HAL_LOGE("Failed to interrupt buffer wait: %s", strerror(errno));
+  }
+}
+
 int V4L2Wrapper::GetInFlightBufferCount() {
   int count = 0;
   std::lock_guard<std::mutex> guard(buffer_queue_lock_);
   for (auto& buffer : buffers_) {
-    if (buffer.active) {
+    if (buffer.active || buffer.processing) {
       count++;
     }
   }
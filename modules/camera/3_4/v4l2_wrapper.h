@@ -18,6 +18,7 @@
 #define V4L2_CAMERA_HAL_V4L2_WRAPPER_H_
 
 #include <array>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <set>
@@ -25,8 +26,10 @@
 #include <vector>
 
 #include <android-base/unique_fd.h>
+#include "arc/cached_frame.h"
 #include "arc/common_types.h"
 #include "arc/frame_buffer.h"
+#include "capability_cache.h"
 #include "capture_request.h"
 #include "common.h"
 #include "stream_format.h"
@@ -38,6 +41,10 @@ class V4L2Wrapper {
   // Use this method to create V4L2Wrapper objects. Functionally equivalent
   // to "new V4L2Wrapper", except that it may return nullptr in case of failure.
   static V4L2Wrapper* NewV4L2Wrapper(const std::string device_path);
+  // Directory that format enumeration results are kept in across camera
+  // opens (see CapabilityCache). Empty disables the cache. Only affects
+  // devices connected afterwards.
+  static void SetCapabilityCacheDir(const std::string& dir);
   virtual ~V4L2Wrapper();
 
   // Helper class to ensure all opened connections are closed.
@@ -67,7 +74,21 @@ class V4L2Wrapper {
   virtual int SetControl(uint32_t control_id,
                          int32_t desired,
                          int32_t* result = nullptr);
-  // Manage format.
+  // Batch control changes. Between BeginControlBatch and CommitControlBatch,
+  // SetControl only records the value (and reports it as the result); the
+  // commit applies all of them with one VIDIOC_S_EXT_CTRLS per control
+  // class. Values equal to the last one applied are skipped, in or out of a
+  // batch.
+  virtual void BeginControlBatch();
+  virtual int CommitControlBatch();
+  // Return whether any control read with GetControl may have changed on the
+  // device since the last call (e.g. exposure under auto exposure). Uses
+  // control events, so it costs one ioctl, unless the driver can't report
+  // changes to some control; then it always returns true.
+  virtual bool ControlsChanged();
+  // Write control ioctl statistics to |fd|.
+  virtual void DumpControlStats(int fd);
+  // Manage format. Results come from the capability cache when it has them.
   virtual int GetFormats(std::set<uint32_t>* v4l2_formats);
   virtual int GetQualifiedFormats(std::vector<uint32_t>* v4l2_formats);
   virtual int GetFormatFrameSizes(uint32_t v4l2_format,
@@ -78,14 +99,37 @@ class V4L2Wrapper {
       uint32_t v4l2_format,
       const std::array<int32_t, 2>& size,
       std::array<int64_t, 2>* duration_range);
+  // |allow_direct_output| lets the device capture straight into output
+  // buffers when no conversion is needed; pass false when frames are fanned
+  // out to several streams.
   virtual int SetFormat(const StreamFormat& desired_format,
+                        bool allow_direct_output,
                         uint32_t* result_max_buffers);
+  // Gralloc usage output buffers must be allocated with for the format
+  // last set, or 0 if they're only written by the CPU.
+  virtual uint32_t GetOutputBufferUsage();
   // Manage buffers.
   virtual int EnqueueRequest(
       std::shared_ptr<default_camera_hal::CaptureRequest> request);
-  virtual int DequeueRequest(
-      std::shared_ptr<default_camera_hal::CaptureRequest>* request);
+  // Dequeueing is split into phases so outputs can be painted on other
+  // threads. DequeueFrame hands out a filled device buffer as |index|.
+  // ProcessFrame paints the request's BLOB or non-BLOB outputs from it, so
+  // JPEG encoding can run as its own stage; frames with different indices may
+  // be processed concurrently. ReleaseFrame makes the buffer reusable, and
+  // must be called before the request is completed.
+  virtual int DequeueFrame(
+      std::shared_ptr<default_camera_hal::CaptureRequest>* request,
+      uint32_t* index);
+  virtual int ProcessFrame(uint32_t index, bool blob_outputs);
+  virtual void ReleaseFrame(uint32_t index);
   virtual int GetInFlightBufferCount();
+  // Block until the device has a filled buffer ready for DequeueFrame.
+  // Returns 0 when a buffer is ready, -EINTR if woken by InterruptWait,
+  // -ETIMEDOUT after |timeout_ms| (negative waits forever), or -EIO if the
+  // device reports an error (e.g. the stream is off or has no buffers queued).
+  virtual int WaitForBuffer(int timeout_ms);
+  // Wake up a thread blocked in WaitForBuffer, e.g. on flush or shutdown.
+  virtual void InterruptWait();
 
  private:
   // Constructor is private to allow failing on bad input.
@@ -99,24 +143,52 @@ class V4L2Wrapper {
   // Perform an ioctl call in a thread-safe fashion.
   template <typename T>
   int IoctlLocked(unsigned long request, T data);
-  // Request/release userspace buffer mode via VIDIOC_REQBUFS.
+  // Request/release buffers of |memory_| type via VIDIOC_REQBUFS.
   int RequestBuffers(uint32_t num_buffers);
+  // Pick the cheapest memory type the driver supports for the current format
+  // and request buffers with it. |direct_output| means captured frames can be
+  // handed to the framework without conversion.
+  int NegotiateMemory(bool direct_output);
+  // Whether the device can capture straight into gralloc buffers of the
+  // current format: they must be dma-bufs of at least |size_image| bytes,
+  // laid out exactly like the device's frames.
+  bool CanImportOutputBuffers(uint32_t size_image);
+  // Export and map every MMAP buffer so frames can be read in place.
+  int MapBuffers();
+  // Set a single control right away, with S_CTRL or S_EXT_CTRLS.
+  int ApplyControl(uint32_t control_id, int32_t desired, int32_t* result);
+  // Subscribe to change events of |control_id|. Requires |control_lock_|.
+  void WatchControl(uint32_t control_id);
+  // Apply the |count| controls of |control_class| starting at |controls|
+  // with one S_EXT_CTRLS. Requires |control_lock_|.
+  int ApplyControlClass(uint32_t control_class, v4l2_ext_control* controls,
+                        uint32_t count);
 
   inline bool connected() { return device_fd_.get() >= 0; }
 
   // Format management.
   const arc::SupportedFormats GetSupportedFormats();
+  // GetFormatFrameSizes without the capability cache.
+  int EnumerateFrameSizes(uint32_t v4l2_format,
+                          std::set<std::array<int32_t, 2>>* sizes);
 
   // The camera device path. For example, /dev/video0.
   const std::string device_path_;
   // The opened device fd.
   android::base::unique_fd device_fd_;
+  // eventfd used to interrupt WaitForBuffer.
+  android::base::unique_fd wake_fd_;
   // The underlying gralloc module.
   // std::unique_ptr<V4L2Gralloc> gralloc_;
   // Whether or not the device supports the extended control query.
   bool extended_query_supported_;
   // The format this device is set up for.
   std::unique_ptr<StreamFormat> format_;
+  // V4L2_MEMORY_* type the current buffers were requested with, negotiated
+  // in SetFormat. DMABUF imports the output gralloc buffer so frames need no
+  // copy, MMAP reads frames in place from driver-allocated buffers, and
+  // USERPTR captures into HAL-allocated buffers as a fallback.
+  uint32_t memory_;
   // Lock protecting use of the buffer tracker.
   std::mutex buffer_queue_lock_;
   // Lock protecting use of the device.
@@ -125,6 +197,32 @@ class V4L2Wrapper {
   std::mutex connection_lock_;
   // Reference count connections.
   int connection_count_;
+  // Lock protecting the control state below.
+  std::mutex control_lock_;
+  // Whether SetControl is batching.
+  bool control_batch_open_;
+  // Values waiting for CommitControlBatch. Ordered by id, which keeps the
+  // controls of each class together.
+  std::map<uint32_t, int32_t> pending_controls_;
+  // Last value set on each control since connecting (or read back from it).
+  std::map<uint32_t, int32_t> applied_controls_;
+  // Controls subscribed to change events.
+  std::set<uint32_t> watched_controls_;
+  // Whether a control read with GetControl can change without an event.
+  bool unwatched_controls_;
+  struct ControlStats {
+    // All control setting ioctls, in batches or not.
+    uint64_t ioctls;
+    uint64_t batches;
+    uint64_t batch_ioctls;
+    uint64_t controls_set;
+    uint64_t controls_skipped;
+    uint32_t last_batch_ioctls;
+    uint32_t max_batch_ioctls;
+  } control_stats_;
+  // Format enumeration results, loaded on connecting and saved when the
+  // last connection closes.
+  CapabilityCache capabilities_;
   // Supported formats.
   arc::SupportedFormats supported_formats_;
   // Qualified formats.
@@ -134,15 +232,32 @@ class V4L2Wrapper {
    public:
     RequestContext()
         : active(false),
-          camera_buffer(std::make_shared<arc::AllocatedFrameBuffer>(0)){};
-    ~RequestContext(){};
-    // Indicates whether this request context is in use.
+          processing(false),
+          device_buffer_length(0),
+          cached(false){};
+    // Indicates whether this request context is queued on the device.
     bool active;
-    // Buffer handles of the context.
-    std::shared_ptr<arc::AllocatedFrameBuffer> camera_buffer;
+    // Indicates whether this request context has been dequeued and its
+    // outputs are being painted (between DequeueFrame and ReleaseFrame).
+    bool processing;
+    uint32_t device_buffer_length;
+    // Conversion state borrowed from |cached_frames_| while processing.
+    std::unique_ptr<arc::CachedFrame> cached_frame;
+    // Whether |cached_frame| holds this frame's YU12 decode.
+    bool cached;
+    // Buffer handles of the context. An AllocatedFrameBuffer for USERPTR, a
+    // mapped V4L2FrameBuffer for MMAP, and null for DMABUF (the frame lands
+    // in the request's output buffer).
+    std::shared_ptr<arc::FrameBuffer> camera_buffer;
     std::shared_ptr<default_camera_hal::CaptureRequest> request;
   };
 
+  // Conversion state reused by the frames of the current format, so
+  // steady-state capture doesn't reallocate the YU12 and scaled buffers.
+  // One is lent to each frame being processed. Guarded by
+  // |buffer_queue_lock_|.
+  std::vector<std::unique_ptr<arc::CachedFrame>> cached_frames_;
+
   // Map of in flight requests.
   // |buffers_.size()| will always be the maximum number of buffers this device
   // can handle in its current format.
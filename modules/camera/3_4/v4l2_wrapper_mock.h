@@ -35,6 +35,9 @@ class V4L2WrapperMock : public V4L2Wrapper {
   MOCK_METHOD2(GetControl, int(uint32_t control_id, int32_t* value));
   MOCK_METHOD3(SetControl,
                int(uint32_t control_id, int32_t desired, int32_t* result));
+  MOCK_METHOD0(BeginControlBatch, void());
+  MOCK_METHOD0(CommitControlBatch, int());
+  MOCK_METHOD0(ControlsChanged, bool());
   MOCK_METHOD1(GetFormats, int(std::set<uint32_t>*));
   MOCK_METHOD1(GetQualifiedFormats, int(std::vector<uint32_t>*));
   MOCK_METHOD2(GetFormatFrameSizes,
@@ -43,12 +46,22 @@ class V4L2WrapperMock : public V4L2Wrapper {
                int(uint32_t,
                    const std::array<int32_t, 2>&,
                    std::array<int64_t, 2>*));
-  MOCK_METHOD2(SetFormat, int(const StreamFormat& desired_format,
+  MOCK_METHOD3(SetFormat, int(const StreamFormat& desired_format,
+                              bool allow_direct_output,
                               uint32_t* result_max_buffers));
+  MOCK_METHOD0(GetOutputBufferUsage, uint32_t());
   MOCK_METHOD2(EnqueueBuffer,
                int(const camera3_stream_buffer_t* camera_buffer,
                    uint32_t* enqueued_index));
   MOCK_METHOD1(DequeueBuffer, int(uint32_t* dequeued_index));
+  MOCK_METHOD2(
+      DequeueFrame,
+      int(std::shared_ptr<default_camera_hal::CaptureRequest>* request,
+          uint32_t* index));
+  MOCK_METHOD2(ProcessFrame, int(uint32_t index, bool blob_outputs));
+  MOCK_METHOD1(ReleaseFrame, void(uint32_t index));
+  MOCK_METHOD1(WaitForBuffer, int(int timeout_ms));
+  MOCK_METHOD0(InterruptWait, void());
 };
 
 }  // namespace v4l2_camera_hal
@@ -32,7 +32,9 @@ LOCAL_CFLAGS := -Wall -Werror -DLOG_TAG=\"MultiHal\"
 
 LOCAL_SRC_FILES := \
     multihal.cpp \
+    SensorEventMerger.cpp \
     SensorEventQueue.cpp \
+    SensorHandleTable.cpp \
 
 LOCAL_HEADER_LIBRARIES := \
     libhardware_headers \
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <functional>
+
+#include <hardware/sensors.h>
+#include "SensorEventMerger.h"
+
+// std heap functions build a max-heap, so compare with greater to keep the oldest on top.
+typedef std::greater<std::pair<int64_t, int>> HeapOrder;
+
+SensorEventMerger::SensorEventMerger(int64_t reorderWindowNs)
+        : mReorderWindowNs(reorderWindowNs), mQueueCount(0) {
+}
+
+void SensorEventMerger::reset(const std::vector<SensorEventQueue*>& queues) {
+    mHeap.clear();
+    mQueueCount = (int)queues.size();
+    for (int i = 0; i < mQueueCount; i++) {
+        push(queues[i], i);
+    }
+}
+
+int SensorEventMerger::pop(int64_t nowNs, int64_t* waitNs) {
+    if (mHeap.empty()) {
+        *waitNs = -1;
+        return -1;
+    }
+    int64_t timestamp = mHeap.front().first;
+    // With a head from every queue, the top of the heap is the oldest event overall. Otherwise
+    // an empty queue may still receive an older event, unless the window has already passed.
+    if ((int)mHeap.size() < mQueueCount && nowNs - timestamp < mReorderWindowNs) {
+        *waitNs = timestamp + mReorderWindowNs - nowNs;
+        return -1;
+    }
+    std::pop_heap(mHeap.begin(), mHeap.end(), HeapOrder());
+    int index = mHeap.back().second;
+    mHeap.pop_back();
+    return index;
+}
+
+void SensorEventMerger::push(SensorEventQueue* queue, int index) {
+    sensors_event_t* event = queue->peek();
+    if (event == NULL) {
+        return;
+    }
+    mHeap.push_back(std::make_pair(event->timestamp, index));
+    std::push_heap(mHeap.begin(), mHeap.end(), HeapOrder());
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SENSOREVENTMERGER_H_
+#define SENSOREVENTMERGER_H_
+
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include "SensorEventQueue.h"
+
+/*
+ * K-way merge of several SensorEventQueues by sensors_event_t::timestamp, using a min-heap over
+ * the queue heads.
+ *
+ * An event is only known to be the globally oldest one when every queue has a head to compare
+ * it with. While some queue is empty, the oldest head is held back until it is older than the
+ * reorder window, which bounds both the latency added by the merge and the lateness an event
+ * can have and still be put in order.
+ *
+ * Thread safety:
+ * Only call from the reader of the queues.
+ */
+class SensorEventMerger {
+    int64_t mReorderWindowNs;
+    // (timestamp, queue index) of every queue head that is known to the merger.
+    std::vector<std::pair<int64_t, int>> mHeap;
+    int mQueueCount;
+
+public:
+    explicit SensorEventMerger(int64_t reorderWindowNs);
+
+    // Forgets the current heads and rebuilds the heap from the head of every queue.
+    void reset(const std::vector<SensorEventQueue*>& queues);
+
+    // Returns the index of the queue whose head is the oldest event that can be delivered at time
+    // nowNs, and removes it from the heap. The caller should then dequeue that event and call
+    // push() for the queue.
+    // Returns -1 if there is nothing to deliver. In that case *waitNs is set to the time until the
+    // oldest held back event becomes deliverable, or -1 if all queues were empty.
+    int pop(int64_t nowNs, int64_t* waitNs);
+
+    // Adds the current head of the queue at index to the heap, if there is one.
+    void push(SensorEventQueue* queue, int index);
+};
+
+#endif // SENSOREVENTMERGER_H_
@@ -23,12 +23,23 @@
 #include <hardware/sensors.h>
 #include "SensorEventQueue.h"
 
-SensorEventQueue::SensorEventQueue(int capacity) {
+SensorEventQueue::SensorEventQueue(int capacity) : SensorEventQueue(capacity, capacity) {
+}
+
+SensorEventQueue::SensorEventQueue(int capacity, int maxCapacity) {
     mCapacity = capacity;
+    mMaxCapacity = std::max(capacity, maxCapacity);
 
     mStart = 0;
+    mEnd = 0;
     mSize = 0;
     mData = new sensors_event_t[mCapacity];
+    mWriterWaiting = false;
+    mWriterBlocked = false;
+    mReportedCapacity = mCapacity;
+    mHighWaterMark = 0;
+    mStallCount = 0;
+    pthread_mutex_init(&mSpaceAvailableMutex, NULL);
     pthread_cond_init(&mSpaceAvailableCondition, NULL);
 }
 
@@ -36,58 +47,134 @@ SensorEventQueue::~SensorEventQueue() {
     delete[] mData;
     mData = NULL;
     pthread_cond_destroy(&mSpaceAvailableCondition);
+    pthread_mutex_destroy(&mSpaceAvailableMutex);
 }
 
 int SensorEventQueue::getWritableRegion(int requestedLength, sensors_event_t** out) {
-    if (mSize == mCapacity || requestedLength <= 0) {
+    // The reader can only make the queue smaller, so this never overestimates the free space.
+    int freeSpace = mCapacity - mSize.load(std::memory_order_acquire);
+    if (freeSpace == 0 || requestedLength <= 0) {
         *out = NULL;
         return 0;
     }
-    // Start writing after the last readable record.
-    int firstWritable = (mStart + mSize) % mCapacity;
-
-    int lastWritable = firstWritable + requestedLength - 1;
-
-    // Don't go past the end of the data array.
-    if (lastWritable > mCapacity - 1) {
-        lastWritable = mCapacity - 1;
-    }
-    // Don't go into the readable region.
-    if (firstWritable < mStart && lastWritable >= mStart) {
-        lastWritable = mStart - 1;
-    }
-    *out = &mData[firstWritable];
-    return lastWritable - firstWritable + 1;
+    // Start writing after the last readable record, without going past the end of the data
+    // array or into the readable region.
+    int length = std::min(requestedLength, std::min(freeSpace, mCapacity - mEnd));
+    *out = &mData[mEnd];
+    return length;
 }
 
 void SensorEventQueue::markAsWritten(int count) {
-    mSize += count;
+    mEnd = (mEnd + count) % mCapacity;
+    // Publishes the written records to the reader.
+    int size = mSize.fetch_add(count) + count;
+    if (size > mHighWaterMark.load(std::memory_order_relaxed)) {
+        mHighWaterMark.store(size, std::memory_order_relaxed);
+    }
 }
 
 int SensorEventQueue::getSize() {
-    return mSize;
+    return mSize.load(std::memory_order_acquire);
 }
 
 sensors_event_t* SensorEventQueue::peek() {
-    if (mSize == 0) return NULL;
+    if (getSize() == 0) return NULL;
     return &mData[mStart];
 }
 
+int SensorEventQueue::getReadableRegion(int requestedLength, sensors_event_t** out) {
+    int size = getSize();
+    if (size == 0 || requestedLength <= 0) {
+        *out = NULL;
+        return 0;
+    }
+    *out = &mData[mStart];
+    return std::min(requestedLength, std::min(size, mCapacity - mStart));
+}
+
 void SensorEventQueue::dequeue() {
-    if (mSize == 0) return;
-    if (mSize == mCapacity) {
+    markAsRead(1);
+}
+
+void SensorEventQueue::markAsRead(int count) {
+    count = std::min(count, getSize());
+    if (count <= 0) return;
+    mStart = (mStart + count) % mCapacity;
+    mSize.fetch_sub(count);
+    // Sequentially consistent with the store in waitForSpace(), so either the writer sees the
+    // freed slots or we see that it is waiting. Only the first read after the writer started
+    // waiting needs to wake it up.
+    if (mWriterWaiting.load() && mWriterWaiting.exchange(false)) {
+        pthread_mutex_lock(&mSpaceAvailableMutex);
+        if (mWriterBlocked) {
+            // The writer filled the queue faster than it was read.
+            grow();
+        }
         pthread_cond_broadcast(&mSpaceAvailableCondition);
+        pthread_mutex_unlock(&mSpaceAvailableMutex);
     }
-    mSize--;
-    mStart = (mStart + 1) % mCapacity;
+}
+
+// returns true if it waited, or false if it was a no-op.
+bool SensorEventQueue::waitForSpace() {
+    if (getSize() < mCapacity) {
+        return false;
+    }
+    pthread_mutex_lock(&mSpaceAvailableMutex);
+    // Until the mutex is released by waiting, the reader cannot see mWriterBlocked, and after
+    // waking up the writer needs the mutex again, so the reader can resize the queue whenever it
+    // holds the mutex and sees mWriterBlocked.
+    mWriterBlocked = true;
+    bool waited = waitForSpace(&mSpaceAvailableMutex);
+    mWriterBlocked = false;
+    pthread_mutex_unlock(&mSpaceAvailableMutex);
+    if (waited) {
+        mStallCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    return waited;
 }
 
 // returns true if it waited, or false if it was a no-op.
 bool SensorEventQueue::waitForSpace(pthread_mutex_t* mutex) {
     bool waited = false;
-    while (mSize == mCapacity) {
+    while (mSize.load(std::memory_order_acquire) == mCapacity) {
+        mWriterWaiting.store(true);
+        if (mSize.load() < mCapacity) {
+            break;
+        }
         waited = true;
         pthread_cond_wait(&mSpaceAvailableCondition, mutex);
     }
+    mWriterWaiting.store(false);
     return waited;
 }
+
+void SensorEventQueue::grow() {
+    int newCapacity = std::min(mCapacity * 2, mMaxCapacity);
+    if (newCapacity <= mCapacity) {
+        return;
+    }
+    ALOGI("Growing sensor event queue from %d to %d", mCapacity, newCapacity);
+
+    // Move the readable records to the start of the new array.
+    sensors_event_t* newData = new sensors_event_t[newCapacity];
+    int size = getSize();
+    for (int i = 0; i < size; i++) {
+        newData[i] = mData[(mStart + i) % mCapacity];
+    }
+    delete[] mData;
+    mData = newData;
+    mStart = 0;
+    mEnd = size;
+    mCapacity = newCapacity;
+    mReportedCapacity.store(newCapacity, std::memory_order_relaxed);
+}
+
+SensorEventQueue::Stats SensorEventQueue::getStats() {
+    Stats stats;
+    stats.capacity = mReportedCapacity.load(std::memory_order_relaxed);
+    stats.maxCapacity = mMaxCapacity;
+    stats.highWaterMark = mHighWaterMark.load(std::memory_order_relaxed);
+    stats.stallCount = mStallCount.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -20,6 +20,8 @@
 #include <hardware/sensors.h>
 #include <pthread.h>
 
+#include <atomic>
+
 /*
  * Fixed-size circular queue, with an API developed around the sensor HAL poll() method.
  * Poll() takes a pointer to a buffer, which is written by poll() before it returns.
@@ -27,50 +29,102 @@
  * write to, instead of using an intermediate buffer and a memcpy.
  *
  * Thread safety:
- * Reading can be done safely after grabbing the mutex lock, while poll() writing in a separate
- * thread without a mutex lock. But there can only be one writer at a time.
+ * The queue is a single-producer / single-consumer ring. The write position is owned by the
+ * writer, the read position is owned by the reader, and the two only share an atomic count of
+ * readable items, so one writer thread and one reader thread may use the queue concurrently
+ * without any lock. There can only be one writer and one reader at a time.
+ *
+ * Adaptive sizing:
+ * A queue created with a maxCapacity larger than its capacity grows when its writer stalls on it.
+ * The reader doubles the capacity, up to maxCapacity, while the writer is blocked in
+ * waitForSpace(), so the writer never sees the data array change under it.
  */
 class SensorEventQueue {
     int mCapacity;
-    int mStart; // start of readable region
-    int mSize; // number of readable items
+    int mMaxCapacity;
+    int mStart; // start of readable region, owned by the reader
+    int mEnd; // start of writable region, owned by the writer
+    std::atomic<int> mSize; // number of readable items
     sensors_event_t* mData;
+
+    // Only used when the writer has to block on a full queue.
+    std::atomic<bool> mWriterWaiting;
+    bool mWriterBlocked; // guarded by mSpaceAvailableMutex
+    pthread_mutex_t mSpaceAvailableMutex;
     pthread_cond_t mSpaceAvailableCondition;
 
+    // Statistics, readable from any thread.
+    std::atomic<int> mReportedCapacity;
+    std::atomic<int> mHighWaterMark;
+    std::atomic<int> mStallCount;
+
+    // Doubles the capacity, up to mMaxCapacity. Only call from the reader, while the writer is
+    // blocked in waitForSpace().
+    void grow();
+
 public:
+    struct Stats {
+        int capacity;
+        int maxCapacity;
+        int highWaterMark; // largest size() seen
+        int stallCount; // number of times the writer had to wait for space
+    };
+
     explicit SensorEventQueue(int capacity);
+    SensorEventQueue(int capacity, int maxCapacity);
     ~SensorEventQueue();
 
     // Returns length of region, between zero and min(capacity, requestedLength). If there is any
     // writable space, it will return a region of at least one. Because it must return
     // a pointer to a contiguous region, it may return smaller regions as we approach the end of
     // the data array.
-    // Only call while holding the lock.
+    // Only call from the writer.
     // The region is not marked internally in any way. Subsequent calls may return overlapping
     // regions. This class expects there to be exactly one writer at a time.
     int getWritableRegion(int requestedLength, sensors_event_t** out);
 
     // After writing to the region returned by getWritableRegion(), call this to indicate how
-    // many records were actually written.
+    // many records were actually written. The records become visible to the reader.
     // This increases size() by count.
-    // Only call while holding the lock.
+    // Only call from the writer.
     void markAsWritten(int count);
 
     // Gets the number of readable records.
-    // Only call while holding the lock.
     int getSize();
 
     // Returns pointer to the first readable record, or NULL if size() is zero.
-    // Only call this while holding the lock.
+    // Only call from the reader.
     sensors_event_t* peek();
 
-    // This will decrease the size by one, freeing up the oldest readable event's slot for writing.
-    // Only call while holding the lock.
+    // Returns length of the region of readable records starting with the oldest one, between zero
+    // and min(size(), requestedLength). Because it must return a pointer to a contiguous region,
+    // it may return fewer records than are readable when the records wrap around the end of the
+    // data array.
+    // Only call from the reader.
+    int getReadableRegion(int requestedLength, sensors_event_t** out);
+
+    // This will decrease the size by one, freeing up the oldest readable event's slot for writing,
+    // and wakes up the writer if it is blocked in waitForSpace().
+    // Only call from the reader.
     void dequeue();
 
+    // Same as dequeue(), for the count oldest records. After reading the region returned by
+    // getReadableRegion(), call this with the number of records that were consumed.
+    // Only call from the reader.
+    void markAsRead(int count);
+
     // Blocks until space is available. No-op if there is already space.
     // Returns true if it had to wait.
+    // Only call from the writer.
+    bool waitForSpace();
+
+    // Same as waitForSpace(), for callers that serialize all access to the queue with their own
+    // mutex. The mutex must be held by the caller, and is released while waiting.
+    // The queue does not grow while the writer waits here.
     bool waitForSpace(pthread_mutex_t* mutex);
+
+    // Can be called from any thread.
+    Stats getStats();
 };
 
 #endif // SENSOREVENTQUEUE_H_
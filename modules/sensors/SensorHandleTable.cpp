@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <limits.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+#include <log/log.h>
+
+#include "SensorHandleTable.h"
+
+SensorHandleTable::SensorHandleTable() {
+    // Global handle 0 is not used.
+    mGlobalToFull.push_back(std::make_pair(-1, -1));
+}
+
+int SensorHandleTable::add(int moduleIndex, int localHandle) {
+    int globalHandle = (int)mGlobalToFull.size();
+    mGlobalToFull.push_back(std::make_pair(moduleIndex, localHandle));
+
+    if (moduleIndex >= (int)mModules.size()) {
+        mModules.resize(moduleIndex + 1);
+    }
+    ModuleTable& module = mModules[moduleIndex];
+
+    if (module.sparse.empty()) {
+        if (module.globalHandles.empty()) {
+            module.firstLocalHandle = localHandle;
+        }
+        int first = std::min(module.firstLocalHandle, localHandle);
+        int last = std::max(module.firstLocalHandle + (int)module.globalHandles.size() - 1,
+                localHandle);
+        if ((int64_t)last - first < kMaxDenseRange) {
+            if (localHandle < module.firstLocalHandle) {
+                module.globalHandles.insert(module.globalHandles.begin(),
+                        module.firstLocalHandle - localHandle, -1);
+                module.firstLocalHandle = localHandle;
+            }
+            module.globalHandles.resize(last - first + 1, -1);
+            module.globalHandles[localHandle - first] = globalHandle;
+            return globalHandle;
+        }
+
+        ALOGI("Local handles of module %d span more than %d, using a sparse table",
+                moduleIndex, kMaxDenseRange);
+        for (size_t i = 0; i < module.globalHandles.size(); i++) {
+            if (module.globalHandles[i] >= 0) {
+                module.sparse.push_back(std::make_pair(module.firstLocalHandle + (int)i,
+                        module.globalHandles[i]));
+            }
+        }
+        module.globalHandles.clear();
+    }
+
+    auto entry = std::make_pair(localHandle, globalHandle);
+    module.sparse.insert(std::upper_bound(module.sparse.begin(), module.sparse.end(), entry),
+            entry);
+    return globalHandle;
+}
+
+void SensorHandleTable::remapEvents(int moduleIndex, sensors_event_t* events, int count) const {
+    if (moduleIndex < 0 || moduleIndex >= (int)mModules.size() ||
+            !mModules[moduleIndex].sparse.empty()) {
+        for (int i = 0; i < count; i++) {
+            int* handle = events[i].type == SENSOR_TYPE_META_DATA ?
+                    &events[i].meta_data.sensor : &events[i].sensor;
+            *handle = getGlobalHandle(moduleIndex, *handle);
+        }
+        return;
+    }
+
+    // Dense table: hoist the module's array out of the loop.
+    const int* globalHandles = mModules[moduleIndex].globalHandles.data();
+    const unsigned size = mModules[moduleIndex].globalHandles.size();
+    const int first = mModules[moduleIndex].firstLocalHandle;
+    for (int i = 0; i < count; i++) {
+        int* handle = events[i].type == SENSOR_TYPE_META_DATA ?
+                &events[i].meta_data.sensor : &events[i].sensor;
+        unsigned index = (unsigned)(*handle - first);
+        *handle = index < size ? globalHandles[index] : -1;
+    }
+}
+
+int SensorHandleTable::lookupSparse(const ModuleTable& module, int localHandle) {
+    auto it = std::lower_bound(module.sparse.begin(), module.sparse.end(),
+            std::make_pair(localHandle, INT_MIN));
+    if (it == module.sparse.end() || it->first != localHandle) {
+        return -1;
+    }
+    return it->second;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SENSORHANDLETABLE_H_
+#define SENSORHANDLETABLE_H_
+
+#include <hardware/sensors.h>
+
+#include <utility>
+#include <vector>
+
+/*
+ * Translation between the global sensor handles the multihal exposes and the (module index,
+ * local handle) pairs of its sub-HALs.
+ *
+ * Global handles are assigned consecutively, so they index an array directly. Local handles are
+ * usually small and contiguous within a module, so each module also gets an array indexed by
+ * local handle; only a module whose handles span more than kMaxDenseRange falls back to a sorted
+ * list. Per-event translation is therefore a couple of array loads.
+ *
+ * Thread safety:
+ * Build the table with add() before any lookups. Lookups may then run concurrently.
+ */
+class SensorHandleTable {
+public:
+    // Largest span of local handles in one module that is stored as an array.
+    static const int kMaxDenseRange = 4096;
+
+    SensorHandleTable();
+
+    // Assigns the next global handle to the sensor with this local handle in the module.
+    // Returns the global handle.
+    int add(int moduleIndex, int localHandle);
+
+    // Returns the global handle, or -1 if the sensor is unknown.
+    inline int getGlobalHandle(int moduleIndex, int localHandle) const {
+        if (moduleIndex < 0 || moduleIndex >= (int)mModules.size()) {
+            return -1;
+        }
+        const ModuleTable& module = mModules[moduleIndex];
+        // Unsigned comparison also rejects handles below the first one.
+        unsigned index = (unsigned)(localHandle - module.firstLocalHandle);
+        if (index < module.globalHandles.size()) {
+            return module.globalHandles[index];
+        }
+        return module.sparse.empty() ? -1 : lookupSparse(module, localHandle);
+    }
+
+    // Replaces the local handles of count events from the module with global handles, or with -1
+    // for unknown handles. Meta-data events have their nested sensor handle replaced instead.
+    void remapEvents(int moduleIndex, sensors_event_t* events, int count) const;
+
+    // Returns the local handle, or -1 if the global handle is unknown.
+    inline int getLocalHandle(int globalHandle) const {
+        return isValid(globalHandle) ? mGlobalToFull[globalHandle].second : -1;
+    }
+
+    // Returns the index of the module of the sensor, or -1 if the global handle is unknown.
+    inline int getModuleIndex(int globalHandle) const {
+        return isValid(globalHandle) ? mGlobalToFull[globalHandle].first : -1;
+    }
+
+    // Returns the number of global handles assigned.
+    int size() const { return (int)mGlobalToFull.size() - 1; }
+
+private:
+    struct ModuleTable {
+        int firstLocalHandle;
+        std::vector<int> globalHandles; // indexed by local handle - firstLocalHandle, or -1
+        std::vector<std::pair<int, int>> sparse; // sorted (local handle, global handle)
+    };
+
+    inline bool isValid(int globalHandle) const {
+        return globalHandle > 0 && globalHandle < (int)mGlobalToFull.size();
+    }
+
+    static int lookupSparse(const ModuleTable& module, int localHandle);
+
+    // (module index, local handle), indexed by global handle. Global handles start at 1.
+    std::vector<std::pair<int, int>> mGlobalToFull;
+    std::vector<ModuleTable> mModules;
+};
+
+#endif // SENSORHANDLETABLE_H_
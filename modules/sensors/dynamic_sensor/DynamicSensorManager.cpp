@@ -20,10 +20,12 @@
 #include "HidRawSensorDaemon.h"
 #include "DynamicSensorManager.h"
 
+#include <cutils/properties.h>
 #include <utils/Log.h>
 #include <utils/SystemClock.h>
 
 #include <cassert>
+#include <cinttypes>
 
 namespace android {
 namespace SensorHalExt {
@@ -40,7 +42,9 @@ DynamicSensorManager::DynamicSensorManager(
         int handleBase, int handleMax, SensorEventCallback* callback) :
         mHandleRange(handleBase, handleMax),
         mCallback(callback),
-        mFifo(callback ? 0 : kFifoSize),
+        mFifo(callback ? 0 : kFifoSize,
+              property_get_bool("sensor.dynamic_sensor_hal.fifo_drop_oldest", false)
+                      ? RingBuffer::DROP_OLDEST : RingBuffer::DROP_NEWEST),
         mNextHandle(handleBase+1) {
     assert(handleBase > 0 && handleMax > handleBase + 1); // handleBase is reserved
 
@@ -127,7 +131,6 @@ int DynamicSensorManager::flush(int handle) {
 
 int DynamicSensorManager::poll(sensors_event_t * data, int count) {
     assert(mCallback == nullptr);
-    std::lock_guard<std::mutex> lk(mFifoLock);
     return mFifo.read(data, count);
 }
 
@@ -220,9 +223,12 @@ int DynamicSensorManager::submitEvent(sp<BaseSensorObject> source, const sensors
         }
     } else {
         // standalone mode, add event to internal buffer for poll() to pick up
-        std::lock_guard<std::mutex> lk(mFifoLock);
-        if (mFifo.write(&event, 1) < 0) {
-            ALOGE("DynamicSensorManager fifo full");
+        if (mFifo.write(&event, 1) < 1) {
+            uint64_t dropped = mFifo.getDroppedNewestCount();
+            // only log on power-of-two drop counts so a stalled reader does not flood the log
+            if ((dropped & (dropped - 1)) == 0) {
+                ALOGE("DynamicSensorManager fifo full, %" PRIu64 " events dropped", dropped);
+            }
         }
     }
     return 0;
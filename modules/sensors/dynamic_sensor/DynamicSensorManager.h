@@ -110,9 +110,9 @@ private:
     // immutable pointer to event callback, used in extention mode.
     SensorEventCallback * const mCallback;
 
-    // RingBuffer used in standalone mode
+    // RingBuffer used in standalone mode, written lock-free from daemon threads and drained by
+    // poll(). Overflow policy is selected by sensor.dynamic_sensor_hal.fifo_drop_oldest.
     static constexpr size_t kFifoSize = 4096; //4K events
-    mutable std::mutex mFifoLock;
     RingBuffer mFifo;
 
     // mapping between handle and SensorObjects
@@ -24,6 +24,18 @@
 namespace android {
 namespace SensorHalExt {
 
+// Non-owning view of report payload bytes, the report id byte (if any) is not included.
+struct HidReportView {
+    const uint8_t *data;
+    size_t size;
+
+    HidReportView() : data(nullptr), size(0) {}
+    HidReportView(const uint8_t *d, size_t s) : data(d), size(s) {}
+    HidReportView(const std::vector<uint8_t> &v) : data(v.data()), size(v.size()) {}
+
+    const uint8_t &operator[](size_t i) const { return data[i]; }
+};
+
 class HidDevice : virtual public REF_BASE(HidDevice) {
 public:
     virtual ~HidDevice() = default;
@@ -48,9 +48,19 @@ HidRawDevice::HidRawDevice(
         return;
     }
 
+    mValid = init(usageSet);
+}
+
+HidRawDevice::HidRawDevice(
+        int fd, const HidDeviceInfo &info, const std::unordered_set<unsigned int> &usageSet)
+        : mDevFd(fd), mDeviceInfo(info), mMultiIdDevice(false), mValid(false) {
+    mValid = init(usageSet);
+}
+
+bool HidRawDevice::init(const std::unordered_set<unsigned int> &usageSet) {
     if (!generateDigest(usageSet)) {
         LOG_E << "Cannot parse hid descriptor" << LOG_ENDL;
-        return;
+        return false;
     }
 
     // digest error checking
@@ -61,26 +71,26 @@ HidRawDevice::HidRawDevice(
                         std::make_pair(packet.type, packet.id), &packet).second == false) {
                 LOG_E << "Same type - report id pair (" << packet.type << ", " << packet.id << ")"
                       << "is used by more than one usage collection" << LOG_ENDL;
-                return;
+                return false;
             }
             reportIdSet.insert(packet.id);
         }
     }
     if (mReportTypeIdMap.empty()) {
-        return;
+        return false;
     }
 
     if (reportIdSet.size() > 1) {
         if (reportIdSet.find(0) != reportIdSet.end()) {
             LOG_E << "Default report id 0 is not expected when more than one report id is found."
                   << LOG_ENDL;
-            return;
+            return false;
         }
         mMultiIdDevice = true;
     } else { // reportIdSet.size() == 1
         mMultiIdDevice = !(reportIdSet.find(0) != reportIdSet.end());
     }
-    mValid = true;
+    return true;
 }
 
 HidRawDevice::~HidRawDevice() {
@@ -295,13 +305,24 @@ bool HidRawDevice::sendReport(uint8_t id, std::vector<uint8_t> &data) {
 }
 
 bool HidRawDevice::receiveReport(uint8_t *id, std::vector<uint8_t> *data) {
+    HidReportView report;
+    if (!receiveReport(id, &report)) {
+        return false;
+    }
+    data->assign(report.data, report.data + report.size);
+    return true;
+}
+
+bool HidRawDevice::receiveReport(uint8_t *id, HidReportView *report) {
     if (mDevFd < 0) {
         return false;
     }
 
-    uint8_t buffer[256];
-    int res = ::read(mDevFd, buffer, 256);
+    int res = ::read(mDevFd, mReceiveBuffer, kReceiveBufferSize);
     if (res < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return false;
+        }
         LOG_E << "HidRawDevice::receiveReport: read returns " << res
               << " (" << ::strerror(res) << ")" << LOG_ENDL;
         return false;
@@ -312,13 +333,11 @@ bool HidRawDevice::receiveReport(uint8_t *id, std::vector<uint8_t> *data) {
             LOG_E << "read hidraw returns data too short, len: " << res << LOG_ENDL;
             return false;
         }
-        data->resize(static_cast<size_t>(res - 1));
-        std::copy(buffer + 1, buffer + res, data->begin());
-        *id = buffer[0];
+        *id = mReceiveBuffer[0];
+        *report = HidReportView(mReceiveBuffer + 1, static_cast<size_t>(res - 1));
     } else {
-        data->resize(static_cast<size_t>(res));
-        std::copy(buffer, buffer + res, data->begin());
         *id = 0;
+        *report = HidReportView(mReceiveBuffer, static_cast<size_t>(res));
     }
     return true;
 }
@@ -19,6 +19,7 @@
 #include "HidDevice.h"
 
 #include <HidParser.h>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <unordered_set>
@@ -46,7 +47,18 @@ public:
     virtual bool sendReport(uint8_t id, std::vector<uint8_t> &data) override;
     virtual bool receiveReport(uint8_t *id, std::vector<uint8_t> *data) override;
 
+    // receive one input report without copying it, *report points into an internal buffer that
+    // is only valid until the next receive call. Only call from one thread. If the device fd is
+    // non-blocking and no report is pending, returns false with errno set to EAGAIN.
+    bool receiveReport(uint8_t *id, HidReportView *report);
+
 protected:
+    // adopt an already opened device fd with known device info, used by host test and benchmark
+    // with a synthetic device in place of a hidraw node
+    HidRawDevice(int fd, const HidDeviceInfo &info, const std::unordered_set<unsigned int> &usageSet);
+
+    bool init(const std::unordered_set<unsigned int> &usageSet);
+    int getFd() const { return mDevFd; }
     bool populateDeviceInfo();
     size_t getReportSize(int type, uint8_t id);
     bool generateDigest(const std::unordered_set<uint32_t> &usage);
@@ -69,6 +81,10 @@ private:
     std::mutex mIoBufferLock;
     std::vector<uint8_t> mIoBuffer;
 
+    // hidraw hands out one report per read(), receive it in place
+    static constexpr size_t kReceiveBufferSize = 256;
+    uint8_t mReceiveBuffer[kReceiveBufferSize];
+
     int mDevFd;
     HidDeviceInfo mDeviceInfo;
     bool mMultiIdDevice;
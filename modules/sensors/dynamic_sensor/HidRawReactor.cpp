@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "HidRawReactor.h"
+#include "HidLog.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace android {
+namespace SensorHalExt {
+
+HidRawReactor::HidRawReactor()
+        : mEpollFd(-1), mWakeFd(-1), mValid(false), mDispatchingFd(-1), mExitPending(false) {
+    mEpollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (mEpollFd < 0) {
+        LOG_E << "HidRawReactor: epoll_create1 failed (" << ::strerror(errno) << ")" << LOG_ENDL;
+        return;
+    }
+
+    mWakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (mWakeFd < 0) {
+        LOG_E << "HidRawReactor: eventfd failed (" << ::strerror(errno) << ")" << LOG_ENDL;
+        return;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = mWakeFd;
+    if (::epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeFd, &ev) < 0) {
+        LOG_E << "HidRawReactor: cannot poll wake fd (" << ::strerror(errno) << ")" << LOG_ENDL;
+        return;
+    }
+
+    mThread = std::thread(&HidRawReactor::threadLoop, this);
+    mValid = true;
+}
+
+HidRawReactor::~HidRawReactor() {
+    if (mThread.joinable()) {
+        mExitPending = true;
+        uint64_t one = 1;
+        if (::write(mWakeFd, &one, sizeof(one)) < 0) {
+            LOG_E << "HidRawReactor: cannot wake reactor thread" << LOG_ENDL;
+        }
+        mThread.join();
+    }
+    if (mWakeFd >= 0) {
+        ::close(mWakeFd);
+    }
+    if (mEpollFd >= 0) {
+        ::close(mEpollFd);
+    }
+}
+
+bool HidRawReactor::add(int fd, Handler *handler) {
+    if (!mValid || fd < 0 || handler == nullptr) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lk(mLock);
+    if (!mHandlers.emplace(fd, handler).second) {
+        LOG_E << "HidRawReactor: fd " << fd << " added twice" << LOG_ENDL;
+        return false;
+    }
+
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (::epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        LOG_E << "HidRawReactor: cannot poll fd " << fd << " (" << ::strerror(errno) << ")"
+              << LOG_ENDL;
+        mHandlers.erase(fd);
+        return false;
+    }
+    return true;
+}
+
+void HidRawReactor::remove(int fd) {
+    std::unique_lock<std::mutex> lk(mLock);
+    detachLocked(fd);
+
+    // events already returned by epoll_wait are looked up again before dispatch, so only a
+    // handler that is running right now can still touch fd
+    if (std::this_thread::get_id() != mThread.get_id()) {
+        mDispatchDoneCondition.wait(lk, [this, fd] { return mDispatchingFd != fd; });
+    }
+}
+
+size_t HidRawReactor::size() const {
+    std::lock_guard<std::mutex> lk(mLock);
+    return mHandlers.size();
+}
+
+void HidRawReactor::detachLocked(int fd) {
+    if (mHandlers.erase(fd) > 0) {
+        ::epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+    }
+}
+
+void HidRawReactor::dispatch(int fd, uint32_t events) {
+    Handler *handler;
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        auto i = mHandlers.find(fd);
+        if (i == mHandlers.end()) {
+            return; // removed after epoll_wait returned
+        }
+        handler = i->second;
+        mDispatchingFd = fd;
+    }
+
+    // drain pending input before acting on a hang-up reported along with it
+    bool ok = true;
+    if (events & EPOLLIN) {
+        ok = handler->onReadable();
+    }
+    bool hangup = !ok || (events & (EPOLLHUP | EPOLLERR));
+
+    if (hangup) {
+        {
+            std::lock_guard<std::mutex> lk(mLock);
+            detachLocked(fd);
+        }
+        handler->onHangup();
+    }
+
+    {
+        std::lock_guard<std::mutex> lk(mLock);
+        mDispatchingFd = -1;
+    }
+    mDispatchDoneCondition.notify_all();
+}
+
+void HidRawReactor::threadLoop() {
+    LOG_V << "HidRawReactor thread started" << LOG_ENDL;
+    struct epoll_event events[kMaxEvents];
+
+    while (!mExitPending) {
+        int n = ::epoll_wait(mEpollFd, events, kMaxEvents, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_E << "HidRawReactor: epoll_wait failed (" << ::strerror(errno) << ")" << LOG_ENDL;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.fd == mWakeFd) {
+                uint64_t value;
+                if (::read(mWakeFd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                    LOG_E << "HidRawReactor: read wake fd failed" << LOG_ENDL;
+                }
+                continue;
+            }
+            dispatch(events[i].data.fd, events[i].events);
+        }
+    }
+    LOG_V << "HidRawReactor thread ended" << LOG_ENDL;
+}
+
+} // namespace SensorHalExt
+} // namespace android
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ANDROID_SENSORHAL_EXT_HIDRAW_REACTOR_H
+#define ANDROID_SENSORHAL_EXT_HIDRAW_REACTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace android {
+namespace SensorHalExt {
+
+// Single thread that epolls the fds of all connected hidraw devices and dispatches input to
+// their handlers, in place of one blocking reader thread per device.
+class HidRawReactor {
+public:
+    class Handler {
+    public:
+        virtual ~Handler() = default;
+
+        // fd is readable. Return false if the device failed and should no longer be polled.
+        virtual bool onReadable() = 0;
+
+        // fd reported hang-up or error (e.g. device unplugged) or onReadable() returned false.
+        // The fd has already been removed from the reactor, no further callback follows.
+        virtual void onHangup() {}
+    };
+
+    HidRawReactor();
+    ~HidRawReactor();
+
+    // test if epoll and the reactor thread are set up
+    bool isValid() const { return mValid; }
+
+    // start dispatching input on fd to handler. fd should be non-blocking.
+    bool add(int fd, Handler *handler);
+
+    // stop dispatching fd. On return handler is not running and will not be called again, so the
+    // handler can be destroyed. Can be called from a handler.
+    void remove(int fd);
+
+    // number of fds being polled
+    size_t size() const;
+
+private:
+    static constexpr int kMaxEvents = 16;
+
+    void threadLoop();
+    void dispatch(int fd, uint32_t events);
+    void detachLocked(int fd);
+
+    int mEpollFd;
+    int mWakeFd;
+    bool mValid;
+
+    mutable std::mutex mLock;
+    std::condition_variable mDispatchDoneCondition;
+    std::unordered_map<int, Handler *> mHandlers;
+    int mDispatchingFd;  // fd whose handler is running on the reactor thread, or -1
+
+    std::atomic<bool> mExitPending;
+    std::thread mThread;
+
+    HidRawReactor(const HidRawReactor &) = delete;
+    void operator=(const HidRawReactor &) = delete;
+};
+
+} // namespace SensorHalExt
+} // namespace android
+
+#endif // ANDROID_SENSORHAL_EXT_HIDRAW_REACTOR_H
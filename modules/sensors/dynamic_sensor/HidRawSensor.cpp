@@ -37,6 +37,7 @@ const std::string CUSTOM_TYPE_PREFIX("com.google.hardware.sensor.hid_dynamic.");
 HidRawSensor::HidRawSensor(
         SP(HidDevice) device, uint32_t usage, const std::vector<HidParser::ReportPacket> &packets)
         : mReportingStateId(-1), mPowerStateId(-1), mReportIntervalId(-1), mInputReportId(-1),
+        mInputReportMinSize(0), mDecoder(),
         mEnabled(false), mSamplingPeriod(1000LL*1000*1000), mBatchingPeriod(0),
         mDevice(device), mValid(false) {
     if (device == nullptr) {
@@ -216,6 +217,11 @@ HidRawSensor::HidRawSensor(
             LOG_I << "unsupported sensor usage " << usage << LOG_ENDL;
     }
 
+    for (const auto &rec : mTranslateTable) {
+        mInputReportMinSize = std::max(mInputReportMinSize, rec.byteOffset + rec.byteSize);
+    }
+    compileDecoder();
+
     bool sensorValid = validateFeatureValueAndBuildSensor();
     mValid = translationTableValid && sensorValid;
     LOG_V << "HidRawSensor init, translationTableValid: " << translationTableValid
@@ -1011,10 +1017,15 @@ int HidRawSensor::batch(int64_t samplingPeriod, int64_t batchingPeriod) {
     }
 }
 
-void HidRawSensor::handleInput(uint8_t id, const std::vector<uint8_t> &message) {
+void HidRawSensor::handleInput(uint8_t id, const HidReportView &message) {
     if (id != mInputReportId || mEnabled == false) {
         return;
     }
+    if (message.size < mInputReportMinSize) {
+        LOG_E << "Input report too short, " << message.size << " bytes, need "
+              << mInputReportMinSize << LOG_ENDL;
+        return;
+    }
     sensors_event_t event = {
         .version = sizeof(event),
         .sensor = -1,
@@ -1038,11 +1049,18 @@ void HidRawSensor::handleInput(uint8_t id, const std::vector<uint8_t> &message)
     generateEvent(event);
 }
 
-bool HidRawSensor::getHeadTrackerEventData(const std::vector<uint8_t> &message,
+bool HidRawSensor::getHeadTrackerEventData(const HidReportView &message,
                                            sensors_event_t *event) {
     head_tracker_event_t *head_tracker;
 
     head_tracker = &(event->head_tracker);
+    if (mDecoder.rawSize != 0 && mDecoder.count >= 7) {
+        // rx, ry, rz, vx, vy, vz overlay data[0, 6)
+        bool valid = decodeCompiled(message, 6, event->data);
+        return getReportFieldValue(message, &(mTranslateTable[6]),
+                                   &(head_tracker->discontinuity_count)) && valid;
+    }
+
     if (!getReportFieldValue(message, &(mTranslateTable[0]),
                              &(head_tracker->rx))
             || !getReportFieldValue(message, &(mTranslateTable[1]),
@@ -1063,8 +1081,16 @@ bool HidRawSensor::getHeadTrackerEventData(const std::vector<uint8_t> &message,
     return true;
 }
 
-bool HidRawSensor::getSensorEventData(const std::vector<uint8_t> &message,
+bool HidRawSensor::getSensorEventData(const HidReportView &message,
                                       sensors_event_t *event) {
+    if (mDecoder.rawSize == 0) {
+        return decodeTranslateTable(message, event);
+    }
+    return decodeCompiled(message, mDecoder.count, event->data);
+}
+
+bool HidRawSensor::decodeTranslateTable(const HidReportView &message,
+                                        sensors_event_t *event) {
     for (const auto &rec : mTranslateTable) {
         int64_t v = (message[rec.byteOffset + rec.byteSize - 1] & 0x80) ? -1 : 0;
         for (int i = static_cast<int>(rec.byteSize) - 1; i >= 0; --i) {
@@ -1093,6 +1119,59 @@ bool HidRawSensor::getSensorEventData(const std::vector<uint8_t> &message,
     return true;
 }
 
+void HidRawSensor::compileDecoder() {
+    mDecoder.rawSize = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // HID is little endian, fixed width loads are only valid on a little endian host
+    if (mTranslateTable.empty() || mTranslateTable.size() > kMaxCompiledFields) {
+        return;
+    }
+    size_t rawSize = mTranslateTable[0].byteSize;
+    if (rawSize != 2 && rawSize != 4) {
+        return;
+    }
+    const int64_t rawMax = rawSize == 2 ? INT16_MAX : INT32_MAX;
+    const int64_t rawMin = rawSize == 2 ? INT16_MIN : INT32_MIN;
+    for (size_t i = 0; i < mTranslateTable.size(); ++i) {
+        const auto &rec = mTranslateTable[i];
+        if (rec.type != TYPE_FLOAT || rec.byteSize != rawSize
+                || rec.index != static_cast<int>(i)
+                || rec.minValue > rec.maxValue || rec.minValue > rawMax || rec.maxValue < rawMin) {
+            return;
+        }
+    }
+
+    mDecoder.count = mTranslateTable.size();
+    for (size_t i = 0; i < mDecoder.count; ++i) {
+        const auto &rec = mTranslateTable[i];
+        mDecoder.byteOffset[i] = rec.byteOffset;
+        mDecoder.maxValue[i] = std::min(rec.maxValue, rawMax);
+        mDecoder.minValue[i] = std::max(rec.minValue, rawMin);
+        mDecoder.a[i] = rec.a;
+        mDecoder.b[i] = rec.b;
+    }
+    mDecoder.rawSize = rawSize;
+#endif
+}
+
+template<typename RawType>
+bool HidRawSensor::decodeCompiled(const HidReportView &message, size_t count, float *data) const {
+    bool valid = true;
+    for (size_t i = 0; i < count; ++i) {
+        RawType raw;
+        memcpy(&raw, message.data + mDecoder.byteOffset[i], sizeof(raw)); // unaligned load
+        valid &= (raw <= mDecoder.maxValue[i]) & (raw >= mDecoder.minValue[i]);
+        data[i] = mDecoder.a[i] * (raw + mDecoder.b[i]);
+    }
+    return valid;
+}
+
+bool HidRawSensor::decodeCompiled(const HidReportView &message, size_t count, float *data) const {
+    return mDecoder.rawSize == 2
+            ? decodeCompiled<int16_t>(message, count, data)
+            : decodeCompiled<int32_t>(message, count, data);
+}
+
 std::string HidRawSensor::dump() const {
     std::ostringstream ss;
     ss << "Feature Values " << LOG_ENDL
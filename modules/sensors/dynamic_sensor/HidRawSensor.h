@@ -33,6 +33,7 @@ using ReportItem = HidParser::ReportItem;
 class HidRawSensor : public BaseSensorObject {
     friend class HidRawSensorTest;
     friend class HidRawDeviceTest;
+    friend class HidRawSensorBenchmark;
 public:
     HidRawSensor(SP(HidDevice) device, uint32_t usage,
                  const std::vector<HidParser::ReportPacket> &report);
@@ -43,15 +44,15 @@ public:
     virtual int enable(bool enable);
     virtual int batch(int64_t samplePeriod, int64_t batchPeriod); // unit nano-seconds
 
-    // handle input report received
-    void handleInput(uint8_t id, const std::vector<uint8_t> &message);
+    // handle input report received, message is decoded in place
+    void handleInput(uint8_t id, const HidReportView &message);
 
     // get head tracker sensor event data
-    bool getHeadTrackerEventData(const std::vector<uint8_t> &message,
+    bool getHeadTrackerEventData(const HidReportView &message,
                                  sensors_event_t *event);
 
     // get generic sensor event data
-    bool getSensorEventData(const std::vector<uint8_t> &message,
+    bool getSensorEventData(const HidReportView &message,
                             sensors_event_t *event);
 
     // indicate if the HidRawSensor is a valid one
@@ -76,6 +77,21 @@ private:
         int64_t b;
     };
 
+    // Translate table compiled at construction into a flat layout. Only built when every field is
+    // TYPE_FLOAT with the same 2 or 4 byte size (rawSize) and field i maps to data[i], which covers
+    // tri-axis, quaternion and android custom sensors including head tracker; other tables use
+    // the generic loop.
+    static constexpr size_t kMaxCompiledFields = 16;
+    struct CompiledDecoder {
+        size_t rawSize;  // 0 if not compiled
+        size_t count;
+        uint32_t byteOffset[kMaxCompiledFields];
+        int32_t maxValue[kMaxCompiledFields];  // clamped to the range of the raw type
+        int32_t minValue[kMaxCompiledFields];
+        double a[kMaxCompiledFields];
+        double b[kMaxCompiledFields];
+    };
+
     // sensor related information parsed from HID descriptor
     struct FeatureValue {
         // information needed to furnish sensor_t structure (see hardware/sensors.h)
@@ -149,9 +165,20 @@ private:
     // process HID snesor spec defined orientation(quaternion) sensor usages.
     bool processQuaternionUsage(const std::vector<HidParser::ReportPacket> &packets);
 
+    // build mDecoder from mTranslateTable if the table layout allows
+    void compileDecoder();
+
+    // decode the first count fields with mDecoder into data[0, count)
+    template<typename RawType>
+    bool decodeCompiled(const HidReportView &message, size_t count, float *data) const;
+    bool decodeCompiled(const HidReportView &message, size_t count, float *data) const;
+
+    // decode with the generic per-field loop over mTranslateTable
+    bool decodeTranslateTable(const HidReportView &message, sensors_event_t *event);
+
     // get the value of a report field
     template<typename ValueType>
-    bool getReportFieldValue(const std::vector<uint8_t> &message,
+    bool getReportFieldValue(const HidReportView &message,
                              ReportTranslateRecord* rec, ValueType* value) {
         bool valid = true;
         int64_t v;
@@ -201,6 +228,9 @@ private:
     // Input report translate table
     std::vector<ReportTranslateRecord> mTranslateTable;
     unsigned mInputReportId;
+    // minimum input report size to cover all fields in mTranslateTable
+    size_t mInputReportMinSize;
+    CompiledDecoder mDecoder;
 
     FeatureValue mFeatureInfo;
     sensor_t mSensor;
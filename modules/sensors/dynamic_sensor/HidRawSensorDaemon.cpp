@@ -44,7 +44,7 @@ HidRawSensorDaemon::HidRawSensorDaemon(DynamicSensorManager& manager)
 
 BaseSensorVector HidRawSensorDaemon::createSensor(const std::string &deviceKey) {
     BaseSensorVector ret;
-    sp<HidRawSensorDevice> device(HidRawSensorDevice::create(deviceKey));
+    sp<HidRawSensorDevice> device(HidRawSensorDevice::create(deviceKey, &mReactor));
 
     if (device != nullptr) {
         ALOGV("created HidRawSensorDevice(%p) successfully on device %s contains %zu sensors",
@@ -18,6 +18,7 @@
 #define ANDROID_SENSORHAL_EXT_HIDRAW_SENSOR_DAEMON_H
 
 #include "BaseDynamicSensorDaemon.h"
+#include "HidRawReactor.h"
 
 #include <HidParser.h>
 #include <hardware/sensors.h>
@@ -52,6 +53,8 @@ private:
     class HidRawSensor;
     void registerExisting();
 
+    // reads input of all devices, declared first so it outlives them
+    HidRawReactor mReactor;
     sp<ConnectionDetector> mDetector;
     std::unordered_map<std::string, sp<HidRawSensorDevice>> mHidRawSensorDevices;
 };
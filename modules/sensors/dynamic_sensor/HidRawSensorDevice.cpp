@@ -19,6 +19,7 @@
 #include "HidSensorDef.h"
 
 #include <utils/Log.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <linux/input.h>
 #include <linux/hidraw.h>
@@ -35,8 +36,9 @@ using namespace Hid::Sensor::PropertyUsage;
 const std::unordered_set<unsigned int> HidRawSensorDevice::sInterested{
         ACCELEROMETER_3D, GYROMETER_3D, COMPASS_3D, CUSTOM};
 
-sp<HidRawSensorDevice> HidRawSensorDevice::create(const std::string &devName) {
-    sp<HidRawSensorDevice> device(new HidRawSensorDevice(devName));
+sp<HidRawSensorDevice> HidRawSensorDevice::create(
+        const std::string &devName, HidRawReactor *reactor) {
+    sp<HidRawSensorDevice> device(new HidRawSensorDevice(devName, reactor));
     // offset +1 strong count added by constructor
     device->decStrong(device.get());
 
@@ -47,9 +49,8 @@ sp<HidRawSensorDevice> HidRawSensorDevice::create(const std::string &devName) {
     }
 }
 
-HidRawSensorDevice::HidRawSensorDevice(const std::string &devName)
-        : RefBase(), HidRawDevice(devName, sInterested),
-          Thread(false /*canCallJava*/), mValid(false) {
+HidRawSensorDevice::HidRawSensorDevice(const std::string &devName, HidRawReactor *reactor)
+        : RefBase(), HidRawDevice(devName, sInterested), mReactor(reactor), mValid(false) {
     // create HidRawSensor objects from digest
     // HidRawSensor object will take sp<HidRawSensorDevice> as parameter, so increment strong count
     // to prevent "this" being destructed.
@@ -74,26 +75,35 @@ HidRawSensorDevice::HidRawSensorDevice(const std::string &devName)
         return;
     }
 
-    run("HidRawSensor");
+    // reactor drains each device until read() would block
+    int flags = ::fcntl(getFd(), F_GETFL);
+    if (flags < 0 || ::fcntl(getFd(), F_SETFL, flags | O_NONBLOCK) < 0) {
+        ALOGE("Cannot set hidraw fd non-blocking");
+        return;
+    }
+    if (!mReactor->add(getFd(), this)) {
+        return;
+    }
     mValid = true;
 }
 
 HidRawSensorDevice::~HidRawSensorDevice() {
     ALOGV("~HidRawSensorDevice %p", this);
-    requestExitAndWait();
-    ALOGV("~HidRawSensorDevice %p, thread exited", this);
+    if (mValid) {
+        mReactor->remove(getFd());
+    }
+    ALOGV("~HidRawSensorDevice %p, removed from reactor", this);
 }
 
-bool HidRawSensorDevice::threadLoop() {
-    ALOGV("Hid Raw Device thread started %p", this);
-    std::vector<uint8_t> buffer;
-    bool ret;
+bool HidRawSensorDevice::onReadable() {
+    HidReportView report;
     uint8_t usageId;
 
-    while(!Thread::exitPending()) {
-        ret = receiveReport(&usageId, &buffer);
-        if (!ret) {
-            break;
+    for (int n = 0; n < kMaxReportsPerWakeup; ++n) {
+        errno = 0;
+        if (!receiveReport(&usageId, &report)) {
+            // EAGAIN: drained; errno 0: malformed report, already logged; otherwise read failed
+            return errno == 0 || errno == EAGAIN || errno == EWOULDBLOCK;
         }
 
         auto i = mSensors.find(usageId);
@@ -102,11 +112,14 @@ bool HidRawSensorDevice::threadLoop() {
             continue;
         }
 
-        i->second->handleInput(usageId, buffer);
+        i->second->handleInput(usageId, report);
     }
+    return true;
+}
 
-    ALOGI("Hid Raw Device thread ended for %p", this);
-    return false;
+void HidRawSensorDevice::onHangup() {
+    // the device node is gone or failed, connection detector will remove this device
+    ALOGI("Hid Raw Device %p hung up", this);
 }
 
 BaseSensorVector HidRawSensorDevice::getSensors() const {
@@ -19,31 +19,36 @@
 #include "BaseSensorObject.h"
 #include "BaseDynamicSensorDaemon.h" // BaseSensorVector
 #include "HidRawDevice.h"
+#include "HidRawReactor.h"
 #include "HidRawSensor.h"
 
 #include <HidParser.h>
-#include <utils/Thread.h>
 #include <string>
 #include <vector>
 
 namespace android {
 namespace SensorHalExt {
 
-class HidRawSensorDevice : public HidRawDevice, public Thread {
+// Input reports are read on the shared reactor thread rather than a thread per device.
+class HidRawSensorDevice : public HidRawDevice, public HidRawReactor::Handler {
 public:
-    static sp<HidRawSensorDevice> create(const std::string &devName);
+    static sp<HidRawSensorDevice> create(const std::string &devName, HidRawReactor *reactor);
     virtual ~HidRawSensorDevice();
 
     // get a list of sensors associated with this device
     BaseSensorVector getSensors() const;
 private:
     static const std::unordered_set<unsigned int> sInterested;
+    // reports handled per wake-up before yielding to other devices on the reactor
+    static constexpr int kMaxReportsPerWakeup = 16;
 
     // constructor will result in +1 strong count
-    explicit HidRawSensorDevice(const std::string &devName);
-    // implement function of Thread
-    virtual bool threadLoop() override;
+    HidRawSensorDevice(const std::string &devName, HidRawReactor *reactor);
+    // implement HidRawReactor::Handler
+    virtual bool onReadable() override;
+    virtual void onHangup() override;
     std::unordered_map<unsigned int/*reportId*/, sp<HidRawSensor>> mSensors;
+    HidRawReactor *mReactor;
     bool mValid;
 };
 
@@ -16,89 +16,146 @@
 
 #include "RingBuffer.h"
 
-#include <stdlib.h>
-#include <string.h>
+#include <sys/types.h>
 
 namespace android {
 
-RingBuffer::RingBuffer(size_t size)
-    : mSize(size),
-      mData((sensors_event_t *)malloc(sizeof(sensors_event_t) * mSize)),
+namespace {
+size_t roundUpToPowerOfTwo(size_t size) {
+    size_t result = 1;
+    while (result < size) {
+        result <<= 1;
+    }
+    return result;
+}
+} // namespace
+
+RingBuffer::RingBuffer(size_t size, OverflowPolicy policy)
+    : mPolicy(policy),
+      mMask(size ? roundUpToPowerOfTwo(size) - 1 : 0),
+      mCells(size ? new Cell[mMask + 1] : nullptr),
+      mWritePos(0),
       mReadPos(0),
-      mWritePos(0) {
+      mReaderWaiting(false),
+      mDroppedNewest(0),
+      mDroppedOldest(0) {
+    for (size_t i = 0; mCells && i <= mMask; ++i) {
+        mCells[i].sequence.store(i, std::memory_order_relaxed);
+    }
 }
 
 RingBuffer::~RingBuffer() {
-    free(mData);
-    mData = NULL;
 }
 
-ssize_t RingBuffer::write(const sensors_event_t *ev, size_t size) {
-    Mutex::Autolock autoLock(mLock);
-
-    size_t numAvailableToRead = mWritePos - mReadPos;
-    size_t numAvailableToWrite = mSize - numAvailableToRead;
-
-    if (size > numAvailableToWrite) {
-        size = numAvailableToWrite;
-    }
-
-    size_t writePos = (mWritePos % mSize);
-    size_t copy = mSize - writePos;
-
-    if (copy > size) {
-        copy = size;
+// Bounded queue after Dmitry Vyukov's MPMC design: a position is claimed with a CAS, and the
+// cell's sequence number tells whether it is free, published or still being written.
+bool RingBuffer::push(const sensors_event_t &ev) {
+    size_t pos = mWritePos.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+        cell = &mCells[pos & mMask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (mWritePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; // full
+        } else {
+            pos = mWritePos.load(std::memory_order_relaxed);
+        }
     }
+    cell->event = ev;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
 
-    memcpy(&mData[writePos], ev, copy * sizeof(sensors_event_t));
-
-    if (size > copy) {
-        memcpy(mData, &ev[copy], (size - copy) * sizeof(sensors_event_t));
+// The consumer and, under DROP_OLDEST, producers making room can pop concurrently.
+bool RingBuffer::pop(sensors_event_t *ev) {
+    size_t pos = mReadPos.load(std::memory_order_relaxed);
+    Cell *cell;
+    for (;;) {
+        cell = &mCells[pos & mMask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (mReadPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false; // empty
+        } else {
+            pos = mReadPos.load(std::memory_order_relaxed);
+        }
     }
-
-    mWritePos += size;
-
-    if (numAvailableToRead == 0 && size > 0) {
-        mNotEmptyCondition.broadcast();
+    if (ev != nullptr) {
+        *ev = cell->event;
     }
-
-    return size;
+    cell->sequence.store(pos + mMask + 1, std::memory_order_release);
+    return true;
 }
 
-ssize_t RingBuffer::read(sensors_event_t *ev, size_t size) {
-    Mutex::Autolock autoLock(mLock);
+ssize_t RingBuffer::write(const sensors_event_t *ev, size_t size) {
+    if (!mCells) {
+        mDroppedNewest.fetch_add(size, std::memory_order_relaxed);
+        return 0;
+    }
 
-    size_t numAvailableToRead;
-    for (;;) {
-        numAvailableToRead = mWritePos - mReadPos;
-        if (numAvailableToRead > 0) {
+    size_t written = 0;
+    for (size_t i = 0; i < size; ++i) {
+        bool pushed = push(ev[i]);
+        if (mPolicy == DROP_OLDEST) {
+            while (!pushed) {
+                if (pop(nullptr)) {
+                    mDroppedOldest.fetch_add(1, std::memory_order_relaxed);
+                }
+                pushed = push(ev[i]);
+            }
+        } else if (!pushed) {
+            mDroppedNewest.fetch_add(size - i, std::memory_order_relaxed);
             break;
         }
-
-        mNotEmptyCondition.wait(mLock);
+        ++written;
     }
 
-    if (size > numAvailableToRead) {
-        size = numAvailableToRead;
+    // Pairs with the fence in read(): either the reader sees the events just published, or we
+    // see that it is waiting.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (written > 0 && mReaderWaiting.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lk(mLock);
+        mNotEmptyCondition.notify_all();
     }
+    return written;
+}
 
-    size_t readPos = (mReadPos % mSize);
-    size_t copy = mSize - readPos;
-
-    if (copy > size) {
-        copy = size;
+ssize_t RingBuffer::read(sensors_event_t *ev, size_t size) {
+    if (!mCells || size == 0) {
+        return 0;
     }
 
-    memcpy(ev, &mData[readPos], copy * sizeof(sensors_event_t));
-
-    if (size > copy) {
-        memcpy(&ev[copy], mData, (size - copy) * sizeof(sensors_event_t));
+    size_t count = 0;
+    while (count < size && pop(&ev[count])) {
+        ++count;
+    }
+    if (count > 0) {
+        return count;
     }
 
-    mReadPos += size;
-
-    return size;
+    std::unique_lock<std::mutex> lk(mLock);
+    for (;;) {
+        mReaderWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (count < size && pop(&ev[count])) {
+            ++count;
+        }
+        if (count > 0) {
+            break;
+        }
+        mNotEmptyCondition.wait(lk);
+    }
+    mReaderWaiting.store(false, std::memory_order_relaxed);
+    return count;
 }
 
 }  // namespace android
-
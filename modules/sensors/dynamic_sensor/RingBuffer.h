@@ -18,30 +18,74 @@
 
 #define RING_BUFFER_H_
 
-#include <media/stagefright/foundation/ABase.h>
-
 #include <hardware/sensors.h>
-#include <utils/threads.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 
 namespace android {
 
+// Bounded multi-producer / single-consumer event FIFO.
+//
+// Producers never take a lock: each event is claimed and published through a per-slot sequence
+// number, so many sensor threads can write concurrently. The consumer blocks in read() while the
+// buffer is empty; producers only touch the wake-up mutex when the consumer is actually waiting.
 class RingBuffer {
 public:
-    explicit RingBuffer(size_t size);
+    // What write() does with an event that does not fit.
+    enum OverflowPolicy {
+        DROP_NEWEST, // discard the event being written
+        DROP_OLDEST, // discard the oldest unread event to make room
+    };
+
+    // size is rounded up to a power of two.
+    explicit RingBuffer(size_t size, OverflowPolicy policy = DROP_NEWEST);
     ~RingBuffer();
 
+    // Can be called from any thread. Returns the number of events written, which is less than size
+    // if events were dropped under DROP_NEWEST.
     ssize_t write(const sensors_event_t *ev, size_t size);
+
+    // Only call from the consumer. Blocks until at least one event is available, and returns the
+    // number of events read.
     ssize_t read(sensors_event_t *ev, size_t size);
 
+    OverflowPolicy getOverflowPolicy() const { return mPolicy; }
+    // Number of events dropped because the buffer was full.
+    uint64_t getDroppedNewestCount() const { return mDroppedNewest.load(std::memory_order_relaxed); }
+    uint64_t getDroppedOldestCount() const { return mDroppedOldest.load(std::memory_order_relaxed); }
+
 private:
-    Mutex mLock;
-    Condition mNotEmptyCondition;
+    struct Cell {
+        // Equal to the position of the cell when it can be written, and to that position plus one
+        // once the event is published.
+        std::atomic<size_t> sequence;
+        sensors_event_t event;
+    };
+
+    bool push(const sensors_event_t &ev);
+    bool pop(sensors_event_t *ev);
+
+    const OverflowPolicy mPolicy;
+    size_t mMask;
+    std::unique_ptr<Cell[]> mCells;
+
+    // Producers and consumer update these from different cores, keep them on separate lines.
+    alignas(64) std::atomic<size_t> mWritePos;
+    alignas(64) std::atomic<size_t> mReadPos;
+
+    alignas(64) std::atomic<bool> mReaderWaiting;
+    std::mutex mLock;
+    std::condition_variable mNotEmptyCondition;
 
-    size_t mSize;
-    sensors_event_t *mData;
-    size_t mReadPos, mWritePos;
+    std::atomic<uint64_t> mDroppedNewest;
+    std::atomic<uint64_t> mDroppedOldest;
 
-    DISALLOW_EVIL_CONSTRUCTORS(RingBuffer);
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
 };
 
 }  // namespace android
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Per-report cost of HidRawDevice::receiveReport() into a std::vector versus the in-place
+// HidReportView path. A SOCK_SEQPACKET socketpair stands in for the hidraw node: like hidraw it
+// hands out exactly one report per read().
+
+#include "HidRawDevice.h"
+#include "HidSensorDef.h"
+#include "TestHidDescriptor.h"
+
+#include <benchmark/benchmark.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <vector>
+
+namespace android {
+namespace SensorHalExt {
+
+class SyntheticHidRawDevice : public HidRawDevice {
+public:
+    SyntheticHidRawDevice(int fd, const HidDeviceInfo &info)
+            : HidRawDevice(fd, info, {Hid::Sensor::SensorTypeUsage::ACCELEROMETER_3D}) {}
+};
+
+namespace {
+
+// reports written per iteration, small enough to fit in the socket buffer
+constexpr int kBurst = 32;
+
+struct Fixture {
+    int fds[2];
+    std::unique_ptr<SyntheticHidRawDevice> device;
+    std::vector<uint8_t> report;
+
+    explicit Fixture(size_t reportSize) : report(reportSize) {
+        if (::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) != 0) {
+            fds[0] = fds[1] = -1;
+            return;
+        }
+        const TestHidDescriptor *d = findTestDescriptor("accel3");
+        HidDevice::HidDeviceInfo info = {
+            .name = "synthetic",
+            .physicalPath = "",
+            .busType = "Virtual",
+            .vendorId = 0,
+            .productId = 0,
+            .descriptor = std::vector<uint8_t>(d->data, d->data + d->len),
+        };
+        // the device owns and closes fds[0]
+        device.reset(new SyntheticHidRawDevice(fds[0], info));
+        for (size_t i = 0; i < reportSize; ++i) {
+            report[i] = static_cast<uint8_t>(i);
+        }
+    }
+
+    ~Fixture() {
+        if (fds[1] >= 0) {
+            ::close(fds[1]);
+        }
+    }
+
+    void fill() {
+        for (int i = 0; i < kBurst; ++i) {
+            if (::write(fds[1], report.data(), report.size()) < 0) {
+                break;
+            }
+        }
+    }
+};
+
+} // namespace
+
+static void BM_ReceiveVector(benchmark::State &state) {
+    Fixture f(state.range(0));
+    if (f.device == nullptr || !f.device->isValid()) {
+        state.SkipWithError("cannot create synthetic device");
+        return;
+    }
+    std::vector<uint8_t> buffer;
+    uint8_t id;
+    uint64_t sum = 0;
+    for (auto _ : state) {
+        f.fill();
+        for (int i = 0; i < kBurst; ++i) {
+            f.device->receiveReport(&id, &buffer);
+            sum += buffer[buffer.size() - 1];
+        }
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * kBurst);
+}
+
+static void BM_ReceiveView(benchmark::State &state) {
+    Fixture f(state.range(0));
+    if (f.device == nullptr || !f.device->isValid()) {
+        state.SkipWithError("cannot create synthetic device");
+        return;
+    }
+    HidReportView report;
+    uint8_t id;
+    uint64_t sum = 0;
+    for (auto _ : state) {
+        f.fill();
+        for (int i = 0; i < kBurst; ++i) {
+            f.device->receiveReport(&id, &report);
+            sum += report[report.size - 1];
+        }
+    }
+    benchmark::DoNotOptimize(sum);
+    state.SetItemsProcessed(state.iterations() * kBurst);
+}
+
+BENCHMARK(BM_ReceiveVector)->Arg(8)->Arg(32)->Arg(128);
+BENCHMARK(BM_ReceiveView)->Arg(8)->Arg(32)->Arg(128);
+
+} // namespace SensorHalExt
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Delivering input reports from 1 to 64 simulated hidraw devices, with one blocking reader thread
+// per device (the previous HidRawSensorDevice scheme) and with a single HidRawReactor. Devices are
+// SOCK_SEQPACKET socketpairs. Reports a "threads" counter and context switches per report.
+
+#include "HidRawReactor.h"
+
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace SensorHalExt {
+
+namespace {
+
+constexpr int kReportSize = 16;
+// reports written per iteration, spread round-robin over the devices
+constexpr int kReportsPerIteration = 256;
+
+// Counts delivered reports and wakes the benchmark thread once a target is reached.
+class Completion {
+public:
+    void expect(int64_t target) {
+        std::lock_guard<std::mutex> lk(mLock);
+        mTarget = target;
+    }
+    void delivered() {
+        if (++mDelivered == mTarget.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lk(mLock);
+            mCondition.notify_one();
+        }
+    }
+    void wait() {
+        std::unique_lock<std::mutex> lk(mLock);
+        mCondition.wait(lk, [this] { return mDelivered >= mTarget; });
+    }
+
+private:
+    std::mutex mLock;
+    std::condition_variable mCondition;
+    std::atomic<int64_t> mDelivered{0};
+    std::atomic<int64_t> mTarget{0};
+};
+
+struct SimulatedDevice : public HidRawReactor::Handler {
+    int fds[2];
+    Completion *completion;
+
+    SimulatedDevice(Completion *c, bool nonBlocking) : completion(c) {
+        ::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds);
+        if (nonBlocking) {
+            ::fcntl(fds[0], F_SETFL, ::fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+        }
+    }
+    ~SimulatedDevice() {
+        ::close(fds[0]);
+        ::close(fds[1]);
+    }
+
+    void send() {
+        uint8_t report[kReportSize] = {};
+        benchmark::DoNotOptimize(::write(fds[1], report, sizeof(report)));
+    }
+
+    // reactor path, same drain limit as HidRawSensorDevice
+    virtual bool onReadable() override {
+        uint8_t report[kReportSize];
+        for (int n = 0; n < 16 && ::read(fds[0], report, sizeof(report)) > 0; ++n) {
+            completion->delivered();
+        }
+        return true;
+    }
+
+    // thread per device path, until the socket is shut down
+    void blockingLoop() {
+        uint8_t report[kReportSize];
+        while (::read(fds[0], report, sizeof(report)) > 0) {
+            completion->delivered();
+        }
+    }
+};
+
+long contextSwitches() {
+    struct rusage usage;
+    ::getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+void run(benchmark::State &state, std::vector<std::unique_ptr<SimulatedDevice>> &devices,
+         Completion &completion) {
+    int64_t total = 0;
+    long switches = contextSwitches();
+    for (auto _ : state) {
+        total += kReportsPerIteration;
+        completion.expect(total);
+        for (int i = 0; i < kReportsPerIteration; ++i) {
+            devices[i % devices.size()]->send();
+        }
+        completion.wait();
+    }
+    switches = contextSwitches() - switches;
+    state.SetItemsProcessed(total);
+    state.counters["ctxsw_per_report"] =
+            benchmark::Counter(static_cast<double>(switches) / (total ? total : 1));
+}
+
+} // namespace
+
+static void BM_ThreadPerDevice(benchmark::State &state) {
+    const int count = state.range(0);
+    Completion completion;
+    std::vector<std::unique_ptr<SimulatedDevice>> devices;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < count; ++i) {
+        devices.emplace_back(new SimulatedDevice(&completion, false));
+        threads.emplace_back(&SimulatedDevice::blockingLoop, devices.back().get());
+    }
+
+    run(state, devices, completion);
+    state.counters["threads"] = count;
+
+    for (auto &d : devices) {
+        ::shutdown(d->fds[0], SHUT_RDWR);
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+}
+
+static void BM_Reactor(benchmark::State &state) {
+    const int count = state.range(0);
+    Completion completion;
+    std::vector<std::unique_ptr<SimulatedDevice>> devices;
+    HidRawReactor reactor;
+    for (int i = 0; i < count; ++i) {
+        devices.emplace_back(new SimulatedDevice(&completion, true));
+        reactor.add(devices.back()->fds[0], devices.back().get());
+    }
+
+    run(state, devices, completion);
+    state.counters["threads"] = 1;
+
+    for (auto &d : devices) {
+        reactor.remove(d->fds[0]);
+    }
+}
+
+BENCHMARK(BM_ThreadPerDevice)->RangeMultiplier(4)->Range(1, 64)->UseRealTime();
+BENCHMARK(BM_Reactor)->RangeMultiplier(4)->Range(1, 64)->UseRealTime();
+
+} // namespace SensorHalExt
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "HidRawReactorTest"
+
+#include "HidLog.h"
+#include "HidRawReactor.h"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace android {
+namespace SensorHalExt {
+
+namespace {
+
+// Stands in for a hidraw device: reads SOCK_SEQPACKET messages written to the other end.
+class TestDevice : public HidRawReactor::Handler {
+public:
+    TestDevice() : mReads(0), mHangups(0), mReadDelayMs(0) {
+        if (::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0, mFds) != 0) {
+            mFds[0] = mFds[1] = -1;
+        }
+    }
+    ~TestDevice() {
+        closePeer();
+        if (mFds[0] >= 0) {
+            ::close(mFds[0]);
+        }
+    }
+
+    int fd() const { return mFds[0]; }
+    void send() {
+        uint8_t report[8] = {};
+        if (::write(mFds[1], report, sizeof(report)) < 0) {
+            LOG_E << "write failed" << LOG_ENDL;
+        }
+    }
+    void closePeer() {
+        if (mFds[1] >= 0) {
+            ::close(mFds[1]);
+            mFds[1] = -1;
+        }
+    }
+
+    virtual bool onReadable() override {
+        uint8_t report[8];
+        while (::read(mFds[0], report, sizeof(report)) > 0) {
+            ++mReads;
+        }
+        if (mReadDelayMs > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(mReadDelayMs));
+        }
+        return true;
+    }
+    virtual void onHangup() override { ++mHangups; }
+
+    int mFds[2];
+    std::atomic<int> mReads;
+    std::atomic<int> mHangups;
+    int mReadDelayMs;
+};
+
+template <typename Predicate>
+bool waitFor(Predicate p) {
+    for (int i = 0; i < 200; ++i) {
+        if (p()) {
+            return true;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return false;
+}
+
+} // namespace
+
+class HidRawReactorTest {
+public:
+    static bool test() {
+        bool ret = true;
+        ret &= testDispatch();
+        ret &= testHangup();
+        ret &= testRemoveWaitsForHandler();
+        return ret;
+    }
+
+private:
+    static bool testDispatch() {
+        HidRawReactor reactor;
+        TestDevice a, b;
+        if (!reactor.add(a.fd(), &a) || !reactor.add(b.fd(), &b)) {
+            LOG_E << "add failed" << LOG_ENDL;
+            return false;
+        }
+        for (int i = 0; i < 10; ++i) {
+            a.send();
+            b.send();
+        }
+        bool ok = waitFor([&] { return a.mReads == 10 && b.mReads == 10; });
+        reactor.remove(a.fd());
+        reactor.remove(b.fd());
+        if (!ok) {
+            LOG_E << "dispatch: reads " << a.mReads << ", " << b.mReads << LOG_ENDL;
+        }
+        return ok;
+    }
+
+    // unplug: the peer going away must detach the device once instead of spinning on EPOLLHUP
+    static bool testHangup() {
+        HidRawReactor reactor;
+        TestDevice a, b;
+        reactor.add(a.fd(), &a);
+        reactor.add(b.fd(), &b);
+        a.send();
+        a.closePeer();
+        bool ok = waitFor([&] { return a.mHangups == 1 && reactor.size() == 1; });
+        ok &= a.mReads == 1;
+        b.send();
+        ok &= waitFor([&] { return b.mReads == 1; });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ok &= a.mHangups == 1 && b.mHangups == 0;
+        reactor.remove(a.fd());
+        reactor.remove(b.fd());
+        if (!ok) {
+            LOG_E << "hangup: hangups " << a.mHangups << ", " << b.mHangups << " size "
+                  << reactor.size() << LOG_ENDL;
+        }
+        return ok;
+    }
+
+    static bool testRemoveWaitsForHandler() {
+        HidRawReactor reactor;
+        TestDevice a;
+        a.mReadDelayMs = 100;
+        reactor.add(a.fd(), &a);
+        a.send();
+        waitFor([&] { return a.mReads == 1; });
+        auto start = std::chrono::steady_clock::now();
+        reactor.remove(a.fd());
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        // handler was sleeping inside onReadable when remove() was called
+        bool ok = elapsed >= std::chrono::milliseconds(50);
+        if (!ok) {
+            LOG_E << "remove returned while handler was running" << LOG_ENDL;
+        }
+        return ok;
+    }
+};
+
+} // namespace SensorHalExt
+} // namespace android
+
+int main() {
+    return android::SensorHalExt::HidRawReactorTest::test() ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Input report decoding in HidRawSensor: the generic per-field loop over the translate table
+// against the decoder compiled at construction.
+
+#include "HidRawSensor.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <vector>
+
+namespace android {
+namespace SensorHalExt {
+
+class HidRawSensorBenchmark {
+public:
+    // A sensor with count TYPE_FLOAT fields of rawSize bytes packed from offset 0.
+    static SP(HidRawSensor) createSensor(size_t count, size_t rawSize) {
+        SP(HidRawSensor) sensor =
+                std::make_shared<HidRawSensor>(nullptr, 0, std::vector<HidParser::ReportPacket>());
+        for (size_t i = 0; i < count; ++i) {
+            HidRawSensor::ReportTranslateRecord record = {
+                .type = HidRawSensor::TYPE_FLOAT,
+                .index = static_cast<int>(i),
+                .maxValue = rawSize == 2 ? INT16_MAX : INT32_MAX,
+                .minValue = rawSize == 2 ? INT16_MIN : INT32_MIN,
+                .byteOffset = i * rawSize,
+                .byteSize = rawSize,
+                .a = 0.001 * (i + 1),
+                .b = 0,
+            };
+            sensor->mTranslateTable.push_back(record);
+        }
+        sensor->compileDecoder();
+        return sensor;
+    }
+
+    static bool decodeLoop(HidRawSensor *sensor, const HidReportView &message,
+                           sensors_event_t *event) {
+        return sensor->decodeTranslateTable(message, event);
+    }
+
+    static bool decodeCompiled(HidRawSensor *sensor, const HidReportView &message,
+                               sensors_event_t *event) {
+        return sensor->getSensorEventData(message, event);
+    }
+};
+
+namespace {
+
+std::vector<uint8_t> makeReport(size_t size) {
+    std::vector<uint8_t> report(size);
+    for (size_t i = 0; i < size; ++i) {
+        report[i] = static_cast<uint8_t>(i * 37 + 11);
+    }
+    return report;
+}
+
+template <bool (*Decode)(HidRawSensor *, const HidReportView &, sensors_event_t *)>
+void BM_Decode(benchmark::State &state) {
+    const size_t count = state.range(0);
+    const size_t rawSize = state.range(1);
+    SP(HidRawSensor) sensor = HidRawSensorBenchmark::createSensor(count, rawSize);
+    std::vector<uint8_t> report = makeReport(count * rawSize);
+    HidReportView message(report);
+
+    // both paths must agree before timing either of them
+    sensors_event_t expected = {}, actual = {};
+    HidRawSensorBenchmark::decodeLoop(sensor.get(), message, &expected);
+    HidRawSensorBenchmark::decodeCompiled(sensor.get(), message, &actual);
+    if (memcmp(expected.data, actual.data, sizeof(float) * count) != 0) {
+        state.SkipWithError("compiled decoder does not match translate table loop");
+        return;
+    }
+
+    sensors_event_t event = {};
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Decode(sensor.get(), message, &event));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// {field count, field size}: tri-axis 16 bit, head tracker 32 bit, full custom 16 bit
+void decodeArgs(benchmark::internal::Benchmark *b) {
+    b->Args({3, 2})->Args({7, 4})->Args({16, 2});
+}
+
+BENCHMARK_TEMPLATE(BM_Decode, HidRawSensorBenchmark::decodeLoop)->Apply(decodeArgs);
+BENCHMARK_TEMPLATE(BM_Decode, HidRawSensorBenchmark::decodeCompiled)->Apply(decodeArgs);
+
+} // namespace
+
+} // namespace SensorHalExt
+} // namespace android
+
+BENCHMARK_MAIN();
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define LOG_TAG "RingBufferTest"
+
+#include "HidLog.h"
+#include "RingBuffer.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace SensorHalExt {
+
+class RingBufferTest {
+public:
+    static bool test() {
+        bool ret = true;
+        ret &= testOverflow(RingBuffer::DROP_NEWEST);
+        ret &= testOverflow(RingBuffer::DROP_OLDEST);
+        ret &= testConcurrentWriters(RingBuffer::DROP_NEWEST);
+        ret &= testConcurrentWriters(RingBuffer::DROP_OLDEST);
+        return ret;
+    }
+
+private:
+    static constexpr size_t kSize = 64;
+
+    static sensors_event_t makeEvent(int32_t sensor, int64_t seq) {
+        sensors_event_t ev = {};
+        ev.sensor = sensor;
+        ev.timestamp = seq;
+        return ev;
+    }
+
+    // Fill past capacity from one thread and check which events survive.
+    static bool testOverflow(RingBuffer::OverflowPolicy policy) {
+        RingBuffer fifo(kSize, policy);
+        for (size_t i = 0; i < kSize * 2; ++i) {
+            sensors_event_t ev = makeEvent(0, i);
+            fifo.write(&ev, 1);
+        }
+
+        std::vector<sensors_event_t> out(kSize * 2);
+        ssize_t n = fifo.read(out.data(), out.size());
+        int64_t first = policy == RingBuffer::DROP_NEWEST ? 0 : kSize;
+        uint64_t dropped = policy == RingBuffer::DROP_NEWEST
+                ? fifo.getDroppedNewestCount() : fifo.getDroppedOldestCount();
+        if (n != (ssize_t)kSize || dropped != kSize) {
+            LOG_E << "overflow policy " << policy << ": read " << n << " dropped " << dropped
+                  << LOG_ENDL;
+            return false;
+        }
+        for (ssize_t i = 0; i < n; ++i) {
+            if (out[i].timestamp != first + i) {
+                LOG_E << "overflow policy " << policy << ": event " << i << " has seq "
+                      << out[i].timestamp << LOG_ENDL;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Several writers against one blocking reader; every event is either delivered in per-writer
+    // order or counted as dropped.
+    static bool testConcurrentWriters(RingBuffer::OverflowPolicy policy) {
+        constexpr int kWriters = 4;
+        constexpr int64_t kPerWriter = 200000;
+        RingBuffer fifo(kSize, policy);
+        bool ret = true;
+        uint64_t received = 0;
+        std::thread reader([&fifo, &ret, &received] {
+            int64_t last[kWriters] = {-1, -1, -1, -1};
+            std::vector<sensors_event_t> out(16);
+            for (;;) {
+                ssize_t n = fifo.read(out.data(), out.size());
+                for (ssize_t i = 0; i < n; ++i) {
+                    int w = out[i].sensor;
+                    if (w == kWriters) {
+                        return; // stop marker
+                    }
+                    if (out[i].timestamp <= last[w]) {
+                        LOG_E << "writer " << w << " out of order: " << out[i].timestamp
+                              << " after " << last[w] << LOG_ENDL;
+                        ret = false;
+                    }
+                    last[w] = out[i].timestamp;
+                    ++received;
+                }
+            }
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> writers;
+        for (int w = 0; w < kWriters; ++w) {
+            writers.emplace_back([&fifo, w] {
+                for (int64_t i = 0; i < kPerWriter; ++i) {
+                    sensors_event_t ev = makeEvent(w, i);
+                    fifo.write(&ev, 1);
+                }
+            });
+        }
+        for (auto &t : writers) {
+            t.join();
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        // the stop marker is the newest event once writers are done, retry until it fits
+        sensors_event_t stop = makeEvent(kWriters, 0);
+        uint64_t stopRetries = 0;
+        while (fifo.write(&stop, 1) != 1) {
+            ++stopRetries;
+            std::this_thread::yield();
+        }
+        reader.join();
+
+        uint64_t dropped =
+                fifo.getDroppedNewestCount() + fifo.getDroppedOldestCount() - stopRetries;
+
+        if (received + dropped != (uint64_t)kWriters * kPerWriter) {
+            LOG_E << "policy " << policy << ": lost events, received " << received << " dropped "
+                  << dropped << LOG_ENDL;
+            ret = false;
+        }
+        LOG_V << "policy " << policy << ": " << kWriters << " writers, received " << received
+              << " dropped " << dropped << " in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << " ms"
+              << LOG_ENDL;
+        return ret;
+    }
+};
+
+}// namespace SensorHalExt
+}// namespace android
+
+int main() {
+    return android::SensorHalExt::RingBufferTest::test() ? 0 : 1;
+}
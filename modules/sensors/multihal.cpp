@@ -14,40 +14,63 @@
  * limitations under the License.
  */
 
+#include "SensorEventMerger.h"
 #include "SensorEventQueue.h"
+#include "SensorHandleTable.h"
 #include "multihal.h"
 
 #define LOG_NDEBUG 1
+#define ATRACE_TAG ATRACE_TAG_HAL
 #include <log/log.h>
 #include <cutils/atomic.h>
+#include <cutils/properties.h>
 #include <hardware/sensors.h>
+#include <utils/SystemClock.h>
+#include <utils/Timers.h>
+#include <utils/Trace.h>
 
+#include <algorithm>
+#include <atomic>
 #include <vector>
 #include <string>
 #include <fstream>
-#include <map>
+#include <functional>
+#include <sstream>
+#include <thread>
 
 #include <dirent.h>
 #include <dlfcn.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <math.h>
 #include <poll.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 
 static pthread_mutex_t init_modules_mutex = PTHREAD_MUTEX_INITIALIZER;
 static pthread_mutex_t init_sensors_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-// This mutex is shared by all queues
-static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-// Used to pause the multihal poll(). Broadcasted by sub-polling tasks if waiting_for_data.
-static pthread_cond_t data_available_cond = PTHREAD_COND_INITIALIZER;
-bool waiting_for_data = false;
+// Used to pause the multihal poll(). Signaled by sub-polling tasks if waiting_for_data.
+// The queues themselves are lock-free, each one having a single writer task and poll() as its
+// only reader.
+static int data_available_fd = -1;
+static std::atomic<bool> waiting_for_data(false);
+
+static void signal_data_available() {
+    // Sequentially consistent with the store in wait_for_data(), so either poll() sees the
+    // events just written or we see that it is about to block.
+    if (waiting_for_data.load()) {
+        ALOGV("writerTask - signal data_available_fd");
+        uint64_t one = 1;
+        TEMP_FAILURE_RETRY(write(data_available_fd, &one, sizeof(one)));
+    }
+}
 
 // Vector of sub modules, whose indexes are referred to in this file as module_index.
 static std::vector<hw_module_t *> *sub_hw_modules = nullptr;
@@ -56,78 +79,62 @@ static std::vector<hw_module_t *> *sub_hw_modules = nullptr;
 static std::vector<void *> *so_handles = nullptr;
 
 /*
- * Comparable class that globally identifies a sensor, by module index and local handle.
+ * Translates between global handles and (module index, local handle) pairs.
  * A module index is the module's index in sub_hw_modules.
  * A local handle is the handle the sub-module assigns to a sensor.
+ * Built in lazy_init_sensors_list(), and read-only afterwards.
  */
-struct FullHandle {
-    int moduleIndex;
-    int localHandle;
-
-    bool operator<(const FullHandle &that) const {
-        if (moduleIndex < that.moduleIndex) {
-            return true;
-        }
-        if (moduleIndex > that.moduleIndex) {
-            return false;
-        }
-        return localHandle < that.localHandle;
-    }
-
-    bool operator==(const FullHandle &that) const {
-        return moduleIndex == that.moduleIndex && localHandle == that.localHandle;
-    }
-};
-
-std::map<int, FullHandle> global_to_full;
-std::map<FullHandle, int> full_to_global;
-int next_global_handle = 1;
+static SensorHandleTable handle_table;
 
 static int assign_global_handle(int module_index, int local_handle) {
-    int global_handle = next_global_handle++;
-    FullHandle full_handle;
-    full_handle.moduleIndex = module_index;
-    full_handle.localHandle = local_handle;
-    full_to_global[full_handle] = global_handle;
-    global_to_full[global_handle] = full_handle;
-    return global_handle;
+    return handle_table.add(module_index, local_handle);
 }
 
 // Returns the local handle, or -1 if it does not exist.
 static int get_local_handle(int global_handle) {
-    if (global_to_full.count(global_handle) == 0) {
-        ALOGW("Unknown global_handle %d", global_handle);
-        return -1;
-    }
-    return global_to_full[global_handle].localHandle;
+    int local_handle = handle_table.getLocalHandle(global_handle);
+    ALOGW_IF(local_handle < 0, "Unknown global_handle %d", global_handle);
+    return local_handle;
 }
 
 // Returns the sub_hw_modules index of the module that contains the sensor associates with this
 // global_handle, or -1 if that global_handle does not exist.
 static int get_module_index(int global_handle) {
-    if (global_to_full.count(global_handle) == 0) {
-        ALOGW("Unknown global_handle %d", global_handle);
-        return -1;
-    }
-    FullHandle f = global_to_full[global_handle];
-    ALOGV("FullHandle for global_handle %d: moduleIndex %d, localHandle %d",
-            global_handle, f.moduleIndex, f.localHandle);
-    return f.moduleIndex;
+    int module_index = handle_table.getModuleIndex(global_handle);
+    ALOGW_IF(module_index < 0, "Unknown global_handle %d", global_handle);
+    return module_index;
 }
 
-// Returns the global handle for this full_handle, or -1 if the full_handle is unknown.
-static int get_global_handle(FullHandle* full_handle) {
-    int global_handle = -1;
-    if (full_to_global.count(*full_handle)) {
-        global_handle = full_to_global[*full_handle];
-    } else {
-        ALOGW("Unknown FullHandle: moduleIndex %d, localHandle %d",
-            full_handle->moduleIndex, full_handle->localHandle);
-    }
+// Returns the global handle for this sensor, or -1 if it is unknown.
+static inline int get_global_handle(int module_index, int local_handle) {
+    int global_handle = handle_table.getGlobalHandle(module_index, local_handle);
+    ALOGW_IF(global_handle < 0, "Unknown handle: moduleIndex %d, localHandle %d",
+            module_index, local_handle);
     return global_handle;
 }
 
+// Default queue sizing, unless set for the sub-HAL in the config file. Queues start at the
+// capacity and grow up to the max capacity while their sub-HAL stalls on them.
 static const int SENSOR_EVENT_QUEUE_CAPACITY = 36;
+static const int SENSOR_EVENT_QUEUE_MAX_CAPACITY = SENSOR_EVENT_QUEUE_CAPACITY * 8;
+
+/*
+ * One line of the multihal config file:
+ *   <path of the sub-HAL .so> [<queue capacity> [<max queue capacity>]]
+ */
+struct SubHalConfig {
+    std::string path;
+    int queueCapacity;
+    int maxQueueCapacity;
+};
+
+// Configs of the sub modules, parallel to sub_hw_modules.
+static std::vector<SubHalConfig> *sub_hal_configs = nullptr;
+
+// When set to a positive number of milliseconds, poll() returns events ordered by timestamp
+// across all sub-HALs, holding events back for at most this long. Otherwise the queues are read
+// round-robin.
+static const char* REORDER_WINDOW_PROPERTY = "sensor.multihal.reorder_window_ms";
 
 struct TaskContext {
   sensors_poll_device_t* device;
@@ -142,13 +149,10 @@ void *writerTask(void* ptr) {
     sensors_event_t* buffer;
     int eventsPolled;
     while (1) {
-        pthread_mutex_lock(&queue_mutex);
-        if (queue->waitForSpace(&queue_mutex)) {
+        if (queue->waitForSpace()) {
             ALOGV("writerTask waited for space");
         }
-        int bufferSize = queue->getWritableRegion(SENSOR_EVENT_QUEUE_CAPACITY, &buffer);
-        // Do blocking poll outside of lock
-        pthread_mutex_unlock(&queue_mutex);
+        int bufferSize = queue->getWritableRegion(INT_MAX, &buffer);
 
         ALOGV("writerTask before poll() - bufferSize = %d", bufferSize);
         eventsPolled = device->poll(device, buffer, bufferSize);
@@ -160,14 +164,9 @@ void *writerTask(void* ptr) {
             }
             continue;
         }
-        pthread_mutex_lock(&queue_mutex);
         queue->markAsWritten(eventsPolled);
         ALOGV("writerTask wrote %d events", eventsPolled);
-        if (waiting_for_data) {
-            ALOGV("writerTask - broadcast data_available_cond");
-            pthread_cond_broadcast(&data_available_cond);
-        }
-        pthread_mutex_unlock(&queue_mutex);
+        signal_data_available();
     }
     // never actually returns
     return NULL;
@@ -190,11 +189,12 @@ struct sensors_poll_context_t {
      */
     sensors_poll_device_1 proxy_device; // must be first
 
-    void addSubHwDevice(struct hw_device_t*);
+    void addSubHwDevice(struct hw_device_t*, const SubHalConfig&);
 
     int activate(int handle, int enabled);
     int setDelay(int handle, int64_t ns);
     int poll(sensors_event_t* data, int count);
+    int poll_ordered(sensors_event_t* data, int count);
     int batch(int handle, int flags, int64_t period_ns, int64_t timeout);
     int flush(int handle);
     int inject_sensor_data(const sensors_event_t *data);
@@ -204,11 +204,13 @@ struct sensors_poll_context_t {
                              int channel_handle,
                              const struct sensors_direct_cfg_t *config);
     int close();
+    void logQueueStats();
 
     std::vector<hw_device_t*> sub_hw_devices;
     std::vector<SensorEventQueue*> queues;
     std::vector<pthread_t> threads;
     int nextReadIndex;
+    SensorEventMerger* merger; // null unless events are merged by timestamp
 
     sensors_poll_device_t* get_v0_device_by_handle(int global_handle);
     sensors_poll_device_1_t* get_v1_device_by_handle(int global_handle);
@@ -216,13 +218,20 @@ struct sensors_poll_context_t {
     int get_device_version_by_handle(int global_handle);
 
     void copy_event_remap_handle(sensors_event_t* src, sensors_event_t* dest, int sub_index);
+    int copy_events_remap_handles(sensors_event_t* dest, sensors_event_t* src, int count,
+            int sub_index);
+    bool has_data();
+    void wait_for_data();
+    void sleep_for_data(int64_t timeout_ns);
 };
 
-void sensors_poll_context_t::addSubHwDevice(struct hw_device_t* sub_hw_device) {
+void sensors_poll_context_t::addSubHwDevice(struct hw_device_t* sub_hw_device,
+        const SubHalConfig& config) {
     ALOGV("addSubHwDevice");
     this->sub_hw_devices.push_back(sub_hw_device);
 
-    SensorEventQueue *queue = new SensorEventQueue(SENSOR_EVENT_QUEUE_CAPACITY);
+    SensorEventQueue *queue = new SensorEventQueue(config.queueCapacity,
+            config.maxQueueCapacity);
     this->queues.push_back(queue);
 
     TaskContext* taskContext = new TaskContext();
@@ -342,64 +351,163 @@ void sensors_poll_context_t::copy_event_remap_handle(sensors_event_t* dest, sens
     // A normal event's "sensor" field is a local handle. Convert it to a global handle.
     // A meta-data event must have its sensor set to 0, but it has a nested event
     // with a local handle that needs to be converted to a global handle.
-    FullHandle full_handle;
-    full_handle.moduleIndex = sub_index;
 
     // If it's a metadata event, rewrite the inner payload, not the sensor field.
     // If the event's sensor field is unregistered for any reason, rewrite the sensor field
     // with a -1, instead of writing an incorrect but plausible sensor number, because
-    // get_global_handle() returns -1 for unknown FullHandles.
+    // get_global_handle() returns -1 for unknown handles.
     if (dest->type == SENSOR_TYPE_META_DATA) {
-        full_handle.localHandle = dest->meta_data.sensor;
-        dest->meta_data.sensor = get_global_handle(&full_handle);
+        dest->meta_data.sensor = get_global_handle(sub_index, dest->meta_data.sensor);
     } else {
-        full_handle.localHandle = dest->sensor;
-        dest->sensor = get_global_handle(&full_handle);
+        dest->sensor = get_global_handle(sub_index, dest->sensor);
     }
 }
 
+// Same as copy_event_remap_handle(), for count events. Events with bad handles are dropped.
+// Returns the number of events copied.
+int sensors_poll_context_t::copy_events_remap_handles(sensors_event_t* dest, sensors_event_t* src,
+        int count, int sub_index) {
+    memcpy(dest, src, count * sizeof(struct sensors_event_t));
+    handle_table.remapEvents(sub_index, dest, count);
+
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        if (dest[i].sensor == SENSORS_HANDLE_BASE - 1) {
+            // Bad handle, do not pass corrupted event upstream !
+            ALOGW("Dropping bad local handle event packet on the floor");
+            continue;
+        }
+        if (kept != i) {
+            dest[kept] = dest[i];
+        }
+        kept++;
+    }
+    return kept;
+}
+
+bool sensors_poll_context_t::has_data() {
+    for (SensorEventQueue* queue : this->queues) {
+        if (queue->getSize() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void sensors_poll_context_t::wait_for_data() {
+    waiting_for_data.store(true);
+    // Check again after publishing waiting_for_data, in case a writer task wrote its events
+    // before it could see the flag.
+    if (!has_data()) {
+        sleep_for_data(-1);
+    }
+    waiting_for_data.store(false);
+}
+
+// Blocks until a writer task signals new data, or until timeout_ns has passed if it is not
+// negative. Only call with waiting_for_data set.
+void sensors_poll_context_t::sleep_for_data(int64_t timeout_ns) {
+    if (timeout_ns >= 0) {
+        struct pollfd pfd = { .fd = data_available_fd, .events = POLLIN, .revents = 0 };
+        struct timespec timeout = {
+            .tv_sec = (time_t)(timeout_ns / 1000000000),
+            .tv_nsec = (long)(timeout_ns % 1000000000),
+        };
+        if (TEMP_FAILURE_RETRY(ppoll(&pfd, 1, &timeout, NULL)) <= 0) {
+            return;
+        }
+    }
+    uint64_t count;
+    TEMP_FAILURE_RETRY(read(data_available_fd, &count, sizeof(count)));
+}
+
 int sensors_poll_context_t::poll(sensors_event_t *data, int maxReads) {
     ALOGV("poll");
+    if (this->merger != nullptr) {
+        return this->poll_ordered(data, maxReads);
+    }
     int empties = 0;
     int queueCount = 0;
     int eventsRead = 0;
 
-    pthread_mutex_lock(&queue_mutex);
     queueCount = (int)this->queues.size();
     while (eventsRead == 0) {
         while (empties < queueCount && eventsRead < maxReads) {
             SensorEventQueue* queue = this->queues.at(this->nextReadIndex);
-            sensors_event_t* event = queue->peek();
-            if (event == NULL) {
+            // Move a run of events at a time, but only a fair share of the remaining space.
+            int share = std::max(1, (maxReads - eventsRead) / queueCount);
+            sensors_event_t* events;
+            int count = queue->getReadableRegion(share, &events);
+            if (count == 0) {
                 empties++;
             } else {
                 empties = 0;
-                this->copy_event_remap_handle(&data[eventsRead], event, nextReadIndex);
-                if (data[eventsRead].sensor == SENSORS_HANDLE_BASE - 1) {
-                    // Bad handle, do not pass corrupted event upstream !
-                    ALOGW("Dropping bad local handle event packet on the floor");
-                } else {
-                    eventsRead++;
-                }
-                queue->dequeue();
+                eventsRead += this->copy_events_remap_handles(&data[eventsRead], events, count,
+                        nextReadIndex);
+                queue->markAsRead(count);
             }
             this->nextReadIndex = (this->nextReadIndex + 1) % queueCount;
         }
         if (eventsRead == 0) {
             // The queues have been scanned and none contain data, so wait.
             ALOGV("poll stopping to wait for data");
-            waiting_for_data = true;
-            pthread_cond_wait(&data_available_cond, &queue_mutex);
-            waiting_for_data = false;
+            wait_for_data();
             empties = 0;
         }
     }
-    pthread_mutex_unlock(&queue_mutex);
     ALOGV("poll returning %d events.", eventsRead);
 
     return eventsRead;
 }
 
+// Same as poll(), but merges the queues so that events are returned in timestamp order.
+int sensors_poll_context_t::poll_ordered(sensors_event_t *data, int maxReads) {
+    int eventsRead = 0;
+    bool waiting = false;
+
+    while (eventsRead == 0) {
+        int64_t wait_ns = -1;
+        this->merger->reset(this->queues);
+        while (eventsRead < maxReads) {
+            int index = this->merger->pop(android::elapsedRealtimeNano(), &wait_ns);
+            if (index < 0) {
+                break;
+            }
+            SensorEventQueue* queue = this->queues[index];
+            this->copy_event_remap_handle(&data[eventsRead], queue->peek(), index);
+            if (data[eventsRead].sensor == SENSORS_HANDLE_BASE - 1) {
+                // Bad handle, do not pass corrupted event upstream !
+                ALOGW("Dropping bad local handle event packet on the floor");
+            } else {
+                eventsRead++;
+            }
+            queue->dequeue();
+            this->merger->push(queue, index);
+        }
+        if (eventsRead == 0) {
+            if (!waiting) {
+                // Publish waiting_for_data, then look at the queues once more, in case a writer
+                // task wrote its events before it could see the flag.
+                waiting_for_data.store(true);
+                waiting = true;
+                continue;
+            }
+            // Nothing can be delivered yet; wait for new data, or for the oldest held back
+            // event to leave the reorder window.
+            ALOGV("poll_ordered stopping to wait for data, timeout %" PRId64 " ns", wait_ns);
+            this->sleep_for_data(wait_ns);
+            waiting_for_data.store(false);
+            waiting = false;
+        }
+    }
+    if (waiting) {
+        waiting_for_data.store(false);
+    }
+    ALOGV("poll_ordered returning %d events.", eventsRead);
+
+    return eventsRead;
+}
+
 int sensors_poll_context_t::batch(int handle, int flags, int64_t period_ns, int64_t timeout) {
     ALOGV("batch");
     int retval = -EINVAL;
@@ -499,6 +607,8 @@ int sensors_poll_context_t::config_direct_report(int sensor_handle,
 }
 int sensors_poll_context_t::close() {
     ALOGV("close");
+    // Report how the event queues were sized against the load they saw, to help tune hals.conf.
+    logQueueStats();
     for (std::vector<hw_device_t*>::iterator it = this->sub_hw_devices.begin();
             it != this->sub_hw_devices.end(); it++) {
         hw_device_t* dev = *it;
@@ -508,12 +618,22 @@ int sensors_poll_context_t::close() {
     return 0;
 }
 
+void sensors_poll_context_t::logQueueStats() {
+    for (size_t i = 0; i < this->queues.size(); i++) {
+        const hw_device_t* device = this->sub_hw_devices[i];
+        SensorEventQueue::Stats stats = this->queues[i]->getStats();
+        ALOGI("event queue %zu (%s): capacity %d (max %d), high-water mark %d, stalls %d", i,
+                device->module->name, stats.capacity, stats.maxCapacity,
+                stats.highWaterMark, stats.stallCount);
+    }
+}
 
 static int device__close(struct hw_device_t *dev) {
     pthread_mutex_lock(&init_modules_mutex);
     sensors_poll_context_t* ctx = (sensors_poll_context_t*) dev;
     if (ctx != NULL) {
         int retval = ctx->close();
+        delete ctx->merger;
         delete ctx;
         return retval;
     }
@@ -523,6 +643,11 @@ static int device__close(struct hw_device_t *dev) {
         sub_hw_modules = nullptr;
     }
 
+    if (sub_hal_configs != nullptr) {
+        delete sub_hal_configs;
+        sub_hal_configs = nullptr;
+    }
+
     if (so_handles != nullptr) {
         for (auto handle : *so_handles) {
             dlclose(handle);
@@ -588,11 +713,41 @@ static int open_sensors(const struct hw_module_t* module, const char* name,
         struct hw_device_t** device);
 
 /*
- * Adds valid paths from the config file to the vector passed in.
- * The vector must not be null.
+ * Parses one line of the config file. Returns false if the line has no path.
+ */
+static bool parse_sub_hal_config(const std::string& line, SubHalConfig* config) {
+    std::istringstream fields(line);
+    if (!(fields >> config->path)) {
+        return false;
+    }
+    config->queueCapacity = SENSOR_EVENT_QUEUE_CAPACITY;
+    config->maxQueueCapacity = SENSOR_EVENT_QUEUE_MAX_CAPACITY;
+    int capacity;
+    if (fields >> capacity) {
+        if (capacity > 0) {
+            config->queueCapacity = capacity;
+            config->maxQueueCapacity = std::max(capacity, SENSOR_EVENT_QUEUE_MAX_CAPACITY);
+        } else {
+            ALOGW("Ignoring invalid queue capacity %d for %s", capacity, config->path.c_str());
+        }
+        int max_capacity;
+        if (fields >> max_capacity) {
+            if (max_capacity >= config->queueCapacity) {
+                config->maxQueueCapacity = max_capacity;
+            } else {
+                ALOGW("Ignoring invalid max queue capacity %d for %s", max_capacity,
+                        config->path.c_str());
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Returns the sub-HAL configs from the config file.
  */
-static std::vector<std::string> get_so_paths() {
-    std::vector<std::string> so_paths;
+static std::vector<SubHalConfig> get_sub_hal_configs() {
+    std::vector<SubHalConfig> configs;
 
     const std::vector<const char *> config_path_list(
             { MULTI_HAL_CONFIG_FILE_PATH, DEPRECATED_MULTI_HAL_CONFIG_FILE_PATH });
@@ -609,7 +764,7 @@ static std::vector<std::string> get_so_paths() {
     }
     if(!stream) {
         ALOGW("No multihal config file found");
-        return so_paths;
+        return configs;
     }
 
     ALOGE_IF(strcmp(path, DEPRECATED_MULTI_HAL_CONFIG_FILE_PATH) == 0,
@@ -621,9 +776,82 @@ static std::vector<std::string> get_so_paths() {
     std::string line;
     while (std::getline(stream, line)) {
         ALOGV("config file line: '%s'", line.c_str());
-        so_paths.push_back(line);
+        SubHalConfig config;
+        if (parse_sub_hal_config(line, &config)) {
+            configs.push_back(config);
+        }
+    }
+    return configs;
+}
+
+/*
+ * A sub-HAL library loaded by load_module().
+ */
+struct LoadedModule {
+    void* lib_handle = nullptr;
+    hw_module_t* module = nullptr; // null if the library could not be loaded
+};
+
+/*
+ * dlopens the sub-HAL library of the config and looks up its module symbol.
+ * Runs concurrently for all sub-HALs, so it only touches its own result.
+ */
+static void load_module(const SubHalConfig& config, LoadedModule* result) {
+    const char* path = config.path.c_str();
+    ATRACE_NAME(path);
+    nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
+    const char* sym = HAL_MODULE_INFO_SYM_AS_STR;
+    dlerror(); // clear any old errors
+    void* lib_handle = dlopen(path, RTLD_LAZY);
+    if (lib_handle == NULL) {
+        ALOGW("dlerror(): %s", dlerror());
+    } else {
+        ALOGI("Loaded library from %s in %.1f ms", path,
+                (systemTime(SYSTEM_TIME_MONOTONIC) - start_time) / 1000000.0);
+        ALOGV("Opening symbol \"%s\"", sym);
+        // clear old errors
+        dlerror();
+        struct hw_module_t* module = (hw_module_t*) dlsym(lib_handle, sym);
+        const char* error;
+        if ((error = dlerror()) != NULL) {
+            ALOGW("Error calling dlsym: %s", error);
+        } else if (module == NULL) {
+            ALOGW("module == NULL");
+        } else {
+            ALOGV("Loaded symbols from \"%s\"", sym);
+            result->lib_handle = lib_handle;
+            result->module = module;
+            lib_handle = nullptr;
+        }
+    }
+    if (lib_handle != nullptr) {
+        dlclose(lib_handle);
     }
-    return so_paths;
+}
+
+/*
+ * The sensor list of one sub-module, as returned by its get_sensors_list().
+ */
+struct ModuleSensorList {
+    const struct sensor_t* list = nullptr;
+    int count = 0;
+};
+
+/*
+ * Runs concurrently for all sub-modules, so it only touches its own result.
+ */
+static void read_module_sensor_list(hw_module_t* hw_module, ModuleSensorList* result) {
+    ATRACE_NAME(hw_module->name);
+    nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
+    struct sensors_module_t *module = (struct sensors_module_t*) hw_module;
+    int count = module->get_sensors_list(module, &result->list);
+    if (count < 0) {
+        ALOGE("get_sensors_list() of %s failed: %d", hw_module->name, count);
+        count = 0;
+    }
+    result->count = count;
+    ALOGI("Read %d sensors from %s in %.1f ms", count, hw_module->name,
+            (systemTime(SYSTEM_TIME_MONOTONIC) - start_time) / 1000000.0);
 }
 
 /*
@@ -636,40 +864,34 @@ static void lazy_init_modules() {
         pthread_mutex_unlock(&init_modules_mutex);
         return;
     }
-    std::vector<std::string> so_paths(get_so_paths());
+    ATRACE_CALL();
+    nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
+    std::vector<SubHalConfig> configs(get_sub_hal_configs());
+
+    // dlopen the module files concurrently. Each one gets the slot of its config line, so that
+    // module indexes, and therefore global handles, follow the order of the config file.
+    std::vector<LoadedModule> loaded(configs.size());
+    std::vector<std::thread> loaders;
+    for (size_t i = 0; i < configs.size(); i++) {
+        loaders.emplace_back(load_module, std::cref(configs[i]), &loaded[i]);
+    }
+    for (auto& loader : loaders) {
+        loader.join();
+    }
 
-    // dlopen the module files and cache their module symbols in sub_hw_modules
+    // Cache the module symbols in sub_hw_modules
     sub_hw_modules = new std::vector<hw_module_t *>();
     so_handles = new std::vector<void *>();
-    dlerror(); // clear any old errors
-    const char* sym = HAL_MODULE_INFO_SYM_AS_STR;
-    for (const auto &s : so_paths) {
-        const char* path = s.c_str();
-        void* lib_handle = dlopen(path, RTLD_LAZY);
-        if (lib_handle == NULL) {
-            ALOGW("dlerror(): %s", dlerror());
-        } else {
-            ALOGI("Loaded library from %s", path);
-            ALOGV("Opening symbol \"%s\"", sym);
-            // clear old errors
-            dlerror();
-            struct hw_module_t* module = (hw_module_t*) dlsym(lib_handle, sym);
-            const char* error;
-            if ((error = dlerror()) != NULL) {
-                ALOGW("Error calling dlsym: %s", error);
-            } else if (module == NULL) {
-                ALOGW("module == NULL");
-            } else {
-                ALOGV("Loaded symbols from \"%s\"", sym);
-                sub_hw_modules->push_back(module);
-                so_handles->push_back(lib_handle);
-                lib_handle = nullptr;
-            }
-        }
-        if (lib_handle != nullptr) {
-            dlclose(lib_handle);
+    sub_hal_configs = new std::vector<SubHalConfig>();
+    for (size_t i = 0; i < configs.size(); i++) {
+        if (loaded[i].module != nullptr) {
+            sub_hw_modules->push_back(loaded[i].module);
+            so_handles->push_back(loaded[i].lib_handle);
+            sub_hal_configs->push_back(configs[i]);
         }
     }
+    ALOGI("Loaded %zu of %zu sub-HALs in %.1f ms", sub_hw_modules->size(), configs.size(),
+            (systemTime(SYSTEM_TIME_MONOTONIC) - start_time) / 1000000.0);
     pthread_mutex_unlock(&init_modules_mutex);
 }
 
@@ -687,15 +909,25 @@ static void lazy_init_sensors_list() {
     }
 
     ALOGV("lazy_init_sensors_list needs to do work");
+    ATRACE_CALL();
+    nsecs_t start_time = systemTime(SYSTEM_TIME_MONOTONIC);
     lazy_init_modules();
+    nsecs_t modules_time = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    // Read the sensor lists of all the sub-modules concurrently.
+    std::vector<ModuleSensorList> module_lists(sub_hw_modules->size());
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i < sub_hw_modules->size(); i++) {
+        readers.emplace_back(read_module_sensor_list, (*sub_hw_modules)[i], &module_lists[i]);
+    }
+    for (auto& reader : readers) {
+        reader.join();
+    }
 
     // Count all the sensors, then allocate an array of blanks.
     global_sensors_count = 0;
-    const struct sensor_t *subhal_sensors_list;
-    for (std::vector<hw_module_t*>::iterator it = sub_hw_modules->begin();
-            it != sub_hw_modules->end(); it++) {
-        struct sensors_module_t *module = (struct sensors_module_t*) *it;
-        global_sensors_count += module->get_sensors_list(module, &subhal_sensors_list);
+    for (const auto& module_list : module_lists) {
+        global_sensors_count += module_list.count;
         ALOGV("increased global_sensors_count to %d", global_sensors_count);
     }
 
@@ -705,15 +937,12 @@ static void lazy_init_sensors_list() {
 
     // index of the next sensor to set in mutable_sensor_list
     int mutable_sensor_index = 0;
-    int module_index = 0;
 
-    for (std::vector<hw_module_t*>::iterator it = sub_hw_modules->begin();
-            it != sub_hw_modules->end(); it++) {
-        hw_module_t *hw_module = *it;
+    // Global handles are assigned in module order, regardless of which list was read first.
+    for (int module_index = 0; module_index < (int)module_lists.size(); module_index++) {
         ALOGV("examine one module");
-        // Read the sub-module's sensor list.
-        struct sensors_module_t *module = (struct sensors_module_t*) hw_module;
-        int module_sensor_count = module->get_sensors_list(module, &subhal_sensors_list);
+        const struct sensor_t *subhal_sensors_list = module_lists[module_index].list;
+        int module_sensor_count = module_lists[module_index].count;
         ALOGV("the module has %d sensors", module_sensor_count);
 
         // Copy the HAL's sensor list into global_sensors_list,
@@ -740,11 +969,15 @@ static void lazy_init_sensors_list() {
 
             mutable_sensor_index++;
         }
-        module_index++;
     }
     // Set the const static global_sensors_list to the mutable one allocated by this function.
     global_sensors_list = mutable_sensor_list;
 
+    nsecs_t end_time = systemTime(SYSTEM_TIME_MONOTONIC);
+    ALOGI("Initialized %d sensors in %.1f ms (modules %.1f ms, sensor lists %.1f ms)",
+            global_sensors_count, (end_time - start_time) / 1000000.0,
+            (modules_time - start_time) / 1000000.0, (end_time - modules_time) / 1000000.0);
+
     pthread_mutex_unlock(&init_sensors_mutex);
     ALOGV("end lazy_init_sensors_list");
 }
@@ -790,6 +1023,15 @@ static int open_sensors(const struct hw_module_t* hw_module, const char* name,
 
     lazy_init_modules();
 
+    if (data_available_fd < 0) {
+        data_available_fd = eventfd(0, EFD_CLOEXEC);
+        if (data_available_fd < 0) {
+            int err = errno;
+            ALOGE("eventfd() failed: %s", strerror(err));
+            return -err;
+        }
+    }
+
     // Create proxy device, to return later.
     sensors_poll_context_t *dev = new sensors_poll_context_t();
     memset(dev, 0, sizeof(sensors_poll_device_1_t));
@@ -807,6 +1049,12 @@ static int open_sensors(const struct hw_module_t* hw_module, const char* name,
     dev->proxy_device.config_direct_report = device__config_direct_report;
 
     dev->nextReadIndex = 0;
+    dev->merger = nullptr;
+    int reorder_window_ms = property_get_int32(REORDER_WINDOW_PROPERTY, 0);
+    if (reorder_window_ms > 0) {
+        ALOGI("Merging sub-HAL events by timestamp, reorder window %d ms", reorder_window_ms);
+        dev->merger = new SensorEventMerger((int64_t)reorder_window_ms * 1000000);
+    }
 
     // Open() the subhal modules. Remember their devices in a vector parallel to sub_hw_modules.
     for (std::vector<hw_module_t*>::iterator it = sub_hw_modules->begin();
@@ -821,7 +1069,7 @@ static int open_sensors(const struct hw_module_t* hw_module, const char* name,
                         apiNumToStr(sub_hw_device->version));
                 ALOGE("Sensors belonging to this HAL will get ignored !");
             }
-            dev->addSubHwDevice(sub_hw_device);
+            dev->addSubHwDevice(sub_hw_device, sub_hal_configs->at(it - sub_hw_modules->begin()));
         }
     }
 
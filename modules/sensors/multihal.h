@@ -19,6 +19,9 @@
 #include <hardware/sensors.h>
 #include <hardware/hardware.h>
 
+// Each line of the config file names a sub-HAL, optionally followed by the initial and maximum
+// capacity of its event queue:
+//   /vendor/lib64/hw/sensors.foo.so [<capacity> [<max capacity>]]
 static const char* MULTI_HAL_CONFIG_FILE_PATH = "/vendor/etc/sensors/hals.conf";
 
 // Depracated because system partition HAL config file does not satisfy treble requirements.
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the timestamp-ordered merge of the multihal queues with the round-robin read, both
+// for the CPU cost of draining the queues and for the latency the reorder window adds.
+
+#include <algorithm>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <hardware/sensors.h>
+
+#include "SensorEventMerger.h"
+#include "SensorEventQueue.h"
+
+static const int kQueueCapacity = 36;
+static const int64_t kMsToNs = 1000000;
+
+static void fillQueues(std::vector<SensorEventQueue*>& queues) {
+    int count = (int)queues.size();
+    for (int i = 0; i < count; i++) {
+        sensors_event_t* events;
+        int size = queues[i]->getWritableRegion(kQueueCapacity, &events);
+        for (int j = 0; j < size; j++) {
+            events[j].timestamp = j * count + i;
+        }
+        queues[i]->markAsWritten(size);
+    }
+}
+
+static int drainRoundRobin(std::vector<SensorEventQueue*>& queues, sensors_event_t* data) {
+    int count = (int)queues.size();
+    int read = 0;
+    for (int empties = 0, index = 0; empties < count; index = (index + 1) % count) {
+        sensors_event_t* event = queues[index]->peek();
+        if (event == nullptr) {
+            empties++;
+        } else {
+            empties = 0;
+            data[read++] = *event;
+            queues[index]->dequeue();
+        }
+    }
+    return read;
+}
+
+static int drainOrdered(SensorEventMerger* merger, std::vector<SensorEventQueue*>& queues,
+        int64_t nowNs, sensors_event_t* data) {
+    int read = 0;
+    int64_t waitNs;
+    int index;
+    merger->reset(queues);
+    while ((index = merger->pop(nowNs, &waitNs)) >= 0) {
+        data[read++] = *queues[index]->peek();
+        queues[index]->dequeue();
+        merger->push(queues[index], index);
+    }
+    return read;
+}
+
+// CPU cost per event of draining full queues.
+static void BM_DrainRoundRobin(benchmark::State& state) {
+    std::vector<SensorEventQueue*> queues;
+    for (int i = 0; i < state.range(0); i++) {
+        queues.push_back(new SensorEventQueue(kQueueCapacity));
+    }
+    std::vector<sensors_event_t> data(kQueueCapacity * queues.size());
+    int64_t events = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        fillQueues(queues);
+        state.ResumeTiming();
+        events += drainRoundRobin(queues, data.data());
+    }
+    state.SetItemsProcessed(events);
+    for (SensorEventQueue* queue : queues) {
+        delete queue;
+    }
+}
+BENCHMARK(BM_DrainRoundRobin)->DenseRange(2, 6, 2);
+
+static void BM_DrainOrdered(benchmark::State& state) {
+    std::vector<SensorEventQueue*> queues;
+    for (int i = 0; i < state.range(0); i++) {
+        queues.push_back(new SensorEventQueue(kQueueCapacity));
+    }
+    std::vector<sensors_event_t> data(kQueueCapacity * queues.size());
+    SensorEventMerger merger(0);
+    int64_t events = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        fillQueues(queues);
+        state.ResumeTiming();
+        events += drainOrdered(&merger, queues, INT64_MAX, data.data());
+    }
+    state.SetItemsProcessed(events);
+    for (SensorEventQueue* queue : queues) {
+        delete queue;
+    }
+}
+BENCHMARK(BM_DrainOrdered)->DenseRange(2, 6, 2);
+
+// Latency added by the reorder window, in simulated time: three sub-HALs deliver one event at a
+// time at 400, 200 and 5 Hz, and poll() runs every millisecond. A window of 0 ms reads the
+// queues in arrival order, like the round-robin read.
+static void BM_OrderedAddedLatency(benchmark::State& state) {
+    const int64_t periodsNs[] = { 2500000, 5000000, 200000000 };
+    const int64_t windowNs = state.range(0) * kMsToNs;
+    const int64_t durationNs = 1000 * kMsToNs;
+    std::vector<SensorEventQueue*> queues;
+    for (size_t i = 0; i < sizeof(periodsNs) / sizeof(periodsNs[0]); i++) {
+        queues.push_back(new SensorEventQueue(kQueueCapacity));
+    }
+    sensors_event_t data[kQueueCapacity * 3];
+    SensorEventMerger merger(windowNs);
+    int64_t events = 0;
+    int64_t totalLatencyNs = 0;
+    int64_t maxLatencyNs = 0;
+    for (auto _ : state) {
+        for (int64_t nowNs = 0; nowNs < durationNs; nowNs += kMsToNs) {
+            for (size_t i = 0; i < queues.size(); i++) {
+                if (nowNs % periodsNs[i] == 0) {
+                    sensors_event_t* event;
+                    queues[i]->getWritableRegion(1, &event);
+                    event->timestamp = nowNs;
+                    queues[i]->markAsWritten(1);
+                }
+            }
+            int read = windowNs > 0 ? drainOrdered(&merger, queues, nowNs, data)
+                                    : drainRoundRobin(queues, data);
+            for (int i = 0; i < read; i++) {
+                int64_t latencyNs = nowNs - data[i].timestamp;
+                totalLatencyNs += latencyNs;
+                maxLatencyNs = std::max(maxLatencyNs, latencyNs);
+            }
+            events += read;
+        }
+        events += drainRoundRobin(queues, data);
+    }
+    state.SetItemsProcessed(events);
+    state.counters["avg_added_latency_us"] = events ? totalLatencyNs / 1000.0 / events : 0;
+    state.counters["max_added_latency_us"] = maxLatencyNs / 1000.0;
+    for (SensorEventQueue* queue : queues) {
+        delete queue;
+    }
+}
+BENCHMARK(BM_OrderedAddedLatency)->Arg(0)->Arg(1)->Arg(5)->Arg(20);
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+#include <hardware/sensors.h>
+
+#include <vector>
+
+#include "SensorEventMerger.h"
+#include "SensorEventQueue.h"
+
+static const int64_t kWindowNs = 10;
+
+class SensorEventMergerTest : public testing::Test {
+protected:
+    void SetUp() override {
+        for (int i = 0; i < 3; i++) {
+            queues_.push_back(new SensorEventQueue(8));
+        }
+    }
+
+    void TearDown() override {
+        for (SensorEventQueue* queue : queues_) {
+            delete queue;
+        }
+    }
+
+    void write(int index, std::vector<int64_t> timestamps) {
+        for (int64_t timestamp : timestamps) {
+            sensors_event_t* event;
+            ASSERT_EQ(1, queues_[index]->getWritableRegion(1, &event));
+            event->timestamp = timestamp;
+            queues_[index]->markAsWritten(1);
+        }
+    }
+
+    // Reads everything deliverable at nowNs, returning the timestamps in delivery order.
+    std::vector<int64_t> drain(SensorEventMerger* merger, int64_t nowNs, int64_t* waitNs) {
+        std::vector<int64_t> result;
+        merger->reset(queues_);
+        int index;
+        while ((index = merger->pop(nowNs, waitNs)) >= 0) {
+            result.push_back(queues_[index]->peek()->timestamp);
+            queues_[index]->dequeue();
+            merger->push(queues_[index], index);
+        }
+        return result;
+    }
+
+    std::vector<SensorEventQueue*> queues_;
+};
+
+TEST_F(SensorEventMergerTest, EmptyQueues) {
+    SensorEventMerger merger(kWindowNs);
+    int64_t waitNs = 0;
+    EXPECT_TRUE(drain(&merger, 100, &waitNs).empty());
+    EXPECT_EQ(-1, waitNs);
+}
+
+TEST_F(SensorEventMergerTest, OrdersAcrossQueues) {
+    SensorEventMerger merger(kWindowNs);
+    write(0, {1, 4, 7});
+    write(1, {2, 5, 8});
+    write(2, {3, 6, 9});
+
+    // Time is not advanced: only events that are provably the oldest come out, and the last
+    // one is held back once its queue runs dry.
+    int64_t waitNs = 0;
+    EXPECT_EQ(std::vector<int64_t>({1, 2, 3, 4, 5, 6, 7}), drain(&merger, 9, &waitNs));
+    EXPECT_EQ(8 + kWindowNs - 9, waitNs);
+
+    // After the window has passed, the rest is released in order.
+    EXPECT_EQ(std::vector<int64_t>({8, 9}), drain(&merger, 9 + kWindowNs, &waitNs));
+}
+
+TEST_F(SensorEventMergerTest, HoldsEventsWithinWindow) {
+    SensorEventMerger merger(kWindowNs);
+    write(0, {100, 120});
+    write(1, {110});
+
+    int64_t waitNs = 0;
+    EXPECT_TRUE(drain(&merger, 105, &waitNs).empty());
+    EXPECT_EQ(5, waitNs);
+
+    // A late event from the idle queue still comes out first.
+    write(2, {90});
+    EXPECT_EQ(std::vector<int64_t>({90}), drain(&merger, 105, &waitNs));
+    EXPECT_EQ(std::vector<int64_t>({100, 110, 120}), drain(&merger, 200, &waitNs));
+}
+
+TEST_F(SensorEventMergerTest, KeepsQueueOrder) {
+    SensorEventMerger merger(kWindowNs);
+    // Events from one queue are never reordered, even if their timestamps are.
+    write(0, {5, 1});
+    write(1, {3});
+    write(2, {4});
+
+    int64_t waitNs = 0;
+    EXPECT_EQ(std::vector<int64_t>({3, 4, 5, 1}), drain(&merger, 100, &waitNs));
+}
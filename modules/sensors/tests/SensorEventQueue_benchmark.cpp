@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Contention benchmark for the multihal event queues. Each producer thread plays the role of a
+// sub-HAL writerTask and a single consumer plays the role of sensors_poll_context_t::poll(),
+// draining all queues round-robin.
+//
+// Run it like this:
+//
+// m sensorsbenchmark
+// out/host/linux-x86/benchmarktest64/sensorsbenchmark/sensorsbenchmark
+
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <hardware/sensors.h>
+
+#include "SensorEventQueue.h"
+#include "SensorHandleTable.h"
+
+static const int kQueueCapacity = 36;
+static const int kEventsPerProducer = 20000;
+// Number of events a sub-HAL poll() returns at once.
+static const int kBatchSize = 4;
+
+// The previous multihal scheme: every queue, writer and the reader share one mutex, and the
+// reader sleeps on a condition variable.
+struct GlobalLockScheme {
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t dataAvailable = PTHREAD_COND_INITIALIZER;
+    bool waiting = false;
+
+    void produce(SensorEventQueue* queue) {
+        sensors_event_t* buffer;
+        int written = 0;
+        while (written < kEventsPerProducer) {
+            pthread_mutex_lock(&mutex);
+            queue->waitForSpace(&mutex);
+            int size = queue->getWritableRegion(kBatchSize, &buffer);
+            pthread_mutex_unlock(&mutex);
+
+            for (int i = 0; i < size; i++) {
+                buffer[i].timestamp = written + i;
+            }
+
+            pthread_mutex_lock(&mutex);
+            queue->markAsWritten(size);
+            if (waiting) {
+                pthread_cond_broadcast(&dataAvailable);
+            }
+            pthread_mutex_unlock(&mutex);
+            written += size;
+        }
+    }
+
+    int consume(std::vector<SensorEventQueue*>& queues, sensors_event_t* data, int maxReads) {
+        int read = 0;
+        pthread_mutex_lock(&mutex);
+        while (read == 0) {
+            for (SensorEventQueue* queue : queues) {
+                sensors_event_t* event;
+                while (read < maxReads && (event = queue->peek()) != nullptr) {
+                    data[read++] = *event;
+                    queue->dequeue();
+                }
+            }
+            if (read == 0) {
+                waiting = true;
+                pthread_cond_wait(&dataAvailable, &mutex);
+                waiting = false;
+            }
+        }
+        pthread_mutex_unlock(&mutex);
+        return read;
+    }
+};
+
+// The lock-free scheme: queues are only shared by their writer and the reader, which sleeps on
+// an eventfd.
+struct LockFreeScheme {
+    int fd = eventfd(0, EFD_CLOEXEC);
+    std::atomic<bool> waiting{false};
+
+    ~LockFreeScheme() { close(fd); }
+
+    void produce(SensorEventQueue* queue) {
+        sensors_event_t* buffer;
+        int written = 0;
+        while (written < kEventsPerProducer) {
+            queue->waitForSpace();
+            int size = queue->getWritableRegion(kBatchSize, &buffer);
+            for (int i = 0; i < size; i++) {
+                buffer[i].timestamp = written + i;
+            }
+            queue->markAsWritten(size);
+            if (waiting.load()) {
+                uint64_t one = 1;
+                TEMP_FAILURE_RETRY(write(fd, &one, sizeof(one)));
+            }
+            written += size;
+        }
+    }
+
+    int consume(std::vector<SensorEventQueue*>& queues, sensors_event_t* data, int maxReads) {
+        int read = 0;
+        while (read == 0) {
+            for (SensorEventQueue* queue : queues) {
+                sensors_event_t* event;
+                while (read < maxReads && (event = queue->peek()) != nullptr) {
+                    data[read++] = *event;
+                    queue->dequeue();
+                }
+            }
+            if (read == 0) {
+                waiting.store(true);
+                bool empty = true;
+                for (SensorEventQueue* queue : queues) {
+                    empty = empty && queue->getSize() == 0;
+                }
+                if (empty) {
+                    uint64_t count;
+                    TEMP_FAILURE_RETRY(::read(fd, &count, sizeof(count)));
+                }
+                waiting.store(false);
+            }
+        }
+        return read;
+    }
+};
+
+template <typename Scheme>
+static void BM_MultiProducerDrain(benchmark::State& state) {
+    const int producers = state.range(0);
+    sensors_event_t data[kQueueCapacity];
+    for (auto _ : state) {
+        Scheme scheme;
+        std::vector<SensorEventQueue*> queues;
+        for (int i = 0; i < producers; i++) {
+            queues.push_back(new SensorEventQueue(kQueueCapacity));
+        }
+        std::vector<std::thread> threads;
+        for (SensorEventQueue* queue : queues) {
+            threads.emplace_back([&scheme, queue] { scheme.produce(queue); });
+        }
+        int total = producers * kEventsPerProducer;
+        while (total > 0) {
+            total -= scheme.consume(queues, data, kQueueCapacity);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (SensorEventQueue* queue : queues) {
+            delete queue;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * producers * kEventsPerProducer);
+}
+
+BENCHMARK_TEMPLATE(BM_MultiProducerDrain, GlobalLockScheme)
+        ->DenseRange(1, 6)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_MultiProducerDrain, LockFreeScheme)
+        ->DenseRange(1, 6)->UseRealTime();
+
+// Reader side only: moving events from full queues into the poll() buffer and remapping their
+// handles, one event at a time or in contiguous runs.
+static const int kPollBufferSize = 128;
+static const int kDrainQueues = 6;
+
+static void fillForDrain(std::vector<SensorEventQueue*>& queues) {
+    for (SensorEventQueue* queue : queues) {
+        sensors_event_t* buffer;
+        int size;
+        while ((size = queue->getWritableRegion(kQueueCapacity, &buffer)) > 0) {
+            for (int i = 0; i < size; i++) {
+                buffer[i].type = SENSOR_TYPE_ACCELEROMETER;
+                buffer[i].sensor = 1 + i % 4;
+            }
+            queue->markAsWritten(size);
+        }
+    }
+}
+
+static int drainPerEvent(std::vector<SensorEventQueue*>& queues, const SensorHandleTable& table,
+        sensors_event_t* data) {
+    int read = 0;
+    for (int index = 0, empties = 0; empties < (int)queues.size() && read < kPollBufferSize;
+            index = (index + 1) % queues.size()) {
+        sensors_event_t* event = queues[index]->peek();
+        if (event == nullptr) {
+            empties++;
+            continue;
+        }
+        empties = 0;
+        data[read] = *event;
+        data[read].sensor = table.getGlobalHandle(index, event->sensor);
+        read++;
+        queues[index]->dequeue();
+    }
+    return read;
+}
+
+static int drainBulk(std::vector<SensorEventQueue*>& queues, const SensorHandleTable& table,
+        sensors_event_t* data) {
+    int read = 0;
+    for (int index = 0, empties = 0; empties < (int)queues.size() && read < kPollBufferSize;
+            index = (index + 1) % queues.size()) {
+        int share = std::max(1, (kPollBufferSize - read) / (int)queues.size());
+        sensors_event_t* events;
+        int count = queues[index]->getReadableRegion(share, &events);
+        if (count == 0) {
+            empties++;
+            continue;
+        }
+        empties = 0;
+        memcpy(&data[read], events, count * sizeof(sensors_event_t));
+        table.remapEvents(index, &data[read], count);
+        read += count;
+        queues[index]->markAsRead(count);
+    }
+    return read;
+}
+
+template <int (*Drain)(std::vector<SensorEventQueue*>&, const SensorHandleTable&,
+        sensors_event_t*)>
+static void BM_Drain(benchmark::State& state) {
+    std::vector<SensorEventQueue*> queues;
+    SensorHandleTable table;
+    for (int i = 0; i < kDrainQueues; i++) {
+        queues.push_back(new SensorEventQueue(kQueueCapacity));
+        for (int handle = 1; handle <= 4; handle++) {
+            table.add(i, handle);
+        }
+    }
+    sensors_event_t data[kPollBufferSize];
+    int64_t events = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        fillForDrain(queues);
+        state.ResumeTiming();
+        int read;
+        while ((read = Drain(queues, table, data)) > 0) {
+            events += read;
+        }
+        benchmark::DoNotOptimize(data);
+    }
+    state.SetItemsProcessed(events);
+    for (SensorEventQueue* queue : queues) {
+        delete queue;
+    }
+}
+BENCHMARK_TEMPLATE(BM_Drain, drainPerEvent);
+BENCHMARK_TEMPLATE(BM_Drain, drainBulk);
+
+BENCHMARK_MAIN();
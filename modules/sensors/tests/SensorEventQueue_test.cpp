@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <hardware/sensors.h>
 #include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 #include <cutils/atomic.h>
 
 #include "SensorEventQueue.h"
@@ -88,7 +90,41 @@ bool testWrappingWriteSizeCounts() {
     return true;
 }
 
+bool checkReadableBufferSize(SensorEventQueue* queue, int requested, int expected) {
+    sensors_event_t* buffer;
+    int actual = queue->getReadableRegion(requested, &buffer);
+    if (actual != expected) {
+        printf("Expected readable size was %d; actual was %d\n", expected, actual);
+        return false;
+    }
+    return true;
+}
 
+bool testWrappingReadSizeCounts() {
+    printf("testWrappingReadSizeCounts\n");
+    SensorEventQueue* queue = new SensorEventQueue(10);
+    if (!checkReadableBufferSize(queue, 10, 0)) return false;
+
+    queue->markAsWritten(8);
+    if (!checkReadableBufferSize(queue, 100, 8)) return false;
+    if (!checkReadableBufferSize(queue, 3, 3)) return false;
+
+    queue->markAsRead(6);
+    if (!checkSize(queue, 2)) return false;
+    // Write past the end of the data array.
+    queue->markAsWritten(4);
+    if (!checkSize(queue, 6)) return false;
+    // Only the records up to the end of the data array are contiguous.
+    if (!checkReadableBufferSize(queue, 100, 4)) return false;
+
+    queue->markAsRead(4);
+    if (!checkReadableBufferSize(queue, 100, 2)) return false;
+    queue->markAsRead(100);
+    if (!checkSize(queue, 0)) return false;
+
+    printf("passed\n");
+    return true;
+}
 
 struct TaskContext {
   bool success;
@@ -186,11 +222,118 @@ bool testFullQueueIo() {
     return true;
 }
 
+int LOCK_FREE_QUEUE_CAPACITY = 7;
+int LOCK_FREE_EVENT_COUNT = 100000;
+
+void* lockFreeWriterTask(void* ptr) {
+    TaskContext* ctx = (TaskContext*)ptr;
+    SensorEventQueue* queue = ctx->queue;
+    sensors_event_t* buffer;
+    int totalWrites = 0;
+    while (totalWrites < LOCK_FREE_EVENT_COUNT) {
+        queue->waitForSpace();
+        int writableSize = queue->getWritableRegion(LOCK_FREE_EVENT_COUNT - totalWrites, &buffer);
+        for (int i = 0; i < writableSize; i++) {
+            buffer[i].timestamp = totalWrites++;
+        }
+        queue->markAsWritten(writableSize);
+    }
+    ctx->success = checkInt("totalWrites", LOCK_FREE_EVENT_COUNT, totalWrites);
+    return NULL;
+}
+
+void* lockFreeReaderTask(void* ptr) {
+    TaskContext* ctx = (TaskContext*)ptr;
+    SensorEventQueue* queue = ctx->queue;
+    int totalReads = 0;
+    ctx->success = true;
+    while (totalReads < LOCK_FREE_EVENT_COUNT) {
+        sensors_event_t* event = queue->peek();
+        if (event == NULL) {
+            sched_yield();
+            continue;
+        }
+        if (!checkInt("event order", totalReads, (int)event->timestamp)) {
+            ctx->success = false;
+            break;
+        }
+        queue->dequeue();
+        totalReads++;
+    }
+    return NULL;
+}
+
+// Test concurrent writing and reading without an external lock.
+bool testLockFreeIo() {
+    printf("testLockFreeIo\n");
+    SensorEventQueue* queue = new SensorEventQueue(LOCK_FREE_QUEUE_CAPACITY);
+
+    TaskContext readerCtx;
+    readerCtx.success = true;
+    readerCtx.queue = queue;
+
+    TaskContext writerCtx;
+    writerCtx.success = true;
+    writerCtx.queue = queue;
+
+    pthread_t writer, reader;
+    pthread_create(&reader, NULL, lockFreeReaderTask, &readerCtx);
+    pthread_create(&writer, NULL, lockFreeWriterTask, &writerCtx);
+
+    pthread_join(writer, NULL);
+    pthread_join(reader, NULL);
+
+    if (!readerCtx.success || !writerCtx.success) return false;
+    if (!checkSize(queue, 0)) return false;
+    printf("passed\n");
+    return true;
+}
+
+// Test that a queue grows while the writer waits on it, without losing or reordering events.
+bool testGrowingQueueIo() {
+    printf("testGrowingQueueIo\n");
+    SensorEventQueue* queue = new SensorEventQueue(2, 64);
+
+    TaskContext readerCtx;
+    readerCtx.success = true;
+    readerCtx.queue = queue;
+
+    TaskContext writerCtx;
+    writerCtx.success = true;
+    writerCtx.queue = queue;
+
+    pthread_t writer, reader;
+    pthread_create(&writer, NULL, lockFreeWriterTask, &writerCtx);
+    // Give the writer a head start so that it fills the queue.
+    usleep(10000);
+    pthread_create(&reader, NULL, lockFreeReaderTask, &readerCtx);
+
+    pthread_join(writer, NULL);
+    pthread_join(reader, NULL);
+
+    if (!readerCtx.success || !writerCtx.success) return false;
+    SensorEventQueue::Stats stats = queue->getStats();
+    if (stats.stallCount == 0 || stats.capacity <= 2) {
+        printf("Expected the queue to grow; capacity %d, stalls %d\n", stats.capacity,
+                stats.stallCount);
+        return false;
+    }
+    if (!checkInt("maxCapacity", 64, stats.maxCapacity)) return false;
+    if (stats.highWaterMark > stats.capacity) {
+        printf("High-water mark %d above capacity %d\n", stats.highWaterMark, stats.capacity);
+        return false;
+    }
+    printf("passed\n");
+    return true;
+}
 
 int main(int argc __attribute((unused)), char **argv __attribute((unused))) {
     if (testSimpleWriteSizeCounts() &&
             testWrappingWriteSizeCounts() &&
-            testFullQueueIo()) {
+            testWrappingReadSizeCounts() &&
+            testFullQueueIo() &&
+            testLockFreeIo() &&
+            testGrowingQueueIo()) {
         printf("ALL PASSED\n");
     } else {
         printf("SOMETHING FAILED\n");
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Handle remapping of event bursts, as done by the multihal poll(), with SensorHandleTable and
+// with the std::map based translation it replaced.
+
+#include <string.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <hardware/sensors.h>
+
+#include "SensorHandleTable.h"
+
+static const int kModules = 6;
+static const int kSensorsPerModule = 20;
+
+// The previous translation: count() followed by operator[] on a map keyed by full handle.
+class MapHandleTable {
+public:
+    void add(int moduleIndex, int localHandle) {
+        mFullToGlobal[std::make_pair(moduleIndex, localHandle)] = mNextGlobalHandle++;
+    }
+
+    int getGlobalHandle(int moduleIndex, int localHandle) {
+        std::pair<int, int> fullHandle(moduleIndex, localHandle);
+        if (mFullToGlobal.count(fullHandle) == 0) {
+            return -1;
+        }
+        return mFullToGlobal[fullHandle];
+    }
+
+private:
+    std::map<std::pair<int, int>, int> mFullToGlobal;
+    int mNextGlobalHandle = 1;
+};
+
+template <typename Table>
+static void remapBurst(Table& table, const sensors_event_t* src, sensors_event_t* dest,
+        int count, int moduleIndex) {
+    memcpy(dest, src, count * sizeof(sensors_event_t));
+    for (int i = 0; i < count; i++) {
+        if (dest[i].type == SENSOR_TYPE_META_DATA) {
+            dest[i].meta_data.sensor = table.getGlobalHandle(moduleIndex, dest[i].meta_data.sensor);
+        } else {
+            dest[i].sensor = table.getGlobalHandle(moduleIndex, dest[i].sensor);
+        }
+    }
+}
+
+template <typename Table>
+static void BM_RemapBurst(benchmark::State& state) {
+    const int burst = state.range(0);
+    Table table;
+    for (int module = 0; module < kModules; module++) {
+        for (int handle = 1; handle <= kSensorsPerModule; handle++) {
+            table.add(module, handle);
+        }
+    }
+    std::vector<sensors_event_t> src(burst);
+    std::vector<sensors_event_t> dest(burst);
+    for (int i = 0; i < burst; i++) {
+        memset(&src[i], 0, sizeof(sensors_event_t));
+        src[i].type = SENSOR_TYPE_ACCELEROMETER;
+        src[i].sensor = 1 + (i * 7) % kSensorsPerModule;
+    }
+    int module = 0;
+    for (auto _ : state) {
+        remapBurst(table, src.data(), dest.data(), burst, module);
+        benchmark::DoNotOptimize(dest.data());
+        module = (module + 1) % kModules;
+    }
+    state.SetItemsProcessed(state.iterations() * burst);
+}
+
+BENCHMARK_TEMPLATE(BM_RemapBurst, MapHandleTable)->RangeMultiplier(4)->Range(36, 2304);
+BENCHMARK_TEMPLATE(BM_RemapBurst, SensorHandleTable)->RangeMultiplier(4)->Range(36, 2304);
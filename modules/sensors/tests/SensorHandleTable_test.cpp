@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#include "SensorHandleTable.h"
+
+TEST(SensorHandleTableTest, AssignsConsecutiveGlobalHandles) {
+    SensorHandleTable table;
+    EXPECT_EQ(1, table.add(0, 5));
+    EXPECT_EQ(2, table.add(0, 7));
+    EXPECT_EQ(3, table.add(1, 5));
+    EXPECT_EQ(3, table.size());
+
+    EXPECT_EQ(1, table.getGlobalHandle(0, 5));
+    EXPECT_EQ(2, table.getGlobalHandle(0, 7));
+    EXPECT_EQ(3, table.getGlobalHandle(1, 5));
+
+    EXPECT_EQ(0, table.getModuleIndex(2));
+    EXPECT_EQ(7, table.getLocalHandle(2));
+    EXPECT_EQ(1, table.getModuleIndex(3));
+    EXPECT_EQ(5, table.getLocalHandle(3));
+}
+
+TEST(SensorHandleTableTest, UnknownHandles) {
+    SensorHandleTable table;
+    table.add(0, 5);
+    table.add(0, 7);
+
+    // Holes, and handles around the range of the module.
+    EXPECT_EQ(-1, table.getGlobalHandle(0, 6));
+    EXPECT_EQ(-1, table.getGlobalHandle(0, 4));
+    EXPECT_EQ(-1, table.getGlobalHandle(0, 8));
+    EXPECT_EQ(-1, table.getGlobalHandle(0, -1));
+    // Unknown modules.
+    EXPECT_EQ(-1, table.getGlobalHandle(1, 5));
+    EXPECT_EQ(-1, table.getGlobalHandle(-1, 5));
+    // Unknown global handles.
+    for (int handle : {-1, 0, 3}) {
+        EXPECT_EQ(-1, table.getLocalHandle(handle));
+        EXPECT_EQ(-1, table.getModuleIndex(handle));
+    }
+}
+
+TEST(SensorHandleTableTest, DescendingLocalHandles) {
+    SensorHandleTable table;
+    EXPECT_EQ(1, table.add(0, 10));
+    EXPECT_EQ(2, table.add(0, 3));
+    EXPECT_EQ(3, table.add(0, 6));
+
+    EXPECT_EQ(1, table.getGlobalHandle(0, 10));
+    EXPECT_EQ(2, table.getGlobalHandle(0, 3));
+    EXPECT_EQ(3, table.getGlobalHandle(0, 6));
+    EXPECT_EQ(-1, table.getGlobalHandle(0, 4));
+}
+
+TEST(SensorHandleTableTest, SparseLocalHandles) {
+    SensorHandleTable table;
+    EXPECT_EQ(1, table.add(0, 1));
+    EXPECT_EQ(2, table.add(0, 2));
+    EXPECT_EQ(3, table.add(0, 0x10000));
+    EXPECT_EQ(4, table.add(0, -0x10000));
+    EXPECT_EQ(5, table.add(1, 1));
+
+    EXPECT_EQ(1, table.getGlobalHandle(0, 1));
+    EXPECT_EQ(2, table.getGlobalHandle(0, 2));
+    EXPECT_EQ(3, table.getGlobalHandle(0, 0x10000));
+    EXPECT_EQ(4, table.getGlobalHandle(0, -0x10000));
+    EXPECT_EQ(-1, table.getGlobalHandle(0, 3));
+    EXPECT_EQ(5, table.getGlobalHandle(1, 1));
+    EXPECT_EQ(0x10000, table.getLocalHandle(3));
+}
+
+TEST(SensorHandleTableTest, RemapEvents) {
+    SensorHandleTable table;
+    table.add(0, 1);
+    table.add(1, 1);
+    table.add(1, 2);
+
+    sensors_event_t events[3] = {};
+    events[0].type = SENSOR_TYPE_ACCELEROMETER;
+    events[0].sensor = 2;
+    events[1].type = SENSOR_TYPE_META_DATA;
+    events[1].meta_data.sensor = 1;
+    events[2].type = SENSOR_TYPE_ACCELEROMETER;
+    events[2].sensor = 3;
+    table.remapEvents(1, events, 3);
+
+    EXPECT_EQ(3, events[0].sensor);
+    EXPECT_EQ(0, events[1].sensor);
+    EXPECT_EQ(2, events[1].meta_data.sensor);
+    EXPECT_EQ(-1, events[2].sensor);
+}